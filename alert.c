@@ -3,28 +3,48 @@
 #include "rental.h"
 #include "vehicle.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <time.h>
 
-void displayAdminAlerts(Rental *rentalHead, Vehicle *vehicleHead)
+static int compareInts(const void *a, const void *b)
+{
+    int x = *(const int *)a, y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+
+void displayAdminAlerts(const RentalTable *rentals, Vehicle *vehicleHead)
 {
     time_t now = time(NULL);
+    time_t tomorrow = now + (24 * 60 * 60);
     int overdue_count = 0;
     int maintenance_count = 0;
     int upcoming_conflicts = 0;
 
-    // Check for overdue rentals
-    for (Rental *r = rentalHead; r; r = r->next)
+    // One pass over the hot rental rows: count overdue rentals and collect the
+    // vehicles of active rentals that end within the next 24 hours.
+    int *endingSoon = NULL;
+    size_t endingCount = 0, endingCapacity = 0;
+    for (size_t i = 0; i < rentals->count; i++)
     {
-        if (r->status == RENT_ACTIVE)
+        const Rental *r = &rentals->rows[i];
+        if (r->status != RENT_ACTIVE || !r->endAt)
+            continue;
+        if (now > r->endAt)
+        {
+            overdue_count++;
+        }
+        else if (r->endAt > now && r->endAt <= tomorrow)
         {
-            time_t endTime;
-            if (stringToTime(r->endTime, &endTime))
+            if (endingCount == endingCapacity)
             {
-                if (now > endTime)
-                {
-                    overdue_count++;
-                }
+                size_t capacity = endingCapacity ? endingCapacity * 2 : 64;
+                int *grown = (int *)realloc(endingSoon, capacity * sizeof(int));
+                if (!grown)
+                    break;
+                endingSoon = grown;
+                endingCapacity = capacity;
             }
+            endingSoon[endingCount++] = r->vehicleId;
         }
     }
 
@@ -37,34 +57,27 @@ void displayAdminAlerts(Rental *rentalHead, Vehicle *vehicleHead)
         }
     }
 
-    // Check for potential booking conflicts in next 24 hours
-    time_t tomorrow = now + (24 * 60 * 60);
-    for (Vehicle *v = vehicleHead; v; v = v->next)
+    // Potential booking conflicts: an available vehicle with more than one
+    // active rental ending in the next 24 hours.
+    if (endingCount > 1)
     {
-        if (v->active && v->available)
+        qsort(endingSoon, endingCount, sizeof(int), compareInts);
+        for (Vehicle *v = vehicleHead; v; v = v->next)
         {
-            // Count active rentals for this vehicle that end within 24 hours
-            int vehicleRentals = 0;
-            for (Rental *r = rentalHead; r; r = r->next)
-            {
-                if (r->vehicleId == v->id && r->status == RENT_ACTIVE)
-                {
-                    time_t endTime;
-                    if (stringToTime(r->endTime, &endTime))
-                    {
-                        if (endTime <= tomorrow && endTime > now)
-                        {
-                            vehicleRentals++;
-                        }
-                    }
-                }
-            }
-            if (vehicleRentals > 1)
+            if (!v->active || !v->available)
+                continue;
+            int *hit = (int *)bsearch(&v->id, endingSoon, endingCount, sizeof(int), compareInts);
+            if (!hit)
+                continue;
+            // Sorted, so a second rental for the same vehicle sits right next to the hit.
+            if ((hit > endingSoon && hit[-1] == v->id) ||
+                (hit + 1 < endingSoon + endingCount && hit[1] == v->id))
             {
                 upcoming_conflicts++;
             }
         }
     }
+    free(endingSoon);
 
     if (overdue_count > 0 || maintenance_count > 0 || upcoming_conflicts > 0)
     {
@@ -5,10 +5,10 @@
 #define ALERT_H
 
 // Forward declarations to keep this header independent
-struct RentalNode;
+struct RentalTable;
 struct VehicleNode;
 
 // Displays system alerts (e.g., overdue rentals) at the top of the admin menu.
-void displayAdminAlerts(struct RentalNode *rentalHead, struct VehicleNode *vehicleHead);
+void displayAdminAlerts(const struct RentalTable *rentals, struct VehicleNode *vehicleHead);
 
 #endif // ALERT_H
@@ -0,0 +1,380 @@
+#include "archive.h"
+#include "asyncio.h"
+#include "atomicfile.h"
+#include "lz.h"
+#include "partition.h"
+#include "utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#endif
+
+// A segment is this line, with the text's length, then the text in blocks of at
+// most LZ_MAX_BLOCK bytes: two 32-bit lengths (the text, then what is stored; equal
+// when the block did not compress) and the stored bytes.
+#define SEGMENT_MAGIC "RideMate cold segment 1"
+
+void coldTierInit(ColdTier *cold, const char *dir)
+{
+    memset(cold, 0, sizeof(*cold));
+    cold->dir = dir;
+}
+
+void coldTierClear(ColdTier *cold)
+{
+    free(cold->months);
+    free(cold->rollups);
+    coldTierInit(cold, cold->dir);
+}
+
+static int searchColdMonth(const ColdTier *cold, int month)
+{
+    int lo = 0, hi = cold->count;
+    while (lo < hi)
+    {
+        int mid = lo + (hi - lo) / 2;
+        if (cold->months[mid].month < month)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+const ColdMonth *findColdMonth(const ColdTier *cold, int month)
+{
+    int at = searchColdMonth(cold, month);
+    return at < cold->count && cold->months[at].month == month ? &cold->months[at] : NULL;
+}
+
+void coldSegmentPath(const ColdTier *cold, int month, char *buf, size_t size)
+{
+    snprintf(buf, size, "%s/%04d-%02d.cold", cold->dir, month / 100, month % 100);
+}
+
+ColdMonth *addColdMonth(ColdTier *cold, int month)
+{
+    int at = searchColdMonth(cold, month);
+    if (at < cold->count && cold->months[at].month == month)
+        return &cold->months[at];
+    ColdMonth *months = (ColdMonth *)realloc(cold->months, (size_t)(cold->count + 1) * sizeof(ColdMonth));
+    if (!months)
+        return NULL;
+    cold->months = months;
+    memmove(&months[at + 1], &months[at], (size_t)(cold->count - at) * sizeof(ColdMonth));
+    cold->count++;
+    memset(&months[at], 0, sizeof(ColdMonth));
+    months[at].month = month;
+    return &months[at];
+}
+
+static int compareRollupKey(const RentalRollup *r, int month, int vehicleId)
+{
+    if (r->month != month)
+        return r->month < month ? -1 : 1;
+    return (r->vehicleId > vehicleId) - (r->vehicleId < vehicleId);
+}
+
+// Position of (month, vehicleId) in the rollups, or where it would go.
+static int searchRollup(const ColdTier *cold, int month, int vehicleId)
+{
+    int lo = 0, hi = cold->rollupCount;
+    while (lo < hi)
+    {
+        int mid = lo + (hi - lo) / 2;
+        if (compareRollupKey(&cold->rollups[mid], month, vehicleId) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+RentalRollup *coldRollupFor(ColdTier *cold, int month, int vehicleId)
+{
+    int at = searchRollup(cold, month, vehicleId);
+    if (at < cold->rollupCount && compareRollupKey(&cold->rollups[at], month, vehicleId) == 0)
+        return &cold->rollups[at];
+    if (cold->rollupCount == cold->rollupCapacity)
+    {
+        int capacity = cold->rollupCapacity ? cold->rollupCapacity * 2 : 256;
+        RentalRollup *rollups = (RentalRollup *)realloc(cold->rollups, (size_t)capacity * sizeof(RentalRollup));
+        if (!rollups)
+            return NULL;
+        cold->rollups = rollups;
+        cold->rollupCapacity = capacity;
+    }
+    RentalRollup *r = &cold->rollups[at];
+    memmove(r + 1, r, (size_t)(cold->rollupCount - at) * sizeof(RentalRollup));
+    cold->rollupCount++;
+    memset(r, 0, sizeof(*r));
+    r->month = month;
+    r->vehicleId = vehicleId;
+    return r;
+}
+
+int coldRollupsOf(const ColdTier *cold, int month, const RentalRollup **first)
+{
+    int at = searchRollup(cold, month, INT32_MIN);
+    int end = searchRollup(cold, month + 1, INT32_MIN);
+    *first = cold->rollups + at;
+    return end - at;
+}
+
+void coldVehicleRatings(const ColdTier *cold, int vehicleId, long *sum, long *count)
+{
+    *sum = 0;
+    *count = 0;
+    for (int i = 0; i < cold->rollupCount; i++)
+    {
+        if (cold->rollups[i].vehicleId == vehicleId)
+        {
+            *sum += cold->rollups[i].ratingSum;
+            *count += cold->rollups[i].ratings;
+        }
+    }
+}
+
+// Copies a segment out of the backup being loaded to where it is read from.
+static int copyColdSegment(const ColdTier *cold, int month)
+{
+    char path[256];
+    coldSegmentPath(cold, month, path, sizeof(path));
+    FILE *in = openDataFile(path);
+    if (!in)
+    {
+        printf("Error: the backup has no %s\n", path);
+        return 0;
+    }
+    struct stat st;
+    if (stat(cold->dir, &st) != 0)
+    {
+#ifdef _WIN32
+        _mkdir(cold->dir);
+#else
+        mkdir(cold->dir, 0755);
+#endif
+    }
+    AtomicFile out;
+    FILE *f = atomicFileOpen(&out, path);
+    char buffer[64 * 1024];
+    size_t n;
+    while (f && (n = fread(buffer, 1, sizeof(buffer), in)) > 0)
+        fwrite(buffer, 1, n, f);
+    int failed = ferror(in);
+    fclose(in);
+    if (!f || failed)
+    {
+        if (f)
+            atomicFileDiscard(&out);
+        printf("Error: could not write %s\n", path);
+        return 0;
+    }
+    return atomicFileCommit(&out) == 0;
+}
+
+int loadColdTier(ColdTier *cold)
+{
+    coldTierClear(cold);
+    char path[256], line[256];
+    snprintf(path, sizeof(path), "%s/" COLD_INDEX_FILE, cold->dir);
+    FILE *f = openDataFile(path);
+    if (!f)
+        return 1; // Nothing archived yet
+    int ok = 1;
+    while (ok && fgets(line, sizeof(line), f))
+    {
+        line[strcspn(line, "\r\n")] = '\0';
+        char *fields[6];
+        if (splitCsvLine(line, fields, 6) < 6)
+            continue;
+        int month = partitionMonthOfText(fields[0]);
+        if (!month)
+            continue; // The header
+        ColdMonth *m = addColdMonth(cold, month);
+        if (!m)
+        {
+            ok = 0;
+            break;
+        }
+        m->rows = atol(fields[1]);
+        m->minId = atoi(fields[2]);
+        m->maxId = atoi(fields[3]);
+        m->minAt = atoll(fields[4]);
+        m->maxAt = atoll(fields[5]);
+    }
+    fclose(f);
+
+    // Rollups of months the index does not list are left over from an archiving
+    // pass that did not finish; those months are still in their .csv files.
+    snprintf(path, sizeof(path), "%s/" COLD_ROLLUP_FILE, cold->dir);
+    f = ok ? openDataFile(path) : NULL;
+    while (f && ok && fgets(line, sizeof(line), f))
+    {
+        line[strcspn(line, "\r\n")] = '\0';
+        char *fields[6];
+        if (splitCsvLine(line, fields, 6) < 6)
+            continue;
+        int month = partitionMonthOfText(fields[0]);
+        Money revenue;
+        if (!month || !findColdMonth(cold, month) || !parseMoney(fields[3], &revenue))
+            continue;
+        RentalRollup *r = coldRollupFor(cold, month, atoi(fields[1]));
+        if (!r)
+        {
+            ok = 0;
+            break;
+        }
+        r->rentals = atol(fields[2]);
+        r->revenue = revenue;
+        r->ratingSum = atol(fields[4]);
+        r->ratings = atol(fields[5]);
+    }
+    if (f)
+        fclose(f);
+
+    for (int i = 0; ok && dataFileSourceSet() && i < cold->count; i++)
+        ok = copyColdSegment(cold, cold->months[i].month);
+    if (!ok)
+        printf("Error: could not load the archived rentals in %s\n", cold->dir);
+    return ok;
+}
+
+int saveColdTier(const ColdTier *cold)
+{
+    // The rollups first: the index is what makes a month count as archived.
+    char path[256];
+    snprintf(path, sizeof(path), "%s/" COLD_ROLLUP_FILE, cold->dir);
+    AsyncFile out;
+    FILE *f = asyncFileOpen(&out, path);
+    if (!f)
+    {
+        printf("Error: could not open %s\n", path);
+        return 0;
+    }
+    fprintf(f, "month,vehicleId,rentals,revenue,ratingSum,ratings\n");
+    for (int i = 0; i < cold->rollupCount; i++)
+    {
+        const RentalRollup *r = &cold->rollups[i];
+        fprintf(f, "%04d-%02d,%d,%ld," MONEY_FMT ",%ld,%ld\n", r->month / 100, r->month % 100, r->vehicleId,
+                r->rentals, MONEY_ARGS(r->revenue), r->ratingSum, r->ratings);
+    }
+    if (asyncFileClose(&out) < 0)
+        return 0;
+
+    snprintf(path, sizeof(path), "%s/" COLD_INDEX_FILE, cold->dir);
+    f = asyncFileOpen(&out, path);
+    if (!f)
+    {
+        printf("Error: could not open %s\n", path);
+        return 0;
+    }
+    fprintf(f, "month,rows,minId,maxId,minAt,maxAt\n");
+    for (int i = 0; i < cold->count; i++)
+    {
+        const ColdMonth *m = &cold->months[i];
+        fprintf(f, "%04d-%02d,%ld,%d,%d,%lld,%lld\n", m->month / 100, m->month % 100, m->rows, m->minId, m->maxId,
+                (long long)m->minAt, (long long)m->maxAt);
+    }
+    return asyncFileClose(&out) >= 0;
+}
+
+static void put32(unsigned char *p, uint32_t v)
+{
+    memcpy(p, &v, sizeof(v));
+}
+
+static uint32_t get32(const unsigned char *p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+int writeColdSegment(const char *path, const char *text, size_t size)
+{
+    AtomicFile out;
+    FILE *f = atomicFileOpen(&out, path);
+    unsigned char *packed = (unsigned char *)malloc(LZ_MAX_BLOCK);
+    if (!f || !packed)
+    {
+        if (f)
+            atomicFileDiscard(&out);
+        free(packed);
+        printf("Error: could not write %s\n", path);
+        return 0;
+    }
+    fprintf(f, SEGMENT_MAGIC " %zu\n", size);
+    for (size_t at = 0; at < size; at += LZ_MAX_BLOCK)
+    {
+        size_t length = size - at < LZ_MAX_BLOCK ? size - at : LZ_MAX_BLOCK;
+        size_t stored = lzCompress(text + at, length, packed, length - 1);
+        unsigned char lengths[8];
+        put32(lengths, (uint32_t)length);
+        put32(lengths + 4, (uint32_t)(stored ? stored : length));
+        fwrite(lengths, 1, sizeof(lengths), f);
+        fwrite(stored ? (const void *)packed : (const void *)(text + at), 1, stored ? stored : length, f);
+    }
+    free(packed);
+    if (ferror(out.f))
+    {
+        atomicFileDiscard(&out);
+        printf("Error: could not write %s\n", path);
+        return 0;
+    }
+    return atomicFileCommit(&out) == 0;
+}
+
+char *readColdSegment(const char *path, size_t *size)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f)
+        return NULL;
+    char header[64];
+    size_t total = 0;
+    char *text = NULL;
+    unsigned char *packed = (unsigned char *)malloc(LZ_MAX_BLOCK);
+    if (packed && fgets(header, sizeof(header), f) &&
+        strncmp(header, SEGMENT_MAGIC " ", sizeof(SEGMENT_MAGIC)) == 0)
+    {
+        total = strtoull(header + sizeof(SEGMENT_MAGIC), NULL, 10);
+        text = (char *)malloc(total + 1);
+    }
+    size_t at = 0;
+    while (text && at < total)
+    {
+        unsigned char lengths[8];
+        uint32_t length = 0, stored = 0;
+        int ok = fread(lengths, 1, sizeof(lengths), f) == sizeof(lengths);
+        if (ok)
+        {
+            length = get32(lengths);
+            stored = get32(lengths + 4);
+            ok = length <= total - at && stored <= LZ_MAX_BLOCK && fread(packed, 1, stored, f) == stored;
+        }
+        if (ok && stored == length)
+            memcpy(text + at, packed, length);
+        else if (ok)
+            ok = lzDecompress(packed, stored, text + at, length) == (long)length;
+        if (!ok || length == 0)
+        {
+            free(text);
+            text = NULL;
+            break;
+        }
+        at += length;
+    }
+    fclose(f);
+    free(packed);
+    if (!text)
+    {
+        printf("Error: %s is damaged\n", path);
+        return NULL;
+    }
+    text[total] = '\0';
+    *size = total;
+    return text;
+}
@@ -0,0 +1,80 @@
+// File: archive.h
+// Description: Cold tier for rentals. A month whose rentals are all closed and older
+// than RIDEMATE_ARCHIVE_MONTHS leaves data/rentals/YYYY-MM.csv for a compressed
+// segment, YYYY-MM.cold, and is no longer loaded, so the in-memory table only holds
+// recent business. cold.csv lists the archived months with the id range of each, so
+// a single archived rental can still be read back by id, and rollup.csv keeps what
+// reports and reviews need from them: per month and vehicle, the rental count,
+// revenue and ratings.
+
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "money.h"
+
+#define COLD_INDEX_FILE "cold.csv"
+#define COLD_ROLLUP_FILE "rollup.csv"
+
+typedef struct
+{
+    int month; // yyyy * 100 + mm, as in partition.h
+    long rows;
+    int minId; // Ids of its rentals; a lookup by id only reads months that cover it
+    int maxId;
+    int64_t minAt; // Earliest and latest start time
+    int64_t maxAt;
+} ColdMonth;
+
+typedef struct
+{
+    int month;
+    int vehicleId;
+    long rentals;
+    Money revenue;  // Completed rentals only, as the revenue report counts them
+    long ratingSum; // Vehicle ratings given to its rentals
+    long ratings;
+} RentalRollup;
+
+typedef struct
+{
+    const char *dir;        // The rentals directory
+    ColdMonth *months;      // Sorted by month
+    int count;
+    RentalRollup *rollups;  // Sorted by month, then vehicle
+    int rollupCount;
+    int rollupCapacity;
+} ColdTier;
+
+void coldTierInit(ColdTier *cold, const char *dir);
+void coldTierClear(ColdTier *cold);
+const ColdMonth *findColdMonth(const ColdTier *cold, int month);
+// "<dir>/YYYY-MM.cold"
+void coldSegmentPath(const ColdTier *cold, int month, char *buf, size_t size);
+
+// Reads cold.csv and rollup.csv through openDataFile. While a backup is being
+// loaded, the segments are copied out of it as well, since no save writes them.
+// Returns 0 if memory ran out.
+int loadColdTier(ColdTier *cold);
+// Writes cold.csv and rollup.csv with the table's other files (asyncFileOpen).
+int saveColdTier(const ColdTier *cold);
+
+// Adds a month that is about to be archived; its rollups are added with
+// coldRollupFor. Returns NULL if out of memory.
+ColdMonth *addColdMonth(ColdTier *cold, int month);
+// The rollup of one vehicle in one month, added empty if need be. NULL if out of memory.
+RentalRollup *coldRollupFor(ColdTier *cold, int month, int vehicleId);
+// The rollups of one month: *first and the returned count.
+int coldRollupsOf(const ColdTier *cold, int month, const RentalRollup **first);
+// Sums one vehicle's archived ratings over every month.
+void coldVehicleRatings(const ColdTier *cold, int vehicleId, long *sum, long *count);
+
+// Writes 'size' bytes of text as a compressed segment, durably (atomicfile.h).
+// Returns 1 on success.
+int writeColdSegment(const char *path, const char *text, size_t size);
+// Reads a segment back into a malloc'd, NUL-terminated buffer. NULL if it is
+// missing or damaged.
+char *readColdSegment(const char *path, size_t *size);
+
+#endif // ARCHIVE_H
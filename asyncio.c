@@ -0,0 +1,721 @@
+#include "asyncio.h"
+#include "atomicfile.h"
+#include "threadpool.h"
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#define ASYNC_IO_URING 1
+#endif
+
+typedef struct AsyncJob
+{
+    struct AsyncJob *next;
+    long ticket;
+    char *data;
+    size_t length;
+    int append;
+    int error; // First errno, 0 if the file is durable
+    struct timespec queuedAt;
+    char path[256];
+    char temp[264]; // A rewrite is written here and renamed over path
+} AsyncJob;
+
+typedef enum
+{
+    BACKEND_OFF,
+    BACKEND_THREADS,
+    BACKEND_URING
+} Backend;
+
+static pthread_mutex_t queueLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t workReady = PTHREAD_COND_INITIALIZER; // A job was queued, or stop
+static pthread_cond_t batchDone = PTHREAD_COND_INITIALIZER;
+static pthread_t ioThread;
+static Backend backend = BACKEND_OFF;
+static int stopping;
+static long ownerPid; // A forked child must not hand files to its parent's thread
+static AsyncJob *queueHead, *queueTail;
+static long nextTicket, queuedCount, writtenCount, failedCount, batchCount;
+static double durableSeconds; // Summed over written files
+static AsyncIoCompletion completions[ASYNC_IO_COMPLETIONS];
+static int completionHead, completionCount;
+static AsyncFileCapture capture;
+
+static double secondsSince(const struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)(now.tv_sec - start->tv_sec) + (double)(now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+// An append only goes into a file whose last line is complete. A missing or empty
+// file, or one that ends in a line cut off by a crash, has to be rewritten instead.
+static int endsWithNewline(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f)
+        return 0;
+    int ok = fseek(f, -1, SEEK_END) == 0 && fgetc(f) == '\n';
+    fclose(f);
+    return ok;
+}
+
+#ifndef _WIN32
+
+// --- Thread pool backend: one task per file, plain blocking calls ---
+
+// Writes job->data from byte 'done' on into a file opened with 'flags', then
+// fsyncs and closes it; the first failure is left in job->error.
+static void writeFrom(AsyncJob *job, size_t done, int flags)
+{
+    const char *target = job->append ? job->path : job->temp;
+    int fd = open(target, O_WRONLY | O_CLOEXEC | flags, 0644);
+    if (fd < 0)
+    {
+        job->error = errno;
+        return;
+    }
+    while (done < job->length && !job->error)
+    {
+        ssize_t n = write(fd, job->data + done, job->length - done);
+        if (n < 0 && errno != EINTR)
+            job->error = errno;
+        else if (n > 0)
+            done += (size_t)n;
+    }
+    if (!job->error && fsync(fd) < 0)
+        job->error = errno;
+    if (close(fd) < 0 && !job->error)
+        job->error = errno;
+}
+
+static void writeJob(void *arg)
+{
+    AsyncJob *job = (AsyncJob *)arg;
+    writeFrom(job, 0, O_CREAT | (job->append ? O_APPEND : O_TRUNC));
+}
+
+static void writeBatchWithThreads(AsyncJob **jobs, int count)
+{
+    TaskGroup group;
+    taskGroupInit(&group);
+    for (int i = 0; i < count; i++)
+        threadPoolSubmit(&group, writeJob, jobs[i]);
+    taskGroupWait(&group);
+    taskGroupDestroy(&group);
+}
+
+#endif // _WIN32
+
+#ifdef ASYNC_IO_URING
+
+// --- io_uring backend ---
+// Each file is one hard-linked chain: open into a registered file slot, write,
+// fsync, close the slot. The rename of a rewrite is left to publishBatch, which only
+// renames files whose chain succeeded. A whole batch is submitted with one system call and the
+// thread waits for every completion of the batch before taking the next one.
+// One write moves at most RING_WRITE_MAX bytes, and may move fewer; the rest of such
+// a file is appended with plain calls once its chain is done.
+
+#define RING_OPS_PER_FILE 4
+#define RING_WRITE_MAX 0x7ffff000u // The most Linux moves in one write
+
+enum
+{
+    OP_OPEN,
+    OP_WRITE,
+    OP_FSYNC,
+    OP_CLOSE
+};
+
+typedef struct
+{
+    int fd;
+    unsigned *sqTail;
+    unsigned *sqMask;
+    unsigned *sqArray;
+    unsigned *cqHead;
+    unsigned *cqTail;
+    unsigned *cqMask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    void *sqMap;
+    void *cqMap;
+    size_t sqMapSize;
+    size_t cqMapSize;
+    size_t sqesSize;
+} Ring;
+
+static Ring ring = {.fd = -1};
+
+static void ringClose(void)
+{
+    if (ring.fd < 0)
+        return;
+    if (ring.sqes)
+        munmap(ring.sqes, ring.sqesSize);
+    if (ring.cqMap)
+        munmap(ring.cqMap, ring.cqMapSize);
+    if (ring.sqMap)
+        munmap(ring.sqMap, ring.sqMapSize);
+    close(ring.fd);
+    memset(&ring, 0, sizeof(ring));
+    ring.fd = -1;
+}
+
+static int ringSetup(void)
+{
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    ring.fd = (int)syscall(__NR_io_uring_setup, ASYNC_IO_BATCH * RING_OPS_PER_FILE, &params);
+    if (ring.fd < 0)
+    {
+        ring.fd = -1;
+        return 0;
+    }
+
+    ring.sqMapSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring.cqMapSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    ring.sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring.sqMap = mmap(NULL, ring.sqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring.fd, IORING_OFF_SQ_RING);
+    ring.cqMap = mmap(NULL, ring.cqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring.fd, IORING_OFF_CQ_RING);
+    ring.sqes = (struct io_uring_sqe *)mmap(NULL, ring.sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                            ring.fd, IORING_OFF_SQES);
+    if (ring.sqMap == MAP_FAILED || ring.cqMap == MAP_FAILED || ring.sqes == MAP_FAILED)
+    {
+        ring.sqMap = ring.sqMap == MAP_FAILED ? NULL : ring.sqMap;
+        ring.cqMap = ring.cqMap == MAP_FAILED ? NULL : ring.cqMap;
+        ring.sqes = ring.sqes == MAP_FAILED ? NULL : ring.sqes;
+        ringClose();
+        return 0;
+    }
+    char *sq = (char *)ring.sqMap, *cq = (char *)ring.cqMap;
+    ring.sqTail = (unsigned *)(sq + params.sq_off.tail);
+    ring.sqMask = (unsigned *)(sq + params.sq_off.ring_mask);
+    ring.sqArray = (unsigned *)(sq + params.sq_off.array);
+    ring.cqHead = (unsigned *)(cq + params.cq_off.head);
+    ring.cqTail = (unsigned *)(cq + params.cq_off.tail);
+    ring.cqMask = (unsigned *)(cq + params.cq_off.ring_mask);
+    ring.cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+
+    // One empty file slot per file of a batch; the open of each chain fills its slot.
+    int slots[ASYNC_IO_BATCH];
+    for (int i = 0; i < ASYNC_IO_BATCH; i++)
+        slots[i] = -1;
+    if (syscall(__NR_io_uring_register, ring.fd, IORING_REGISTER_FILES, slots, ASYNC_IO_BATCH) < 0)
+    {
+        ringClose();
+        return 0;
+    }
+    return 1;
+}
+
+static struct io_uring_sqe *nextSqe(unsigned *tail, int job, int op, int slot)
+{
+    unsigned index = *tail & *ring.sqMask;
+    struct io_uring_sqe *sqe = &ring.sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    ring.sqArray[index] = index;
+    sqe->user_data = (uint64_t)job * RING_OPS_PER_FILE + op;
+    // A hard link runs the rest of the chain even after a failure, so the slot is
+    // always closed again.
+    sqe->flags = op == OP_CLOSE ? 0 : IOSQE_IO_HARDLINK;
+    if (op == OP_WRITE || op == OP_FSYNC)
+    {
+        sqe->flags |= IOSQE_FIXED_FILE;
+        sqe->fd = slot;
+    }
+    (*tail)++;
+    return sqe;
+}
+
+// Returns 0 if the kernel cannot run these chains; the batch is then redone with threads.
+static int writeBatchWithRing(AsyncJob **jobs, int count)
+{
+    unsigned tail = *ring.sqTail;
+    for (int i = 0; i < count; i++)
+    {
+        struct io_uring_sqe *sqe = nextSqe(&tail, i, OP_OPEN, i);
+        sqe->opcode = IORING_OP_OPENAT;
+        sqe->fd = AT_FDCWD;
+        sqe->addr = (uint64_t)(uintptr_t)(jobs[i]->append ? jobs[i]->path : jobs[i]->temp);
+        sqe->len = 0644;
+        // O_CLOEXEC is refused for file slots. With O_APPEND the write lands at the end
+        // whatever its offset.
+        sqe->open_flags = O_WRONLY | O_CREAT | (jobs[i]->append ? O_APPEND : O_TRUNC);
+        sqe->file_index = (unsigned)i + 1;
+
+        sqe = nextSqe(&tail, i, OP_WRITE, i);
+        sqe->opcode = IORING_OP_WRITE;
+        sqe->addr = (uint64_t)(uintptr_t)jobs[i]->data;
+        sqe->len = jobs[i]->length > RING_WRITE_MAX ? RING_WRITE_MAX : (unsigned)jobs[i]->length;
+
+        sqe = nextSqe(&tail, i, OP_FSYNC, i);
+        sqe->opcode = IORING_OP_FSYNC;
+
+        sqe = nextSqe(&tail, i, OP_CLOSE, i);
+        sqe->opcode = IORING_OP_CLOSE;
+        sqe->file_index = (unsigned)i + 1;
+    }
+    __atomic_store_n(ring.sqTail, tail, __ATOMIC_RELEASE);
+
+    unsigned toSubmit = (unsigned)count * RING_OPS_PER_FILE;
+    unsigned remaining = toSubmit;
+    int unsupported = 0;
+    size_t written[ASYNC_IO_BATCH] = {0};
+    while (remaining)
+    {
+        long submitted = syscall(__NR_io_uring_enter, ring.fd, toSubmit, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+        if (submitted < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if (toSubmit)
+                return 0; // Nothing of this batch reached the kernel
+        }
+        else
+        {
+            toSubmit -= (unsigned)submitted;
+        }
+
+        unsigned head = *ring.cqHead;
+        unsigned cqTail = __atomic_load_n(ring.cqTail, __ATOMIC_ACQUIRE);
+        for (; head != cqTail; head++, remaining--)
+        {
+            const struct io_uring_cqe *cqe = &ring.cqes[head & *ring.cqMask];
+            AsyncJob *job = jobs[cqe->user_data / RING_OPS_PER_FILE];
+            int op = (int)(cqe->user_data % RING_OPS_PER_FILE);
+            if (op == OP_OPEN && cqe->res == -EINVAL)
+                unsupported = 1; // Kernel without opens into file slots
+            if (job->error)
+                continue; // Keep the first failure; later steps fail because of it
+            if (cqe->res < 0)
+                job->error = -cqe->res;
+            else if (op == OP_WRITE)
+                written[cqe->user_data / RING_OPS_PER_FILE] = (size_t)cqe->res;
+        }
+        __atomic_store_n(ring.cqHead, head, __ATOMIC_RELEASE);
+    }
+    if (unsupported)
+        return 0;
+    // The hard link still synced and closed a file whose write came up short; the
+    // file holds exactly the bytes written so far, so the rest goes on its end.
+    for (int i = 0; i < count; i++)
+    {
+        if (!jobs[i]->error && written[i] < jobs[i]->length)
+            writeFrom(jobs[i], written[i], O_APPEND);
+    }
+    return 1;
+}
+
+#endif // ASYNC_IO_URING
+
+#ifndef _WIN32
+
+static void writeBatch(AsyncJob **jobs, int count)
+{
+#ifdef ASYNC_IO_URING
+    if (backend == BACKEND_URING)
+    {
+        if (writeBatchWithRing(jobs, count))
+            return;
+        ringClose();
+        __atomic_store_n(&backend, BACKEND_THREADS, __ATOMIC_RELEASE);
+        for (int i = 0; i < count; i++)
+            jobs[i]->error = 0;
+    }
+#endif
+    writeBatchWithThreads(jobs, count);
+}
+
+static int sameDirectory(const char *a, const char *b)
+{
+    const char *slashA = strrchr(a, '/'), *slashB = strrchr(b, '/');
+    if (!slashA || !slashB)
+        return !slashA && !slashB;
+    return slashA - a == slashB - b && strncmp(a, b, (size_t)(slashA - a)) == 0;
+}
+
+// Renames every rewritten file over its target, then fsyncs each directory touched
+// once, which makes the renames (and files created by appends) durable. A rewrite
+// that failed to write leaves the old file alone and only drops its temporary file.
+static void publishBatch(AsyncJob **jobs, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        if (jobs[i]->append)
+            continue;
+        if (!jobs[i]->error && rename(jobs[i]->temp, jobs[i]->path) != 0)
+            jobs[i]->error = errno;
+        if (jobs[i]->error)
+            unlink(jobs[i]->temp);
+    }
+    for (int i = 0; i < count; i++)
+    {
+        int synced = 0;
+        for (int j = 0; j < i && !synced; j++)
+            synced = sameDirectory(jobs[i]->path, jobs[j]->path);
+        if (synced || syncParentDirectory(jobs[i]->path) == 0)
+            continue;
+        int error = errno;
+        for (int j = i; j < count; j++)
+        {
+            if (!jobs[j]->error && sameDirectory(jobs[i]->path, jobs[j]->path))
+                jobs[j]->error = error;
+        }
+    }
+}
+
+// Takes up to ASYNC_IO_BATCH jobs off the queue. A second write of a path already in
+// the batch waits for the next one, so writes of one file land in order. queueLock held.
+static int takeBatch(AsyncJob **jobs)
+{
+    int count = 0;
+    AsyncJob **link = &queueHead;
+    while (*link && count < ASYNC_IO_BATCH)
+    {
+        AsyncJob *job = *link;
+        int repeated = 0;
+        for (int i = 0; i < count && !repeated; i++)
+            repeated = strcmp(jobs[i]->path, job->path) == 0;
+        if (repeated)
+            break;
+        jobs[count++] = job;
+        *link = job->next;
+    }
+    if (!queueHead)
+        queueTail = NULL;
+    return count;
+}
+
+// queueLock held.
+static void recordCompletion(const AsyncJob *job)
+{
+    if (completionCount == ASYNC_IO_COMPLETIONS)
+    {
+        // Nobody is polling: drop the oldest.
+        completionHead = (completionHead + 1) % ASYNC_IO_COMPLETIONS;
+        completionCount--;
+    }
+    AsyncIoCompletion *c = &completions[(completionHead + completionCount) % ASYNC_IO_COMPLETIONS];
+    completionCount++;
+    c->ticket = job->ticket;
+    c->ok = job->error == 0;
+    c->error = job->error;
+    c->seconds = secondsSince(&job->queuedAt);
+    memcpy(c->path, job->path, sizeof(c->path));
+    if (c->ok)
+    {
+        writtenCount++;
+        durableSeconds += c->seconds;
+    }
+    else
+    {
+        failedCount++;
+    }
+}
+
+static void *ioThreadMain(void *unused)
+{
+    (void)unused;
+    AsyncJob *jobs[ASYNC_IO_BATCH];
+    for (;;)
+    {
+        pthread_mutex_lock(&queueLock);
+        while (!queueHead && !stopping)
+            pthread_cond_wait(&workReady, &queueLock);
+        if (!queueHead)
+        {
+            pthread_mutex_unlock(&queueLock);
+            return NULL;
+        }
+        int count = takeBatch(jobs);
+        pthread_mutex_unlock(&queueLock);
+
+        writeBatch(jobs, count);
+        publishBatch(jobs, count);
+
+        pthread_mutex_lock(&queueLock);
+        for (int i = 0; i < count; i++)
+            recordCompletion(jobs[i]);
+        batchCount++;
+        pthread_cond_broadcast(&batchDone);
+        pthread_mutex_unlock(&queueLock);
+
+        for (int i = 0; i < count; i++)
+        {
+            free(jobs[i]->data);
+            free(jobs[i]);
+        }
+    }
+}
+
+void asyncIoStart(void)
+{
+    if (backend != BACKEND_OFF)
+        return;
+    const char *mode = getenv("RIDEMATE_ASYNC_IO");
+    if (mode && strcmp(mode, "0") == 0)
+        return;
+
+    Backend chosen = BACKEND_THREADS;
+#ifdef ASYNC_IO_URING
+    if (!(mode && strcmp(mode, "threads") == 0) && ringSetup())
+        chosen = BACKEND_URING;
+#endif
+    stopping = 0;
+    ownerPid = (long)getpid();
+    backend = chosen;
+    if (pthread_create(&ioThread, NULL, ioThreadMain, NULL) != 0)
+    {
+#ifdef ASYNC_IO_URING
+        ringClose();
+#endif
+        backend = BACKEND_OFF;
+    }
+}
+
+void asyncIoStop(void)
+{
+    if (backend == BACKEND_OFF || (long)getpid() != ownerPid)
+        return;
+    pthread_mutex_lock(&queueLock);
+    stopping = 1;
+    pthread_cond_signal(&workReady);
+    pthread_mutex_unlock(&queueLock);
+    pthread_join(ioThread, NULL); // It empties the queue first
+#ifdef ASYNC_IO_URING
+    ringClose();
+#endif
+    __atomic_store_n(&backend, BACKEND_OFF, __ATOMIC_RELEASE);
+}
+
+static int queueRunning(void)
+{
+    return __atomic_load_n(&backend, __ATOMIC_ACQUIRE) != BACKEND_OFF && (long)getpid() == ownerPid;
+}
+
+static FILE *openFile(AsyncFile *file, const char *path, int append)
+{
+    memset(file, 0, sizeof(*file));
+    file->append = append;
+    if (capture)
+    {
+        // A captured file is always whole; refusing the append makes the saver rewrite.
+        if (append || snprintf(file->path, sizeof(file->path), "%s", path) >= (int)sizeof(file->path))
+            return NULL;
+        file->captured = 1;
+        return file->f = open_memstream(&file->data, &file->length);
+    }
+    if (append && !endsWithNewline(path))
+        return NULL;
+    int fits = snprintf(file->path, sizeof(file->path), "%s", path) < (int)sizeof(file->path);
+    if (fits && queueRunning())
+    {
+        file->f = open_memstream(&file->data, &file->length);
+        if (file->f)
+        {
+            file->queued = 1;
+            return file->f;
+        }
+    }
+    if (!append)
+        return file->f = atomicFileOpen(&file->atomic, path);
+    file->f = fopen(path, "a");
+    if (file->f && fseek(file->f, 0, SEEK_END) == 0)
+        file->start = ftell(file->f);
+    return file->f;
+}
+
+FILE *asyncFileOpen(AsyncFile *file, const char *path)
+{
+    return openFile(file, path, 0);
+}
+
+FILE *asyncFileAppend(AsyncFile *file, const char *path)
+{
+    return openFile(file, path, 1);
+}
+
+// Files written in place are fsynced as well, so the journal checkpoint that
+// follows a save can count on them.
+static long closeDurably(FILE *f)
+{
+    int ok = fflush(f) == 0 && fsync(fileno(f)) == 0;
+    return fclose(f) == 0 && ok ? 0 : -1;
+}
+
+long asyncFileClose(AsyncFile *file)
+{
+    if (file->captured)
+    {
+        int ok = fclose(file->f) == 0 && capture(file->path, file->data, file->length);
+        free(file->data);
+        return ok ? 0 : -1;
+    }
+    if (!file->queued)
+    {
+        long end = ftell(file->f);
+        file->length = end > file->start ? (size_t)(end - file->start) : 0;
+        if (!file->append)
+            return atomicFileCommit(&file->atomic);
+        return closeDurably(file->f);
+    }
+
+    // Closing the memory stream settles data and length.
+    AsyncJob *job = (AsyncJob *)malloc(sizeof(AsyncJob));
+    if (fclose(file->f) != 0 || !job)
+    {
+        free(file->data);
+        free(job);
+        return -1;
+    }
+    memset(job, 0, sizeof(*job));
+    memcpy(job->path, file->path, sizeof(job->path));
+    atomicTempPath(job->temp, sizeof(job->temp), job->path); // Always fits: path is shorter
+    job->data = file->data;
+    job->length = file->length;
+    job->append = file->append;
+    clock_gettime(CLOCK_MONOTONIC, &job->queuedAt);
+
+    pthread_mutex_lock(&queueLock);
+    if (!queueRunning())
+    {
+        // Stopped since the file was opened: write it here instead.
+        pthread_mutex_unlock(&queueLock);
+        writeJob(job);
+        publishBatch(&job, 1);
+        long result = job->error ? -1 : 0;
+        free(job->data);
+        free(job);
+        return result;
+    }
+    job->ticket = ++nextTicket;
+    if (queueTail)
+        queueTail->next = job;
+    else
+        queueHead = job;
+    queueTail = job;
+    queuedCount++;
+    long ticket = job->ticket;
+    pthread_cond_signal(&workReady);
+    pthread_mutex_unlock(&queueLock);
+    return ticket;
+}
+
+void asyncIoDrain(void)
+{
+    if (!queueRunning())
+        return;
+    pthread_mutex_lock(&queueLock);
+    while (writtenCount + failedCount < queuedCount)
+        pthread_cond_wait(&batchDone, &queueLock);
+    pthread_mutex_unlock(&queueLock);
+}
+
+#else
+
+void asyncIoStart(void)
+{
+}
+
+void asyncIoStop(void)
+{
+}
+
+static FILE *openFile(AsyncFile *file, const char *path, int append)
+{
+    memset(file, 0, sizeof(*file));
+    file->append = append;
+    if (!append)
+        return file->f = atomicFileOpen(&file->atomic, path);
+    if (!endsWithNewline(path))
+        return NULL;
+    file->f = fopen(path, "a");
+    if (file->f && fseek(file->f, 0, SEEK_END) == 0)
+        file->start = ftell(file->f);
+    return file->f;
+}
+
+FILE *asyncFileOpen(AsyncFile *file, const char *path)
+{
+    return openFile(file, path, 0);
+}
+
+FILE *asyncFileAppend(AsyncFile *file, const char *path)
+{
+    return openFile(file, path, 1);
+}
+
+long asyncFileClose(AsyncFile *file)
+{
+    long end = ftell(file->f);
+    file->length = end > file->start ? (size_t)(end - file->start) : 0;
+    if (!file->append)
+        return atomicFileCommit(&file->atomic);
+    return fclose(file->f) == 0 ? 0 : -1;
+}
+
+void asyncIoDrain(void)
+{
+}
+
+#endif // _WIN32
+
+void asyncIoSetCapture(AsyncFileCapture fn)
+{
+    capture = fn;
+}
+
+int asyncIoCapturing(void)
+{
+    return capture != NULL;
+}
+
+const char *asyncIoBackend(void)
+{
+    switch (__atomic_load_n(&backend, __ATOMIC_ACQUIRE))
+    {
+    case BACKEND_URING:
+        return "io_uring";
+    case BACKEND_THREADS:
+        return "threads";
+    default:
+        return "off";
+    }
+}
+
+int asyncIoPoll(AsyncIoCompletion *out, int max)
+{
+    pthread_mutex_lock(&queueLock);
+    int n = 0;
+    while (n < max && completionCount > 0)
+    {
+        out[n++] = completions[completionHead];
+        completionHead = (completionHead + 1) % ASYNC_IO_COMPLETIONS;
+        completionCount--;
+    }
+    pthread_mutex_unlock(&queueLock);
+    return n;
+}
+
+void describeAsyncIoStatus(char *buf, size_t size)
+{
+    pthread_mutex_lock(&queueLock);
+    long pending = queuedCount - writtenCount - failedCount;
+    double average = writtenCount ? durableSeconds / (double)writtenCount * 1000.0 : 0.0;
+    snprintf(buf, size, "Async I/O: %s, %ld queued, %ld written in %ld batches (%.1f ms to durable on average), %ld failed",
+             asyncIoBackend(), pending, writtenCount, batchCount, average, failedCount);
+    pthread_mutex_unlock(&queueLock);
+}
@@ -0,0 +1,83 @@
+// File: asyncio.h
+// Description: Asynchronous file writes. A saver writes its file into memory and
+// queues it; one I/O thread creates, writes and fsyncs the queued files in batches,
+// through io_uring where the kernel offers it and with the thread pool otherwise.
+// A file that is rewritten goes to a temporary file that is renamed over the old
+// one only once it is durable (see atomicfile.h), with or without the queue.
+// Each queued file gets a ticket, and the thread reports when its data is durable
+// (or why it is not) through a completion queue the caller polls.
+
+#ifndef ASYNCIO_H
+#define ASYNCIO_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include "atomicfile.h"
+
+// Files written in one batch.
+#define ASYNC_IO_BATCH 64
+// Completions kept for asyncIoPoll; older ones are dropped once it is full.
+#define ASYNC_IO_COMPLETIONS 1024
+
+// A file being written through the queue, or straight to disk when the queue is not running.
+typedef struct
+{
+    FILE *f;
+    char *data;
+    size_t length; // Bytes written; set by asyncFileClose
+    int queued;    // f is a memory stream that asyncFileClose queues
+    int captured;  // f is a memory stream that asyncFileClose hands to the capture
+    int append;    // Added to the end of the file instead of replacing it
+    long start;    // Appended in place: file offset the writes started at
+    AtomicFile atomic; // Rewritten in place: the temporary file behind f
+    char path[256];
+} AsyncFile;
+
+typedef struct
+{
+    long ticket;
+    int ok;        // The file is written, fsynced and in place
+    int error;     // errno of the step that failed
+    char path[256];
+    double seconds; // From asyncFileClose until durable
+} AsyncIoCompletion;
+
+// Starts the I/O thread. RIDEMATE_ASYNC_IO=0 keeps every write synchronous,
+// RIDEMATE_ASYNC_IO=threads skips io_uring.
+void asyncIoStart(void);
+// Waits for everything queued, then stops the thread.
+void asyncIoStop(void);
+// "io_uring", "threads" or "off".
+const char *asyncIoBackend(void);
+
+// Opens 'path' to be rewritten. Write with f as usual, then call asyncFileClose; the
+// old file stays as it is until the new one is complete. Returns NULL if the file
+// could not be opened.
+FILE *asyncFileOpen(AsyncFile *file, const char *path);
+// Like asyncFileOpen, but what is written is appended to the file ("a"). Returns
+// NULL as well if the file is missing or its last line is incomplete, so the caller
+// rewrites it instead.
+FILE *asyncFileAppend(AsyncFile *file, const char *path);
+// Queues the file and returns its ticket, or returns 0 once it was written and
+// fsynced in place. Returns -1 if it could not be written or queued.
+long asyncFileClose(AsyncFile *file);
+
+// Receives each file a saver closes, whole, instead of it being written; returns 0 if
+// it could not take it.
+typedef int (*AsyncFileCapture)(const char *path, const char *data, size_t length);
+// Sends every file opened from now on to 'capture' (NULL to write files again). For
+// the online-backup child, whose saves go into the backup rather than the data
+// files; appends are refused, so savers write their tables whole. Not on Windows.
+void asyncIoSetCapture(AsyncFileCapture capture);
+// 1 while files go to the capture, so nothing a saver does touches the data files.
+int asyncIoCapturing(void);
+
+// Takes up to 'max' completions off the queue; returns how many.
+int asyncIoPoll(AsyncIoCompletion *out, int max);
+// Blocks until every file queued so far is durable or has failed.
+void asyncIoDrain(void);
+
+// One line for the admin panel, e.g. "Async I/O: io_uring, 0 queued, 12 written in 3 batches, 0 failed".
+void describeAsyncIoStatus(char *buf, size_t size);
+
+#endif // ASYNCIO_H
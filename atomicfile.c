@@ -0,0 +1,112 @@
+#include "atomicfile.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+int atomicTempPath(char *temp, size_t size, const char *path)
+{
+    int n = snprintf(temp, size, "%s.tmp", path);
+    return n >= 0 && (size_t)n < size;
+}
+
+int syncParentDirectory(const char *path)
+{
+#ifdef _WIN32
+    (void)path;
+    return 0; // MoveFileEx with MOVEFILE_WRITE_THROUGH already waited for the rename
+#else
+    char dir[256];
+    const char *slash = strrchr(path, '/');
+    if (!slash)
+        snprintf(dir, sizeof(dir), ".");
+    else if (slash == path)
+        snprintf(dir, sizeof(dir), "/");
+    else
+        snprintf(dir, sizeof(dir), "%.*s", (int)(slash - path), path);
+
+    int fd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0)
+        return -1;
+    // Some file systems cannot fsync a directory and say so with EINVAL; their
+    // renames are as durable as they get.
+    int result = fsync(fd) == 0 || errno == EINVAL ? 0 : -1;
+    int saved = errno;
+    close(fd);
+    errno = saved;
+    return result;
+#endif
+}
+
+int atomicReplace(const char *temp, const char *path)
+{
+#ifdef _WIN32
+    if (!MoveFileExA(temp, path, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+    {
+        errno = EIO;
+        return -1;
+    }
+    return 0;
+#else
+    if (rename(temp, path) != 0)
+        return -1;
+    return syncParentDirectory(path);
+#endif
+}
+
+FILE *atomicFileOpen(AtomicFile *file, const char *path)
+{
+    memset(file, 0, sizeof(*file));
+    if (snprintf(file->path, sizeof(file->path), "%s", path) >= (int)sizeof(file->path) ||
+        !atomicTempPath(file->temp, sizeof(file->temp), path))
+    {
+        errno = ENAMETOOLONG;
+        return NULL;
+    }
+    file->f = fopen(file->temp, "w");
+    if (!file->f)
+        return NULL;
+    // Without a buffer of our own, stdio would write the table in 4 KB pieces.
+    file->buffer = (char *)malloc(ATOMIC_FILE_BUFFER);
+    if (file->buffer)
+        setvbuf(file->f, file->buffer, _IOFBF, ATOMIC_FILE_BUFFER);
+    return file->f;
+}
+
+static int closeTemp(AtomicFile *file)
+{
+    int ok = fflush(file->f) == 0;
+#ifndef _WIN32
+    ok = ok && fsync(fileno(file->f)) == 0;
+#endif
+    if (fclose(file->f) != 0)
+        ok = 0;
+    file->f = NULL;
+    free(file->buffer);
+    file->buffer = NULL;
+    return ok ? 0 : -1;
+}
+
+int atomicFileCommit(AtomicFile *file)
+{
+    if (closeTemp(file) != 0 || atomicReplace(file->temp, file->path) != 0)
+    {
+        int saved = errno;
+        remove(file->temp); // Gone already if only the directory fsync failed
+        errno = saved;
+        return -1;
+    }
+    return 0;
+}
+
+void atomicFileDiscard(AtomicFile *file)
+{
+    if (file->f)
+        closeTemp(file);
+    remove(file->temp);
+}
@@ -0,0 +1,42 @@
+// File: atomicfile.h
+// Description: Crash-safe replacement of a data file. The new contents go to a
+// temporary file next to the target ("<path>.tmp"), which is fsynced and then renamed
+// over the target, and the directory is fsynced so the rename itself is durable. A
+// crash at any point leaves either the old file or the new one, never a truncated mix.
+
+#ifndef ATOMICFILE_H
+#define ATOMICFILE_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+// stdio buffer of an atomic file, so a table is written in a few large writes.
+#define ATOMIC_FILE_BUFFER (256 * 1024)
+
+typedef struct
+{
+    FILE *f;
+    char *buffer;
+    char path[256];
+    char temp[264];
+} AtomicFile;
+
+// Fills 'temp' with the temporary name for 'path'. Returns 0 if it does not fit.
+int atomicTempPath(char *temp, size_t size, const char *path);
+
+// Opens the temporary file for 'path'. Write with f as usual, then call
+// atomicFileCommit (or atomicFileDiscard). Returns NULL if it could not be opened.
+FILE *atomicFileOpen(AtomicFile *file, const char *path);
+// Flushes, fsyncs and closes the temporary file, then renames it over the target.
+// Returns 0 once the new file is durable, -1 (errno set) if it may not be.
+int atomicFileCommit(AtomicFile *file);
+// Closes and removes the temporary file; the target keeps its old contents.
+void atomicFileDiscard(AtomicFile *file);
+
+// Renames a written and fsynced temporary file over 'path' and fsyncs the
+// directory. Returns 0 or -1 (errno set).
+int atomicReplace(const char *temp, const char *path);
+// fsyncs the directory that holds 'path', making a rename or create in it durable.
+int syncParentDirectory(const char *path);
+
+#endif // ATOMICFILE_H
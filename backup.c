@@ -1,121 +1,2062 @@
+#define _GNU_SOURCE // fopencookie
 #include "backup.h"
 #include "utils.h"
+#include "sha256.h"
+#include "atomicfile.h"
+#include "filecopy.h"
+#include "threadpool.h"
+#include "lz.h"
+#include "journal.h"
+#include "snapshot.h"
+#include "asyncio.h"
+#include "dirty.h"
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <time.h>
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+
+#define BACKUP_DIR "backups"
+#define CHUNK_DIR BACKUP_DIR "/chunks"
+#define CHUNK_INDEX_FILE CHUNK_DIR "/index.csv"
+#define PACK_SUFFIX ".pack"
+#define MANIFEST_SUFFIX ".manifest"
+#define MANIFEST_HEADER "RideMate backup manifest "
+
+// Chunk boundaries come from a rolling hash of the content, so an edit only changes
+// the chunks around it and the rest of the file dedupes against earlier backups.
+// A boundary is placed where the top 13 bits of the hash are zero: 8 KB apart on
+// average, never closer than CHUNK_MIN or further than CHUNK_MAX.
+#define CHUNK_MIN (2 * 1024)
+#define CHUNK_MAX (64 * 1024)
+#define CHUNK_CUT_BITS 13
+#define SCAN_BUFFER (1024 * 1024)
+
+// Enough for decades of monthly partitions.
+#define MAX_MANIFEST_FILES 512
+// Read back by offset while the program runs (see complaint.c), so a backup load
+// restores it to disk instead of streaming it.
+#define TEXT_HEAP_FILE "complaints.text"
+#define TEXT_HEAP_PREVIOUS TEXT_HEAP_FILE ".prev"
+#define PACK_NAME_SIZE 48
+
+// Where each table is saved, plus the complaint text heap and the id high-water marks
+// that the tables depend on.
+const char *dataFilesToBackup[] = {
+    "customers.csv",
+    "complaints.csv",
+    "complaints.text",
+    "data/vehicles.csv",
+    "data/routes.csv",
+    "data/promos.csv",
+    "data/drivers.csv",
+    "data/ids.csv"};
+const int NUM_DATA_FILES = sizeof(dataFilesToBackup) / sizeof(dataFilesToBackup[0]);
+
+const char *dataDirsToBackup[] = {
+    "data/rentals",
+    "data/invoices"};
+const int NUM_DATA_DIRS = sizeof(dataDirsToBackup) / sizeof(dataDirsToBackup[0]);
+
+// Before the month partitions, backups held these instead of data/rentals and
+// data/invoices. Restoring one puts them back, and the loaders split them up again.
+static const char *legacyFilesToRestore[] = {
+    "customers.csv",
+    "rentals.csv",
+    "complaints.csv",
+    "complaints.text",
+    "data/vehicles.csv",
+    "data/routes.csv",
+    "data/promos.csv",
+    "data/drivers.csv",
+    "data/invoices.csv",
+    "data/ids.csv"};
+#define NUM_LEGACY_FILES (int)(sizeof(legacyFilesToRestore) / sizeof(legacyFilesToRestore[0]))
+
+// Where a table is kept until its first save moves it into partitions.
+static const char *unpartitionedFiles[] = {"rentals.csv", "data/invoices.csv"};
+#define NUM_UNPARTITIONED_FILES (int)(sizeof(unpartitionedFiles) / sizeof(unpartitionedFiles[0]))
+
+// The backed-up directory 'path' is directly in, or NULL.
+static const char *backedUpDirOf(const char *path)
+{
+    for (int i = 0; i < NUM_DATA_DIRS; i++)
+    {
+        size_t length = strlen(dataDirsToBackup[i]);
+        if (strncmp(path, dataDirsToBackup[i], length) == 0 && path[length] == '/' &&
+            !strchr(path + length + 1, '/'))
+            return dataDirsToBackup[i];
+    }
+    return NULL;
+}
+
+static int isBackedUpFile(const char *path)
+{
+    for (int i = 0; i < NUM_DATA_FILES; i++)
+    {
+        if (strcmp(dataFilesToBackup[i], path) == 0)
+            return 1;
+    }
+    return backedUpDirOf(path) != NULL;
+}
+
+static int comparePaths(const void *a, const void *b)
+{
+    return strcmp((const char *)a, (const char *)b);
+}
+
+int listFilesToBackup(char (*paths)[BACKUP_PATH_SIZE], int max)
+{
+    int count = 0;
+    for (int i = 0; i < NUM_DATA_FILES && count < max; i++)
+        snprintf(paths[count++], BACKUP_PATH_SIZE, "%s", dataFilesToBackup[i]);
+    for (int i = 0; i < NUM_UNPARTITIONED_FILES && count < max; i++)
+    {
+        struct stat st;
+        if (stat(unpartitionedFiles[i], &st) == 0)
+            snprintf(paths[count++], BACKUP_PATH_SIZE, "%s", unpartitionedFiles[i]);
+    }
+    for (int i = 0; i < NUM_DATA_DIRS; i++)
+    {
+        int first = count;
+        DIR *dir = opendir(dataDirsToBackup[i]);
+        struct dirent *entry;
+        while (dir && (entry = readdir(dir)) != NULL)
+        {
+            const char *name = entry->d_name;
+            size_t length = strlen(name);
+            // Temporary files of a save in progress are not part of the data.
+            if (name[0] == '.' || (length > 4 && strcmp(name + length - 4, ".tmp") == 0))
+                continue;
+            if (count == max)
+            {
+                printf("Warning: more than %d files to back up; '%s/%s' left out\n", max, dataDirsToBackup[i], name);
+                break;
+            }
+            int n = snprintf(paths[count], BACKUP_PATH_SIZE, "%s/%s", dataDirsToBackup[i], name);
+            if (n > 0 && n < BACKUP_PATH_SIZE)
+                count++;
+        }
+        if (dir)
+            closedir(dir);
+        qsort(paths[first], (size_t)(count - first), BACKUP_PATH_SIZE, comparePaths);
+    }
+    return count;
+}
+
+// A chunk and where it is stored: 'stored' bytes at 'offset' in
+// backups/chunks/<pack>.pack, LZ-compressed if that is fewer than 'length'. Backups
+// made before packs kept each chunk in its own file; their refs have no pack.
+typedef struct
+{
+    char hash[SHA256_HEX_SIZE]; // Of the uncompressed bytes
+    unsigned length;
+    unsigned stored;
+    char pack[PACK_NAME_SIZE];
+    long long offset;
+} ChunkRef;
+
+typedef struct
+{
+    char path[BACKUP_PATH_SIZE];
+    long long size;
+    long long mtime; // Nanoseconds where the platform has them
+    unsigned long long inode;
+    char hash[SHA256_HEX_SIZE]; // Of the whole file
+    ChunkRef *chunks;
+    size_t chunkCount;
+    size_t chunkCapacity;
+} ManifestFile;
+
+typedef struct
+{
+    long long created;
+    long journalSequence; // Journal rows up to this one are in the files; -1 if not recorded
+    int count;
+    ManifestFile files[MAX_MANIFEST_FILES];
+} Manifest;
+
+// Every chunk in the store, from index.csv plus the ones added by the running backup.
+// Shared by the per-file tasks: lookups and offset reservations happen under the
+// lock, the copies themselves outside it.
+typedef struct
+{
+    pthread_mutex_t lock;
+    int loaded;
+    ChunkRef *slots; // Open addressing on the hash; an empty slot has hash[0] == '\0'
+    size_t capacity;
+    size_t count;
+    char pack[PACK_NAME_SIZE]; // This backup's pack, where new chunks go
+    int packFd;                // -1 until the first new chunk
+    long long packEnd;
+    int failed;
+} ChunkIndex;
+
+static uint64_t gear[256];
+
+// Fixed pseudo-random byte weights for the rolling hash. They must never change, or
+// new backups would cut at different places and stop deduplicating against old ones.
+static void initGear(void)
+{
+    if (gear[0])
+        return;
+    uint64_t x = 0x526964654d617465ULL;
+    for (int i = 0; i < 256; i++)
+    {
+        uint64_t z = (x += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        gear[i] = z ^ (z >> 31);
+    }
+}
+
+// Length of the chunk that starts at data; len is what is buffered after it, which
+// is at least CHUNK_MAX unless the file ends sooner.
+static size_t findChunkEnd(const unsigned char *data, size_t len)
+{
+    if (len <= CHUNK_MIN)
+        return len;
+    size_t limit = len < CHUNK_MAX ? len : CHUNK_MAX;
+    uint64_t hash = 0;
+    for (size_t i = CHUNK_MIN; i < limit; i++)
+    {
+        hash = (hash << 1) + gear[data[i]];
+        if ((hash >> (64 - CHUNK_CUT_BITS)) == 0)
+            return i + 1;
+    }
+    return limit;
+}
+
+static void makeDirectory(const char *path)
+{
+#ifdef _WIN32
+    _mkdir(path);
+#else
+    mkdir(path, 0755);
+#endif
+}
+
+// Creates the directories above 'path' that do not exist yet.
+static void makeParentDirectories(const char *path)
+{
+    char dir[256];
+    snprintf(dir, sizeof(dir), "%s", path);
+    for (char *slash = strchr(dir, '/'); slash; slash = strchr(slash + 1, '/'))
+    {
+        *slash = '\0';
+        makeDirectory(dir);
+        *slash = '/';
+    }
+}
+
+static void packPath(const char *pack, char *path, size_t size)
+{
+    snprintf(path, size, CHUNK_DIR "/%s" PACK_SUFFIX, pack);
+}
+
+static void manifestPath(const char *name, char *path, size_t size)
+{
+    snprintf(path, size, BACKUP_DIR "/%s" MANIFEST_SUFFIX, name);
+}
+
+static double secondsSince(const struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)(now.tv_sec - start->tv_sec) + (double)(now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static int addChunk(ManifestFile *file, const ChunkRef *chunk)
+{
+    if (file->chunkCount == file->chunkCapacity)
+    {
+        size_t capacity = file->chunkCapacity ? file->chunkCapacity * 2 : 64;
+        ChunkRef *grown = (ChunkRef *)realloc(file->chunks, capacity * sizeof(ChunkRef));
+        if (!grown)
+            return 0;
+        file->chunks = grown;
+        file->chunkCapacity = capacity;
+    }
+    file->chunks[file->chunkCount++] = *chunk;
+    return 1;
+}
+
+static void freeManifest(Manifest *manifest)
+{
+    for (int i = 0; i < manifest->count; i++)
+        free(manifest->files[i].chunks);
+    manifest->count = 0;
+}
+
+static const ManifestFile *findManifestFile(const Manifest *manifest, const char *path)
+{
+    for (int i = 0; i < manifest->count; i++)
+    {
+        if (strcmp(manifest->files[i].path, path) == 0)
+            return &manifest->files[i];
+    }
+    return NULL;
+}
+
+// "chunk,<hash>,<length>,<pack>,<offset>,<stored>". Older backups wrote uncompressed
+// packs without the stored size, and before packs just "chunk,<hash>,<length>".
+static int parseChunkRef(char **fields, int n, ChunkRef *chunk)
+{
+    if (n < 3 || n == 4 || n > 6 || strlen(fields[1]) != SHA256_HEX_SIZE - 1)
+        return 0;
+    memset(chunk, 0, sizeof(*chunk));
+    memcpy(chunk->hash, fields[1], SHA256_HEX_SIZE);
+    chunk->length = (unsigned)strtoul(fields[2], NULL, 10);
+    chunk->stored = n == 6 ? (unsigned)strtoul(fields[5], NULL, 10) : chunk->length;
+    if (n >= 5)
+    {
+        snprintf(chunk->pack, sizeof(chunk->pack), "%s", fields[3]);
+        chunk->offset = atoll(fields[4]);
+    }
+    return chunk->length > 0 && chunk->length <= CHUNK_MAX && chunk->stored > 0 && chunk->stored <= chunk->length;
+}
+
+static int loadManifest(const char *name, Manifest *manifest)
+{
+    memset(manifest, 0, sizeof(*manifest));
+    manifest->journalSequence = -1;
+    char path[256];
+    manifestPath(name, path, sizeof(path));
+    FILE *f = fopen(path, "r");
+    if (!f)
+        return 0;
+
+    char line[512];
+    int ok = fgets(line, sizeof(line), f) && strncmp(line, MANIFEST_HEADER, strlen(MANIFEST_HEADER)) == 0;
+    ManifestFile *file = NULL;
+    while (ok && fgets(line, sizeof(line), f))
+    {
+        line[strcspn(line, "\r\n")] = '\0';
+        char *fields[8];
+        int n = splitCsvLine(line, fields, 8);
+        ChunkRef chunk;
+        if (strcmp(fields[0], "chunk") == 0)
+            ok = file && parseChunkRef(fields, n, &chunk) && addChunk(file, &chunk);
+        else if (n == 7 && strcmp(fields[0], "file") == 0 && manifest->count < MAX_MANIFEST_FILES)
+        {
+            file = &manifest->files[manifest->count++];
+            snprintf(file->path, sizeof(file->path), "%s", fields[1]);
+            file->size = atoll(fields[2]);
+            file->mtime = atoll(fields[3]);
+            file->inode = strtoull(fields[4], NULL, 10);
+            snprintf(file->hash, sizeof(file->hash), "%s", fields[5]);
+        }
+        else if (n == 2 && strcmp(fields[0], "created") == 0)
+            manifest->created = atoll(fields[1]);
+        else if (n == 2 && strcmp(fields[0], "journal") == 0)
+            manifest->journalSequence = atol(fields[1]);
+        else
+            ok = 0;
+    }
+    fclose(f);
+    if (!ok)
+        freeManifest(manifest);
+    return ok;
+}
+
+// Reads just the lines before the first file: when the backup was taken and its
+// journal position. Returns 0 if 'name' is not a manifest.
+static int readManifestHeader(const char *name, long long *created, long *journalSequence)
+{
+    *created = 0;
+    *journalSequence = -1;
+    char path[256];
+    manifestPath(name, path, sizeof(path));
+    FILE *f = fopen(path, "r");
+    if (!f)
+        return 0;
+    char line[512];
+    int ok = fgets(line, sizeof(line), f) && strncmp(line, MANIFEST_HEADER, strlen(MANIFEST_HEADER)) == 0;
+    while (ok && fgets(line, sizeof(line), f) && strncmp(line, "file,", 5) != 0)
+    {
+        if (strncmp(line, "created,", 8) == 0)
+            *created = atoll(line + 8);
+        else if (strncmp(line, "journal,", 8) == 0)
+            *journalSequence = atol(line + 8);
+    }
+    fclose(f);
+    return ok;
+}
+
+static int saveManifest(const char *name, const Manifest *manifest)
+{
+    char path[256];
+    manifestPath(name, path, sizeof(path));
+    AtomicFile out;
+    FILE *f = atomicFileOpen(&out, path);
+    if (!f)
+        return 0;
+    fprintf(f, MANIFEST_HEADER "3\ncreated,%lld\n", manifest->created);
+    if (manifest->journalSequence >= 0)
+        fprintf(f, "journal,%ld\n", manifest->journalSequence);
+    for (int i = 0; i < manifest->count; i++)
+    {
+        const ManifestFile *file = &manifest->files[i];
+        fprintf(f, "file,%s,%lld,%lld,%llu,%s,%zu\n", file->path, file->size, file->mtime, file->inode,
+                file->hash, file->chunkCount);
+        for (size_t c = 0; c < file->chunkCount; c++)
+        {
+            const ChunkRef *chunk = &file->chunks[c];
+            fprintf(f, "chunk,%s,%u,%s,%lld,%u\n", chunk->hash, chunk->length, chunk->pack, chunk->offset,
+                    chunk->stored);
+        }
+    }
+    return atomicFileCommit(&out) == 0;
+}
+
+typedef struct
+{
+    char name[128];
+} BackupName;
+
+static int compareBackupNames(const void *a, const void *b)
+{
+    return strcmp(((const BackupName *)a)->name, ((const BackupName *)b)->name);
+}
+
+// Every backup in the store, oldest first (names are timestamps). Returns the count
+// and leaves the array in *names for the caller to free.
+static int listBackupNames(BackupName **names)
+{
+    *names = NULL;
+    DIR *dir = opendir(BACKUP_DIR);
+    if (!dir)
+        return 0;
+    int count = 0, capacity = 0;
+    struct dirent *entry;
+    size_t suffix = strlen(MANIFEST_SUFFIX);
+    while ((entry = readdir(dir)) != NULL)
+    {
+        size_t len = strlen(entry->d_name);
+        if (len <= suffix || len - suffix >= sizeof((*names)->name) ||
+            strcmp(entry->d_name + len - suffix, MANIFEST_SUFFIX) != 0)
+            continue;
+        if (count == capacity)
+        {
+            capacity = capacity ? capacity * 2 : 16;
+            BackupName *grown = (BackupName *)realloc(*names, (size_t)capacity * sizeof(BackupName));
+            if (!grown)
+                break;
+            *names = grown;
+        }
+        snprintf((*names)[count++].name, sizeof((*names)->name), "%.*s", (int)(len - suffix), entry->d_name);
+    }
+    closedir(dir);
+    if (count)
+        qsort(*names, (size_t)count, sizeof(BackupName), compareBackupNames);
+    return count;
+}
+
+// --- Chunk index ---
+
+static size_t slotOf(const ChunkIndex *index, const char *hash)
+{
+    // The hash is already uniformly distributed; its first 16 hex digits will do.
+    uint64_t h = 0;
+    for (int i = 0; i < 16; i++)
+        h = h << 4 | (uint64_t)(hash[i] <= '9' ? hash[i] - '0' : hash[i] - 'a' + 10);
+    return (size_t)h & (index->capacity - 1);
+}
+
+static ChunkRef *findSlot(ChunkIndex *index, const char *hash)
+{
+    size_t i = slotOf(index, hash);
+    while (index->slots[i].hash[0] && strcmp(index->slots[i].hash, hash) != 0)
+        i = (i + 1) & (index->capacity - 1);
+    return &index->slots[i];
+}
+
+static int insertChunk(ChunkIndex *index, const ChunkRef *chunk)
+{
+    if ((index->count + 1) * 2 > index->capacity)
+    {
+        ChunkRef *old = index->slots;
+        size_t oldCapacity = index->capacity;
+        size_t capacity = oldCapacity ? oldCapacity * 2 : 4096;
+        ChunkRef *slots = (ChunkRef *)calloc(capacity, sizeof(ChunkRef));
+        if (!slots)
+            return 0;
+        index->slots = slots;
+        index->capacity = capacity;
+        for (size_t i = 0; i < oldCapacity; i++)
+        {
+            if (old[i].hash[0])
+                *findSlot(index, old[i].hash) = old[i];
+        }
+        free(old);
+    }
+    ChunkRef *slot = findSlot(index, chunk->hash);
+    if (!slot->hash[0])
+        index->count++;
+    *slot = *chunk;
+    return 1;
+}
+
+// index.csv: "hash,length,pack,offset,stored" for every chunk of every pack (packs
+// from before compression have no stored size). A line cut off by a crash is
+// ignored; its pack was never referred to by a manifest.
+static void loadChunkIndex(ChunkIndex *index)
+{
+    index->loaded = 1;
+    FILE *f = fopen(CHUNK_INDEX_FILE, "r");
+    if (!f)
+        return;
+    char line[256];
+    while (fgets(line, sizeof(line), f))
+    {
+        if (!strchr(line, '\n'))
+            continue;
+        line[strcspn(line, "\r\n")] = '\0';
+        char *fields[7] = {"chunk"};
+        int n = splitCsvLine(line, fields + 1, 6) + 1;
+        ChunkRef chunk;
+        if (n >= 5 && parseChunkRef(fields, n, &chunk) && !insertChunk(index, &chunk))
+            break;
+    }
+    fclose(f);
+}
+
+// Looks a chunk up in the store; call with the lock held.
+static int findChunk(ChunkIndex *index, const char *hash, ChunkRef *chunk)
+{
+    if (!index->loaded)
+        loadChunkIndex(index);
+    ChunkRef *known = index->capacity ? findSlot(index, hash) : NULL;
+    if (!known || !known->hash[0])
+        return 0;
+    *chunk = *known;
+    return 1;
+}
+
+static int writeAt(int fd, const unsigned char *buffer, size_t length, long long offset)
+{
+    while (length)
+    {
+#ifdef _WIN32
+        long n = _lseeki64(fd, offset, SEEK_SET) < 0 ? -1 : (long)write(fd, buffer, (unsigned)length);
+#else
+        long n = (long)pwrite(fd, buffer, length, (off_t)offset);
+#endif
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return 0;
+        buffer += n;
+        length -= (size_t)n;
+        offset += n;
+    }
+    return 1;
+}
+
+// Stores a chunk the store does not have yet in this backup's pack: compressed if
+// that saves at least an eighth, otherwise copied out of the source file by the
+// kernel (or written from 'data' if there is no source file, source < 0). 'packed' is
+// scratch space of CHUNK_MAX bytes. Fills *chunk with where the chunk is. Returns 1
+// if it was new, 0 if the store had it and -1 on failure.
+static int storeChunk(ChunkIndex *index, const unsigned char *data, const char *hash, int source,
+                      long long offset, unsigned length, unsigned char *packed, ChunkRef *chunk)
+{
+    pthread_mutex_lock(&index->lock);
+    int known = findChunk(index, hash, chunk);
+    pthread_mutex_unlock(&index->lock);
+    if (known)
+        return 0;
+    size_t compressed = lzCompress(data, length, packed, length - length / 8);
+
+    pthread_mutex_lock(&index->lock);
+    if (findChunk(index, hash, chunk))
+    {
+        // Another file had the same chunk and stored it meanwhile.
+        pthread_mutex_unlock(&index->lock);
+        return 0;
+    }
+    if (index->packFd < 0)
+    {
+        char path[256];
+        packPath(index->pack, path, sizeof(path));
+        index->packFd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, 0644);
+    }
+    memset(chunk, 0, sizeof(*chunk));
+    memcpy(chunk->hash, hash, SHA256_HEX_SIZE);
+    chunk->length = length;
+    chunk->stored = compressed ? (unsigned)compressed : length;
+    memcpy(chunk->pack, index->pack, sizeof(chunk->pack));
+    chunk->offset = index->packEnd;
+    index->packEnd += chunk->stored;
+    int ok = index->packFd >= 0 && insertChunk(index, chunk);
+    int packFd = index->packFd;
+    pthread_mutex_unlock(&index->lock);
+
+    // Each chunk has its own range of the pack, so tasks write side by side.
+    if (ok)
+    {
+        if (compressed)
+            ok = writeAt(packFd, packed, compressed, chunk->offset);
+        else if (source < 0)
+            ok = writeAt(packFd, data, length, chunk->offset);
+        else
+            ok = copyFileRange(source, offset, packFd, chunk->offset, length, NULL) == 0;
+    }
+    if (!ok)
+    {
+        __atomic_store_n(&index->failed, 1, __ATOMIC_RELAXED);
+        return -1;
+    }
+    return 1;
+}
+
+// Makes this backup's pack durable and records its chunks in index.csv, before any
+// manifest refers to them.
+static int finishPack(ChunkIndex *index)
+{
+    if (index->packFd < 0)
+        return 1;
+    int ok = !index->failed;
+#ifndef _WIN32
+    ok = ok && fsync(index->packFd) == 0;
+#endif
+    ok = close(index->packFd) == 0 && ok;
+    index->packFd = -1;
+    char path[256];
+    packPath(index->pack, path, sizeof(path));
+    ok = ok && syncParentDirectory(path) == 0;
+
+    FILE *f = ok ? fopen(CHUNK_INDEX_FILE, "a") : NULL;
+    if (!f)
+        return 0;
+    for (size_t i = 0; i < index->capacity; i++)
+    {
+        const ChunkRef *chunk = &index->slots[i];
+        if (chunk->hash[0] && strcmp(chunk->pack, index->pack) == 0)
+            fprintf(f, "%s,%u,%s,%lld,%u\n", chunk->hash, chunk->length, chunk->pack, chunk->offset, chunk->stored);
+    }
+    ok = fflush(f) == 0;
+#ifndef _WIN32
+    ok = ok && fsync(fileno(f)) == 0;
+#endif
+    return fclose(f) == 0 && ok;
+}
+
+static long long modificationTime(const struct stat *st)
+{
+#ifdef __linux__
+    return (long long)st->st_mtim.tv_sec * 1000000000LL + st->st_mtim.tv_nsec;
+#else
+    return (long long)st->st_mtime;
+#endif
+}
+
+// Hashes one chunk of a file, stores it if it is new and adds it to the file's list.
+// Returns 0 on failure.
+static int backupChunk(ChunkIndex *index, const unsigned char *data, size_t length, int source, long long offset,
+                       unsigned char *packed, Sha256 *whole, ManifestFile *out, BackupStats *stats)
+{
+    char hash[SHA256_HEX_SIZE];
+    sha256Hex(data, length, hash);
+    sha256Update(whole, data, length);
+    ChunkRef chunk;
+    int stored = storeChunk(index, data, hash, source, offset, (unsigned)length, packed, &chunk);
+    if (stored < 0 || !addChunk(out, &chunk))
+        return 0;
+    if (stored)
+    {
+        stats->newChunks++;
+        stats->newBytes += (long long)length;
+        stats->storedBytes += (long long)chunk.stored;
+    }
+    stats->chunks++;
+    stats->scanned += (long long)length;
+    return 1;
+}
+
+// Splits one data file into chunks and stores the new ones. A file whose size, time
+// and inode match the previous backup is taken from its manifest without being read.
+// Returns 0 if the file does not exist, -1 on failure.
+static int backupFile(const char *path, const Manifest *previous, ChunkIndex *index, ManifestFile *out,
+                      BackupStats *stats)
+{
+    struct stat st;
+    if (stat(path, &st) != 0)
+        return 0;
+    memset(out, 0, sizeof(*out));
+    snprintf(out->path, sizeof(out->path), "%s", path);
+    out->size = (long long)st.st_size;
+    out->mtime = modificationTime(&st);
+    out->inode = (unsigned long long)st.st_ino;
+    stats->bytes += out->size;
+
+    const ManifestFile *same = previous ? findManifestFile(previous, path) : NULL;
+    if (same && same->size == out->size && same->mtime == out->mtime && same->inode == out->inode)
+    {
+        memcpy(out->hash, same->hash, sizeof(out->hash));
+        for (size_t i = 0; i < same->chunkCount; i++)
+        {
+            if (!addChunk(out, &same->chunks[i]))
+                return -1;
+        }
+        stats->unchanged++;
+        stats->chunks += (long)same->chunkCount;
+        return 1;
+    }
+
+    // The content is read once to find the cuts and hash it. New chunks are
+    // compressed from the buffer, or if they do not compress, copied into the pack
+    // from a second descriptor.
+    FILE *f = fopen(path, "rb");
+    int source = open(path, O_RDONLY | O_BINARY);
+    unsigned char *buffer = (unsigned char *)malloc(SCAN_BUFFER + CHUNK_MAX);
+    unsigned char *packed = buffer + SCAN_BUFFER;
+    if (!f || source < 0 || !buffer)
+    {
+        if (f)
+            fclose(f);
+        if (source >= 0)
+            close(source);
+        free(buffer);
+        return -1;
+    }
+    Sha256 whole;
+    sha256Init(&whole);
+    size_t start = 0, end = 0;
+    long long offset = 0; // File offset of buffer[start]
+    int eof = 0, result = 1;
+    for (;;)
+    {
+        if (!eof && end - start < CHUNK_MAX)
+        {
+            // Keep at least CHUNK_MAX bytes ahead so the cut search sees a full window.
+            memmove(buffer, buffer + start, end - start);
+            end -= start;
+            start = 0;
+            size_t n = fread(buffer + end, 1, SCAN_BUFFER - end, f);
+            end += n;
+            if (n == 0)
+            {
+                eof = 1;
+                if (ferror(f))
+                {
+                    result = -1;
+                    break;
+                }
+            }
+            continue;
+        }
+        if (start == end)
+            break;
+        size_t length = findChunkEnd(buffer + start, end - start);
+        if (!backupChunk(index, buffer + start, length, source, offset, packed, &whole, out, stats))
+        {
+            result = -1;
+            break;
+        }
+        start += length;
+        offset += (long long)length;
+    }
+    fclose(f);
+    close(source);
+    free(buffer);
+
+    uint8_t digest[SHA256_SIZE];
+    sha256Final(&whole, digest);
+    sha256ToHex(digest, out->hash);
+    return result;
+}
+
+// The same for a file's contents that are in memory rather than on disk. It has no
+// time or inode, so the next backup from the files reads that file again.
+static int backupBuffer(const char *path, const unsigned char *data, size_t size, ChunkIndex *index,
+                        ManifestFile *out, BackupStats *stats)
+{
+    memset(out, 0, sizeof(*out));
+    snprintf(out->path, sizeof(out->path), "%s", path);
+    out->size = (long long)size;
+    stats->bytes += out->size;
+    unsigned char *packed = (unsigned char *)malloc(CHUNK_MAX);
+    if (!packed)
+        return -1;
+    Sha256 whole;
+    sha256Init(&whole);
+    int result = 1;
+    for (size_t start = 0; start < size && result > 0;)
+    {
+        size_t length = findChunkEnd(data + start, size - start);
+        if (!backupChunk(index, data + start, length, -1, 0, packed, &whole, out, stats))
+            result = -1;
+        start += length;
+    }
+    free(packed);
+    uint8_t digest[SHA256_SIZE];
+    sha256Final(&whole, digest);
+    sha256ToHex(digest, out->hash);
+    return result;
+}
+
+typedef struct
+{
+    const char *path;
+    const Manifest *previous;
+    ChunkIndex *index;
+    ManifestFile file;
+    BackupStats stats; // This file's share
+    int result;        // As returned by backupFile
+} FileBackupTask;
+
+static void backupFileTask(void *arg)
+{
+    FileBackupTask *task = (FileBackupTask *)arg;
+    task->result = backupFile(task->path, task->previous, task->index, &task->file, &task->stats);
+}
+
+// Creation time of the newest backup, looked up once and then kept up to date here.
+static time_t lastBackupTime = -1;
+
+// Named after the time; a second backup within the same second gets a suffix.
+static void newBackupName(time_t now, char *name, size_t size)
+{
+    struct tm tmNow;
+    localTimeSafe(now, &tmNow);
+    char base[64];
+    strftime(base, sizeof(base), "backup_%Y-%m-%d_%H-%M-%S", &tmNow);
+    snprintf(name, size, "%s", base);
+    for (int n = 2;; n++)
+    {
+        char path[256];
+        struct stat st;
+        manifestPath(name, path, sizeof(path));
+        if (stat(path, &st) != 0)
+            break;
+        snprintf(name, size, "%s_%d", base, n);
+    }
+}
+
+int createBackup(char *name, size_t size, BackupStats *stats)
+{
+    struct timespec started;
+    clock_gettime(CLOCK_MONOTONIC, &started);
+    memset(stats, 0, sizeof(*stats));
+    waitOnlineBackup(); // Its pack has to be in index.csv before chunks are looked up
+    initGear();
+    makeDirectory(BACKUP_DIR);
+    makeDirectory(CHUNK_DIR);
+
+    time_t now = time(NULL);
+    newBackupName(now, name, size);
+
+    // Read before the files: whatever they hold, it is at least everything up to this
+    // row, and replaying a row that is already in them is harmless.
+    long journalSequence = journalCheckpointSequence();
+
+    BackupName *names;
+    int backups = listBackupNames(&names);
+    Manifest previous;
+    int havePrevious = backups > 0 && loadManifest(names[backups - 1].name, &previous);
+    free(names);
+
+    // The index is only read if some file changed and has to be chunked.
+    ChunkIndex index;
+    memset(&index, 0, sizeof(index));
+    pthread_mutex_init(&index.lock, NULL);
+    snprintf(index.pack, sizeof(index.pack), "%s", name);
+    index.packFd = -1;
+
+    // One task per file; the pool runs them side by side.
+    char paths[MAX_MANIFEST_FILES][BACKUP_PATH_SIZE];
+    FileBackupTask tasks[MAX_MANIFEST_FILES];
+    int taskCount = listFilesToBackup(paths, MAX_MANIFEST_FILES);
+    TaskGroup group;
+    taskGroupInit(&group);
+    for (int i = 0; i < taskCount; i++)
+    {
+        memset(&tasks[i], 0, sizeof(tasks[i]));
+        tasks[i].path = paths[i];
+        tasks[i].previous = havePrevious ? &previous : NULL;
+        tasks[i].index = &index;
+        threadPoolSubmit(&group, backupFileTask, &tasks[i]);
+    }
+    taskGroupWait(&group);
+    taskGroupDestroy(&group);
+
+    Manifest manifest;
+    memset(&manifest, 0, sizeof(manifest));
+    manifest.created = (long long)now;
+    manifest.journalSequence = journalSequence;
+    int ok = 1;
+    for (int i = 0; i < taskCount; i++)
+    {
+        const BackupStats *part = &tasks[i].stats;
+        stats->bytes += part->bytes;
+        stats->scanned += part->scanned;
+        stats->chunks += part->chunks;
+        stats->newChunks += part->newChunks;
+        stats->newBytes += part->newBytes;
+        stats->storedBytes += part->storedBytes;
+        stats->unchanged += part->unchanged;
+        if (tasks[i].result < 0)
+        {
+            printf("Error: could not back up '%s'\n", tasks[i].path);
+            free(tasks[i].file.chunks);
+            ok = 0;
+        }
+        else if (tasks[i].result == 0)
+        {
+            printf("  - Skipped '%s' (file does not exist yet)\n", tasks[i].path);
+        }
+        else
+        {
+            manifest.files[manifest.count++] = tasks[i].file;
+            stats->files++;
+        }
+    }
+    if (havePrevious)
+        freeManifest(&previous);
+
+    ok = ok && manifest.count > 0;
+    if (!finishPack(&index) && ok)
+    {
+        printf("Error: could not write the chunk pack of '%s'\n", name);
+        ok = 0;
+    }
+    if (ok && !saveManifest(name, &manifest))
+    {
+        printf("Error: could not write the manifest of '%s'\n", name);
+        ok = 0;
+    }
+    freeManifest(&manifest);
+    free(index.slots);
+    pthread_mutex_destroy(&index.lock);
+    if (ok)
+        lastBackupTime = now;
+    stats->seconds = secondsSince(&started);
+    return ok;
+}
+
+// Opens the file a chunk lives in: its pack, or its own file for backups made
+// before packs. One descriptor is kept open and reused while chunks come from the
+// same pack.
+static int openChunkSource(const ChunkRef *chunk, char *openPack, int *fd, long long *offset)
+{
+    if (chunk->pack[0])
+    {
+        if (*fd < 0 || strcmp(openPack, chunk->pack) != 0)
+        {
+            char path[256];
+            if (*fd >= 0)
+                close(*fd);
+            packPath(chunk->pack, path, sizeof(path));
+            *fd = open(path, O_RDONLY | O_BINARY);
+            snprintf(openPack, PACK_NAME_SIZE, "%s", chunk->pack);
+        }
+        *offset = chunk->offset;
+        return *fd;
+    }
+    char path[256];
+    if (*fd >= 0)
+        close(*fd);
+    openPack[0] = '\0';
+    snprintf(path, sizeof(path), CHUNK_DIR "/%.2s/%s", chunk->hash, chunk->hash);
+    *fd = open(path, O_RDONLY | O_BINARY);
+    *offset = 0;
+    return *fd;
+}
+
+static long readAt(int fd, unsigned char *buffer, unsigned length, long long offset)
+{
+#ifdef _WIN32
+    if (_lseeki64(fd, offset, SEEK_SET) < 0)
+        return -1;
+    return (long)read(fd, buffer, length);
+#else
+    return (long)pread(fd, buffer, length, (off_t)offset);
+#endif
+}
+
+// Reads the chunks of one file in order, decompressing them and checking each
+// against its hash, and the whole file against the manifest at the end.
+typedef struct
+{
+    const ManifestFile *file;
+    size_t next; // Chunk to read next
+    char openPack[PACK_NAME_SIZE];
+    int source;            // Pack (or old chunk file) the last chunk came from
+    unsigned char *stored; // The chunk as read from the store
+    unsigned char *data;   // Decompressed
+    Sha256 whole;
+} ChunkReader;
+
+static int chunkReaderOpen(ChunkReader *reader, const ManifestFile *file)
+{
+    memset(reader, 0, sizeof(*reader));
+    reader->file = file;
+    reader->source = -1;
+    reader->stored = (unsigned char *)malloc(2 * CHUNK_MAX);
+    reader->data = reader->stored ? reader->stored + CHUNK_MAX : NULL;
+    sha256Init(&reader->whole);
+    return reader->stored != NULL;
+}
+
+static void chunkReaderClose(ChunkReader *reader)
+{
+    if (reader->source >= 0)
+        close(reader->source);
+    free(reader->stored);
+}
+
+// 1 if the next chunk is stored uncompressed at 'offset' of the pack read last.
+static int nextChunkFollows(const ChunkReader *reader, long long offset)
+{
+    if (reader->next >= reader->file->chunkCount || reader->source < 0)
+        return 0;
+    const ChunkRef *chunk = &reader->file->chunks[reader->next];
+    return chunk->pack[0] && strcmp(reader->openPack, chunk->pack) == 0 && chunk->stored == chunk->length &&
+           chunk->offset == offset;
+}
+
+// Reads the next chunk and points *data at its bytes. *rawOffset is where it sits in
+// reader->source if it is stored uncompressed, else -1. Returns its length, 0 after
+// the last chunk, or -1 if it is missing or damaged.
+static long readNextChunk(ChunkReader *reader, const unsigned char **data, long long *rawOffset)
+{
+    if (reader->next >= reader->file->chunkCount)
+        return 0;
+    const ChunkRef *chunk = &reader->file->chunks[reader->next++];
+    long long offset;
+    long got = -1;
+    if (openChunkSource(chunk, reader->openPack, &reader->source, &offset) >= 0)
+        got = readAt(reader->source, reader->stored, chunk->stored, offset);
+    if (got != (long)chunk->stored)
+    {
+        printf("Error: chunk %.12s of '%s' is missing from the store\n", chunk->hash, reader->file->path);
+        return -1;
+    }
+    *data = reader->stored;
+    *rawOffset = offset;
+    if (chunk->stored < chunk->length)
+    {
+        got = lzDecompress(reader->stored, chunk->stored, reader->data, CHUNK_MAX);
+        *data = reader->data;
+        *rawOffset = -1;
+    }
+    char hash[SHA256_HEX_SIZE];
+    if (got == (long)chunk->length)
+        sha256Hex(*data, (size_t)got, hash);
+    if (got != (long)chunk->length || strcmp(hash, chunk->hash) != 0)
+    {
+        printf("Error: chunk %.12s of '%s' is damaged\n", chunk->hash, reader->file->path);
+        return -1;
+    }
+    sha256Update(&reader->whole, *data, (size_t)got);
+    return got;
+}
+
+// After the last chunk: 1 if the file matches the checksum in the manifest.
+static int chunkReaderVerified(ChunkReader *reader)
+{
+    uint8_t digest[SHA256_SIZE];
+    char hex[SHA256_HEX_SIZE];
+    sha256Final(&reader->whole, digest);
+    sha256ToHex(digest, hex);
+    if (strcmp(hex, reader->file->hash) == 0)
+        return 1;
+    printf("Error: '%s' does not match the checksum in the manifest\n", reader->file->path);
+    return 0;
+}
+
+// Rebuilds one file from its chunks at 'target', through a temporary file that is
+// renamed there only if every chunk and the whole file match their hashes. Compressed
+// chunks are written out decompressed; runs of uncompressed ones are copied by the
+// kernel.
+static int restoreFile(const ManifestFile *file, const char *target)
+{
+    AtomicFile out;
+    ChunkReader reader;
+    FILE *f = atomicFileOpen(&out, target);
+    int ok = chunkReaderOpen(&reader, file) && f;
+    int fd = f ? fileno(f) : -1; // Written by descriptor only; the stdio buffer stays empty
+    long long written = 0;
+    long long runStart = 0, runLength = 0; // Checked bytes of the open pack not copied yet
+    while (ok)
+    {
+        if (runLength && !nextChunkFollows(&reader, runStart + runLength))
+        {
+            ok = copyFileRange(reader.source, runStart, fd, written, runLength, NULL) == 0;
+            written += runLength;
+            runLength = 0;
+        }
+        const unsigned char *data;
+        long long rawOffset;
+        long length = ok ? readNextChunk(&reader, &data, &rawOffset) : -1;
+        if (length <= 0)
+        {
+            ok = length == 0 && chunkReaderVerified(&reader);
+            break;
+        }
+        if (rawOffset >= 0)
+        {
+            if (!runLength)
+                runStart = rawOffset;
+            runLength += length;
+        }
+        else
+        {
+            ok = writeAt(fd, data, (size_t)length, written);
+            written += length;
+        }
+    }
+    chunkReaderClose(&reader);
+    if (!f)
+        return 0;
+    if (!ok)
+    {
+        atomicFileDiscard(&out);
+        return 0;
+    }
+    return atomicFileCommit(&out) == 0;
+}
+
+// Checks one file of a backup: every chunk and the whole file against their hashes,
+// nothing written.
+static int verifyFile(const ManifestFile *file)
+{
+    ChunkReader reader;
+    int ok = chunkReaderOpen(&reader, file);
+    while (ok)
+    {
+        const unsigned char *data;
+        long long rawOffset;
+        long length = readNextChunk(&reader, &data, &rawOffset);
+        if (length <= 0)
+        {
+            ok = length == 0 && chunkReaderVerified(&reader);
+            break;
+        }
+    }
+    chunkReaderClose(&reader);
+    return ok;
+}
+
+typedef struct
+{
+    const ManifestFile *file;
+    char target[128]; // Where it is rebuilt; empty to only verify it
+    int ok;
+} FileRestoreTask;
+
+static void restoreFileTask(void *arg)
+{
+    FileRestoreTask *task = (FileRestoreTask *)arg;
+    task->ok = task->target[0] ? restoreFile(task->file, task->target) : verifyFile(task->file);
+}
+
+// Runs one task per file of the manifest on the thread pool and counts the outcome.
+static void runFileTasks(const Manifest *manifest, FileRestoreTask *tasks, RestoreStats *stats)
+{
+    TaskGroup group;
+    taskGroupInit(&group);
+    for (int i = 0; i < manifest->count; i++)
+    {
+        tasks[i].file = &manifest->files[i];
+        tasks[i].ok = 0;
+        threadPoolSubmit(&group, restoreFileTask, &tasks[i]);
+    }
+    taskGroupWait(&group);
+    taskGroupDestroy(&group);
+
+    for (int i = 0; i < manifest->count; i++)
+    {
+        if (tasks[i].ok)
+        {
+            stats->files++;
+            stats->bytes += manifest->files[i].size;
+        }
+        else
+        {
+            printf("  - FAILED: '%s' is missing chunks or does not match its checksums\n", manifest->files[i].path);
+            stats->failed++;
+        }
+    }
+}
+
+int verifyBackup(const char *name, RestoreStats *stats)
+{
+    struct timespec started;
+    clock_gettime(CLOCK_MONOTONIC, &started);
+    memset(stats, 0, sizeof(*stats));
+    waitOnlineBackup();
+    Manifest manifest;
+    if (!loadManifest(name, &manifest))
+        return -1;
+    FileRestoreTask tasks[MAX_MANIFEST_FILES];
+    memset(tasks, 0, sizeof(tasks));
+    runFileTasks(&manifest, tasks, stats);
+    freeManifest(&manifest);
+    stats->seconds = secondsSince(&started);
+    return stats->failed == 0;
+}
+
+// --- Restoring by swapping in a staged copy ---
+
+// A restore first rebuilds every file in STAGING_DIR, laid out like the working
+// directory: the files of data/ in STAGING_DIR/data, the others at its top. Only when
+// all of them are written, checked and durable is STAGING_COMMIT created; after that
+// the restore counts as done and is finished, if need be on the next start.
+#define DATA_DIR "data"
+#define STAGING_DIR "restore.staging"
+#define STAGING_DATA_DIR STAGING_DIR "/" DATA_DIR
+#define STAGING_COMMIT STAGING_DIR "/COMMIT"
+// Staged in the new data directory; finding it in data/ means the swap has happened.
+#define RESTORE_MARK "restore.mark"
+
+static void removeTree(const char *path)
+{
+    DIR *dir = opendir(path);
+    struct dirent *entry;
+    while (dir && (entry = readdir(dir)) != NULL)
+    {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+            continue;
+        char child[512];
+        struct stat st;
+        snprintf(child, sizeof(child), "%s/%s", path, entry->d_name);
+        if (stat(child, &st) == 0 && S_ISDIR(st.st_mode))
+            removeTree(child);
+        else
+            remove(child);
+    }
+    if (dir)
+        closedir(dir);
+    rmdir(path);
+}
+
+// Swaps two directories in one rename. Returns 0, or -1 where that is not supported.
+static int exchangeDirectories(const char *a, const char *b)
+{
+#if defined(__linux__) && defined(RENAME_EXCHANGE)
+    return renameat2(AT_FDCWD, a, AT_FDCWD, b, RENAME_EXCHANGE);
+#else
+    (void)a;
+    (void)b;
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+static int isBackedUpDir(const char *path)
+{
+    for (int i = 0; i < NUM_DATA_DIRS; i++)
+    {
+        if (strcmp(dataDirsToBackup[i], path) == 0)
+            return 1;
+    }
+    return 0;
+}
+
+// Moves the entries of directory 'from' into directory 'to': all of them over the
+// ones there ('replace' 1), or only those 'to' does not have (0). The restore mark
+// stays where it is, and so do the partition directories when moving only what is
+// missing: a backup without them is from before partitions, and its rentals.csv and
+// invoices.csv would be shadowed by the old ones.
+static int moveEntries(const char *from, const char *to, int replace)
+{
+    DIR *dir = opendir(from);
+    if (!dir)
+        return errno == ENOENT;
+    int ok = 1;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL)
+    {
+        const char *name = entry->d_name;
+        if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0 || strcmp(name, RESTORE_MARK) == 0)
+            continue;
+        char source[512], target[512];
+        struct stat st;
+        snprintf(source, sizeof(source), "%s/%s", from, name);
+        snprintf(target, sizeof(target), "%s/%s", to, name);
+        if (!replace && (stat(target, &st) == 0 || isBackedUpDir(target)))
+            continue;
+        // A directory is only renamed over an empty one.
+        if (replace && stat(source, &st) == 0 && S_ISDIR(st.st_mode))
+            removeTree(target);
+        if (rename(source, target) != 0)
+        {
+            printf("Error: could not move '%s' to '%s': %s\n", source, target, strerror(errno));
+            ok = 0;
+        }
+    }
+    closedir(dir);
+    return ok;
+}
+
+// Puts the staged files in place. Every step can be run again after a crash and
+// picks up where the last run stopped.
+static int commitStagedRestore(void)
+{
+    struct stat st;
+    int ok = 1;
+    if (stat(STAGING_DATA_DIR, &st) == 0 && stat(DATA_DIR "/" RESTORE_MARK, &st) != 0)
+    {
+        makeDirectory(DATA_DIR);
+        // The whole data directory in one rename. Where directories cannot be swapped,
+        // its files are renamed over the live ones one by one instead, and partition
+        // directories the backup does not have are dropped, as a swap would.
+        if (exchangeDirectories(STAGING_DATA_DIR, DATA_DIR) != 0)
+        {
+            for (int i = 0; i < NUM_DATA_DIRS; i++)
+            {
+                char staged[128];
+                snprintf(staged, sizeof(staged), STAGING_DIR "/%s", dataDirsToBackup[i]);
+                if (stat(staged, &st) != 0)
+                    removeTree(dataDirsToBackup[i]);
+            }
+            ok = moveEntries(STAGING_DATA_DIR, DATA_DIR, 1);
+        }
+    }
+    // After a swap the old data directory is in the staging area. What the backup did
+    // not have, such as the journal and its archive, goes back to the live one.
+    if (stat(DATA_DIR "/" RESTORE_MARK, &st) == 0)
+        ok = moveEntries(STAGING_DATA_DIR, DATA_DIR, 0) && ok;
+    // Then the files outside data/, whichever the backup had.
+    DIR *dir = opendir(STAGING_DIR);
+    struct dirent *entry;
+    while (dir && (entry = readdir(dir)) != NULL)
+    {
+        const char *name = entry->d_name;
+        char staged[512];
+        snprintf(staged, sizeof(staged), STAGING_DIR "/%s", name);
+        if (name[0] == '.' || strcmp(name, DATA_DIR) == 0 || strcmp(staged, STAGING_COMMIT) == 0)
+            continue;
+        if (atomicReplace(staged, name) != 0)
+        {
+            printf("Error: could not move '%s' into place: %s\n", staged, strerror(errno));
+            ok = 0;
+        }
+    }
+    if (dir)
+        closedir(dir);
+    ok = ok && syncParentDirectory(DATA_DIR "/" RESTORE_MARK) == 0 && syncParentDirectory(DATA_DIR) == 0;
+    if (!ok)
+        return 0; // Left staged and committed; the next start tries again
+    remove(STAGING_COMMIT);
+    syncParentDirectory(STAGING_COMMIT);
+    remove(DATA_DIR "/" RESTORE_MARK);
+    removeTree(STAGING_DIR);
+    return 1;
+}
+
+int finishInterruptedRestore(void)
+{
+    struct stat st;
+    if (stat(STAGING_DIR, &st) != 0)
+        return 0;
+    if (stat(STAGING_COMMIT, &st) != 0)
+    {
+        // Staging never finished, or the restore did; either way the live files are right.
+        removeTree(STAGING_DIR);
+        return 0;
+    }
+    printf("Finishing an interrupted restore...\n");
+    return commitStagedRestore() ? 1 : -1;
+}
+
+// Small files that mark the stages of a restore, durable before the next step.
+static int writeMarker(const char *path, const char *text)
+{
+    AtomicFile out;
+    FILE *f = atomicFileOpen(&out, path);
+    if (!f)
+        return 0;
+    fprintf(f, "%s\n", text);
+    return atomicFileCommit(&out) == 0;
+}
+
+// Clears what an earlier restore left and creates the staging directory.
+static int beginStaging(void)
+{
+    if (finishInterruptedRestore() < 0)
+        return 0;
+    makeDirectory(STAGING_DIR);
+    makeDirectory(STAGING_DATA_DIR);
+    return 1;
+}
 
-static int copyFile(const char *sourcePath, const char *destPath)
+// Commits and puts in place the staged files of backup 'name' if 'complete', or
+// throws them away. Returns 1 if the restore happened.
+static int swapInStaged(const char *name, int complete, double *swapSeconds)
 {
-    FILE *source = fopen(sourcePath, "rb");
-    if (!source)
+    if (!complete || !writeMarker(STAGING_DATA_DIR "/" RESTORE_MARK, name) || !writeMarker(STAGING_COMMIT, name))
+    {
+        removeTree(STAGING_DIR);
         return 0;
+    }
+    struct timespec started;
+    clock_gettime(CLOCK_MONOTONIC, &started);
+    if (!commitStagedRestore())
+        printf("Warning: the restore is committed but not all files are in place; it finishes on the next start\n");
+    *swapSeconds = secondsSince(&started);
+    return 1;
+}
 
-    FILE *dest = fopen(destPath, "wb");
-    if (!dest)
+int restoreBackup(const char *name, RestoreStats *stats)
+{
+    struct timespec started;
+    clock_gettime(CLOCK_MONOTONIC, &started);
+    memset(stats, 0, sizeof(*stats));
+    waitOnlineBackup(); // It may be the one being restored, or still reading the text heap
+    // Nothing may write a data file behind the restore's back.
+    waitBackgroundSave();
+    asyncIoDrain();
+    Manifest manifest;
+    if (!loadManifest(name, &manifest))
+        return -1;
+    if (!beginStaging())
     {
-        fclose(source);
+        freeManifest(&manifest);
         return 0;
     }
 
-    char buffer[4096];
-    size_t bytes;
-    while ((bytes = fread(buffer, 1, sizeof(buffer), source)) > 0)
+    FileRestoreTask tasks[MAX_MANIFEST_FILES];
+    memset(tasks, 0, sizeof(tasks));
+    for (int i = 0; i < manifest.count; i++)
     {
-        fwrite(buffer, 1, bytes, dest);
+        snprintf(tasks[i].target, sizeof(tasks[i].target), STAGING_DIR "/%s", manifest.files[i].path);
+        makeParentDirectories(tasks[i].target);
     }
+    runFileTasks(&manifest, tasks, stats);
+    freeManifest(&manifest);
 
-    fclose(source);
-    fclose(dest);
-    return 1;
+    if (!swapInStaged(name, !stats->failed && stats->files > 0, &stats->swapSeconds))
+        stats->files = 0;
+    stats->seconds = secondsSince(&started);
+    return stats->files;
 }
 
-const char *dataFilesToBackup[] = {
-    "data/customers.csv",
-    "data/vehicles.csv",
-    "data/routes.csv",
-    "data/rentals.csv",
-    "data/promos.csv",
-    "data/drivers.csv"};
-const int NUM_DATA_FILES = sizeof(dataFilesToBackup) / sizeof(dataFilesToBackup[0]);
+// --- Loading a backup straight into memory ---
 
-static void createFullBackup()
+static struct
 {
-    printf("\nCreating a full data backup...\n");
+    Manifest manifest;
+    int active;
+    int failed;      // A file read from the backup was missing chunks or damaged
+    int heapRestored;
+    int heapSetAside; // The text heap in use before is at TEXT_HEAP_PREVIOUS
+} backupLoad;
 
-#ifdef _WIN32
-    system("mkdir backups > nul 2>&1");
+typedef struct
+{
+    ChunkReader reader;
+    const unsigned char *data; // What is left of the current chunk
+    size_t left;
+    int status; // 1 at the end of the file, -1 after a failure
+} BackupStream;
+
+// Fills buf from the chunks as the loader asks for more, so the file is never
+// decompressed to disk.
+static long readBackupStream(BackupStream *stream, char *buf, size_t size)
+{
+    size_t done = 0;
+    while (done < size && stream->status == 0)
+    {
+        if (!stream->left)
+        {
+            long long rawOffset;
+            long length = readNextChunk(&stream->reader, &stream->data, &rawOffset);
+            if (length > 0)
+                stream->left = (size_t)length;
+            else
+                stream->status = length == 0 && chunkReaderVerified(&stream->reader) ? 1 : -1;
+            if (stream->status < 0)
+                backupLoad.failed = 1;
+            continue;
+        }
+        size_t take = stream->left < size - done ? stream->left : size - done;
+        memcpy(buf + done, stream->data, take);
+        stream->data += take;
+        stream->left -= take;
+        done += take;
+    }
+    return done == 0 && stream->status < 0 ? -1 : (long)done;
+}
+
+#ifdef __GLIBC__
+
+static ssize_t cookieRead(void *cookie, char *buf, size_t size)
+{
+    return (ssize_t)readBackupStream((BackupStream *)cookie, buf, size);
+}
+
+static int cookieClose(void *cookie)
+{
+    BackupStream *stream = (BackupStream *)cookie;
+    chunkReaderClose(&stream->reader);
+    free(stream);
+    return 0;
+}
+
+#endif // __GLIBC__
+
+// The DataFileSource while a backup is loaded: the loader reads the file's content
+// from the backup. NULL, as for a missing file, if the backup does not have it.
+static FILE *openBackupFile(const char *path)
+{
+    const ManifestFile *file = findManifestFile(&backupLoad.manifest, path);
+    if (!file)
+        return NULL;
+    BackupStream *stream = (BackupStream *)calloc(1, sizeof(BackupStream));
+    if (!stream || !chunkReaderOpen(&stream->reader, file))
+    {
+        free(stream);
+        backupLoad.failed = 1;
+        return NULL;
+    }
+#ifdef __GLIBC__
+    cookie_io_functions_t io = {cookieRead, NULL, NULL, cookieClose};
+    FILE *f = fopencookie(stream, "r", io);
+    if (!f)
+    {
+        cookieClose(stream);
+        backupLoad.failed = 1;
+    }
+    return f;
 #else
-    system("mkdir -p backups");
+    // Without custom streams, go through an anonymous temporary file.
+    FILE *f = tmpfile();
+    char buf[8192];
+    long n;
+    while (f && (n = readBackupStream(stream, buf, sizeof(buf))) > 0)
+        fwrite(buf, 1, (size_t)n, f);
+    chunkReaderClose(&stream->reader);
+    free(stream);
+    if (f)
+        rewind(f);
+    return f;
 #endif
+}
+
+int beginBackupLoad(const char *name)
+{
+    if (backupLoad.active || !loadManifest(name, &backupLoad.manifest))
+        return 0;
+    backupLoad.failed = 0;
+    backupLoad.heapRestored = 0;
+    backupLoad.heapSetAside = 0;
+
+    // The current text heap is set aside rather than replaced, in case the rest of
+    // the backup turns out to be damaged.
+    const ManifestFile *heap = findManifestFile(&backupLoad.manifest, TEXT_HEAP_FILE);
+    if (heap)
+    {
+        backupLoad.heapSetAside = rename(TEXT_HEAP_FILE, TEXT_HEAP_PREVIOUS) == 0;
+        if (!restoreFile(heap, heap->path))
+        {
+            if (backupLoad.heapSetAside)
+                rename(TEXT_HEAP_PREVIOUS, TEXT_HEAP_FILE);
+            freeManifest(&backupLoad.manifest);
+            return 0;
+        }
+        backupLoad.heapRestored = 1;
+    }
+    backupLoad.active = 1;
+    setDataFileSource(openBackupFile);
+    return 1;
+}
+
+int endBackupLoad(void)
+{
+    if (!backupLoad.active)
+        return 0;
+    setDataFileSource(NULL);
+    backupLoad.active = 0;
+    freeManifest(&backupLoad.manifest);
+    if (!backupLoad.failed)
+    {
+        if (backupLoad.heapSetAside)
+            remove(TEXT_HEAP_PREVIOUS);
+    }
+    else if (backupLoad.heapSetAside)
+        rename(TEXT_HEAP_PREVIOUS, TEXT_HEAP_FILE);
+    else if (backupLoad.heapRestored)
+        remove(TEXT_HEAP_FILE);
+    return !backupLoad.failed;
+}
+
+int findBackupBefore(time_t instant, char *name, size_t size, time_t *created, long *journalSequence)
+{
+    BackupName *names;
+    int count = listBackupNames(&names);
+    int found = 0;
+    for (int i = count - 1; i >= 0 && !found; i--)
+    {
+        long long when;
+        long sequence;
+        if (!readManifestHeader(names[i].name, &when, &sequence) || when > (long long)instant || sequence < 0)
+            continue; // Too new, or from before manifests recorded where the journal was
+        snprintf(name, size, "%s", names[i].name);
+        *created = (time_t)when;
+        *journalSequence = sequence;
+        found = 1;
+    }
+    free(names);
+    return found;
+}
+
+static time_t newestBackupTime(void)
+{
+    if (lastBackupTime >= 0)
+        return lastBackupTime;
+    BackupName *names;
+    int count = listBackupNames(&names);
+    long long created = 0;
+    long sequence;
+    if (count > 0)
+        readManifestHeader(names[count - 1].name, &created, &sequence);
+    free(names);
+    lastBackupTime = (time_t)created;
+    return lastBackupTime;
+}
+
+// --- Online backups ---
+
+// What the child sends back when it is done.
+typedef struct
+{
+    int ok;
+    BackupStats stats;
+} OnlineBackupReport;
+
+static BackupWriter onlineWriter;
+static OnlineBackupStatus online;
+static int onlineReportFd = -1;
 
-    char backupDir[100];
+// The backup the captured files go into; only used in the child.
+static struct
+{
+    ChunkIndex index;
+    Manifest manifest;
+    BackupStats stats;
+    int failed;
+} capture;
+
+static int captureFile(const char *path, const char *data, size_t length)
+{
+    if (!isBackedUpFile(path))
+        return 1; // Written by a saver, but not part of a backup
+    if (capture.manifest.count == MAX_MANIFEST_FILES ||
+        backupBuffer(path, (const unsigned char *)data, length, &capture.index,
+                     &capture.manifest.files[capture.manifest.count], &capture.stats) < 0)
+    {
+        capture.failed = 1;
+        return 0;
+    }
+    capture.manifest.count++;
+    capture.stats.files++;
+    return 1;
+}
+
+void captureBackupFile(const char *path, long long length)
+{
+    FILE *f = fopen(path, "rb");
+    char *data = length > 0 ? (char *)malloc((size_t)length) : NULL;
+    size_t got = f && data ? fread(data, 1, (size_t)length, f) : 0;
+    if (f)
+        fclose(f);
+    if (length > 0 && got != (size_t)length)
+        capture.failed = 1;
+    else
+        captureFile(path, data, (size_t)length);
+    free(data);
+}
+
+void setOnlineBackupWriter(BackupWriter writer)
+{
+    onlineWriter = writer;
+}
+
+#ifndef _WIN32
+
+// Runs in the child: every table written by the writer, from the child's copy of
+// memory, straight into backup 'name'.
+static int writeOnlineBackup(const char *name, time_t created, BackupStats *stats)
+{
+    struct timespec started;
+    clock_gettime(CLOCK_MONOTONIC, &started);
+    initGear();
+    makeDirectory(BACKUP_DIR);
+    makeDirectory(CHUNK_DIR);
+    memset(&capture, 0, sizeof(capture));
+    pthread_mutex_init(&capture.index.lock, NULL);
+    snprintf(capture.index.pack, sizeof(capture.index.pack), "%s", name);
+    capture.index.packFd = -1;
+    capture.manifest.created = (long long)created;
+    // The copy of the journal counter is exactly what the copy of the data holds.
+    capture.manifest.journalSequence = journalLastSequence();
+
+    markAllDirty(); // Every table in full, however recently it was saved
+    asyncIoSetCapture(captureFile);
+    onlineWriter();
+    asyncIoSetCapture(NULL);
+    // Months left on disk at start-up and tables not loaded yet are not in memory for
+    // the writer, and have not changed since; they go in from their files.
+    char paths[MAX_MANIFEST_FILES][BACKUP_PATH_SIZE];
+    int count = listFilesToBackup(paths, MAX_MANIFEST_FILES);
+    for (int i = 0; i < count; i++)
+    {
+        struct stat st;
+        if (!findManifestFile(&capture.manifest, paths[i]) && stat(paths[i], &st) == 0)
+            captureBackupFile(paths[i], (long long)st.st_size);
+    }
+
+    int ok = !capture.failed && capture.manifest.count > 0;
+    ok = finishPack(&capture.index) && ok;
+    ok = ok && saveManifest(name, &capture.manifest);
+    *stats = capture.stats;
+    stats->seconds = secondsSince(&started);
+    return ok;
+}
+
+int startOnlineBackup(void)
+{
+    if (!onlineWriter || pollOnlineBackup())
+        return 0;
+    // The child's savers would wait for a save child that is not theirs.
+    waitBackgroundSave();
+    int fds[2];
+    if (pipe(fds) < 0)
+        return 0;
     time_t now = time(NULL);
-    strftime(backupDir, sizeof(backupDir), "backups/backup_%Y-%m-%d_%H-%M-%S", localtime(&now));
+    char name[PACK_NAME_SIZE];
+    newBackupName(now, name, sizeof(name));
+
+    struct timespec forkStart;
+    clock_gettime(CLOCK_MONOTONIC, &forkStart);
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        close(fds[0]);
+        close(fds[1]);
+        return 0;
+    }
+    if (pid == 0)
+    {
+        close(fds[0]);
+        int devNull = open("/dev/null", O_WRONLY);
+        if (devNull >= 0)
+            dup2(devNull, STDOUT_FILENO);
+        OnlineBackupReport report;
+        memset(&report, 0, sizeof(report));
+        report.ok = writeOnlineBackup(name, now, &report.stats);
+        if (write(fds[1], &report, sizeof(report)) != (ssize_t)sizeof(report))
+            _exit(1);
+        _exit(report.ok ? 0 : 1);
+    }
+
+    close(fds[1]);
+    fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    onlineReportFd = fds[0];
+    online.running = 1;
+    online.pid = (int)pid;
+    online.startedAt = now;
+    snprintf(online.name, sizeof(online.name), "%s", name);
+    online.forkMs = secondsSince(&forkStart) * 1000.0;
+    lastBackupTime = now;
+    return 1;
+}
+
+// The child has exited; read its report and record the outcome.
+static void collectOnlineBackup(pid_t result, int status)
+{
+    OnlineBackupReport report;
+    int reported = read(onlineReportFd, &report, sizeof(report)) == (ssize_t)sizeof(report);
+    close(onlineReportFd);
+    onlineReportFd = -1;
+    online.running = 0;
+    online.lastFinishedAt = time(NULL);
+    online.lastOk = reported && report.ok && result == (pid_t)online.pid && WIFEXITED(status) &&
+                    WEXITSTATUS(status) == 0;
+    if (reported)
+        online.lastStats = report.stats;
+    if (online.lastOk)
+        online.completed++;
+    else
+        online.failed++;
+}
+
+int pollOnlineBackup(void)
+{
+    if (!online.running)
+        return 0;
+    int status = 0;
+    pid_t result = waitpid((pid_t)online.pid, &status, WNOHANG);
+    if (result == 0)
+        return 1;
+    collectOnlineBackup(result, status);
+    return 0;
+}
+
+void waitOnlineBackup(void)
+{
+    if (!online.running)
+        return;
+    int status = 0;
+    pid_t result;
+    do
+        result = waitpid((pid_t)online.pid, &status, 0);
+    while (result < 0 && errno == EINTR);
+    collectOnlineBackup(result, status);
+}
 
-    char cmd[120];
-#ifdef _WIN32
-    snprintf(cmd, sizeof(cmd), "mkdir %s > nul 2>&1", backupDir);
 #else
-    snprintf(cmd, sizeof(cmd), "mkdir -p %s", backupDir);
-#endif
-    system(cmd);
 
-    int success_count = 0;
-    for (int i = 0; i < NUM_DATA_FILES; i++)
+int startOnlineBackup(void)
+{
+    return 0;
+}
+
+int pollOnlineBackup(void)
+{
+    return 0;
+}
+
+void waitOnlineBackup(void)
+{
+}
+
+#endif // _WIN32
+
+void getOnlineBackupStatus(OnlineBackupStatus *status)
+{
+    pollOnlineBackup();
+    *status = online;
+}
+
+void describeOnlineBackupStatus(char *buf, size_t size)
+{
+    pollOnlineBackup();
+    if (online.running)
+    {
+        snprintf(buf, size, "Online backup: '%s' running for %.0f s (pid %d)", online.name,
+                 difftime(time(NULL), online.startedAt), online.pid);
+        return;
+    }
+    if (!online.lastFinishedAt)
+    {
+        snprintf(buf, size, "Online backup: none yet");
+        return;
+    }
+    char when[16];
+    struct tm tmv;
+    if (!localTimeSafe(online.lastFinishedAt, &tmv) || !strftime(when, sizeof(when), "%H:%M:%S", &tmv))
+        snprintf(when, sizeof(when), "-");
+    if (!online.lastOk)
+    {
+        snprintf(buf, size, "Online backup: '%s' FAILED at %s", online.name, when);
+        return;
+    }
+    snprintf(buf, size, "Online backup: '%s' finished at %s in %.2f s (fork %.1f ms; %d files, %ld new chunks, %.1f KB stored)",
+             online.name, when, online.lastStats.seconds, online.forkMs, online.lastStats.files,
+             online.lastStats.newChunks, (double)online.lastStats.storedBytes / 1024.0);
+}
+
+// Read once; the server loop asks after every wake-up.
+int backupIntervalMinutes(void)
+{
+    static int minutes = -1;
+    if (minutes >= 0)
+        return minutes;
+    minutes = BACKUP_DEFAULT_INTERVAL_MINUTES;
+    const char *text = getenv("RIDEMATE_BACKUP_INTERVAL");
+    if (!text || !*text)
+        return minutes;
+    char *end;
+    long value = strtol(text, &end, 10);
+    if (*end || value < 0 || value > 525600)
+        printf("Warning: ignoring RIDEMATE_BACKUP_INTERVAL=%s (expected 0-525600 minutes)\n", text);
+    else
+        minutes = (int)value;
+    return minutes;
+}
+
+int backupIfDue(void)
+{
+    int minutes = backupIntervalMinutes();
+    time_t now = time(NULL);
+    if (minutes == 0 || pollOnlineBackup() || now - newestBackupTime() < (time_t)minutes * 60)
+        return 0;
+    if (startOnlineBackup())
+    {
+        printf("Scheduled online backup '%s' started in the background\n", online.name);
+        return 1;
+    }
+    // Let a background save finish first, so the backup has its files.
+    waitBackgroundSave();
+    char name[128];
+    BackupStats stats;
+    lastBackupTime = now; // Also after a failure: try again next interval, not on every save
+    if (!createBackup(name, sizeof(name), &stats))
+    {
+        printf("Error: the scheduled backup failed\n");
+        return 0;
+    }
+    printf("Scheduled backup '%s' taken in %.1f ms (%ld new chunks, %.1f KB stored)\n", name,
+           stats.seconds * 1000.0, stats.newChunks, (double)stats.storedBytes / 1024.0);
+    return 1;
+}
+
+static void createFullBackup()
+{
+    if (pollOnlineBackup())
+    {
+        printf("\nBackup '%s' is still being written; wait for it to finish.\n", online.name);
+        return;
+    }
+    if (startOnlineBackup())
     {
-        const char *sourceFile = dataFilesToBackup[i];
+        printf("\nOnline backup '%s' started: it holds the data as of now, saved or not,\n", online.name);
+        printf("and is written in the background (the app paused %.1f ms to fork).\n", online.forkMs);
+        printf("Its progress is shown at the top of this menu.\n");
+        return;
+    }
+    printf("\nCreating a data backup...\n");
+
+    char name[128];
+    BackupStats stats;
+    if (!createBackup(name, sizeof(name), &stats))
+    {
+        printf("\nBackup failed. No data files were backed up.\n");
+        return;
+    }
+    printf("\nBackup '%s' completed in %.1f ms: %d files, %.1f KB\n", name, stats.seconds * 1000.0, stats.files,
+           (double)stats.bytes / 1024.0);
+    printf("  %d files unchanged since the last backup; %lld bytes read, %ld chunks, %ld new (%.1f KB stored)\n",
+           stats.unchanged, stats.scanned, stats.chunks, stats.newChunks, (double)stats.storedBytes / 1024.0);
+}
+
+static void formatBackupTime(long long created, char *buf, size_t size)
+{
+    struct tm tm;
+    if (created <= 0 || !localTimeSafe((time_t)created, &tm) || !strftime(buf, size, "%Y-%m-%d %H:%M:%S", &tm))
+        snprintf(buf, size, "time unknown");
+}
+
+// Numbered, oldest first, with when each was taken and up to which journal row.
+static void listBackups(void)
+{
+    BackupName *names;
+    int count = listBackupNames(&names);
+    printf("Available backups:\n");
+    for (int i = 0; i < count; i++)
+    {
+        long long created;
+        long sequence;
+        char when[32];
+        readManifestHeader(names[i].name, &created, &sequence);
+        formatBackupTime(created, when, sizeof(when));
+        if (sequence >= 0)
+            printf("  %2d. %s  (%s, journal row %ld)\n", i + 1, names[i].name, when, sequence);
+        else
+            printf("  %2d. %s  (%s)\n", i + 1, names[i].name, when);
+    }
+    if (count == 0)
+        printf("  (none)\n");
+    free(names);
+}
 
-        const char *filename = strrchr(sourceFile, '/');
+// The backup a number from listBackups stands for; anything else is taken as a name.
+static void resolveBackupName(const char *input, char *name, size_t size)
+{
+    snprintf(name, size, "%s", input);
+    if (!isValidNumber(input))
+        return;
+    BackupName *names;
+    int count = listBackupNames(&names);
+    int number = atoi(input);
+    if (number >= 1 && number <= count)
+        snprintf(name, size, "%s", names[number - 1].name);
+    free(names);
+}
+
+// Backups taken before the chunk store were plain folders with a copy of each file.
+// Backups from before manifests are a directory of plain copies. They are staged
+// and swapped in like the others.
+static int restoreLegacyBackup(const char *backupPath)
+{
+    waitOnlineBackup();
+    waitBackgroundSave();
+    asyncIoDrain();
+    if (!beginStaging())
+        return 0;
+    int success_count = 0, failed = 0;
+    for (int i = 0; i < NUM_LEGACY_FILES; i++)
+    {
+        const char *destFile = legacyFilesToRestore[i];
+
+        const char *filename = strrchr(destFile, '/');
         if (!filename)
-            filename = sourceFile;
+            filename = destFile;
         else
             filename++;
 
-        char destFile[256];
-        snprintf(destFile, sizeof(destFile), "%s/%s", backupDir, filename);
+        char sourceFile[256], staged[128], temp[136];
+        struct stat st;
+        snprintf(sourceFile, sizeof(sourceFile), "%s/%s", backupPath, filename);
+        if (stat(sourceFile, &st) != 0)
+            continue; // Older backups do not have every file
+        snprintf(staged, sizeof(staged), STAGING_DIR "/%s", destFile);
+        atomicTempPath(temp, sizeof(temp), staged);
 
-        if (copyFile(sourceFile, destFile))
+        CopyMethod method;
+        if (copyFile(sourceFile, temp, &method) && atomicReplace(temp, staged) == 0)
         {
-            printf("  - Backed up '%s'\n", sourceFile);
+            printf("  - Staged '%s' (%s)\n", destFile, copyMethodName(method));
             success_count++;
         }
         else
         {
-            printf("  - FAILED to back up '%s' (file might not exist yet)\n", sourceFile);
+            printf("  - FAILED to copy '%s'\n", sourceFile);
+            failed++;
         }
     }
-
-    if (success_count > 0)
-    {
-        printf("\nBackup completed! Files are saved in '%s'\n", backupDir);
-    }
-    else
-    {
-        printf("\nBackup failed. No data files were found to back up.\n");
-    }
+    double swapSeconds;
+    return swapInStaged(backupPath, success_count > 0 && !failed, &swapSeconds) ? success_count : 0;
 }
 
 static void restoreFromBackup()
 {
     printf("\n--- Restore Data from Backup ---\n");
     printf("WARNING: This will OVERWRITE your current data. This action cannot be undone.\n");
+    listBackups();
 
-    char backupDirName[100];
-    getStringInput("Enter the exact name of the backup folder to restore from: ", backupDirName, 100);
+    char input[100], backupDirName[128];
+    getStringInput("Enter the number or exact name of the backup to restore from: ", input, 100);
+    resolveBackupName(input, backupDirName, sizeof(backupDirName));
 
-    char backupPath[120];
-    snprintf(backupPath, sizeof(backupPath), "backups/%s", backupDirName);
-
-    char checkFile[256];
-    snprintf(checkFile, sizeof(checkFile), "%s/customers.csv", backupPath);
-    FILE *f = fopen(checkFile, "r");
-    if (!f)
+    char manifestFile[256], backupPath[160];
+    manifestPath(backupDirName, manifestFile, sizeof(manifestFile));
+    snprintf(backupPath, sizeof(backupPath), BACKUP_DIR "/%s", backupDirName);
+    struct stat st;
+    int legacy = stat(manifestFile, &st) != 0;
+    if (legacy && stat(backupPath, &st) != 0)
     {
-        printf("Error: Backup folder '%s' not found or is invalid.\n", backupDirName);
+        printf("Error: Backup '%s' not found or is invalid.\n", backupDirName);
         return;
     }
-    fclose(f);
 
     printf("Are you absolutely sure you want to restore from '%s'? (y/n): ", backupDirName);
     char confirm[10];
@@ -123,38 +2064,31 @@ static void restoreFromBackup()
 
     if (confirm[0] == 'y' || confirm[0] == 'Y')
     {
-        int success_count = 0;
-        for (int i = 0; i < NUM_DATA_FILES; i++)
-        {
-            const char *destFile = dataFilesToBackup[i];
-
-            const char *filename = strrchr(destFile, '/');
-            if (!filename)
-                filename = destFile;
-            else
-                filename++;
-
-            char sourceFile[256];
-            snprintf(sourceFile, sizeof(sourceFile), "%s/%s", backupPath, filename);
-
-            if (copyFile(sourceFile, destFile))
-            {
-                printf("  - Restored '%s'\n", destFile);
-                success_count++;
-            }
-            else
-            {
-                printf("  - FAILED to restore '%s' (file missing in backup)\n", destFile);
-            }
-        }
+        RestoreStats stats;
+        int success_count = legacy ? restoreLegacyBackup(backupPath) : restoreBackup(backupDirName, &stats);
+        if (!legacy && success_count > 0)
+            printf("Restored %d files (%.1f KB) in %.1f ms; the live files were swapped in %.2f ms\n", stats.files,
+                   (double)stats.bytes / 1024.0, stats.seconds * 1000.0, stats.swapSeconds * 1000.0);
 
         if (success_count > 0)
         {
-            printf("\nRestore complete. Please RESTART the application to load the restored data.\n");
+            // The journal's unsaved rows belong to the data that was replaced. Marking
+            // them as saved keeps the next start from replaying them over the restored
+            // files, and later recoveries start from the backup taken here.
+            saveJournalCheckpoint();
+            char name[128];
+            BackupStats backup;
+            if (!legacy && createBackup(name, sizeof(name), &backup))
+                printf("Backup '%s' holds the restored data\n", name);
+            // What is in memory is the data that was just replaced; saving it on the
+            // way out would undo the restore.
+            printf("\nRestore complete. The application exits now; start it again to load the restored data.\n");
+            fflush(stdout);
+            exit(EXIT_SUCCESS);
         }
         else
         {
-            printf("\nRestore failed. No files were copied.\n");
+            printf("\nRestore failed. The data files were not changed.\n");
         }
     }
     else
@@ -163,6 +2097,63 @@ static void restoreFromBackup()
     }
 }
 
+// Checks every file of a backup without restoring it.
+static void verifyBackupMenu(void)
+{
+    printf("\n--- Verify a Backup ---\n");
+    listBackups();
+    char input[100], name[128];
+    getStringInput("Enter the number or exact name of the backup to verify: ", input, 100);
+    resolveBackupName(input, name, sizeof(name));
+    RestoreStats stats;
+    int result = verifyBackup(name, &stats);
+    if (result < 0)
+    {
+        printf("Error: Backup '%s' not found or it predates manifests.\n", name);
+        return;
+    }
+    printf("\n%d of %d files (%.1f KB) checked in %.1f ms (%.1f MB/s)\n", stats.files, stats.files + stats.failed,
+           (double)stats.bytes / 1024.0, stats.seconds * 1000.0,
+           stats.seconds > 0 ? (double)stats.bytes / (1024.0 * 1024.0) / stats.seconds : 0.0);
+    printf(result ? "Backup '%s' is intact.\n" : "Backup '%s' is DAMAGED; restoring it would fail.\n", name);
+}
+
+static void skipRow(char kind, char *row, void *ctx)
+{
+    (void)kind;
+    (void)row;
+    (void)ctx;
+}
+
+// Shows what a recovery to a given instant would start from; the recovery itself
+// replaces everything in memory, so it runs at start-up (--recover).
+static void pointInTimeRecovery(void)
+{
+    printf("\n--- Point-in-Time Recovery ---\n");
+    listBackups();
+    char input[64];
+    getStringInput("Recover the data as it was at (YYYY-MM-DD HH:MM[:SS]): ", input, sizeof(input));
+    time_t instant;
+    if (!stringToTime(input, &instant))
+    {
+        printf("Invalid date and time.\n");
+        return;
+    }
+    char name[128];
+    time_t created;
+    long sequence;
+    if (!findBackupBefore(instant, name, sizeof(name), &created, &sequence))
+    {
+        printf("No backup with a journal position was taken before %s.\n", input);
+        return;
+    }
+    long rows = replayMutationLog(sequence, created, instant, skipRow, NULL);
+    char when[32];
+    formatBackupTime((long long)created, when, sizeof(when));
+    printf("\nThe data as of %s is backup '%s' (%s) plus %ld journaled changes.\n", input, name, when, rows);
+    printf("To recover it, exit and start RideMate with:  --recover \"%s\"\n", input);
+}
+
 void adminBackupMenu()
 {
     int running = 1;
@@ -170,10 +2161,15 @@ void adminBackupMenu()
     {
         clearScreen();
         printf("\n--- Data Management (Backup & Restore) ---\n");
-        printf("1. Create Full Backup of All Data\n");
+        char status[256];
+        describeOnlineBackupStatus(status, sizeof(status));
+        printf("%s\n\n", status);
+        printf("1. Create Backup of All Data\n");
         printf("2. Restore Data from a Backup\n");
-        printf("3. Back to Admin Panel\n");
-        int choice = getIntegerInput("Enter choice: ", 1, 3);
+        printf("3. Point-in-Time Recovery\n");
+        printf("4. Verify a Backup\n");
+        printf("5. Back to Admin Panel\n");
+        int choice = getIntegerInput("Enter choice: ", 1, 5);
 
         switch (choice)
         {
@@ -184,6 +2180,12 @@ void adminBackupMenu()
             restoreFromBackup();
             break;
         case 3:
+            pointInTimeRecovery();
+            break;
+        case 4:
+            verifyBackupMenu();
+            break;
+        case 5:
             running = 0;
             break;
         }
@@ -1,9 +1,132 @@
 // File: backup.h
 // Description: Manages the backup and restore functionality for all data files.
+// Backups are incremental: each data file is cut into content-defined chunks, every
+// distinct chunk is stored once, identified by its SHA-256 and LZ-compressed, in the
+// pack file of the backup that first saw it (backups/chunks/<name>.pack, indexed by
+// backups/chunks/index.csv), and each backup is a manifest (backups/<name>.manifest)
+// listing the chunks of every file and the journal position the files were saved at.
+// Together with the journal archive that allows point-in-time recovery: the newest
+// backup before the chosen instant plus the journaled changes up to it.
 
 #ifndef BACKUP_H
 #define BACKUP_H
 
+#include <stddef.h>
+#include <time.h>
+
+// Default for RIDEMATE_BACKUP_INTERVAL: minutes between scheduled backups (0 turns
+// them off). The interval bounds how much journal a recovery has to replay.
+#define BACKUP_DEFAULT_INTERVAL_MINUTES 60
+
+// Every data file a backup covers, by the path it is saved at, and the directories
+// whose files it covers whole (the month partitions of rentals and invoices).
+extern const char *dataFilesToBackup[];
+extern const int NUM_DATA_FILES;
+extern const char *dataDirsToBackup[];
+extern const int NUM_DATA_DIRS;
+
+#define BACKUP_PATH_SIZE 64
+// Fills paths with every file a backup would take right now: the data files, the
+// old single file of a table not yet split into months, then the files in the
+// backed-up directories. Returns how many, at most 'max'.
+int listFilesToBackup(char (*paths)[BACKUP_PATH_SIZE], int max);
+
+typedef struct
+{
+    int files;             // Data files in the backup
+    int unchanged;         // Files taken over from the previous manifest without reading them
+    long long bytes;       // Total size of the files
+    long long scanned;     // Bytes read and chunked
+    long chunks;           // Chunks the manifest refers to
+    long newChunks;        // Chunks the store did not have yet
+    long long newBytes;    // Size of the new chunks
+    long long storedBytes; // What they take up in the store, compressed
+    double seconds;
+} BackupStats;
+
+typedef struct
+{
+    int files;  // Files rebuilt and in place (checked, for a verification)
+    int failed; // Files with a chunk missing or damaged
+    long long bytes;
+    double seconds;
+    double swapSeconds; // Of a restore: how long the live files were being replaced
+} RestoreStats;
+
+// Backs up every data file, one thread pool task per file; 'name' receives the
+// backup's name. Returns 1 on success.
+int createBackup(char *name, size_t size, BackupStats *stats);
+// Reads every file of backup 'name' in parallel and checks each chunk and file
+// against its hashes. Returns 1 if all of them match, 0 if not, -1 if there is no
+// such backup.
+int verifyBackup(const char *name, RestoreStats *stats);
+// Rebuilds the data files of backup 'name' in parallel into a staging directory next
+// to the data, checked against their hashes. Only if every file is good are they put
+// in place: the data directory is swapped for the staged one in a single rename (on
+// Linux), then the few files outside it are renamed over theirs, so the live set
+// changes all at once and a crash in between is finished on the next start. Returns
+// the number of files restored; 0 if any failed and nothing was changed, -1 if there
+// is no such backup.
+int restoreBackup(const char *name, RestoreStats *stats);
+// Completes a restore that was interrupted after its files were staged, or removes
+// one that was not. Call at start-up before loading. Returns 1 if it finished one, 0
+// if there was none, -1 if it could not.
+int finishInterruptedRestore(void);
+
+// Loads backup 'name' straight into memory: until endBackupLoad, the loaders read
+// each file from the backup (through openDataFile), decompressed and checked as they
+// parse, instead of from the data files. Only the complaint text heap, which is read
+// by offset later on, is restored to disk first. Returns 0 if there is no such backup.
+int beginBackupLoad(const char *name);
+// Switches the loaders back to the data files. Returns 1 if every file read from the
+// backup was complete and matched its checksums; if not, the loaded data must not be
+// saved, and the previous text heap is put back.
+int endBackupLoad(void);
+
+// Finds the newest backup taken no later than 'instant' that records its journal
+// position. Returns 1 and fills name, *created and *journalSequence, or 0 if none.
+int findBackupBefore(time_t instant, char *name, size_t size, time_t *created, long *journalSequence);
+
+// Writes every table the way the app saves it; see setOnlineBackupWriter.
+typedef void (*BackupWriter)(void);
+
+typedef struct
+{
+    int running;           // A backup child is writing
+    int pid;
+    time_t startedAt;
+    double forkMs;         // How long the app was paused to fork it
+    long completed;
+    long failed;
+    char name[128];        // Of the running backup, or the last one
+    int lastOk;
+    time_t lastFinishedAt; // 0 if none has finished yet
+    BackupStats lastStats;
+} OnlineBackupStatus;
+
+// Online backups capture the data in memory at one instant, including changes that
+// are not saved yet: a forked child runs 'writer' over its copy-on-write snapshot
+// with every saver's file sent into the backup instead of to disk, while the app
+// goes on serving. Call between commands, never while a change is half made.
+void setOnlineBackupWriter(BackupWriter writer);
+// From the writer, for files not written through asyncio: backs up the first
+// 'length' bytes of 'path' as they are on disk.
+void captureBackupFile(const char *path, long long length);
+// Starts one unless one is already running or no writer is set. Returns 1 if started.
+int startOnlineBackup(void);
+// Collects a finished backup child; returns 1 while one is still running.
+int pollOnlineBackup(void);
+// Blocks until the running online backup, if any, has finished.
+void waitOnlineBackup(void);
+void getOnlineBackupStatus(OnlineBackupStatus *status);
+// One line for the Data Management menu.
+void describeOnlineBackupStatus(char *buf, size_t size);
+
+int backupIntervalMinutes(void);
+// Takes a backup if the interval has passed since the newest one: an online one when
+// a writer is set, otherwise from the data files. Returns 1 if it took or started one.
+int backupIfDue(void);
+
 // The main menu function for the backup/restore module.
 void adminBackupMenu();
 
@@ -0,0 +1,505 @@
+#define _GNU_SOURCE // nftw, mkdtemp
+#include "backupbench.h"
+#include "backup.h"
+#include "filecopy.h"
+#include "partition.h"
+#include "utils.h"
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifndef _WIN32
+#include <ftw.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifndef _WIN32
+
+static double secondsSince(const struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)(now.tv_sec - start->tv_sec) + (double)(now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static double megabytes(long long bytes)
+{
+    return (double)bytes / (1024.0 * 1024.0);
+}
+
+// Rows shaped like the real tables, so chunking and copying see realistic data: a
+// year of rentals in twelve monthly partitions.
+static int writeRentals(long long bytes)
+{
+    mkdir("data/rentals", 0755);
+    unsigned seed = 42;
+    long id = 5001;
+    for (int month = 1; month <= 12; month++)
+    {
+        char path[64];
+        snprintf(path, sizeof(path), "data/rentals/2025-%02d.csv", month);
+        FILE *f = fopen(path, "w");
+        if (!f)
+            return 0;
+        fprintf(f, "id,customerId,vehicleId,routeId,driverId,type,startTime,endTime,totalCost,status,vehicleRating,driverRating,comment\n");
+        for (; ftell(f) < bytes / 12; id++)
+        {
+            seed = seed * 1103515245u + 12345u;
+            int day = (int)(seed >> 8) % 28 + 1, hour = (int)(seed >> 16) % 22;
+            fprintf(f, "%ld,%u,%u,0,%u,1,2025-%02d-%02d %02d:00,2025-%02d-%02d %02d:00,%u.%02u,2,%u,%u,\n", id,
+                    (seed >> 4) % 5000 + 1, (seed >> 12) % 2000 + 1, (seed >> 20) % 50, month, day, hour, month, day,
+                    hour + 2, (seed >> 3) % 300 + 10, (seed >> 7) % 100, (seed >> 9) % 6, (seed >> 11) % 6);
+        }
+        if (fclose(f) != 0)
+            return 0;
+    }
+    return 1;
+}
+
+// Invoices a minute apart, each in the partition of the month it was created in.
+static int writeInvoices(long long bytes)
+{
+    mkdir("data/invoices", 0755);
+    PartitionSet set;
+    partitionSetInit(&set, "data/invoices", NULL);
+    unsigned seed = 7;
+    long long written = 0;
+    int month = 0;
+    FILE *f = NULL;
+    for (long id = 6001; written < bytes; id++)
+    {
+        long createdAt = 1735689600L + id * 60;
+        if (!f || partitionMonthOf((time_t)createdAt) != month)
+        {
+            if (f)
+            {
+                written += ftell(f);
+                if (fclose(f) != 0)
+                    return 0;
+            }
+            month = partitionMonthOf((time_t)createdAt);
+            char path[64];
+            partitionPath(&set, month, path, sizeof(path));
+            if (!(f = fopen(path, "w")))
+                return 0;
+            fprintf(f, "id,customerId,rentalId,driverId,subtotal,discountAmount,taxAmount,totalAmount,status,paymentMethod,paymentReference,promoCode,createdAt\n");
+        }
+        seed = seed * 1103515245u + 12345u;
+        unsigned cents = (seed >> 6) % 30000 + 1000;
+        fprintf(f, "%ld,%u,%ld,%u,%u.%02u,0.00,%u.%02u,%u.%02u,1,1,TX-%u,,%ld\n", id, (seed >> 4) % 5000 + 1,
+                id - 1000, (seed >> 20) % 50, cents / 100, cents % 100, cents * 15 / 10000, cents * 15 / 100 % 100,
+                cents * 115 / 10000, cents * 115 / 100 % 100, seed % 100000, createdAt);
+        if (written + ftell(f) >= bytes)
+            break;
+    }
+    return !f || fclose(f) == 0;
+}
+
+static int writeSmallFile(const char *path, const char *header, int rows)
+{
+    FILE *f = fopen(path, "w");
+    if (!f)
+        return 0;
+    fprintf(f, "%s\n", header);
+    for (int i = 1; i <= rows; i++)
+        fprintf(f, "%d,row %d,%d,%d.%02d,1\n", i, i, i * 7 % 1000, i % 90 + 10, i % 100);
+    return fclose(f) == 0;
+}
+
+static int buildDataSet(long long bytes)
+{
+    mkdir("data", 0755);
+    return writeRentals(bytes * 55 / 100) && writeInvoices(bytes * 40 / 100) &&
+           writeSmallFile("customers.csv", "id,name,username,password,email,phone,status", 5000) &&
+           writeSmallFile("complaints.csv", "id,rentalId,customerId,status,createdAt", 2000) &&
+           writeSmallFile("complaints.text", "text", 2000) &&
+           writeSmallFile("data/vehicles.csv", "id,make,model,year,rate,status", 2000) &&
+           writeSmallFile("data/routes.csv", "id,name,distance,fare,status", 100) &&
+           writeSmallFile("data/promos.csv", "code,percent,uses,limit,status", 50) &&
+           writeSmallFile("data/drivers.csv", "id,name,phone,rating,status", 50) &&
+           writeSmallFile("data/ids.csv", "entity,next", 8);
+}
+
+static int removeEntry(const char *path, const struct stat *st, int type, struct FTW *ftw)
+{
+    (void)st, (void)type, (void)ftw;
+    remove(path);
+    return 0;
+}
+
+static void printBackup(const char *label, const BackupStats *stats)
+{
+    printf("  %-22s %8.3f s %9.1f MB/s   %6.1f MB read, %ld chunks, %ld new (%.1f MB, %.1f MB stored)\n", label,
+           stats->seconds, stats->seconds > 0 ? megabytes(stats->bytes) / stats->seconds : 0.0,
+           megabytes(stats->scanned), stats->chunks, stats->newChunks, megabytes(stats->newBytes),
+           megabytes(stats->storedBytes));
+}
+
+// The steps, run inside the scratch directory. Returns 0 on success.
+static int runSteps(long long size)
+{
+    if (!buildDataSet(size))
+    {
+        printf("Error: could not write the data set\n");
+        return 1;
+    }
+
+    struct stat st;
+    const char *copied = "data/rentals/2025-01.csv";
+    stat(copied, &st);
+    printf("Whole-file copy of %s (%.1f MB):\n", copied, megabytes((long long)st.st_size));
+    for (int method = 0; method < COPY_METHOD_COUNT; method++)
+    {
+        struct timespec started;
+        clock_gettime(CLOCK_MONOTONIC, &started);
+        int ok = copyFileWith(copied, "copy.csv", (CopyMethod)method);
+        double seconds = secondsSince(&started);
+        if (ok)
+            printf("  %-22s %8.3f s %9.1f MB/s\n", copyMethodName((CopyMethod)method), seconds,
+                   megabytes((long long)st.st_size) / seconds);
+        else
+            printf("  %-22s not supported on this file system\n", copyMethodName((CopyMethod)method));
+        remove("copy.csv");
+    }
+
+    char name[128];
+    BackupStats stats;
+    printf("Backups:\n");
+    if (!createBackup(name, sizeof(name), &stats))
+        return 1;
+    printBackup("first (empty store)", &stats);
+    if (!createBackup(name, sizeof(name), &stats))
+        return 1;
+    printBackup("repeat, unchanged", &stats);
+
+    FILE *f = fopen("data/rentals/2025-12.csv", "a");
+    if (f)
+    {
+        fprintf(f, "99999999,1,1,0,0,1,2025-12-31 10:00,2025-12-31 12:00,20.00,2,0,0,\n");
+        fclose(f);
+    }
+    if (!createBackup(name, sizeof(name), &stats))
+        return 1;
+    printBackup("repeat, one row added", &stats);
+
+    // What the loaders see with --restore: every file read straight out of the
+    // backup, without the parsing.
+    struct timespec started;
+    clock_gettime(CLOCK_MONOTONIC, &started);
+    long long streamed = 0;
+    static char paths[512][BACKUP_PATH_SIZE];
+    int count = listFilesToBackup(paths, 512);
+    int loaded = beginBackupLoad(name);
+    static char buffer[64 * 1024];
+    for (int i = 0; loaded && i < count; i++)
+    {
+        FILE *in = openDataFile(paths[i]);
+        size_t n;
+        while (in && (n = fread(buffer, 1, sizeof(buffer), in)) > 0)
+            streamed += (long long)n;
+        if (in)
+            fclose(in);
+    }
+    if (!loaded || !endBackupLoad())
+        return 1;
+    double seconds = secondsSince(&started);
+    printf("Restore:\n");
+    printf("  %-22s %8.3f s %9.1f MB/s\n", "streamed to loaders", seconds, megabytes(streamed) / seconds);
+
+    RestoreStats verified;
+    if (verifyBackup(name, &verified) != 1)
+        return 1;
+    printf("  %-22s %8.3f s %9.1f MB/s\n", "verified", verified.seconds,
+           verified.seconds > 0 ? megabytes(verified.bytes) / verified.seconds : 0.0);
+
+    // Restore onto an empty data set, as after losing the files.
+    for (int i = 0; i < count; i++)
+        remove(paths[i]);
+    RestoreStats restored;
+    if (restoreBackup(name, &restored) <= 0)
+        return 1;
+    printf("  %-22s %8.3f s %9.1f MB/s   %d files, %d failed; swapped in %.2f ms\n", "written to files",
+           restored.seconds, restored.seconds > 0 ? megabytes(restored.bytes) / restored.seconds : 0.0, restored.files,
+           restored.failed, restored.swapSeconds * 1000.0);
+    printf("(The page cache is warm; these are upper bounds for this machine.)\n");
+    return restored.failed ? 1 : 0;
+}
+
+int runBackupBenchmark(const BackupBenchOptions *options)
+{
+    char scratch[512];
+    snprintf(scratch, sizeof(scratch), "%s/ridemate-bench-XXXXXX", options->directory);
+    char home[1024];
+    if (!getcwd(home, sizeof(home)) || !mkdtemp(scratch) || chdir(scratch) != 0)
+    {
+        printf("Error: could not create a scratch directory in %s\n", options->directory);
+        return 1;
+    }
+    printf("Backup benchmark in %s: building %d MB of data...\n", scratch, options->megabytes);
+    int result = runSteps((long long)options->megabytes * 1024 * 1024);
+    if (chdir(home) == 0)
+        nftw(scratch, removeEntry, 16, FTW_DEPTH | FTW_PHYS);
+    return result;
+}
+
+// --- Recovery benchmark ---
+
+// The data rows of a CSV file, header dropped. Returns the count; the rows point into
+// *text, and the caller frees both *text and *lines.
+static int readRows(const char *path, char ***lines, char **text)
+{
+    *lines = NULL;
+    *text = NULL;
+    FILE *f = fopen(path, "r");
+    if (!f)
+        return 0;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    rewind(f);
+    *text = (char *)malloc((size_t)size + 1);
+    size_t got = *text ? fread(*text, 1, (size_t)size, f) : 0;
+    fclose(f);
+    if (!*text)
+        return 0;
+    (*text)[got] = '\0';
+    int count = 0, capacity = 0;
+    char *line = strchr(*text, '\n'); // Skip the header
+    while (line && *++line)
+    {
+        char *end = strchr(line, '\n');
+        if (end)
+            *end = '\0';
+        if (count == capacity)
+        {
+            capacity = capacity ? capacity * 2 : 1024;
+            char **grown = (char **)realloc(*lines, (size_t)capacity * sizeof(char *));
+            if (!grown)
+                break;
+            *lines = grown;
+        }
+        (*lines)[count++] = line;
+        line = end;
+    }
+    return count;
+}
+
+static long maxId(char **lines, int count)
+{
+    long max = 0;
+    for (int i = 0; i < count; i++)
+    {
+        long id = atol(lines[i]);
+        if (id > max)
+            max = id;
+    }
+    return max;
+}
+
+// A journal line: template row 'row' with its id (the first field) replaced by 'id'.
+static void writeJournalRow(FILE *f, long sequence, long long stamp, char kind, long id, const char *row)
+{
+    const char *rest = strchr(row, ',');
+    fprintf(f, "%ld@%lld,%c,%ld%s\n", sequence, stamp, kind, id, rest ? rest : "");
+}
+
+// Archives 'rows' journal rows the way bookings produce them, all after the backup:
+// each booking adds a rental and its invoice, and every other booking is later
+// updated again (completed and paid).
+static int writeJournal(long rows, long firstSequence, time_t stamp, char **rentals, int rentalCount,
+                        char **invoices, int invoiceCount)
+{
+    char path[64];
+    struct tm tm;
+    localTimeSafe(stamp, &tm);
+    mkdir("data/journal", 0755);
+    strftime(path, sizeof(path), "data/journal/%Y-%m-%d.log", &tm);
+    FILE *f = fopen(path, "w");
+    if (!f)
+        return 0;
+    long rentalBase = maxId(rentals, rentalCount) + 1, invoiceBase = maxId(invoices, invoiceCount) + 1;
+    long sequence = firstSequence;
+    for (long booking = 0; sequence < firstSequence + rows; booking++)
+    {
+        const char *rental = rentals[booking % rentalCount], *invoice = invoices[booking % invoiceCount];
+        writeJournalRow(f, sequence++, (long long)stamp, 'R', rentalBase + booking, rental);
+        writeJournalRow(f, sequence++, (long long)stamp, 'I', invoiceBase + booking, invoice);
+        if (booking % 2 == 1 && sequence < firstSequence + rows)
+        {
+            long earlier = booking / 2;
+            writeJournalRow(f, sequence++, (long long)stamp, 'R', rentalBase + earlier, rentals[earlier % rentalCount]);
+            writeJournalRow(f, sequence++, (long long)stamp, 'I', invoiceBase + earlier,
+                            invoices[earlier % invoiceCount]);
+        }
+    }
+    return fclose(f) == 0;
+}
+
+// Leaves only backup 'keep': each recovery backs up its result, and the next run
+// must start from the same backup again.
+static void removeOtherBackups(const char *keep)
+{
+    DIR *dir = opendir("backups");
+    if (!dir)
+        return;
+    char manifest[160];
+    snprintf(manifest, sizeof(manifest), "%s.manifest", keep);
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL)
+    {
+        size_t len = strlen(entry->d_name);
+        if (len > 9 && strcmp(entry->d_name + len - 9, ".manifest") == 0 && strcmp(entry->d_name, manifest) != 0)
+        {
+            char path[512];
+            snprintf(path, sizeof(path), "backups/%s", entry->d_name);
+            remove(path);
+        }
+    }
+    closedir(dir);
+}
+
+// One --recover run in a child process. Returns 0 and fills the phases it reports.
+static int timeRecovery(const char *instant, double *wall, double phases[3], long *replayed)
+{
+    char command[256];
+    // popen runs a shell, so /proc/self would be the shell: name this process.
+    snprintf(command, sizeof(command), "/proc/%ld/exe --recover \"%s\" 2>&1", (long)getpid(), instant);
+    struct timespec started;
+    clock_gettime(CLOCK_MONOTONIC, &started);
+    FILE *child = popen(command, "r");
+    if (!child)
+        return 1;
+    char line[512];
+    int found = 0;
+    *replayed = 0;
+    while (fgets(line, sizeof(line), child))
+    {
+        char *plus = strstr(line, " plus ");
+        if (strncmp(line, "Recovered ", 10) == 0 && plus)
+            *replayed = atol(plus + 6);
+        if (sscanf(line, "Recovery took %*f ms: load %lf ms, replay %lf ms, save %lf ms", &phases[0], &phases[1],
+                   &phases[2]) == 3)
+            found = 1;
+    }
+    int status = pclose(child);
+    *wall = secondsSince(&started);
+    return found && status == 0 ? 0 : 1;
+}
+
+// The latest monthly partition of 'dir' among the listed files, or NULL. Ids grow
+// with time, so its rows hold the highest ones.
+static const char *latestPartition(char (*paths)[BACKUP_PATH_SIZE], int count, const char *dir)
+{
+    const char *latest = NULL;
+    size_t length = strlen(dir);
+    for (int i = 0; i < count; i++)
+    {
+        if (strncmp(paths[i], dir, length) == 0 && paths[i][length] == '/' &&
+            partitionMonthOfText(paths[i] + length + 1))
+            latest = paths[i];
+    }
+    return latest;
+}
+
+static int runRecoverySteps(const char *home, char (*paths)[BACKUP_PATH_SIZE], int count, long maxRows)
+{
+    // A copy of the real data files, so the loaders see what they normally see.
+    mkdir("data", 0755);
+    for (int i = 0; i < NUM_DATA_DIRS; i++)
+        mkdir(dataDirsToBackup[i], 0755);
+    for (int i = 0; i < count; i++)
+    {
+        char source[1100];
+        snprintf(source, sizeof(source), "%s/%.*s", home, BACKUP_PATH_SIZE, paths[i]);
+        if (!copyFile(source, paths[i], NULL))
+            printf("  (no %s to copy)\n", paths[i]);
+    }
+    // Journal rows are made from the rows of the latest month.
+    const char *rentalFile = latestPartition(paths, count, "data/rentals");
+    const char *invoiceFile = latestPartition(paths, count, "data/invoices");
+    char **rentals = NULL, **invoices = NULL, *rentalText = NULL, *invoiceText = NULL;
+    int rentalCount = rentalFile ? readRows(rentalFile, &rentals, &rentalText) : 0;
+    int invoiceCount = invoiceFile ? readRows(invoiceFile, &invoices, &invoiceText) : 0;
+    int result = 1;
+    char name[128];
+    BackupStats stats;
+    if (rentalCount == 0 || invoiceCount == 0)
+        printf("Error: the benchmark needs rentals and invoices with some rows, in monthly partitions\n");
+    else if (createBackup(name, sizeof(name), &stats))
+    {
+        time_t created;
+        long sequence;
+        findBackupBefore(time(NULL), name, sizeof(name), &created, &sequence);
+        // Every row is stamped just after the backup; the recovery goes to an hour later.
+        char instant[32];
+        struct tm tm;
+        time_t until = created + 3600;
+        localTimeSafe(until, &tm);
+        strftime(instant, sizeof(instant), "%Y-%m-%d %H:%M:%S", &tm);
+        printf("Backup '%s' of %.1f MB; %d rentals, %d invoices\n", name, megabytes(stats.bytes), rentalCount,
+               invoiceCount);
+        printf("  %10s %10s %10s %10s %10s %12s\n", "log rows", "total ms", "load ms", "replay ms", "save ms",
+               "rows/s");
+        result = 0;
+        for (long rows = 0; rows <= maxRows && result == 0; rows = rows ? rows * 10 : 1000)
+        {
+            removeOtherBackups(name);
+            remove("data/journal.log");
+            double wall, phases[3];
+            long replayed;
+            if (!writeJournal(rows, sequence + 1, created + 1, rentals, rentalCount, invoices, invoiceCount) ||
+                timeRecovery(instant, &wall, phases, &replayed) != 0 || replayed != rows)
+            {
+                printf("Error: the recovery with %ld log rows failed\n", rows);
+                result = 1;
+                break;
+            }
+            printf("  %10ld %10.1f %10.1f %10.1f %10.1f %12.0f\n", rows, wall * 1000.0, phases[0], phases[1],
+                   phases[2], phases[1] > 0 ? (double)rows / (phases[1] / 1000.0) : 0.0);
+        }
+        printf("(Total is the whole child process, including start-up and the backup of the result.)\n");
+    }
+    free(rentals);
+    free(invoices);
+    free(rentalText);
+    free(invoiceText);
+    return result;
+}
+
+int runRecoveryBenchmark(const RecoveryBenchOptions *options)
+{
+    char scratch[512];
+    snprintf(scratch, sizeof(scratch), "%s/ridemate-bench-XXXXXX", options->directory);
+    char home[1024];
+    static char paths[512][BACKUP_PATH_SIZE];
+    int count = listFilesToBackup(paths, 512);
+    if (!getcwd(home, sizeof(home)) || !mkdtemp(scratch) || chdir(scratch) != 0)
+    {
+        printf("Error: could not create a scratch directory in %s\n", options->directory);
+        return 1;
+    }
+    printf("Recovery benchmark in %s, on a copy of the data in %s\n", scratch, home);
+    int result = runRecoverySteps(home, paths, count, options->maxRows);
+    if (chdir(home) == 0)
+        nftw(scratch, removeEntry, 16, FTW_DEPTH | FTW_PHYS);
+    return result;
+}
+
+#else
+
+int runBackupBenchmark(const BackupBenchOptions *options)
+{
+    (void)options;
+    printf("The backup benchmark is not available on this platform.\n");
+    return 1;
+}
+
+int runRecoveryBenchmark(const RecoveryBenchOptions *options)
+{
+    (void)options;
+    printf("The recovery benchmark is not available on this platform.\n");
+    return 1;
+}
+
+#endif // _WIN32
@@ -0,0 +1,31 @@
+// File: backupbench.h
+// Description: Benchmark for the backup and restore paths (--bench-backup). Builds a
+// synthetic data set of the requested size in a scratch directory, times whole-file
+// copies with each copy method, a first, a repeat and an incremental backup, reading
+// the backup back as the loaders would and a full restore to files, then removes the
+// scratch directory. The recovery benchmark (--bench-recovery) times point-in-time
+// recoveries from one backup over growing lengths of journal, each in a child process
+// as an operator would run it.
+
+#ifndef BACKUPBENCH_H
+#define BACKUPBENCH_H
+
+typedef struct
+{
+    const char *directory; // Where the scratch directory is made; same file system as the data by default
+    int megabytes;         // Size of the synthetic data set
+} BackupBenchOptions;
+
+// Runs the benchmark and prints the results. Returns 0 on success, 1 on failure.
+int runBackupBenchmark(const BackupBenchOptions *options);
+
+typedef struct
+{
+    const char *directory; // Where the scratch directory is made
+    long maxRows;          // Journal lengths run from 1000 up to this, ten times longer each step
+} RecoveryBenchOptions;
+
+// Runs on a copy of the data files in the current directory. Returns 0 on success.
+int runRecoveryBenchmark(const RecoveryBenchOptions *options);
+
+#endif // BACKUPBENCH_H
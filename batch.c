@@ -0,0 +1,929 @@
+#include "batch.h"
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdarg.h>
+
+#include "vehicle.h"
+#include "driver.h"
+#include "search.h"
+#include "money.h"
+#include "spscqueue.h"
+#include "journal.h"
+
+#define BATCH_MAX_FIELDS 16
+#define BATCH_KEY_MAX 32
+#define BATCH_VALUE_MAX 256
+#define BATCH_RESULT_MAX 1024
+
+// One command line is a flat JSON object: string, number, true/false/null values only.
+typedef struct
+{
+    char key[BATCH_KEY_MAX];
+    char value[BATCH_VALUE_MAX]; // Strings unescaped, other values as written
+} BatchField;
+
+typedef struct
+{
+    BatchField fields[BATCH_MAX_FIELDS];
+    int count;
+} BatchCommand;
+
+static const char *skipSpace(const char *p)
+{
+    while (isspace((unsigned char)*p))
+        p++;
+    return p;
+}
+
+// p points at the opening quote. Returns the position after the closing quote, or NULL.
+static const char *parseJsonString(const char *p, char *out, size_t size, const char **error)
+{
+    size_t n = 0;
+    p++;
+    while (*p && *p != '"')
+    {
+        char c = *p++;
+        if (c == '\\')
+        {
+            char e = *p++;
+            switch (e)
+            {
+            case '"':
+            case '\\':
+            case '/':
+                c = e;
+                break;
+            case 'b':
+                c = '\b';
+                break;
+            case 'f':
+                c = '\f';
+                break;
+            case 'n':
+                c = '\n';
+                break;
+            case 'r':
+                c = '\r';
+                break;
+            case 't':
+                c = '\t';
+                break;
+            case 'u':
+            {
+                unsigned code = 0;
+                for (int i = 0; i < 4; i++, p++)
+                {
+                    if (!isxdigit((unsigned char)*p))
+                    {
+                        *error = "bad \\u escape";
+                        return NULL;
+                    }
+                    code = code * 16 + (unsigned)(isdigit((unsigned char)*p) ? *p - '0' : (tolower((unsigned char)*p) - 'a' + 10));
+                }
+                // The model stores plain ASCII text.
+                c = code < 0x80 ? (char)code : '?';
+                break;
+            }
+            default:
+                *error = "bad escape";
+                return NULL;
+            }
+        }
+        if (n + 1 >= size)
+        {
+            *error = "value too long";
+            return NULL;
+        }
+        out[n++] = c;
+    }
+    if (*p != '"')
+    {
+        *error = "unterminated string";
+        return NULL;
+    }
+    out[n] = '\0';
+    return p + 1;
+}
+
+static int parseCommand(const char *line, BatchCommand *cmd, const char **error)
+{
+    cmd->count = 0;
+    const char *p = skipSpace(line);
+    if (*p != '{')
+    {
+        *error = "expected a JSON object";
+        return 0;
+    }
+    p = skipSpace(p + 1);
+    if (*p == '}')
+        return 1;
+
+    while (1)
+    {
+        if (cmd->count == BATCH_MAX_FIELDS)
+        {
+            *error = "too many fields";
+            return 0;
+        }
+        BatchField *field = &cmd->fields[cmd->count];
+        if (*p != '"')
+        {
+            *error = "expected a field name";
+            return 0;
+        }
+        p = parseJsonString(p, field->key, sizeof(field->key), error);
+        if (!p)
+            return 0;
+        p = skipSpace(p);
+        if (*p != ':')
+        {
+            *error = "expected ':'";
+            return 0;
+        }
+        p = skipSpace(p + 1);
+
+        if (*p == '"')
+        {
+            p = parseJsonString(p, field->value, sizeof(field->value), error);
+            if (!p)
+                return 0;
+        }
+        else
+        {
+            size_t n = 0;
+            while (*p == '-' || *p == '+' || *p == '.' || isalnum((unsigned char)*p))
+            {
+                if (n + 1 >= sizeof(field->value))
+                {
+                    *error = "value too long";
+                    return 0;
+                }
+                field->value[n++] = *p++;
+            }
+            field->value[n] = '\0';
+            if (n == 0)
+            {
+                *error = "unsupported value (objects and arrays are not accepted)";
+                return 0;
+            }
+        }
+        cmd->count++;
+
+        p = skipSpace(p);
+        if (*p == ',')
+        {
+            p = skipSpace(p + 1);
+            continue;
+        }
+        if (*p == '}')
+            break;
+        *error = "expected ',' or '}'";
+        return 0;
+    }
+
+    p = skipSpace(p + 1);
+    if (*p)
+    {
+        *error = "trailing characters after object";
+        return 0;
+    }
+    return 1;
+}
+
+static const char *stringField(const BatchCommand *cmd, const char *key)
+{
+    for (int i = 0; i < cmd->count; i++)
+        if (strcmp(cmd->fields[i].key, key) == 0)
+            return cmd->fields[i].value;
+    return NULL;
+}
+
+// Returns 1 and fills *out if key holds an integer (quoted or not), 0 otherwise.
+static int intField(const BatchCommand *cmd, const char *key, int *out)
+{
+    const char *text = stringField(cmd, key);
+    if (!text || !*text)
+        return 0;
+    char *end;
+    long value = strtol(text, &end, 10);
+    if (*end || value < -2147483647L || value > 2147483647L)
+        return 0;
+    *out = (int)value;
+    return 1;
+}
+
+// Appends printf-style text at buf[len], never past size - 1. Returns the new length.
+static size_t appendf(char *buf, size_t size, size_t len, const char *fmt, ...)
+{
+    if (len + 1 >= size)
+        return len;
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(buf + len, size - len, fmt, args);
+    va_end(args);
+    if (n < 0)
+        return len;
+    return len + (size_t)n < size ? len + (size_t)n : size - 1;
+}
+
+static size_t appendJsonString(char *buf, size_t size, size_t len, const char *text)
+{
+    len = appendf(buf, size, len, "\"");
+    for (const unsigned char *c = (const unsigned char *)text; *c; c++)
+    {
+        if (*c == '"' || *c == '\\')
+            len = appendf(buf, size, len, "\\%c", *c);
+        else if (*c == '\n')
+            len = appendf(buf, size, len, "\\n");
+        else if (*c < 0x20)
+            len = appendf(buf, size, len, "\\u%04x", *c);
+        else
+            len = appendf(buf, size, len, "%c", *c);
+    }
+    return appendf(buf, size, len, "\"");
+}
+
+static Rental *rentalField(const BatchModel *ctx, const BatchCommand *cmd, const char **error)
+{
+    int id;
+    if (!intField(cmd, "rental", &id))
+    {
+        *error = "missing or invalid \"rental\"";
+        return NULL;
+    }
+    Rental *r = findRentalById(ctx->rentals, id);
+    if (!r)
+        *error = "rental not found";
+    return r;
+}
+
+static Invoice *invoiceField(const BatchModel *ctx, const BatchCommand *cmd, const char **error)
+{
+    int id;
+    Invoice *invoice = NULL;
+    if (intField(cmd, "invoice", &id))
+        invoice = findInvoiceById(*ctx->invoiceHead, id);
+    else if (intField(cmd, "rental", &id))
+        invoice = findInvoiceByRentalId(*ctx->invoiceHead, id);
+    else
+    {
+        *error = "missing \"invoice\" or \"rental\"";
+        return NULL;
+    }
+    if (!invoice)
+        *error = "invoice not found";
+    return invoice;
+}
+
+static int parseRentalType(const char *text, RentalType *out)
+{
+    if (!text)
+        return 0;
+    if (strcmp(text, "hourly") == 0 || strcmp(text, "1") == 0)
+        *out = RENT_HOURLY;
+    else if (strcmp(text, "daily") == 0 || strcmp(text, "2") == 0)
+        *out = RENT_DAILY;
+    else if (strcmp(text, "route") == 0 || strcmp(text, "3") == 0)
+        *out = RENT_ROUTE;
+    else
+        return 0;
+    return 1;
+}
+
+static int parsePaymentMethod(const char *text, PaymentMethod *out)
+{
+    if (!text || strcmp(text, "cash") == 0 || strcmp(text, "0") == 0)
+        *out = PAYMENT_CASH;
+    else if (strcmp(text, "card") == 0 || strcmp(text, "1") == 0)
+        *out = PAYMENT_CARD;
+    else if (strcmp(text, "mobile") == 0 || strcmp(text, "2") == 0)
+        *out = PAYMENT_MOBILE_BANKING;
+    else if (strcmp(text, "crypto") == 0 || strcmp(text, "3") == 0)
+        *out = PAYMENT_CRYPTO;
+    else
+        return 0;
+    return 1;
+}
+
+// Each command returns NULL on success (after writing its result fields into
+// 'fields') or a short error message.
+
+static const char *runBook(const BatchModel *ctx, const BatchCommand *cmd, char *fields, size_t size)
+{
+    BookingRequest request = {0};
+    if (!intField(cmd, "customer", &request.customerId))
+        return "missing or invalid \"customer\"";
+    if (!findCustomerById(ctx->customerHead, request.customerId))
+        return "customer not found";
+    if (!intField(cmd, "vehicle", &request.vehicleId))
+        return "missing or invalid \"vehicle\"";
+    if (!parseRentalType(stringField(cmd, "type"), &request.type))
+        return "\"type\" must be hourly, daily or route";
+    if (request.type == RENT_HOURLY && !intField(cmd, "hours", &request.quantity))
+        return "missing or invalid \"hours\"";
+    if (request.type == RENT_DAILY && !intField(cmd, "days", &request.quantity))
+        return "missing or invalid \"days\"";
+    if (request.type == RENT_ROUTE && !intField(cmd, "route", &request.routeId))
+        return "missing or invalid \"route\"";
+    request.promoCode = stringField(cmd, "promo");
+
+    BookingResult booked;
+    RentalResult result = bookRental(ctx->rentals, ctx->vehicleHead, ctx->promoHead, ctx->driverHead,
+                                     ctx->invoiceHead, &request, &booked);
+    if (result != RENTAL_OK)
+        return rentalResultStr(result);
+
+    char cost[MONEY_STR_SIZE], discount[MONEY_STR_SIZE];
+    formatMoney(booked.rental.totalCost, cost, sizeof(cost));
+    formatMoney(booked.discountAmount, discount, sizeof(discount));
+    snprintf(fields, size, ",\"rental\":%d,\"driver\":%d,\"invoice\":%d,\"cost\":\"%s\",\"discount\":\"%s\"",
+             booked.rental.id, booked.rental.driverId, booked.invoice ? booked.invoice->id : 0, cost, discount);
+    return NULL;
+}
+
+static const char *runComplete(const BatchModel *ctx, const BatchCommand *cmd, char *fields, size_t size)
+{
+    const char *error;
+    Rental *r = rentalField(ctx, cmd, &error);
+    if (!r)
+        return error;
+    RentalResult result = completeRental(ctx->rentals, r, ctx->vehicleHead, ctx->driverHead, stringField(cmd, "end"));
+    if (result != RENTAL_OK)
+        return rentalResultStr(result);
+    snprintf(fields, size, ",\"rental\":%d,\"end\":\"%s\"", r->id, rentalDetail(ctx->rentals, r)->endTime);
+    return NULL;
+}
+
+static const char *runCancel(const BatchModel *ctx, const BatchCommand *cmd, char *fields, size_t size)
+{
+    const char *error;
+    Rental *r = rentalField(ctx, cmd, &error);
+    if (!r)
+        return error;
+    RentalResult result = cancelRental(ctx->rentals, r, ctx->vehicleHead, ctx->driverHead);
+    if (result != RENTAL_OK)
+        return rentalResultStr(result);
+    snprintf(fields, size, ",\"rental\":%d", r->id);
+    return NULL;
+}
+
+static const char *runRate(const BatchModel *ctx, const BatchCommand *cmd, char *fields, size_t size)
+{
+    const char *error;
+    Rental *r = rentalField(ctx, cmd, &error);
+    if (!r)
+        return error;
+    int vehicleRating, driverRating;
+    if (!intField(cmd, "vehicleRating", &vehicleRating) || !intField(cmd, "driverRating", &driverRating))
+        return "missing or invalid \"vehicleRating\"/\"driverRating\"";
+    RentalResult result = rateRental(ctx->rentals, r, ctx->vehicleHead, ctx->driverHead,
+                                     vehicleRating, driverRating, stringField(cmd, "comment"));
+    if (result != RENTAL_OK)
+        return rentalResultStr(result);
+    snprintf(fields, size, ",\"rental\":%d", r->id);
+    return NULL;
+}
+
+static const char *runPay(const BatchModel *ctx, const BatchCommand *cmd, char *fields, size_t size)
+{
+    const char *error;
+    Invoice *invoice = invoiceField(ctx, cmd, &error);
+    if (!invoice)
+        return error;
+    PaymentMethod method;
+    if (!parsePaymentMethod(stringField(cmd, "method"), &method))
+        return "\"method\" must be cash, card, mobile or crypto";
+    // The reference goes unquoted into the invoice row; a comma or line break from
+    // the JSON would split it, so they become spaces (as rateRental does for comments).
+    const char *text = stringField(cmd, "reference");
+    char reference[sizeof(invoice->paymentReference)];
+    snprintf(reference, sizeof(reference), "%s", text ? text : "");
+    for (char *c = reference; *c; c++)
+    {
+        if (*c == ',' || *c == '\n' || *c == '\r')
+            *c = ' ';
+    }
+    if (!processPayment(invoice, method, text ? reference : NULL))
+        return "invoice is not pending";
+    char total[MONEY_STR_SIZE];
+    formatMoney(invoice->totalAmount, total, sizeof(total));
+    snprintf(fields, size, ",\"invoice\":%d,\"total\":\"%s\"", invoice->id, total);
+    return NULL;
+}
+
+static const char *runRefund(const BatchModel *ctx, const BatchCommand *cmd, char *fields, size_t size)
+{
+    const char *error;
+    Invoice *invoice = invoiceField(ctx, cmd, &error);
+    if (!invoice)
+        return error;
+    if (!refundInvoice(invoice))
+        return "invoice is not paid";
+    snprintf(fields, size, ",\"invoice\":%d", invoice->id);
+    return NULL;
+}
+
+static const char *runGetRental(const BatchModel *ctx, const BatchCommand *cmd, char *fields, size_t size)
+{
+    const char *error;
+    Rental *r = rentalField(ctx, cmd, &error);
+    const RentalDetail *d = r ? rentalDetail(ctx->rentals, r) : NULL;
+    // Rentals of archived months are read back from their segment.
+    Rental archived;
+    RentalDetail archivedDetail;
+    int id;
+    if (!r && intField(cmd, "rental", &id) && fetchArchivedRental(ctx->rentals, id, &archived, &archivedDetail))
+    {
+        r = &archived;
+        d = &archivedDetail;
+    }
+    if (!r)
+        return error;
+    char cost[MONEY_STR_SIZE];
+    formatMoney(r->totalCost, cost, sizeof(cost));
+    snprintf(fields, size, ",\"rental\":%d,\"customer\":%d,\"vehicle\":%d,\"driver\":%d,\"route\":%d,"
+             "\"type\":\"%s\",\"status\":\"%s\",\"start\":\"%s\",\"end\":\"%s\",\"cost\":\"%s\"",
+             r->id, r->customerId, r->vehicleId, r->driverId, r->routeId, rentalTypeStr(r->type),
+             rentalStatusStr(r->status), d->startTime, d->endTime, cost);
+    return NULL;
+}
+
+static const char *runGetDriver(const BatchModel *ctx, const BatchCommand *cmd, char *fields, size_t size)
+{
+    int id;
+    if (!intField(cmd, "driver", &id))
+        return "missing or invalid \"driver\"";
+    Driver *driver = findDriverById(ctx->driverHead, id);
+    if (!driver)
+        return "driver not found";
+    static const char *const statusNames[] = {"AVAILABLE", "BUSY", "OFFLINE"};
+    char earnings[MONEY_STR_SIZE];
+    formatMoney(driver->totalEarnings, earnings, sizeof(earnings));
+    snprintf(fields, size, ",\"driver\":%d,\"status\":\"%s\",\"vehicleType\":\"%s\",\"rating\":%.2f,\"trips\":%d,\"earnings\":\"%s\"",
+             driver->id, driver->status <= DRIVER_OFFLINE ? statusNames[driver->status] : "UNKNOWN",
+             driver->vehicleType, driver->rating, driver->totalTrips, earnings);
+    return NULL;
+}
+
+static const char *runGetInvoice(const BatchModel *ctx, const BatchCommand *cmd, char *fields, size_t size)
+{
+    const char *error;
+    Invoice *invoice = invoiceField(ctx, cmd, &error);
+    if (!invoice)
+        return error;
+    char subtotal[MONEY_STR_SIZE], discount[MONEY_STR_SIZE], tax[MONEY_STR_SIZE], total[MONEY_STR_SIZE];
+    formatMoney(invoice->subtotal, subtotal, sizeof(subtotal));
+    formatMoney(invoice->discountAmount, discount, sizeof(discount));
+    formatMoney(invoice->taxAmount, tax, sizeof(tax));
+    formatMoney(invoice->totalAmount, total, sizeof(total));
+    snprintf(fields, size, ",\"invoice\":%d,\"rental\":%d,\"status\":\"%s\",\"method\":\"%s\","
+             "\"subtotal\":\"%s\",\"discount\":\"%s\",\"tax\":\"%s\",\"total\":\"%s\"",
+             invoice->id, invoice->rentalId, invoiceStatusStr(invoice->status), paymentMethodStr(invoice->paymentMethod),
+             subtotal, discount, tax, total);
+    return NULL;
+}
+
+// Matching vehicle ids, at most BATCH_SEARCH_MAX of them; "count" is the full number.
+#define BATCH_SEARCH_MAX 50
+
+static const char *runSearch(const BatchModel *ctx, const BatchCommand *cmd, char *fields, size_t size)
+{
+    VehicleQuery query = {0};
+    query.text = stringField(cmd, "text");
+    query.type = stringField(cmd, "type");
+    const char *maxDaily = stringField(cmd, "maxDaily");
+    if (maxDaily && !parseMoney(maxDaily, &query.maxPricePerDay))
+        return "invalid \"maxDaily\"";
+    const char *available = stringField(cmd, "available");
+    query.availableOnly = available && strcmp(available, "true") == 0;
+
+    int count = 0;
+    size_t len = appendf(fields, size, 0, ",\"vehicles\":[");
+    for (const Vehicle *v = ctx->vehicleHead; v; v = v->next)
+    {
+        if (!vehicleMatches(v, &query))
+            continue;
+        if (count < BATCH_SEARCH_MAX)
+            len = appendf(fields, size, len, count ? ",%d" : "%d", v->id);
+        count++;
+    }
+    appendf(fields, size, len, "],\"count\":%d", count);
+    return NULL;
+}
+
+typedef const char *(*BatchHandler)(const BatchModel *ctx, const BatchCommand *cmd, char *fields, size_t size);
+
+static const struct
+{
+    const char *op;
+    BatchHandler run;
+} handlers[] = {
+    {"book", runBook},
+    {"complete", runComplete},
+    {"cancel", runCancel},
+    {"rate", runRate},
+    {"pay", runPay},
+    {"refund", runRefund},
+    {"rental", runGetRental},
+    {"driver", runGetDriver},
+    {"invoice", runGetInvoice},
+    {"search", runSearch},
+};
+
+static double monotonicSeconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+#define HANDLER_COUNT ((int)(sizeof(handlers) / sizeof(handlers[0])))
+
+// Items in flight. Every queue is this big, so a push never waits for room.
+#define BATCH_PIPELINE_ITEMS 128
+
+// One command on its way through the stages. Items are recycled from the emit
+// stage back to the read stage and only freed when the batch ends.
+typedef struct
+{
+    int eof; // No more input; passed through every stage so each thread can stop
+    long lineNumber;
+    char line[BATCH_LINE_MAX];
+    BatchCommand cmd;
+    int handler; // Index into handlers, -1 if the line did not parse
+    const char *op;
+    const char *id;
+    const char *error;
+    long sequence; // Journal row the result waits for before it is written
+    char fields[BATCH_RESULT_MAX];
+} BatchItem;
+
+// A result line held back until the journal rows it reports on are durable.
+typedef struct
+{
+    long sequence;
+    size_t length;
+    char text[BATCH_RESPONSE_MAX];
+} HeldResult;
+
+typedef struct
+{
+    FILE *in;
+    FILE *out;
+    long lineNumber; // Read stage only
+    const BatchModel *model; // Commit stage only; the model has a single writer
+    BatchStats *stats;
+    // queues[s] feeds stage s; queues[0] carries emitted items back to the reader.
+    SpscQueue queues[BATCH_STAGES];
+    // Emit stage only: results waiting for the journal, oldest first, as a ring of
+    // BATCH_PIPELINE_ITEMS. NULL when the journal is off.
+    HeldResult *held;
+    int heldFirst;
+    int heldCount;
+} BatchPipeline;
+
+typedef struct
+{
+    BatchPipeline *pipeline;
+    int first; // Stages [first, last] run back to back on this thread
+    int last;
+} BatchStageGroup;
+
+static void resetItem(BatchItem *item)
+{
+    item->error = NULL;
+    item->op = NULL;
+    item->id = NULL;
+    item->handler = -1;
+    item->sequence = 0;
+    item->fields[0] = '\0';
+}
+
+static void parseItem(BatchItem *item)
+{
+    if (item->error || !parseCommand(item->line, &item->cmd, &item->error))
+        return;
+    item->op = stringField(&item->cmd, "op");
+    item->id = stringField(&item->cmd, "id");
+    if (!item->op)
+    {
+        item->error = "missing \"op\"";
+        return;
+    }
+    for (int i = 0; i < HANDLER_COUNT; i++)
+    {
+        if (strcmp(handlers[i].op, item->op) == 0)
+        {
+            item->handler = i;
+            return;
+        }
+    }
+    item->error = "unknown op";
+}
+
+static void commitItem(const BatchModel *model, BatchItem *item)
+{
+    if (item->handler >= 0)
+        item->error = handlers[item->handler].run(model, &item->cmd, item->fields, sizeof(item->fields));
+    item->sequence = journalThreadSequence();
+}
+
+static size_t formatItem(const BatchItem *item, char *buf, size_t size)
+{
+    size_t len = appendf(buf, size, 0, "{\"line\":%ld", item->lineNumber);
+    if (item->id)
+    {
+        len = appendf(buf, size, len, ",\"id\":");
+        len = appendJsonString(buf, size, len, item->id);
+    }
+    if (item->op)
+    {
+        len = appendf(buf, size, len, ",\"op\":");
+        len = appendJsonString(buf, size, len, item->op);
+    }
+    if (item->error)
+    {
+        len = appendf(buf, size, len, ",\"ok\":false,\"error\":");
+        len = appendJsonString(buf, size, len, item->error);
+        len = appendf(buf, size, len, "}");
+    }
+    else
+    {
+        len = appendf(buf, size, len, ",\"ok\":true%s}", item->fields);
+    }
+    // Always end with a newline, even if the text above had to be cut short.
+    if (len + 1 >= size)
+        len = size - 2;
+    buf[len++] = '\n';
+    buf[len] = '\0';
+    return len;
+}
+
+// Writes the held results whose rows are durable, oldest first. Returns 'durable'.
+static long releaseHeldResults(BatchPipeline *p, long durable)
+{
+    while (p->heldCount > 0 && p->held[p->heldFirst].sequence <= durable)
+    {
+        const HeldResult *first = &p->held[p->heldFirst];
+        fwrite(first->text, 1, first->length, p->out);
+        p->heldFirst = (p->heldFirst + 1) % BATCH_PIPELINE_ITEMS;
+        p->heldCount--;
+    }
+    return durable;
+}
+
+static void readStage(BatchPipeline *p, BatchItem *item)
+{
+    resetItem(item);
+    while (fgets(item->line, sizeof(item->line), p->in))
+    {
+        item->lineNumber = ++p->lineNumber;
+        size_t length = strcspn(item->line, "\n");
+        if (item->line[length] != '\n' && !feof(p->in))
+        {
+            int c;
+            while ((c = fgetc(p->in)) != '\n' && c != EOF)
+                ;
+            item->error = "line too long";
+        }
+        item->line[length] = '\0';
+        if (item->error || *skipSpace(item->line) != '\0')
+            return;
+    }
+    item->eof = 1;
+}
+
+static void parseStage(BatchPipeline *p, BatchItem *item)
+{
+    (void)p;
+    parseItem(item);
+}
+
+static void commitStage(BatchPipeline *p, BatchItem *item)
+{
+    commitItem(p->model, item);
+}
+
+static void emitStage(BatchPipeline *p, BatchItem *item)
+{
+    BatchStats *stats = p->stats;
+    stats->requests++;
+    if (item->error)
+        stats->failed++;
+    else
+    {
+        stats->succeeded++;
+        if (handlers[item->handler].run == runBook)
+            stats->bookings++;
+    }
+
+    if (!p->held)
+    {
+        char result[BATCH_RESPONSE_MAX];
+        size_t len = formatItem(item, result, sizeof(result));
+        fwrite(result, 1, len, p->out);
+        return;
+    }
+
+    // Results leave in input order, each once its journal rows are durable. The
+    // commit stage keeps going meanwhile, so one fsync acknowledges many commands.
+    long durable = releaseHeldResults(p, journalDurableSequence());
+    if (p->heldCount == 0 && item->sequence <= durable)
+    {
+        char result[BATCH_RESPONSE_MAX];
+        size_t len = formatItem(item, result, sizeof(result));
+        fwrite(result, 1, len, p->out);
+        return;
+    }
+    if (p->heldCount == BATCH_PIPELINE_ITEMS)
+    {
+        journalWait(p->held[p->heldFirst].sequence);
+        releaseHeldResults(p, journalDurableSequence());
+    }
+    HeldResult *slot = &p->held[(p->heldFirst + p->heldCount) % BATCH_PIPELINE_ITEMS];
+    slot->sequence = item->sequence;
+    slot->length = formatItem(item, slot->text, sizeof(slot->text));
+    p->heldCount++;
+}
+
+size_t formatBatchError(long lineNumber, const char *error, char *buf, size_t size)
+{
+    BatchItem item;
+    resetItem(&item);
+    item.lineNumber = lineNumber;
+    item.error = error;
+    return formatItem(&item, buf, size);
+}
+
+size_t runBatchCommand(const BatchModel *model, long lineNumber, const char *line, char *buf, size_t size)
+{
+    BatchItem item;
+    resetItem(&item);
+    item.eof = 0;
+    item.lineNumber = lineNumber;
+    size_t length = strlen(line);
+    if (length >= sizeof(item.line))
+    {
+        item.error = "line too long";
+        item.line[0] = '\0';
+    }
+    else
+    {
+        memcpy(item.line, line, length + 1);
+        parseItem(&item);
+        commitItem(model, &item);
+    }
+    return formatItem(&item, buf, size);
+}
+
+typedef void (*BatchStageFn)(BatchPipeline *p, BatchItem *item);
+
+static const BatchStageFn stageFns[BATCH_STAGES] = {readStage, parseStage, commitStage, emitStage};
+static const char *const stageNames[BATCH_STAGES] = {"read", "parse", "commit", "emit"};
+
+static void *runStageGroup(void *arg)
+{
+    BatchStageGroup *group = (BatchStageGroup *)arg;
+    BatchPipeline *p = group->pipeline;
+    int next = (group->last + 1) % BATCH_STAGES;
+
+    for (;;)
+    {
+        BatchItem *item = (BatchItem *)spscPop(&p->queues[group->first]);
+        for (int s = group->first; s <= group->last && !item->eof; s++)
+        {
+            double begin = monotonicSeconds();
+            stageFns[s](p, item);
+            if (item->eof)
+                break;
+            double took = monotonicSeconds() - begin;
+            BatchStageStats *stage = &p->stats->stages[s];
+            stage->items++;
+            stage->seconds += took;
+            if (took > stage->maxSeconds)
+                stage->maxSeconds = took;
+        }
+        int eof = item->eof;
+        spscPush(&p->queues[next], item);
+        if (eof)
+            return NULL;
+    }
+}
+
+void runBatch(FILE *in, FILE *out, int threads, const BatchModel *model, BatchStats *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    if (threads < 1)
+        threads = 1;
+    if (threads > BATCH_STAGES)
+        threads = BATCH_STAGES;
+    stats->threads = threads;
+
+    BatchPipeline p = {0};
+    p.in = in;
+    p.out = out;
+    p.model = model;
+    p.stats = stats;
+
+    BatchItem *items = (BatchItem *)calloc(BATCH_PIPELINE_ITEMS, sizeof(BatchItem));
+    if (journalEnabled())
+    {
+        p.held = (HeldResult *)malloc(BATCH_PIPELINE_ITEMS * sizeof(HeldResult));
+        if (!p.held)
+        {
+            free(items);
+            items = NULL;
+        }
+    }
+    int queuesReady = 0;
+    while (items && queuesReady < BATCH_STAGES && spscInit(&p.queues[queuesReady], BATCH_PIPELINE_ITEMS))
+        queuesReady++;
+    if (queuesReady < BATCH_STAGES)
+    {
+        printf("Error: out of memory starting the batch pipeline\n");
+        for (int i = 0; i < queuesReady; i++)
+            spscFree(&p.queues[i]);
+        free(items);
+        free(p.held);
+        return;
+    }
+    for (int i = 0; i < BATCH_PIPELINE_ITEMS; i++)
+        spscPush(&p.queues[0], &items[i]);
+
+    // Stage s runs on thread s * threads / BATCH_STAGES: 2 threads give
+    // read+parse | commit+emit, 4 give every stage its own thread.
+    BatchStageGroup groups[BATCH_STAGES];
+    int groupCount = 0;
+    for (int s = 0; s < BATCH_STAGES; s++)
+    {
+        int thread = s * threads / BATCH_STAGES;
+        if (groupCount == thread)
+            groups[groupCount++] = (BatchStageGroup){&p, s, s};
+        else
+            groups[thread].last = s;
+        stats->stages[s].thread = thread;
+    }
+
+    double start = monotonicSeconds();
+    pthread_t workers[BATCH_STAGES];
+    int started = 1;
+    for (; started < groupCount; started++)
+    {
+        if (pthread_create(&workers[started], NULL, runStageGroup, &groups[started]) != 0)
+            break;
+    }
+    if (started < groupCount)
+    {
+        // Could not get a thread; fold the remaining stages into the last one that started.
+        groups[started - 1].last = BATCH_STAGES - 1;
+        for (int s = groups[started - 1].first; s < BATCH_STAGES; s++)
+            stats->stages[s].thread = started - 1;
+        stats->threads = started;
+    }
+    runStageGroup(&groups[0]);
+    for (int i = 1; i < started; i++)
+        pthread_join(workers[i], NULL);
+    if (p.heldCount > 0)
+    {
+        journalWait(p.held[(p.heldFirst + p.heldCount - 1) % BATCH_PIPELINE_ITEMS].sequence);
+        releaseHeldResults(&p, journalDurableSequence());
+    }
+    fflush(out);
+    stats->seconds = monotonicSeconds() - start;
+
+    for (int s = 0; s < BATCH_STAGES; s++)
+    {
+        BatchStageStats *stage = &stats->stages[s];
+        int fedByQueue = s > 0 && stage->thread != stats->stages[s - 1].thread;
+        stage->queueAverage = fedByQueue ? spscAverageDepth(&p.queues[s]) : 0.0;
+        stage->queueMax = fedByQueue ? p.queues[s].maxDepth : 0;
+    }
+    for (int i = 0; i < BATCH_STAGES; i++)
+        spscFree(&p.queues[i]);
+    free(items);
+    free(p.held);
+}
+
+void printBatchStats(FILE *f, const BatchStats *stats)
+{
+    fprintf(f, "Batch: %ld requests (%ld ok, %ld failed), %ld bookings in %.3f s",
+            stats->requests, stats->succeeded, stats->failed, stats->bookings, stats->seconds);
+    if (stats->seconds > 0)
+        fprintf(f, " (%.0f bookings/s, %.0f requests/s)", stats->bookings / stats->seconds, stats->requests / stats->seconds);
+    fprintf(f, ", %d pipeline thread%s\n", stats->threads, stats->threads == 1 ? "" : "s");
+
+    fprintf(f, "  %-7s %6s %9s %9s %9s %10s %9s\n", "stage", "thread", "items", "avg us", "max us", "queue avg", "queue max");
+    for (int s = 0; s < BATCH_STAGES; s++)
+    {
+        const BatchStageStats *stage = &stats->stages[s];
+        double avg = stage->items ? stage->seconds / stage->items * 1e6 : 0.0;
+        fprintf(f, "  %-7s %6d %9ld %9.2f %9.1f", stageNames[s], stage->thread, stage->items, avg, stage->maxSeconds * 1e6);
+        if (s > 0 && stage->thread != stats->stages[s - 1].thread)
+            fprintf(f, " %10.1f %9zu\n", stage->queueAverage, stage->queueMax);
+        else
+            fprintf(f, " %10s %9s\n", "-", "-");
+    }
+}
@@ -0,0 +1,73 @@
+// File: batch.h
+// Description: Headless batch mode. Reads one JSON command per line (book, complete,
+// cancel, rate, pay, refund, plus the rental/driver/invoice/search lookups), runs it
+// against the in-memory model through the same
+// validation as the menus and writes one JSON result line per command. Commands
+// move through read -> parse -> commit -> emit stages, optionally on separate threads.
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdio.h>
+#include "rental.h"
+#include "customer.h"
+
+// Longest command line accepted, and the longest result line produced.
+#define BATCH_LINE_MAX 4096
+#define BATCH_RESPONSE_MAX 4096
+
+// The parts of the model commands run against. Commands only change what these
+// point to, so one BatchModel can be shared by a whole batch or server run.
+typedef struct
+{
+    RentalTable *rentals;
+    Vehicle *vehicleHead;
+    Customer *customerHead;
+    Promo *promoHead;
+    Driver *driverHead;
+    Invoice **invoiceHead;
+} BatchModel;
+
+// The pipeline stages, in order: read a line, parse it, run it against the model
+// (the only stage that touches it), write the result line.
+#define BATCH_STAGES 4
+
+typedef struct
+{
+    int thread;          // Pipeline thread that ran the stage
+    long items;
+    double seconds;      // Time spent in the stage, summed over items
+    double maxSeconds;   // Slowest single item
+    double queueAverage; // Depth of the queue in front of the stage, sampled on
+    size_t queueMax;     // every push; 0 when the previous stage runs on the same thread
+} BatchStageStats;
+
+typedef struct
+{
+    long requests;
+    long succeeded;
+    long failed;
+    long bookings; // Successful "book" commands
+    double seconds; // Time spent running the batch, excluding load and save
+    int threads;
+    BatchStageStats stages[BATCH_STAGES];
+} BatchStats;
+
+// Runs every command in 'in' and writes the results to 'out', in input order.
+// 'threads' (1-4) spreads the stages over that many threads, joined by SPSC queues.
+// Nothing is saved; the caller persists the model once the whole batch has run.
+// With the journal on, a result line is only written once the rows its command
+// changed are durable in the journal.
+void runBatch(FILE *in, FILE *out, int threads, const BatchModel *model, BatchStats *stats);
+
+// Runs a single command line (without its newline) and writes the result line,
+// newline included, into buf (use BATCH_RESPONSE_MAX). Returns its length.
+size_t runBatchCommand(const BatchModel *model, long lineNumber, const char *line, char *buf, size_t size);
+
+// Result line for a request that was rejected before it could be parsed.
+size_t formatBatchError(long lineNumber, const char *error, char *buf, size_t size);
+
+// Totals, throughput and a per-stage table of latencies and queue depths.
+void printBatchStats(FILE *f, const BatchStats *stats);
+
+#endif // BATCH_H
@@ -0,0 +1,421 @@
+#include "bookingstress.h"
+#include "rental.h"
+#include "vehicle.h"
+#include "invoice.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef struct
+{
+    RentalTable *table;
+    Vehicle *vehicles;
+    Invoice **invoices;
+    int *holders; // Per vehicle: threads that think they hold it right now
+    int vehicleCount;
+    int attempts;
+    unsigned seed;
+    int *rentalIds; // One per successful booking
+    int *invoiceIds;
+    int booked;
+    long refused;      // Conflict or vehicle unavailable: the expected outcomes of a race
+    long doubleBooked; // Booked a vehicle another thread also held
+    long errors;       // Any other failure
+} StressWorker;
+
+static double secondsSince(const struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)(now.tv_sec - start->tv_sec) + (double)(now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static int compareIds(const void *a, const void *b)
+{
+    int x = *(const int *)a, y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+
+// Vehicles 1 .. count, all free. NULL if out of memory.
+static Vehicle *makeFleet(int count)
+{
+    Vehicle *vehicles = NULL;
+    for (int id = count; id >= 1; id--)
+    {
+        Vehicle *v = (Vehicle *)calloc(1, sizeof(Vehicle));
+        if (!v)
+        {
+            freeVehicleList(&vehicles);
+            return NULL;
+        }
+        v->id = id;
+        snprintf(v->make, sizeof(v->make), "Stress");
+        snprintf(v->model, sizeof(v->model), "V%d", id);
+        v->ratePerHour = 1000 + id;
+        v->ratePerDay = 20000;
+        v->available = 1;
+        v->active = 1;
+        v->next = vehicles;
+        vehicles = v;
+    }
+    return vehicles;
+}
+
+// Books a random vehicle, checks nobody else holds it, then completes or cancels the
+// rental so the vehicle is free for the next thread. The holder count is dropped
+// before the release, so a booking that follows a release never counts twice.
+static void *stressWorker(void *arg)
+{
+    StressWorker *w = (StressWorker *)arg;
+    for (int i = 0; i < w->attempts; i++)
+    {
+        w->seed = w->seed * 1103515245u + 12345u;
+        Vehicle *v = w->vehicles;
+        for (int skip = (int)((w->seed >> 8) % (unsigned)w->vehicleCount); skip > 0; skip--)
+            v = v->next;
+
+        BookingRequest request = {0};
+        request.customerId = 1 + (int)(w->seed >> 20) % 100;
+        request.vehicleId = v->id;
+        request.type = RENT_HOURLY;
+        request.quantity = 1 + (int)(w->seed >> 12) % 4;
+        BookingResult booked;
+        RentalResult result = bookRental(w->table, w->vehicles, NULL, NULL, w->invoices, &request, &booked);
+        if (result == RENTAL_ERR_CONFLICT || result == RENTAL_ERR_VEHICLE_UNAVAILABLE)
+        {
+            w->refused++;
+            continue;
+        }
+        if (result != RENTAL_OK || !booked.invoice)
+        {
+            w->errors++;
+            continue;
+        }
+        w->rentalIds[w->booked] = booked.rental.id;
+        w->invoiceIds[w->booked] = booked.invoice->id;
+        w->booked++;
+
+        int *holder = &w->holders[v->id - 1];
+        if (__atomic_add_fetch(holder, 1, __ATOMIC_ACQ_REL) > 1)
+            w->doubleBooked++;
+
+        rentalTableReadLock(w->table);
+        Rental *r = findRentalById(w->table, booked.rental.id);
+        __atomic_sub_fetch(holder, 1, __ATOMIC_ACQ_REL);
+        if (!r)
+            w->errors++;
+        else if ((i & 1 ? cancelRental(w->table, r, w->vehicles, NULL)
+                        : completeRental(w->table, r, w->vehicles, NULL, NULL)) != RENTAL_OK)
+            w->errors++;
+        rentalTableReadUnlock(w->table);
+    }
+    return NULL;
+}
+
+// Returns the number of ids that occur more than once in ids[0..count).
+static long countRepeats(int *ids, long count)
+{
+    qsort(ids, (size_t)count, sizeof(int), compareIds);
+    long repeats = 0;
+    for (long i = 1; i < count; i++)
+        repeats += ids[i] == ids[i - 1];
+    return repeats;
+}
+
+// One round with 'threads' threads on a fresh table and fleet. Returns 1 if it held.
+static int runRound(const BookingStressOptions *options, int threads)
+{
+    RentalTable table;
+    rentalTableInit(&table);
+    Invoice *invoices = NULL;
+    Vehicle *vehicles = makeFleet(options->vehicles);
+    int *holders = (int *)calloc((unsigned)options->vehicles, sizeof(int));
+    StressWorker *workers = (StressWorker *)calloc((size_t)threads, sizeof(StressWorker));
+    pthread_t *ids = (pthread_t *)calloc((size_t)threads, sizeof(pthread_t));
+    long total = (long)threads * options->bookings;
+    int *rentalIds = (int *)malloc((size_t)total * sizeof(int));
+    int *invoiceIds = (int *)malloc((size_t)total * sizeof(int));
+    int ok = vehicles && holders && workers && ids && rentalIds && invoiceIds;
+    if (!ok)
+        printf("Error: out of memory for %d threads\n", threads);
+
+    int started = 0;
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int t = 0; ok && t < threads; t++)
+    {
+        StressWorker *w = &workers[t];
+        w->table = &table;
+        w->vehicles = vehicles;
+        w->invoices = &invoices;
+        w->holders = holders;
+        w->vehicleCount = options->vehicles;
+        w->attempts = options->bookings;
+        w->seed = 7919u * (unsigned)(t + 1);
+        w->rentalIds = rentalIds + (long)t * options->bookings;
+        w->invoiceIds = invoiceIds + (long)t * options->bookings;
+        if (pthread_create(&ids[t], NULL, stressWorker, w) != 0)
+        {
+            printf("Error: could not start thread %d\n", t);
+            ok = 0;
+            break;
+        }
+        started++;
+    }
+    for (int t = 0; t < started; t++)
+        pthread_join(ids[t], NULL);
+    double seconds = secondsSince(&start);
+
+    long booked = 0, refused = 0, doubleBooked = 0, errors = 0;
+    for (int t = 0; t < started; t++)
+    {
+        StressWorker *w = &workers[t];
+        // Packed in place: worker t's ids start at or after the ones before it.
+        memmove(rentalIds + booked, w->rentalIds, (size_t)w->booked * sizeof(int));
+        memmove(invoiceIds + booked, w->invoiceIds, (size_t)w->booked * sizeof(int));
+        booked += w->booked;
+        refused += w->refused;
+        doubleBooked += w->doubleBooked;
+        errors += w->errors;
+    }
+    long rentalRepeats = ok ? countRepeats(rentalIds, booked) : 0;
+    long invoiceRepeats = ok ? countRepeats(invoiceIds, booked) : 0;
+
+    // Every rental was released again, so nothing may be left active or held.
+    long stillActive = 0, unavailable = 0, invoiceCount = 0;
+    for (size_t i = 0; i < table.count; i++)
+        stillActive += table.rows[i].status == RENT_ACTIVE;
+    for (Vehicle *v = vehicles; v; v = v->next)
+        unavailable += !v->available;
+    for (Invoice *inv = invoices; inv; inv = inv->next)
+        invoiceCount++;
+    int held = ok && doubleBooked == 0 && errors == 0 && rentalRepeats == 0 && invoiceRepeats == 0 &&
+               (long)table.count == booked && invoiceCount == booked && stillActive == 0 && unavailable == 0;
+
+    printf("%7d %10ld %10ld %12.0f   %s\n", threads, booked, refused, seconds > 0 ? booked / seconds : 0.0,
+           held ? "ok" : "FAILED");
+    if (ok && !held)
+        printf("        double-booked %ld, errors %ld, repeated rental ids %ld, repeated invoice ids %ld,\n"
+               "        rows %zu, invoices %ld, still active %ld, vehicles not released %ld\n",
+               doubleBooked, errors, rentalRepeats, invoiceRepeats, table.count, invoiceCount, stillActive,
+               unavailable);
+
+    free(rentalIds);
+    free(invoiceIds);
+    free(ids);
+    free(workers);
+    free(holders);
+    freeInvoiceList(&invoices);
+    freeVehicleList(&vehicles);
+    freeRentalTable(&table);
+    return held;
+}
+
+int runBookingStress(const BookingStressOptions *options)
+{
+    printf("Booking stress: %d vehicles, %d attempts per thread\n", options->vehicles, options->bookings);
+    printf("%7s %10s %10s %12s   %s\n", "Threads", "Booked", "Refused", "Bookings/s", "Checks");
+    int failed = 0;
+    for (int threads = 1;; threads *= 2)
+    {
+        if (threads > options->threads)
+            threads = options->threads;
+        failed |= !runRound(options, threads);
+        if (threads == options->threads)
+            break;
+    }
+    printf(failed ? "Stress check FAILED.\n" : "No vehicle was double-booked and no id repeated.\n");
+    return failed;
+}
+
+// --- Snapshot stability ---
+
+typedef struct
+{
+    RentalTable *table;
+    Vehicle *vehicles;
+    Invoice **invoices;
+    const int *stop;
+    int first; // Books vehicles first, first + step, ...
+    int step;
+    int vehicleCount;
+    int *openRental; // Per vehicle of the whole fleet; only this writer's entries are used
+    unsigned seed;
+    long changes;
+    long errors;
+} SnapshotWriter;
+
+// Picks one of its vehicles at random and books it, or completes its rental if it
+// has one, so about half the fleet is out at any time and rows keep being added and
+// changed.
+static void *snapshotWriter(void *arg)
+{
+    SnapshotWriter *w = (SnapshotWriter *)arg;
+    int owned = (w->vehicleCount - w->first + w->step - 1) / w->step;
+    while (!__atomic_load_n(w->stop, __ATOMIC_ACQUIRE))
+    {
+        w->seed = w->seed * 1103515245u + 12345u;
+        int id = w->first + (int)((w->seed >> 8) % (unsigned)owned) * w->step + 1;
+        if (w->openRental[id - 1])
+        {
+            rentalTableReadLock(w->table);
+            Rental *r = findRentalById(w->table, w->openRental[id - 1]);
+            if (!r || completeRental(w->table, r, w->vehicles, NULL, NULL) != RENTAL_OK)
+                w->errors++;
+            rentalTableReadUnlock(w->table);
+            w->openRental[id - 1] = 0;
+        }
+        else
+        {
+            BookingRequest request = {0};
+            request.customerId = 1 + (int)(w->seed >> 20) % 100;
+            request.vehicleId = id;
+            request.type = RENT_HOURLY;
+            request.quantity = 1 + (int)(w->seed >> 12) % 4;
+            BookingResult booked;
+            if (bookRental(w->table, w->vehicles, NULL, NULL, w->invoices, &request, &booked) == RENTAL_OK)
+                w->openRental[id - 1] = booked.rental.id;
+            else
+                w->errors++;
+        }
+        w->changes++;
+    }
+    return NULL;
+}
+
+typedef struct
+{
+    size_t visible; // Rows booked before the snapshot
+    long active;
+    Money activeCost;
+    Money totalCost;
+    long doubleActive; // Vehicles with more than one active rental
+} SnapshotTotals;
+
+// One pass of the report: sums the snapshot's rows. 'activeOf' counts active rentals
+// per vehicle and is cleared first.
+static void sumSnapshot(const RentalSnapshot *snap, int *activeOf, int vehicleCount, SnapshotTotals *totals)
+{
+    memset(totals, 0, sizeof(*totals));
+    memset(activeOf, 0, (size_t)vehicleCount * sizeof(int));
+    for (size_t i = 0; i < snap->count; i++)
+    {
+        Rental r;
+        if (!rentalSnapshotRow(snap, i, &r))
+            continue;
+        totals->visible++;
+        totals->totalCost += r.totalCost;
+        if (r.status != RENT_ACTIVE)
+            continue;
+        totals->active++;
+        totals->activeCost += r.totalCost;
+        if (r.vehicleId >= 1 && r.vehicleId <= vehicleCount && ++activeOf[r.vehicleId - 1] == 2)
+            totals->doubleActive++;
+    }
+}
+
+int runSnapshotStress(const SnapshotStressOptions *options)
+{
+    RentalTable table;
+    rentalTableInit(&table);
+    Invoice *invoices = NULL;
+    Vehicle *vehicles = makeFleet(options->vehicles);
+    int *openRental = (int *)calloc((unsigned)options->vehicles, sizeof(int));
+    int *activeOf = (int *)calloc((unsigned)options->vehicles, sizeof(int));
+    SnapshotWriter *writers = (SnapshotWriter *)calloc((unsigned)options->writers, sizeof(SnapshotWriter));
+    pthread_t *ids = (pthread_t *)calloc((unsigned)options->writers, sizeof(pthread_t));
+    int ok = vehicles && openRental && activeOf && writers && ids;
+    if (!ok)
+        printf("Error: out of memory\n");
+
+    int stop = 0, started = 0;
+    for (int t = 0; ok && t < options->writers; t++)
+    {
+        SnapshotWriter *w = &writers[t];
+        w->table = &table;
+        w->vehicles = vehicles;
+        w->invoices = &invoices;
+        w->stop = &stop;
+        w->first = t;
+        w->step = options->writers;
+        w->vehicleCount = options->vehicles;
+        w->openRental = openRental;
+        w->seed = 104729u * (unsigned)(t + 1);
+        if (pthread_create(&ids[t], NULL, snapshotWriter, w) != 0)
+        {
+            printf("Error: could not start writer %d\n", t);
+            ok = 0;
+            break;
+        }
+        started++;
+    }
+
+    // The report: each snapshot is read twice with a pause in between, during which
+    // the writers commit changes, add rows and may move the rows to a larger array.
+    long snapshots = 0, unstable = 0, shrank = 0, doubleActive = 0, moved = 0;
+    size_t lastVisible = 0, maxVisible = 0;
+    struct timespec start, pause = {0, 1000000};
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while (ok && secondsSince(&start) < options->seconds)
+    {
+        RentalSnapshot snap;
+        SnapshotTotals first, second;
+        rentalSnapshotBegin(&table, &snap);
+        sumSnapshot(&snap, activeOf, options->vehicles, &first);
+        nanosleep(&pause, NULL);
+        sumSnapshot(&snap, activeOf, options->vehicles, &second);
+        rentalTableReadLock(&table);
+        moved += table.rows != snap.rows;
+        rentalTableReadUnlock(&table);
+        rentalSnapshotEnd(&table, &snap);
+
+        if (memcmp(&first, &second, sizeof(first)) != 0)
+        {
+            if (unstable++ == 0)
+                printf("Error: snapshot %ld read %zu rows, %ld active, total %lld, then %zu rows, %ld active, total %lld\n",
+                       snapshots, first.visible, first.active, (long long)first.totalCost, second.visible,
+                       second.active, (long long)second.totalCost);
+        }
+        shrank += first.visible < lastVisible;
+        doubleActive += first.doubleActive;
+        lastVisible = first.visible;
+        if (first.visible > maxVisible)
+            maxVisible = first.visible;
+        snapshots++;
+    }
+    __atomic_store_n(&stop, 1, __ATOMIC_RELEASE);
+    long changes = 0, errors = 0;
+    for (int t = 0; t < started; t++)
+    {
+        pthread_join(ids[t], NULL);
+        changes += writers[t].changes;
+        errors += writers[t].errors;
+    }
+
+    // With the writers gone and no snapshot open, ending one more trims every version.
+    RentalSnapshot last;
+    rentalSnapshotBegin(&table, &last);
+    rentalSnapshotEnd(&table, &last);
+    size_t versionsLeft = table.versionedCount;
+
+    printf("Snapshot stress: %d writers, %d vehicles, %d s\n", options->writers, options->vehicles, options->seconds);
+    printf("Writers: %ld bookings and completions, %ld failed; %zu rows at the end\n", changes, errors, table.count);
+    printf("Report: %ld snapshots read twice, up to %zu rows; the rows moved under %ld of them\n", snapshots,
+           maxVisible, moved);
+    printf("Unstable snapshots %ld, fewer rows than the one before %ld, vehicles active twice %ld, "
+           "versioned rows left %zu\n", unstable, shrank, doubleActive, versionsLeft);
+    int held = ok && snapshots > 0 && unstable == 0 && shrank == 0 && doubleActive == 0 && errors == 0 &&
+               versionsLeft == 0;
+    printf(held ? "Every snapshot saw the same rows and totals on both reads.\n" : "Snapshot check FAILED.\n");
+
+    free(ids);
+    free(writers);
+    free(activeOf);
+    free(openRental);
+    freeInvoiceList(&invoices);
+    freeVehicleList(&vehicles);
+    freeRentalTable(&table);
+    return !held;
+}
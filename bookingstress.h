@@ -0,0 +1,33 @@
+// File: bookingstress.h
+// Description: Concurrency check for the booking path (--stress-booking). Many threads
+// book and release a handful of shared vehicles through bookRental on one in-memory
+// table, for 1, 2, 4, ... threads up to the requested count. A run fails if a vehicle
+// is ever held by two rentals at once or a rental or invoice id is handed out twice;
+// each round prints its booking rate. The snapshot check (--stress-snapshot) has a
+// report read the table twice per snapshot while writers keep booking, completing and
+// growing it, and fails if the two reads ever differ. Touches no data files.
+
+#ifndef BOOKINGSTRESS_H
+#define BOOKINGSTRESS_H
+
+typedef struct
+{
+    int threads;  // Largest round; the rounds double from 1 up to this
+    int vehicles; // Shared by all threads; fewer vehicles, more collisions
+    int bookings; // Attempts per thread per round
+} BookingStressOptions;
+
+// Runs the rounds and prints the results. Returns 0 if every check held, 1 otherwise.
+int runBookingStress(const BookingStressOptions *options);
+
+typedef struct
+{
+    int writers;  // Threads booking and completing while the report reads
+    int vehicles; // Split between the writers
+    int seconds;  // How long the report keeps taking snapshots
+} SnapshotStressOptions;
+
+// Runs the check and prints what the report saw. Returns 0 if every snapshot was stable.
+int runSnapshotStress(const SnapshotStressOptions *options);
+
+#endif // BOOKINGSTRESS_H
@@ -1,4 +1,9 @@
 #include "complaint.h"
+#include "snapshot.h"
+#include "asyncio.h"
+#include "idalloc.h"
+#include "dirty.h"
+#include "threadpool.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -6,7 +11,6 @@
 
 #define COMPLAINT_FILE "complaints.csv"
 
-static int nextComplaintId = 7001;
 
 // Utility Functions
 const char *complaintStatusStr(ComplaintStatus status)
@@ -28,58 +32,105 @@ const char *complaintStatusStr(ComplaintStatus status)
 
 void formatTimeString(time_t timestamp, char *buffer, size_t size)
 {
-    struct tm *tm_info = localtime(&timestamp);
-    strftime(buffer, size, "%Y-%m-%d %H:%M", tm_info);
+    struct tm tm_info;
+    if (!localTimeSafe(timestamp, &tm_info))
+    {
+        snprintf(buffer, size, "-");
+        return;
+    }
+    strftime(buffer, size, "%Y-%m-%d %H:%M", &tm_info);
 }
 
-static void adjustNextComplaintId(Complaint *head)
+static Complaint *appendComplaint(ComplaintTable *table, const Complaint *c)
 {
-    int maxId = 7000;
-    for (Complaint *c = head; c; c = c->next)
-        if (c->id > maxId)
-            maxId = c->id;
-    nextComplaintId = maxId + 1;
+    if (table->count == table->capacity)
+    {
+        size_t capacity = table->capacity ? table->capacity * 2 : 64;
+        Complaint *rows = (Complaint *)realloc(table->rows, capacity * sizeof(Complaint));
+        if (!rows)
+            return NULL;
+        table->rows = rows;
+        table->capacity = capacity;
+    }
+    table->rows[table->count] = *c;
+    markAdded(DIRTY_COMPLAINTS);
+    return &table->rows[table->count++];
 }
 
-static Complaint *parseComplaintCSV(char *line)
+// Complaints filed since the last save are appended as they are by then; only a
+// change to one already in the file needs a rewrite.
+static void markComplaintChanged(const ComplaintTable *table, const Complaint *c)
 {
-    Complaint *c = (Complaint *)malloc(sizeof(Complaint));
-    if (!c)
-        return NULL;
-    
-    int status;
-    long createdAt, resolvedAt;
-    
-    int result = sscanf(line, "%d,%d,%d,%200[^,],%200[^,],%d,%ld,%ld",
-                       &c->id, &c->rentalId, &c->customerId, c->description,
-                       c->adminResponse, &status, &createdAt, &resolvedAt);
-    
-    if (result != 8) {
-        printf("Warning: Failed to parse complaint line: %s (parsed %d fields)\n", line, result);
-        free(c);
-        return NULL;
-    }
-    
-    c->status = (ComplaintStatus)status;
-    c->createdAt = (time_t)createdAt;
-    c->resolvedAt = (time_t)resolvedAt;
-    c->next = NULL;
-    
-    return c;
+    if ((size_t)(c - table->rows) + dirtyAddedCount(DIRTY_COMPLAINTS) < table->count)
+        markDirty(DIRTY_COMPLAINTS);
+}
+
+// Current format: the text columns are references into COMPLAINT_TEXT_FILE.
+static int parseComplaintCSV(char *line, Complaint *c)
+{
+    char *fields[10];
+    if (splitCsvLine(line, fields, 10) != 10)
+        return 0;
+
+    memset(c, 0, sizeof(*c));
+    c->id = atoi(fields[0]);
+    c->rentalId = atoi(fields[1]);
+    c->customerId = atoi(fields[2]);
+    c->status = (uint8_t)atoi(fields[3]);
+    c->createdAt = atoll(fields[4]);
+    c->resolvedAt = atoll(fields[5]);
+    c->description.offset = strtoull(fields[6], NULL, 10);
+    c->description.length = (uint32_t)strtoul(fields[7], NULL, 10);
+    c->adminResponse.offset = strtoull(fields[8], NULL, 10);
+    c->adminResponse.length = (uint32_t)strtoul(fields[9], NULL, 10);
+    return 1;
+}
+
+// Old format with the text inline: id,rentalId,customerId,description,adminResponse,
+// status,createdAt,resolvedAt. The text is moved into the heap as it is read.
+// A description containing commas spans several fields, so the fixed columns
+// are taken from both ends of the line.
+static int parseLegacyComplaintCSV(char *line, Complaint *c, TextHeap *heap)
+{
+    char *fields[64];
+    int n = splitCsvLine(line, fields, 64);
+    if (n < 8)
+        return 0;
+
+    memset(c, 0, sizeof(*c));
+    c->id = atoi(fields[0]);
+    c->rentalId = atoi(fields[1]);
+    c->customerId = atoi(fields[2]);
+    c->status = (uint8_t)atoi(fields[n - 3]);
+    c->createdAt = atoll(fields[n - 2]);
+    c->resolvedAt = atoll(fields[n - 1]);
+
+    // splitCsvLine cut the description at its commas; put them back.
+    for (int i = 4; i < n - 4; i++)
+        fields[i][-1] = ',';
+    return textHeapAppend(heap, fields[3], &c->description) &&
+           textHeapAppend(heap, fields[n - 4], &c->adminResponse);
 }
 
 // CSV I/O Functions
-void loadComplaints(Complaint **head)
+void loadComplaints(ComplaintTable *table)
 {
-    *head = NULL;
-    FILE *f = fopen(COMPLAINT_FILE, "r");
+    freeComplaintTable(table);
+    textHeapOpen(&table->text, COMPLAINT_TEXT_FILE);
+
+    FILE *f = openDataFile(COMPLAINT_FILE);
     if (!f)
         return;
 
-    char line[512];
+    char line[1024];
+    int legacy = 1; // Files without a header predate the text heap
     if (fgets(line, sizeof(line), f))
     {
-        if (strncmp(line, "id,", 3) != 0)
+        if (strncmp(line, "id,", 3) == 0)
+        {
+            legacy = strstr(line, "descriptionOffset") == NULL;
+        }
+        else
         {
             // If no header, rewind to start
             rewind(f);
@@ -90,128 +141,156 @@ void loadComplaints(Complaint **head)
     while (fgets(line, sizeof(line), f))
     {
         line[strcspn(line, "\n")] = 0;
-        Complaint *c = parseComplaintCSV(line);
-        if (c)
+        if (!line[0])
+            continue;
+        Complaint c;
+        int ok = legacy ? parseLegacyComplaintCSV(line, &c, &table->text) : parseComplaintCSV(line, &c);
+        if (!ok)
         {
-            c->next = *head;
-            *head = c;
-            count++;
+            printf("Warning: Failed to parse complaint line: %s\n", line);
+            continue;
         }
+        if (!appendComplaint(table, &c))
+        {
+            printf("Error: Memory allocation failed\n");
+            break;
+        }
+        observeId(ID_COMPLAINT, c.id);
+        count++;
     }
     fclose(f);
-    adjustNextComplaintId(*head);
+    markClean(DIRTY_COMPLAINTS);
     printf("Loaded %d complaints from %s\n", count, COMPLAINT_FILE);
+
+    if (legacy && count > 0)
+    {
+        printf("Moving complaint text into %s\n", COMPLAINT_TEXT_FILE);
+        markDirty(DIRTY_COMPLAINTS);
+        saveComplaints(table);
+    }
 }
 
-void saveComplaints(Complaint *head)
+void saveComplaints(const ComplaintTable *table)
 {
-    FILE *f = fopen(COMPLAINT_FILE, "w");
+    waitBackgroundSave();
+    size_t added;
+    SaveMode mode = beginTableSave(DIRTY_COMPLAINTS, &added);
+    if (mode == SAVE_SKIP)
+        return;
+    AsyncFile out;
+    FILE *f = mode == SAVE_APPEND ? asyncFileAppend(&out, COMPLAINT_FILE) : NULL;
+    if (!f)
+    {
+        mode = SAVE_REWRITE; // Nothing to append to, or its last row was cut off
+        f = asyncFileOpen(&out, COMPLAINT_FILE);
+    }
     if (!f)
     {
         printf("Error: Could not open file %s for writing\n", COMPLAINT_FILE);
+        endTableSave(DIRTY_COMPLAINTS, mode, -1);
         return;
     }
     
-    fprintf(f, "id,rentalId,customerId,description,adminResponse,status,createdAt,resolvedAt\n");
-    int count = 0;
-    for (Complaint *c = head; c; c = c->next)
+    size_t first = 0;
+    if (mode == SAVE_APPEND)
+        first = added < table->count ? table->count - added : 0;
+    else
+        fprintf(f, "id,rentalId,customerId,status,createdAt,resolvedAt,descriptionOffset,descriptionLength,responseOffset,responseLength\n");
+    for (size_t i = first; i < table->count; i++)
     {
-        fprintf(f, "%d,%d,%d,%s,%s,%d,%ld,%ld\n",
-                c->id, c->rentalId, c->customerId, c->description,
-                c->adminResponse, (int)c->status, (long)c->createdAt, (long)c->resolvedAt);
-        count++;
+        const Complaint *c = &table->rows[i];
+        fprintf(f, "%d,%d,%d,%d,%lld,%lld,%llu,%u,%llu,%u\n",
+                c->id, c->rentalId, c->customerId, (int)c->status,
+                (long long)c->createdAt, (long long)c->resolvedAt,
+                (unsigned long long)c->description.offset, (unsigned)c->description.length,
+                (unsigned long long)c->adminResponse.offset, (unsigned)c->adminResponse.length);
     }
-    fclose(f);
-    printf("Successfully saved %d complaints to %s\n", count, COMPLAINT_FILE);
+    long result = asyncFileClose(&out);
+    endTableSave(DIRTY_COMPLAINTS, mode, result < 0 ? -1 : (long)out.length);
+    printf("Successfully saved %zu complaints to %s\n", table->count, COMPLAINT_FILE);
 }
 
-void freeComplaintList(Complaint **head)
+void freeComplaintTable(ComplaintTable *table)
 {
-    Complaint *current = *head;
-    Complaint *next;
-
-    while (current != NULL)
-    {
-        next = current->next;
-        free(current);
-        current = next;
-    }
-
-    *head = NULL;
+    free(table->rows);
+    textHeapClose(&table->text);
+    memset(table, 0, sizeof(*table));
 }
 
 // Search Functions
-Complaint *findComplaintById(Complaint *head, int complaintId)
+Complaint *findComplaintById(ComplaintTable *table, int complaintId)
 {
-    for (Complaint *c = head; c; c = c->next)
-        if (c->id == complaintId)
-            return c;
+    for (size_t i = 0; i < table->count; i++)
+        if (table->rows[i].id == complaintId)
+            return &table->rows[i];
     return NULL;
 }
 
-Complaint *findComplaintsByRentalId(Complaint *head, int rentalId)
+Complaint *findComplaintsByRentalId(ComplaintTable *table, int rentalId)
 {
-    for (Complaint *c = head; c; c = c->next)
-        if (c->rentalId == rentalId)
-            return c;
+    for (size_t i = 0; i < table->count; i++)
+        if (table->rows[i].rentalId == rentalId)
+            return &table->rows[i];
     return NULL;
 }
 
-Complaint *findComplaintsByCustomerId(Complaint *head, int customerId)
+Complaint *findComplaintsByCustomerId(ComplaintTable *table, int customerId)
 {
-    for (Complaint *c = head; c; c = c->next)
-        if (c->customerId == customerId)
-            return c;
+    for (size_t i = 0; i < table->count; i++)
+        if (table->rows[i].customerId == customerId)
+            return &table->rows[i];
     return NULL;
 }
 
+void complaintText(ComplaintTable *table, TextRef ref, char *buf, size_t size)
+{
+    if (!textHeapRead(&table->text, ref, buf, size))
+        snprintf(buf, size, "(text unavailable)");
+}
+
 // Customer Functions
-void fileComplaint(Complaint **head, int rentalId, int customerId)
+void fileComplaint(ComplaintTable *table, int rentalId, int customerId)
 {
-    Complaint *c = (Complaint *)malloc(sizeof(Complaint));
-    if (!c)
-    {
-        printf("Error: Memory allocation failed\n");
-        return;
-    }
-    
-    c->id = nextComplaintId++;
-    c->rentalId = rentalId;
-    c->customerId = customerId;
-    c->status = COMPLAINT_PENDING;
-    c->createdAt = time(NULL);
-    c->resolvedAt = 0;
-    c->adminResponse[0] = '\0';
+    Complaint c = {0};
+    c.rentalId = rentalId;
+    c.customerId = customerId;
+    c.status = COMPLAINT_PENDING;
+    c.createdAt = time(NULL);
+    c.resolvedAt = 0;
     
     printf("\n=== File a Complaint ===\n");
     printf("Please describe your complaint (max 200 characters):\n");
-    getStringInput("Description: ", c->description, sizeof(c->description));
+    char description[COMPLAINT_TEXT_MAX + 1];
+    getStringInput("Description: ", description, sizeof(description));
     
-    if (strlen(c->description) < 10)
+    if (strlen(description) < 10)
     {
         printf("Error: Description must be at least 10 characters long.\n");
-        free(c);
         return;
     }
     
-    c->next = *head;
-    *head = c;
-    saveComplaints(*head);
+    c.id = allocateId(ID_COMPLAINT);
+    if (!textHeapAppend(&table->text, description, &c.description) || !appendComplaint(table, &c))
+    {
+        printf("Error: Could not store the complaint\n");
+        return;
+    }
+    saveComplaints(table);
     
     printf("\nComplaint filed successfully!\n");
-    printf("Complaint ID: %d | Status: %s\n", c->id, complaintStatusStr(c->status));
+    printf("Complaint ID: %d | Status: %s\n", c.id, complaintStatusStr(c.status));
 }
 
-void viewCustomerComplaints(Complaint *head, int customerId)
+void viewCustomerComplaints(ComplaintTable *table, int customerId)
 {
     printf("\n=== Your Complaints ===\n");
     int found = 0;
     
-    for (Complaint *c = head; c; c = c->next)
+    for (size_t i = 0; i < table->count; i++)
     {
-        if (c->customerId == customerId)
+        if (table->rows[i].customerId == customerId)
         {
-            displayComplaint(c);
+            displayComplaint(table, &table->rows[i]);
             found = 1;
         }
     }
@@ -223,22 +302,25 @@ void viewCustomerComplaints(Complaint *head, int customerId)
 }
 
 // Display Functions
-void displayComplaint(const Complaint *c)
+void displayComplaint(ComplaintTable *table, const Complaint *c)
 {
     if (!c)
         return;
         
     char createdAtStr[32], resolvedAtStr[32];
+    char text[COMPLAINT_TEXT_MAX + 1];
     formatTimeString(c->createdAt, createdAtStr, sizeof(createdAtStr));
     
     printf("\nComplaint #%d (Rental #%d)\n", c->id, c->rentalId);
     printf("Status: %s\n", complaintStatusStr(c->status));
     printf("Filed: %s\n", createdAtStr);
-    printf("Description: %s\n", c->description);
+    complaintText(table, c->description, text, sizeof(text));
+    printf("Description: %s\n", text);
     
-    if (c->adminResponse[0] != '\0')
+    if (c->adminResponse.length > 0)
     {
-        printf("Admin Response: %s\n", c->adminResponse);
+        complaintText(table, c->adminResponse, text, sizeof(text));
+        printf("Admin Response: %s\n", text);
     }
     
     if (c->resolvedAt > 0)
@@ -250,23 +332,31 @@ void displayComplaint(const Complaint *c)
     printf("----------------------------------------\n");
 }
 
-void displayComplaintWithRentalInfo(const Complaint *c, Rental *rentalHead)
+void displayComplaintWithRentalInfo(ComplaintTable *table, const Complaint *c, RentalTable *rentals)
 {
     if (!c)
         return;
         
-    displayComplaint(c);
+    displayComplaint(table, c);
     
     // Find and display rental information
-    Rental *rental = findRentalById(rentalHead, c->rentalId);
+    Rental *rental = findRentalById(rentals, c->rentalId);
+    const RentalDetail *detail = rental ? rentalDetail(rentals, rental) : NULL;
+    Rental archived;
+    RentalDetail archivedDetail;
+    if (!rental && fetchArchivedRental(rentals, c->rentalId, &archived, &archivedDetail))
+    {
+        rental = &archived;
+        detail = &archivedDetail;
+    }
     if (rental)
     {
         printf("Rental Details:\n");
         printf("  Vehicle ID: %d\n", rental->vehicleId);
         printf("  Type: %s\n", rental->type == RENT_HOURLY ? "Hourly" : 
                                rental->type == RENT_DAILY ? "Daily" : "Route");
-        printf("  Start: %s | End: %s\n", rental->startTime, rental->endTime);
-        printf("  Cost: $%.2f\n", rental->totalCost);
+        printf("  Start: %s | End: %s\n", detail->startTime, detail->endTime);
+        printf("  Cost: $" MONEY_FMT "\n", MONEY_ARGS(rental->totalCost));
     }
     else
     {
@@ -275,7 +365,7 @@ void displayComplaintWithRentalInfo(const Complaint *c, Rental *rentalHead)
 }
 
 // Admin Functions
-void adminComplaintMenu(Complaint **head, Rental *rentalHead)
+void adminComplaintMenu(ComplaintTable *table, RentalTable *rentals)
 {
     int running = 1;
     while (running)
@@ -294,7 +384,7 @@ void adminComplaintMenu(Complaint **head, Rental *rentalHead)
         switch (choice)
         {
         case 1:
-            listAllComplaints(*head);
+            listAllComplaints(table);
             break;
         case 2:
         {
@@ -305,17 +395,17 @@ void adminComplaintMenu(Complaint **head, Rental *rentalHead)
             printf("4. Closed\n");
             int statusChoice = getIntegerInput("Choose (1-4): ", 1, 4);
             ComplaintStatus status = statusChoice - 1;
-            listComplaintsByStatus(*head, status);
+            listComplaintsByStatus(table, status);
             break;
         }
         case 3:
-            respondToComplaint(*head, rentalHead);
+            respondToComplaint(table, rentals);
             break;
         case 4:
-            updateComplaintStatus(*head);
+            updateComplaintStatus(table);
             break;
         case 5:
-            showComplaintStatistics(*head);
+            showComplaintStatistics(table);
             break;
         case 6:
             running = 0;
@@ -327,34 +417,33 @@ void adminComplaintMenu(Complaint **head, Rental *rentalHead)
     }
 }
 
-void listAllComplaints(Complaint *head)
+void listAllComplaints(ComplaintTable *table)
 {
-    if (!head)
+    if (table->count == 0)
     {
         printf("No complaints found.\n");
         return;
     }
     
     printf("\n=== All Complaints ===\n");
-    int count = 0;
-    for (Complaint *c = head; c; c = c->next)
+    for (size_t i = 0; i < table->count; i++)
     {
-        displayComplaint(c);
-        count++;
+        displayComplaint(table, &table->rows[i]);
     }
-    printf("\nTotal complaints: %d\n", count);
+    printf("\nTotal complaints: %zu\n", table->count);
 }
 
-void listComplaintsByStatus(Complaint *head, ComplaintStatus status)
+void listComplaintsByStatus(ComplaintTable *table, ComplaintStatus status)
 {
     printf("\n=== Complaints - %s ===\n", complaintStatusStr(status));
     int count = 0;
     
-    for (Complaint *c = head; c; c = c->next)
+    for (size_t i = 0; i < table->count; i++)
     {
+        const Complaint *c = &table->rows[i];
         if (c->status == status)
         {
-            displayComplaint(c);
+            displayComplaint(table, c);
             count++;
         }
     }
@@ -369,18 +458,18 @@ void listComplaintsByStatus(Complaint *head, ComplaintStatus status)
     }
 }
 
-void respondToComplaint(Complaint *head, Rental *rentalHead)
+void respondToComplaint(ComplaintTable *table, RentalTable *rentals)
 {
-    if (!head)
+    if (table->count == 0)
     {
         printf("No complaints to respond to.\n");
         return;
     }
     
-    listAllComplaints(head);
+    listAllComplaints(table);
     int complaintId = getIntegerInput("\nEnter Complaint ID to respond to: ", 7001, 9999);
     
-    Complaint *c = findComplaintById(head, complaintId);
+    Complaint *c = findComplaintById(table, complaintId);
     if (!c)
     {
         printf("Complaint not found.\n");
@@ -388,39 +477,48 @@ void respondToComplaint(Complaint *head, Rental *rentalHead)
     }
     
     printf("\n=== Respond to Complaint #%d ===\n", c->id);
-    displayComplaintWithRentalInfo(c, rentalHead);
+    displayComplaintWithRentalInfo(table, c, rentals);
     
     printf("\nEnter your response (max 200 characters):\n");
-    getStringInput("Response: ", c->adminResponse, sizeof(c->adminResponse));
+    char response[COMPLAINT_TEXT_MAX + 1];
+    getStringInput("Response: ", response, sizeof(response));
     
-    if (strlen(c->adminResponse) < 5)
+    if (strlen(response) < 5)
     {
         printf("Error: Response must be at least 5 characters long.\n");
         return;
     }
     
+    // The heap is append-only: the new response is written after the old one.
+    if (!textHeapAppend(&table->text, response, &c->adminResponse))
+    {
+        printf("Error: Could not store the response.\n");
+        return;
+    }
+    
     // Update status to in progress if it was pending
     if (c->status == COMPLAINT_PENDING)
     {
         c->status = COMPLAINT_IN_PROGRESS;
     }
+    markComplaintChanged(table, c);
     
-    saveComplaints(head);
+    saveComplaints(table);
     printf("\nResponse saved successfully!\n");
 }
 
-void updateComplaintStatus(Complaint *head)
+void updateComplaintStatus(ComplaintTable *table)
 {
-    if (!head)
+    if (table->count == 0)
     {
         printf("No complaints to update.\n");
         return;
     }
     
-    listAllComplaints(head);
+    listAllComplaints(table);
     int complaintId = getIntegerInput("\nEnter Complaint ID to update: ", 7001, 9999);
     
-    Complaint *c = findComplaintById(head, complaintId);
+    Complaint *c = findComplaintById(table, complaintId);
     if (!c)
     {
         printf("Complaint not found.\n");
@@ -444,40 +542,68 @@ void updateComplaintStatus(Complaint *head)
     {
         c->resolvedAt = time(NULL);
     }
+    markComplaintChanged(table, c);
     
-    saveComplaints(head);
+    saveComplaints(table);
     printf("\nStatus updated successfully!\n");
 }
 
-void showComplaintStatistics(Complaint *head)
+typedef struct
 {
-    if (!head)
-    {
-        printf("No complaints found.\n");
-        return;
-    }
-    
-    int total = 0, pending = 0, inProgress = 0, resolved = 0, closed = 0;
-    
-    for (Complaint *c = head; c; c = c->next)
+    int total, pending, inProgress, resolved, closed;
+} ComplaintStatsPartial;
+
+static void scanComplaintStats(size_t begin, size_t end, void *partial, void *ctx)
+{
+    const Complaint *rows = (const Complaint *)ctx;
+    ComplaintStatsPartial *p = (ComplaintStatsPartial *)partial;
+
+    for (size_t i = begin; i < end; i++)
     {
-        total++;
-        switch (c->status)
+        p->total++;
+        switch (rows[i].status)
         {
         case COMPLAINT_PENDING:
-            pending++;
+            p->pending++;
             break;
         case COMPLAINT_IN_PROGRESS:
-            inProgress++;
+            p->inProgress++;
             break;
         case COMPLAINT_RESOLVED:
-            resolved++;
+            p->resolved++;
             break;
         case COMPLAINT_CLOSED:
-            closed++;
+            p->closed++;
             break;
         }
     }
+}
+
+static void mergeComplaintStats(void *total, const void *partial, void *ctx)
+{
+    (void)ctx;
+    ComplaintStatsPartial *t = (ComplaintStatsPartial *)total;
+    const ComplaintStatsPartial *p = (const ComplaintStatsPartial *)partial;
+    t->total += p->total;
+    t->pending += p->pending;
+    t->inProgress += p->inProgress;
+    t->resolved += p->resolved;
+    t->closed += p->closed;
+}
+
+void showComplaintStatistics(const ComplaintTable *table)
+{
+    if (table->count == 0)
+    {
+        printf("No complaints found.\n");
+        return;
+    }
+    
+    ComplaintStatsPartial stats = {0};
+    parallelScan(table->count, sizeof(ComplaintStatsPartial), scanComplaintStats, mergeComplaintStats, &stats, (void *)table->rows);
+
+    int total = stats.total, pending = stats.pending, inProgress = stats.inProgress;
+    int resolved = stats.resolved, closed = stats.closed;
     
     printf("\n=== Complaint Statistics ===\n");
     printf("Total Complaints: %d\n", total);
@@ -3,6 +3,7 @@
 
 #include "utils.h"
 #include "rental.h"
+#include "textheap.h"
 
 // Complaint Status Enum
 typedef enum
@@ -13,45 +14,61 @@ typedef enum
     COMPLAINT_CLOSED = 3
 } ComplaintStatus;
 
-// Complaint Structure
-typedef struct ComplaintNode
+#define COMPLAINT_TEXT_FILE "complaints.text" // The text heap behind the descriptions and responses
+#define COMPLAINT_TEXT_MAX 200 // Longest description or response, in characters
+
+// Complaint Structure. The free text lives in the complaint text heap and is
+// read only when a complaint is displayed; the record itself stays small so
+// status and date scans walk a compact array.
+typedef struct
 {
     int id;
     int rentalId;
     int customerId;
-    char description[201];  // Complaint description (max 200 chars + null terminator)
-    char adminResponse[201]; // Admin response (max 200 chars + null terminator)
-    ComplaintStatus status;
-    time_t createdAt;
-    time_t resolvedAt;
-    struct ComplaintNode *next;
+    uint8_t status; // ComplaintStatus
+    int64_t createdAt;
+    int64_t resolvedAt;
+    TextRef description;
+    TextRef adminResponse;
 } Complaint;
 
+// All complaints in filing order, plus the heap holding their text.
+typedef struct ComplaintTable
+{
+    Complaint *rows;
+    size_t count;
+    size_t capacity;
+    TextHeap text;
+} ComplaintTable;
+
 // CSV I/O Functions
-void loadComplaints(Complaint **head);
-void saveComplaints(Complaint *head);
-void freeComplaintList(Complaint **head);
+void loadComplaints(ComplaintTable *table);
+void saveComplaints(const ComplaintTable *table);
+void freeComplaintTable(ComplaintTable *table);
 
 // Search Functions
-Complaint *findComplaintById(Complaint *head, int complaintId);
-Complaint *findComplaintsByRentalId(Complaint *head, int rentalId);
-Complaint *findComplaintsByCustomerId(Complaint *head, int customerId);
+Complaint *findComplaintById(ComplaintTable *table, int complaintId);
+Complaint *findComplaintsByRentalId(ComplaintTable *table, int rentalId);
+Complaint *findComplaintsByCustomerId(ComplaintTable *table, int customerId);
+
+// Reads a complaint's description or response into buf (COMPLAINT_TEXT_MAX + 1 bytes).
+void complaintText(ComplaintTable *table, TextRef ref, char *buf, size_t size);
 
 // Customer Functions
-void fileComplaint(Complaint **head, int rentalId, int customerId);
-void viewCustomerComplaints(Complaint *head, int customerId);
+void fileComplaint(ComplaintTable *table, int rentalId, int customerId);
+void viewCustomerComplaints(ComplaintTable *table, int customerId);
 
 // Admin Functions
-void adminComplaintMenu(Complaint **head, Rental *rentalHead);
-void listAllComplaints(Complaint *head);
-void listComplaintsByStatus(Complaint *head, ComplaintStatus status);
-void respondToComplaint(Complaint *head, Rental *rentalHead);
-void updateComplaintStatus(Complaint *head);
-void showComplaintStatistics(Complaint *head);
+void adminComplaintMenu(ComplaintTable *table, RentalTable *rentals);
+void listAllComplaints(ComplaintTable *table);
+void listComplaintsByStatus(ComplaintTable *table, ComplaintStatus status);
+void respondToComplaint(ComplaintTable *table, RentalTable *rentals);
+void updateComplaintStatus(ComplaintTable *table);
+void showComplaintStatistics(const ComplaintTable *table);
 
 // Display Functions
-void displayComplaint(const Complaint *c);
-void displayComplaintWithRentalInfo(const Complaint *c, Rental *rentalHead);
+void displayComplaint(ComplaintTable *table, const Complaint *c);
+void displayComplaintWithRentalInfo(ComplaintTable *table, const Complaint *c, RentalTable *rentals);
 
 // Utility Functions
 const char *complaintStatusStr(ComplaintStatus status);
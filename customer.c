@@ -2,6 +2,10 @@
 #include <stdlib.h>
 #include <string.h>
 #include "customer.h"
+#include "snapshot.h"
+#include "asyncio.h"
+#include "idalloc.h"
+#include "dirty.h"
 #include "utils.h"
 
 #define CUSTOMER_FILE "customers.csv"
@@ -19,7 +23,7 @@ Customer *parseCustomerCSV(char *line)
 
 void loadCustomers(Customer **head)
 {
-    FILE *f = fopen(CUSTOMER_FILE, "r");
+    FILE *f = openDataFile(CUSTOMER_FILE);
     if (!f)
     {
         *head = NULL;
@@ -41,23 +45,34 @@ void loadCustomers(Customer **head)
         {
             c->next = *head;
             *head = c;
+            observeId(ID_CUSTOMER, c->id);
         }
     }
     fclose(f);
+    markClean(DIRTY_CUSTOMERS);
 }
 
 void saveCustomers(Customer *head)
 {
-    FILE *f = fopen(CUSTOMER_FILE, "w");
+    waitBackgroundSave();
+    size_t added;
+    if (beginTableSave(DIRTY_CUSTOMERS, &added) == SAVE_SKIP)
+        return;
+    AsyncFile out;
+    FILE *f = asyncFileOpen(&out, CUSTOMER_FILE);
     if (!f)
+    {
+        endTableSave(DIRTY_CUSTOMERS, SAVE_REWRITE, -1);
         return;
+    }
     fprintf(f, "id,name,username,password,email,phone,active\n");
     for (Customer *c = head; c; c = c->next)
     {
         fprintf(f, "%d,%s,%s,%s,%s,%s,%d\n",
                 c->id, c->name, c->username, c->password, c->email, c->phone, c->active);
     }
-    fclose(f);
+    long result = asyncFileClose(&out);
+    endTableSave(DIRTY_CUSTOMERS, SAVE_REWRITE, result < 0 ? -1 : (long)out.length);
 }
 
 Customer *findCustomerByUsername(Customer *head, const char *username)
@@ -72,6 +87,18 @@ Customer *findCustomerByUsername(Customer *head, const char *username)
     return NULL;
 }
 
+Customer *findCustomerById(Customer *head, int id)
+{
+    for (Customer *c = head; c; c = c->next)
+    {
+        if (c->active && c->id == id)
+        {
+            return c;
+        }
+    }
+    return NULL;
+}
+
 Customer *authenticateCustomer(Customer *head, const char *username, const char *password)
 {
     Customer *c = findCustomerByUsername(head, username);
@@ -103,7 +130,7 @@ void registerCustomer(Customer **head)
         printf("Memory allocation failed!\n");
         return;
     }
-    newCustomer->id = generateUniqueId();
+    newCustomer->id = allocateId(ID_CUSTOMER);
     newCustomer->active = 1;
     newCustomer->next = NULL;
 
@@ -181,6 +208,7 @@ void registerCustomer(Customer **head)
 
     newCustomer->next = *head;
     *head = newCustomer;
+    markDirty(DIRTY_CUSTOMERS);
     saveCustomers(*head);
     printf("Registration successful! Your ID is %d\n", newCustomer->id);
 }
@@ -236,6 +264,7 @@ void updateCustomerProfile(Customer *c)
         hash_password(buf, c->password, sizeof(c->password));
     }
 
+    markDirty(DIRTY_CUSTOMERS);
     printf("Profile updated.\n");
 }
 
@@ -279,6 +308,7 @@ void adminCustomerMenu(Customer **head)
                 if (c->id == cid && c->active)
                 {
                     c->active = 0;
+                    markDirty(DIRTY_CUSTOMERS);
                     printf("Customer soft deleted.\n");
                     saveCustomers(*head);
                     break;
@@ -287,6 +317,7 @@ void adminCustomerMenu(Customer **head)
         }
         else if (option == 3)
         {
+            markDirty(DIRTY_CUSTOMERS); // Written even if unchanged, as asked
             saveCustomers(*head);
             printf("Exported to customers.csv\n");
         }
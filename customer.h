@@ -19,6 +19,7 @@ void loadCustomers(Customer **head);
 void saveCustomers(Customer *head);
 void freeCustomerList(Customer **head);
 Customer *findCustomerByUsername(Customer *head, const char *username);
+Customer *findCustomerById(Customer *head, int id);
 Customer *authenticateCustomer(Customer *head, const char *username, const char *password);
 void registerCustomer(Customer **head);
 void displayCustomerProfile(const Customer *c);
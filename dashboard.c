@@ -7,7 +7,7 @@
 #include "customer.h"
 #include "rental.h"
 
-static void printBar(float value, float maxValue)
+static void printBar(Money value, Money maxValue)
 {
     int barWidth = 40;
     if (maxValue == 0)
@@ -15,20 +15,20 @@ static void printBar(float value, float maxValue)
         printf("[No data]");
         return;
     }
-    int width = (int)((value / maxValue) * barWidth);
+    int width = (int)(value * barWidth / maxValue);
     for (int i = 0; i < width; i++)
     {
         printf("#");
     }
 }
 
-void showAdminDashboard(Vehicle *vehicleHead, Customer *customerHead, Rental *rentalHead)
+void showAdminDashboard(Vehicle *vehicleHead, Customer *customerHead, const RentalTable *rentals)
 {
     int totalVehicles = 0, availableVehicles = 0, rentedVehicles = 0;
     int totalCustomers = 0;
     int totalRentals = 0, activeRentals = 0;
-    float totalRevenue = 0.0f;
-    float monthlyRevenue[12] = {0};
+    Money totalRevenue = 0;
+    Money monthlyRevenue[12] = {0};
 
     for (Vehicle *v = vehicleHead; v; v = v->next)
     {
@@ -55,35 +55,38 @@ void showAdminDashboard(Vehicle *vehicleHead, Customer *customerHead, Rental *re
     }
 
     time_t now = time(NULL);
-    struct tm *localTime = localtime(&now);
-    int currentYear = localTime->tm_year + 1900;
-
-    for (Rental *r = rentalHead; r; r = r->next)
+    struct tm localTime;
+    localTimeSafe(now, &localTime);
+    int currentYear = localTime.tm_year + 1900;
+    time_t monthStarts[13];
+    monthStartsOfYear(currentYear, monthStarts);
+
+    // One snapshot, so the counts and revenue below describe the same moment.
+    RentalSnapshot snapshot;
+    rentalSnapshotBegin(rentals, &snapshot);
+    for (size_t i = 0; i < snapshot.count; i++)
     {
+        Rental r;
+        if (!rentalSnapshotRow(&snapshot, i, &r))
+            continue;
         totalRentals++;
-        if (r->status == RENT_ACTIVE)
+        if (r.status == RENT_ACTIVE)
         {
             activeRentals++;
         }
 
-        if (r->status == RENT_COMPLETED)
+        if (r.status == RENT_COMPLETED)
         {
-            totalRevenue += r->totalCost;
+            totalRevenue += r.totalCost;
 
-            int year, month, day;
-            if (sscanf(r->startTime, "%d-%d-%d", &year, &month, &day) == 3)
+            int monthIndex = monthIndexOf(monthStarts, (time_t)r.startAt);
+            if (monthIndex >= 0)
             {
-                if (year == currentYear)
-                {
-                    int monthIndex = month - 1;
-                    if (monthIndex >= 0 && monthIndex < 12)
-                    {
-                        monthlyRevenue[monthIndex] += r->totalCost;
-                    }
-                }
+                monthlyRevenue[monthIndex] += r.totalCost;
             }
         }
     }
+    rentalSnapshotEnd(rentals, &snapshot);
 
     clearScreen();
     printf("=============================================================\n");
@@ -103,10 +106,10 @@ void showAdminDashboard(Vehicle *vehicleHead, Customer *customerHead, Rental *re
     printf("\n");
 
     printf("--- FINANCIAL OVERVIEW ------------------------------------\n");
-    printf("Total Revenue (from completed rentals): $%.2f\n\n", totalRevenue);
+    printf("Total Revenue (from completed rentals): $" MONEY_FMT "\n\n", MONEY_ARGS(totalRevenue));
 
     printf("--- Monthly Revenue for %d (Bar Chart) ---\n", currentYear);
-    float maxMonthRevenue = 0.0f;
+    Money maxMonthRevenue = 0;
     for (int i = 0; i < 12; i++)
     {
         if (monthlyRevenue[i] > maxMonthRevenue)
@@ -120,12 +123,12 @@ void showAdminDashboard(Vehicle *vehicleHead, Customer *customerHead, Rental *re
     {
         printf("%-3s | ", months[i]);
         printBar(monthlyRevenue[i], maxMonthRevenue);
-        printf(" $%.2f\n", monthlyRevenue[i]);
+        printf(" $" MONEY_FMT "\n", MONEY_ARGS(monthlyRevenue[i]));
     }
     printf("-------------------------------------------------------------\n");
 }
 
-void showBookingCalendar(Vehicle *vehicleHead, Rental *rentalHead)
+void showBookingCalendar(Vehicle *vehicleHead, const RentalTable *rentals)
 {
     clearScreen();
     printf("\n--- Vehicle Booking Calendar ---\n");
@@ -164,18 +167,15 @@ void showBookingCalendar(Vehicle *vehicleHead, Rental *rentalHead)
         currentDayTm.tm_mday = day;
         time_t currentDayTime = mktime(&currentDayTm);
 
-        for (Rental *r = rentalHead; r; r = r->next)
+        for (size_t i = 0; i < rentals->count; i++)
         {
-            if (r->vehicleId == vehicleId && r->status == RENT_ACTIVE)
+            const Rental *r = &rentals->rows[i];
+            if (r->vehicleId == vehicleId && r->status == RENT_ACTIVE && r->startAt && r->endAt)
             {
-                time_t rentalStart, rentalEnd;
-                if (stringToTime(r->startTime, &rentalStart) && stringToTime(r->endTime, &rentalEnd))
+                if (currentDayTime >= r->startAt && currentDayTime <= r->endAt)
                 {
-                    if (currentDayTime >= rentalStart && currentDayTime <= rentalEnd)
-                    {
-                        booked_days[day] = 1;
-                        break;
-                    }
+                    booked_days[day] = 1;
+                    break;
                 }
             }
         }
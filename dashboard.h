@@ -5,7 +5,7 @@
 #include "customer.h"
 #include "rental.h"
 
-void showAdminDashboard(Vehicle *vehicleHead, Customer *customerHead, Rental *rentalHead);
-void showBookingCalendar(Vehicle *vehicleHead, Rental *rentalHead);
+void showAdminDashboard(Vehicle *vehicleHead, Customer *customerHead, const RentalTable *rentals);
+void showBookingCalendar(Vehicle *vehicleHead, const RentalTable *rentals);
 
 #endif // DASHBOARD_H
\ No newline at end of file
@@ -0,0 +1,174 @@
+#include "dirty.h"
+#include <stdatomic.h>
+#include <stdio.h>
+
+typedef struct
+{
+    atomic_int dirty;   // A saved record changed; the file must be rewritten
+    atomic_size_t added;
+    atomic_uint epoch;
+    atomic_int parts[DIRTY_MAX_PARTS]; // Changed partitions; 0 is a free slot
+} DirtyState;
+
+// Every table starts dirty; the loaders clear the ones they read.
+static DirtyState tables[DIRTY_TABLE_COUNT] = {
+    {1, 0, 0, {0}}, {1, 0, 0, {0}}, {1, 0, 0, {0}}, {1, 0, 0, {0}}, {1, 0, 0, {0}},
+    {1, 0, 0, {0}}, {1, 0, 0, {0}}, {1, 0, 0, {0}}, {1, 0, 0, {0}},
+};
+
+static atomic_llong savedBytes;
+static atomic_long rewriteCount, appendCount, skipCount;
+
+void markDirty(DirtyTable table)
+{
+    // Read first: once the flag is set, further changes do not write the shared line.
+    if (!atomic_load_explicit(&tables[table].dirty, memory_order_relaxed))
+        atomic_store_explicit(&tables[table].dirty, 1, memory_order_relaxed);
+}
+
+void markPartDirty(DirtyTable table, int part)
+{
+    DirtyState *state = &tables[table];
+    for (int i = 0; i < DIRTY_MAX_PARTS; i++)
+    {
+        int seen = atomic_load_explicit(&state->parts[i], memory_order_relaxed);
+        if (seen == part)
+            return;
+        // Claim the free slot; if another thread took it first, look at what it put there.
+        if (!seen && (atomic_compare_exchange_strong(&state->parts[i], &seen, part) || seen == part))
+            return;
+    }
+    markDirty(table); // Too many to list
+}
+
+void markAdded(DirtyTable table)
+{
+    atomic_fetch_add_explicit(&tables[table].added, 1, memory_order_relaxed);
+}
+
+size_t dirtyAddedCount(DirtyTable table)
+{
+    return atomic_load_explicit(&tables[table].added, memory_order_relaxed);
+}
+
+unsigned dirtyEpoch(DirtyTable table)
+{
+    return atomic_load_explicit(&tables[table].epoch, memory_order_relaxed);
+}
+
+int anyTableDirty(void)
+{
+    for (int t = 0; t < DIRTY_TABLE_COUNT; t++)
+    {
+        if (atomic_load(&tables[t].dirty) || atomic_load(&tables[t].added))
+            return 1;
+        for (int i = 0; i < DIRTY_MAX_PARTS; i++)
+        {
+            if (atomic_load(&tables[t].parts[i]))
+                return 1;
+        }
+    }
+    return 0;
+}
+
+// Empties the list of changed partitions; returns how many there were.
+static int takeParts(DirtyState *state, int *parts)
+{
+    int count = 0;
+    for (int i = 0; i < DIRTY_MAX_PARTS; i++)
+    {
+        int part = atomic_exchange(&state->parts[i], 0);
+        if (part && parts)
+            parts[count] = part;
+        count += part != 0;
+    }
+    return count;
+}
+
+static void startOver(DirtyState *state)
+{
+    atomic_fetch_add(&state->epoch, 1);
+    atomic_store(&state->added, 0);
+    atomic_store(&state->dirty, 0);
+    takeParts(state, NULL);
+}
+
+void markClean(DirtyTable table)
+{
+    startOver(&tables[table]);
+}
+
+void markAllDirty(void)
+{
+    for (int t = 0; t < DIRTY_TABLE_COUNT; t++)
+        atomic_store(&tables[t].dirty, 1);
+}
+
+SaveMode beginTableSave(DirtyTable table, size_t *added)
+{
+    int parts[DIRTY_MAX_PARTS], partCount;
+    SaveMode mode = beginPartitionedSave(table, added, parts, &partCount);
+    return mode == SAVE_PARTIAL ? SAVE_REWRITE : mode;
+}
+
+SaveMode beginPartitionedSave(DirtyTable table, size_t *added, int *parts, int *partCount)
+{
+    DirtyState *state = &tables[table];
+    atomic_fetch_add(&state->epoch, 1);
+    *added = atomic_exchange(&state->added, 0);
+    *partCount = takeParts(state, parts);
+    if (atomic_exchange(&state->dirty, 0))
+        return SAVE_REWRITE;
+    if (*partCount)
+        return SAVE_PARTIAL;
+    if (*added)
+        return SAVE_APPEND;
+    atomic_fetch_add(&skipCount, 1);
+    return SAVE_SKIP;
+}
+
+void endTableSave(DirtyTable table, SaveMode mode, long bytes)
+{
+    if (bytes < 0)
+    {
+        markDirty(table);
+        return;
+    }
+    atomic_fetch_add(&savedBytes, bytes);
+    atomic_fetch_add(mode == SAVE_APPEND ? &appendCount : &rewriteCount, 1);
+}
+
+void dirtySnapshotTaken(void)
+{
+    for (int t = 0; t < DIRTY_TABLE_COUNT; t++)
+        startOver(&tables[t]);
+}
+
+void getSaveCounters(SaveCounters *counters)
+{
+    counters->bytes = atomic_load(&savedBytes);
+    counters->rewrites = atomic_load(&rewriteCount);
+    counters->appends = atomic_load(&appendCount);
+    counters->skips = atomic_load(&skipCount);
+}
+
+void addSaveCounters(const SaveCounters *counters)
+{
+    atomic_fetch_add(&savedBytes, counters->bytes);
+    atomic_fetch_add(&rewriteCount, counters->rewrites);
+    atomic_fetch_add(&appendCount, counters->appends);
+    atomic_fetch_add(&skipCount, counters->skips);
+}
+
+void describeSaveCounters(char *buf, size_t size)
+{
+    SaveCounters c;
+    getSaveCounters(&c);
+    double kb = (double)c.bytes / 1024.0;
+    if (kb >= 1024.0)
+        snprintf(buf, size, "Saves: %ld files rewritten, %ld appended, %ld unchanged and skipped; %.1f MB written",
+                 c.rewrites, c.appends, c.skips, kb / 1024.0);
+    else
+        snprintf(buf, size, "Saves: %ld files rewritten, %ld appended, %ld unchanged and skipped; %.1f KB written",
+                 c.rewrites, c.appends, c.skips, kb);
+}
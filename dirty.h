@@ -0,0 +1,93 @@
+// File: dirty.h
+// Description: Change tracking for the data files, so a save only writes what
+// changed. Every function that changes a record marks its table, and each saveX
+// asks beginTableSave how to write: not at all when nothing changed, by appending
+// the new rows when the table only grew (rentals and invoices, whose new records
+// all sit at one end), or by rewriting the whole file. Tables stored in partitions
+// (see partition.h) can also have just the partitions that changed rewritten.
+
+#ifndef DIRTY_H
+#define DIRTY_H
+
+#include <stddef.h>
+
+typedef enum
+{
+    DIRTY_VEHICLES = 0,
+    DIRTY_CUSTOMERS,
+    DIRTY_RENTALS,
+    DIRTY_ROUTES,
+    DIRTY_PROMOS,
+    DIRTY_DRIVERS,
+    DIRTY_INVOICES,
+    DIRTY_COMPLAINTS,
+    DIRTY_IDS,
+    DIRTY_TABLE_COUNT
+} DirtyTable;
+
+typedef enum
+{
+    SAVE_SKIP,    // The file already matches memory
+    SAVE_APPEND,  // Only new records; append them
+    SAVE_PARTIAL, // Rewrite the partitions that changed, append new records to the others
+    SAVE_REWRITE
+} SaveMode;
+
+// Partitions of one table marked since the last save; more than this many rewrite
+// the whole table.
+#define DIRTY_MAX_PARTS 32
+
+// Bytes and files written by saves since the program started, including the ones
+// written by background-save children.
+typedef struct
+{
+    long long bytes;
+    long rewrites;
+    long appends;
+    long skips;
+} SaveCounters;
+
+// A record that is already in the file changed or was removed: the next save
+// rewrites the file. Cheap enough to call on every change, from any thread.
+void markDirty(DirtyTable table);
+// Like markDirty, for a table saved in partitions: only partition 'part' (any
+// non-zero key) has to be rewritten.
+void markPartDirty(DirtyTable table, int part);
+// A record was added after all the others. Tables saved by appending count these.
+void markAdded(DirtyTable table);
+// Records added since the last save began; they are not in the file yet.
+size_t dirtyAddedCount(DirtyTable table);
+// Bumped whenever a save of the table begins. A record stamped with the current
+// epoch when it was added is not in the file yet, so changing it needs no rewrite.
+unsigned dirtyEpoch(DirtyTable table);
+
+// 1 if any table has changes a save would write.
+int anyTableDirty(void);
+
+// The table was just loaded and matches its file. Tables start out dirty, so a
+// table whose file could not be read is written by the next save.
+void markClean(DirtyTable table);
+// After a failed save: everything is written again next time.
+void markAllDirty(void);
+
+// Decides how the save about to run writes the table and clears its marks, so
+// changes from now on go into the next save. For SAVE_APPEND, *added is the number
+// of new records. Call after waitBackgroundSave.
+SaveMode beginTableSave(DirtyTable table, size_t *added);
+// beginTableSave for a partitioned table: SAVE_PARTIAL when only some partitions
+// changed, with their keys in parts[0 .. *partCount - 1] (DIRTY_MAX_PARTS long).
+SaveMode beginPartitionedSave(DirtyTable table, size_t *added, int *parts, int *partCount);
+// Counts a finished save; bytes < 0 means it failed and the table is dirty again.
+void endTableSave(DirtyTable table, SaveMode mode, long bytes);
+
+// Called in the parent right after forking a background save. The child writes
+// everything marked so far from its copy, so the parent's marks start over.
+void dirtySnapshotTaken(void);
+
+void getSaveCounters(SaveCounters *counters);
+// Adds what a background-save child wrote.
+void addSaveCounters(const SaveCounters *counters);
+// "Saves: 4 files rewritten, 2 appended, 21 unchanged and skipped; 183.2 KB written"
+void describeSaveCounters(char *buf, size_t size);
+
+#endif // DIRTY_H
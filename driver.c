@@ -1,5 +1,13 @@
 #include "driver.h"
+#include "snapshot.h"
+#include "asyncio.h"
+#include "journal.h"
+#include "dirty.h"
+#include "idalloc.h"
 #include "utils.h"
+#include "threadpool.h"
+#include <pthread.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -24,6 +32,26 @@ static void ensureDriverFileExists()
     }
 }
 
+// One drivers.csv line, without the newline.
+static void formatDriverRow(const Driver *d, char *buf, size_t size)
+{
+    snprintf(buf, size, "%d,%s,%s,%s,%s,%.2f,%d," MONEY_FMT ",%d,%ld",
+             d->id, d->name, d->phone, d->licenseNumber, d->vehicleType,
+             d->rating, d->totalTrips, MONEY_ARGS(d->totalEarnings), (int)d->status, (long)d->lastActive);
+}
+
+// driverLock held, so rows of one driver are journaled in the order of the changes.
+// Also marks drivers.csv for the next save.
+static void journalDriver(const Driver *d)
+{
+    markDirty(DIRTY_DRIVERS);
+    if (!journalEnabled())
+        return;
+    char row[256];
+    formatDriverRow(d, row, sizeof(row));
+    journalAppend(JOURNAL_DRIVER, row);
+}
+
 static Driver *parseDriverCSV(char *line)
 {
     Driver *d = (Driver *)malloc(sizeof(Driver));
@@ -32,16 +60,16 @@ static Driver *parseDriverCSV(char *line)
 
     d->next = NULL;
 
-    int id, status, totalTrips, totalEarnings;
-    char name[50], phone[15], licenseNumber[20], vehicleType[20];
+    int id, status, totalTrips;
+    char name[50], phone[15], licenseNumber[20], vehicleType[20], earnings[MONEY_STR_SIZE];
     float rating;
     long lastActive;
 
-    int n = sscanf(line, "%d,%49[^,],%14[^,],%19[^,],%19[^,],%f,%d,%d,%d,%ld",
+    int n = sscanf(line, "%d,%49[^,],%14[^,],%19[^,],%19[^,],%f,%d,%23[^,],%d,%ld",
                    &id, name, phone, licenseNumber, vehicleType,
-                   &rating, &totalTrips, &totalEarnings, &status, &lastActive);
+                   &rating, &totalTrips, earnings, &status, &lastActive);
 
-    if (n != 10)
+    if (n != 10 || !parseMoney(earnings, &d->totalEarnings))
     {
         free(d);
         return NULL;
@@ -58,30 +86,18 @@ static Driver *parseDriverCSV(char *line)
     d->vehicleType[sizeof(d->vehicleType) - 1] = '\0';
     d->rating = rating;
     d->totalTrips = totalTrips;
-    d->totalEarnings = totalEarnings;
     d->status = (DriverStatus)status;
     d->lastActive = (time_t)lastActive;
 
     return d;
 }
 
-static int getNextDriverId(Driver *head)
-{
-    int maxId = 4000; // Start from 4000 for driver IDs
-    for (Driver *d = head; d; d = d->next)
-    {
-        if (d->id > maxId)
-            maxId = d->id;
-    }
-    return maxId + 1;
-}
-
 void loadDrivers(Driver **head)
 {
     *head = NULL;
     ensureDriverFileExists();
 
-    FILE *f = fopen(DRIVER_FILE, "r");
+    FILE *f = openDataFile(DRIVER_FILE);
     if (!f)
         return;
 
@@ -105,28 +121,59 @@ void loadDrivers(Driver **head)
         {
             d->next = *head;
             *head = d;
+            observeId(ID_DRIVER, d->id);
         }
     }
     fclose(f);
+    markClean(DIRTY_DRIVERS);
 }
 
 void saveDrivers(Driver *head)
 {
-    FILE *f = fopen(DRIVER_FILE, "w");
+    waitBackgroundSave();
+    size_t added;
+    if (beginTableSave(DIRTY_DRIVERS, &added) == SAVE_SKIP)
+        return;
+    AsyncFile out;
+    FILE *f = asyncFileOpen(&out, DRIVER_FILE);
     if (!f)
     {
         printf("Error: could not open %s\n", DRIVER_FILE);
+        endTableSave(DIRTY_DRIVERS, SAVE_REWRITE, -1);
         return;
     }
 
     fprintf(f, "id,name,phone,licenseNumber,vehicleType,rating,totalTrips,totalEarnings,status,lastActive\n");
     for (Driver *d = head; d; d = d->next)
     {
-        fprintf(f, "%d,%s,%s,%s,%s,%.2f,%d,%d,%d,%ld\n",
-                d->id, d->name, d->phone, d->licenseNumber, d->vehicleType,
-                d->rating, d->totalTrips, d->totalEarnings, (int)d->status, (long)d->lastActive);
+        char row[256];
+        formatDriverRow(d, row, sizeof(row));
+        fputs(row, f);
+        fputc('\n', f);
     }
-    fclose(f);
+    long result = asyncFileClose(&out);
+    endTableSave(DIRTY_DRIVERS, SAVE_REWRITE, result < 0 ? -1 : (long)out.length);
+}
+
+int applyJournaledDriver(Driver **head, char *row)
+{
+    Driver *parsed = parseDriverCSV(row);
+    if (!parsed)
+        return 0;
+    Driver *d = findDriverById(*head, parsed->id);
+    if (d)
+    {
+        parsed->next = d->next;
+        *d = *parsed;
+        free(parsed);
+        markDirty(DIRTY_DRIVERS);
+        return 1;
+    }
+    parsed->next = *head;
+    *head = parsed;
+    observeId(ID_DRIVER, parsed->id);
+    markDirty(DIRTY_DRIVERS);
+    return 1;
 }
 
 Driver *findDriverById(Driver *head, int driverId)
@@ -169,7 +216,7 @@ void addDriver(Driver **head)
         return;
     }
 
-    d->id = getNextDriverId(*head);
+    d->id = allocateId(ID_DRIVER);
     d->rating = 0.0;
     d->totalTrips = 0;
     d->totalEarnings = 0;
@@ -205,6 +252,7 @@ void addDriver(Driver **head)
 
     d->next = *head;
     *head = d;
+    markDirty(DIRTY_DRIVERS);
     saveDrivers(*head);
 
     printf("\nDriver added successfully! ID: %d\n", d->id);
@@ -256,6 +304,7 @@ void updateDriverProfile(Driver *driver)
     }
 
     driver->lastActive = time(NULL);
+    markDirty(DIRTY_DRIVERS);
     printf("\nDriver profile updated successfully!\n");
 }
 
@@ -272,13 +321,15 @@ void displayDriverProfile(const Driver *driver)
     printf("Vehicle Type: %s\n", driver->vehicleType);
     printf("Rating: %.2f/5.0\n", driver->rating);
     printf("Total Trips: %d\n", driver->totalTrips);
-    printf("Total Earnings: $%d\n", driver->totalEarnings);
+    printf("Total Earnings: $" MONEY_FMT "\n", MONEY_ARGS(driver->totalEarnings));
     printf("Status: %s\n",
            driver->status == DRIVER_AVAILABLE ? "Available" : driver->status == DRIVER_BUSY ? "Busy"
                                                                                             : "Offline");
 
     char timeStr[64];
-    strftime(timeStr, sizeof(timeStr), "%Y-%m-%d %H:%M", localtime(&driver->lastActive));
+    struct tm lastActiveTm;
+    localTimeSafe(driver->lastActive, &lastActiveTm);
+    strftime(timeStr, sizeof(timeStr), "%Y-%m-%d %H:%M", &lastActiveTm);
     printf("Last Active: %s\n", timeStr);
 }
 
@@ -297,9 +348,11 @@ void listAllDrivers(Driver *head)
 
     for (Driver *d = head; d; d = d->next)
     {
-        printf("%-4d %-20s %-15s %-12s %-10s %-6.2f %-8d %-8d %-10s\n",
+        char earnings[MONEY_STR_SIZE];
+        formatMoney(d->totalEarnings, earnings, sizeof(earnings));
+        printf("%-4d %-20s %-15s %-12s %-10s %-6.2f %-8d %-8s %-10s\n",
                d->id, d->name, d->phone, d->licenseNumber, d->vehicleType,
-               d->rating, d->totalTrips, d->totalEarnings,
+               d->rating, d->totalTrips, earnings,
                d->status == DRIVER_AVAILABLE ? "Available" : d->status == DRIVER_BUSY ? "Busy"
                                                                                       : "Offline");
     }
@@ -323,8 +376,10 @@ void listAvailableDrivers(Driver *head)
     {
         if (d->status == DRIVER_AVAILABLE)
         {
-            printf("%-4d %-20s %-10s %-6.2f %-8d %-8d\n",
-                   d->id, d->name, d->vehicleType, d->rating, d->totalTrips, d->totalEarnings);
+            char earnings[MONEY_STR_SIZE];
+            formatMoney(d->totalEarnings, earnings, sizeof(earnings));
+            printf("%-4d %-20s %-10s %-6.2f %-8d %-8s\n",
+                   d->id, d->name, d->vehicleType, d->rating, d->totalTrips, earnings);
             found = 1;
         }
     }
@@ -335,24 +390,33 @@ void listAvailableDrivers(Driver *head)
     }
 }
 
+// Guards driver status and trip totals against concurrent bookings. Only the
+// journal's lock is taken while it is held.
+static pthread_mutex_t driverLock = PTHREAD_MUTEX_INITIALIZER;
+
 Driver *assignDriverToRental(Driver *head, const char *vehicleType)
 {
+    pthread_mutex_lock(&driverLock);
     Driver *driver = findAvailableDriver(head, vehicleType);
     if (driver)
     {
-        updateDriverStatus(driver, DRIVER_BUSY);
+        driver->status = DRIVER_BUSY;
         driver->lastActive = time(NULL);
-        return driver;
+        journalDriver(driver);
     }
-    return NULL;
+    pthread_mutex_unlock(&driverLock);
+    return driver;
 }
 
 void updateDriverStatus(Driver *driver, DriverStatus status)
 {
     if (driver)
     {
+        pthread_mutex_lock(&driverLock);
         driver->status = status;
         driver->lastActive = time(NULL);
+        journalDriver(driver);
+        pthread_mutex_unlock(&driverLock);
     }
 }
 
@@ -360,62 +424,99 @@ void updateDriverRating(Driver *driver, float newRating)
 {
     if (driver && newRating >= 0.0 && newRating <= 5.0)
     {
+        pthread_mutex_lock(&driverLock);
         float totalRating = driver->rating * driver->totalTrips + newRating;
         driver->totalTrips++;
         driver->rating = totalRating / driver->totalTrips;
         driver->lastActive = time(NULL);
+        journalDriver(driver);
+        pthread_mutex_unlock(&driverLock);
     }
 }
 
-void completeDriverTrip(Driver *driver, float tripEarnings)
+void completeDriverTrip(Driver *driver, Money tripEarnings)
 {
     if (driver)
     {
+        pthread_mutex_lock(&driverLock);
         driver->totalTrips++;
-        driver->totalEarnings += (int)tripEarnings;
+        driver->totalEarnings += tripEarnings;
         driver->status = DRIVER_AVAILABLE;
         driver->lastActive = time(NULL);
+        journalDriver(driver);
+        pthread_mutex_unlock(&driverLock);
     }
 }
 
-void showDriverStatistics(Driver *head)
+typedef struct
 {
-    if (!head)
-    {
-        printf("No drivers found.\n");
-        return;
-    }
+    int totalDrivers, availableDrivers, busyDrivers, offlineDrivers;
+    double totalRating, totalTrips;
+    Money totalEarnings;
+} DriverStatsPartial;
 
-    int totalDrivers = 0, availableDrivers = 0, busyDrivers = 0, offlineDrivers = 0;
-    float totalRating = 0.0, totalEarnings = 0.0, totalTrips = 0.0;
+static void scanDriverStats(size_t begin, size_t end, void *partial, void *ctx)
+{
+    Driver **items = (Driver **)ctx;
+    DriverStatsPartial *p = (DriverStatsPartial *)partial;
 
-    for (Driver *d = head; d; d = d->next)
+    for (size_t i = begin; i < end; i++)
     {
-        totalDrivers++;
-        totalRating += d->rating;
-        totalEarnings += d->totalEarnings;
-        totalTrips += d->totalTrips;
+        const Driver *d = items[i];
+        p->totalDrivers++;
+        p->totalRating += d->rating;
+        p->totalEarnings += d->totalEarnings;
+        p->totalTrips += d->totalTrips;
 
         switch (d->status)
         {
         case DRIVER_AVAILABLE:
-            availableDrivers++;
+            p->availableDrivers++;
             break;
         case DRIVER_BUSY:
-            busyDrivers++;
+            p->busyDrivers++;
             break;
         case DRIVER_OFFLINE:
-            offlineDrivers++;
+            p->offlineDrivers++;
             break;
         }
     }
+}
+
+static void mergeDriverStats(void *total, const void *partial, void *ctx)
+{
+    (void)ctx;
+    DriverStatsPartial *t = (DriverStatsPartial *)total;
+    const DriverStatsPartial *p = (const DriverStatsPartial *)partial;
+    t->totalDrivers += p->totalDrivers;
+    t->availableDrivers += p->availableDrivers;
+    t->busyDrivers += p->busyDrivers;
+    t->offlineDrivers += p->offlineDrivers;
+    t->totalRating += p->totalRating;
+    t->totalEarnings += p->totalEarnings;
+    t->totalTrips += p->totalTrips;
+}
+
+void showDriverStatistics(Driver *head)
+{
+    if (!head)
+    {
+        printf("No drivers found.\n");
+        return;
+    }
+
+    size_t count;
+    Driver **items = (Driver **)listToArray(head, offsetof(Driver, next), &count);
+    DriverStatsPartial stats = {0};
+    parallelScan(count, sizeof(DriverStatsPartial), scanDriverStats, mergeDriverStats, &stats, items);
+    free(items);
 
     printf("\n--- Driver Statistics ---\n");
-    printf("Total Drivers: %d\n", totalDrivers);
-    printf("Available: %d | Busy: %d | Offline: %d\n", availableDrivers, busyDrivers, offlineDrivers);
-    printf("Average Rating: %.2f/5.0\n", totalDrivers > 0 ? totalRating / totalDrivers : 0.0);
-    printf("Total Trips: %.0f\n", totalTrips);
-    printf("Total Earnings: $%.0f\n", totalEarnings);
+    printf("Total Drivers: %d\n", stats.totalDrivers);
+    printf("Available: %d | Busy: %d | Offline: %d\n", stats.availableDrivers, stats.busyDrivers, stats.offlineDrivers);
+    printf("Average Rating: %.2f/5.0\n", stats.totalDrivers > 0 ? stats.totalRating / stats.totalDrivers : 0.0);
+    printf("Total Trips: %.0f\n", stats.totalTrips);
+    printf("Total Earnings: $" MONEY_FMT "\n", MONEY_ARGS(stats.totalEarnings));
 }
 
 void showTopDrivers(Driver *head, int count)
@@ -461,8 +562,10 @@ void showTopDrivers(Driver *head, int count)
     for (int i = 0; i < count && i < driverCount; i++)
     {
         Driver *d = drivers[i];
-        printf("%-4d %-20s %-10s %-6.2f %-8d %-8d\n",
-               d->id, d->name, d->vehicleType, d->rating, d->totalTrips, d->totalEarnings);
+        char earnings[MONEY_STR_SIZE];
+        formatMoney(d->totalEarnings, earnings, sizeof(earnings));
+        printf("%-4d %-20s %-10s %-6.2f %-8d %-8s\n",
+               d->id, d->name, d->vehicleType, d->rating, d->totalTrips, earnings);
     }
 
     free(drivers);
@@ -2,6 +2,7 @@
 #define DRIVER_H
 
 #include <time.h>
+#include "money.h"
 
 // --- Driver Status Enum ---
 typedef enum
@@ -21,7 +22,7 @@ typedef struct DriverNode
     char vehicleType[20];    // Type of vehicle they can drive
     float rating;            // Average rating (0.0 - 5.0)
     int totalTrips;          // Total number of completed trips
-    int totalEarnings;       // Total earnings in dollars
+    Money totalEarnings;     // Total earnings in cents
     DriverStatus status;     // Current availability status
     time_t lastActive;       // Last active timestamp
     struct DriverNode *next; // Pointer to next driver
@@ -32,6 +33,8 @@ typedef struct DriverNode
 // CSV I/O Functions
 void loadDrivers(Driver **head);
 void saveDrivers(Driver *head);
+// Applies one journaled drivers.csv row on top of the loaded list.
+int applyJournaledDriver(Driver **head, char *row);
 
 // Driver Management Functions
 Driver *findDriverById(Driver *head, int driverId);
@@ -43,10 +46,12 @@ void listAllDrivers(Driver *head);
 void listAvailableDrivers(Driver *head);
 
 // Driver Assignment Functions
+// These may be called from concurrent bookings. They share one lock, separate from the
+// per-vehicle booking locks, so finding a free driver and marking them busy is atomic.
 Driver *assignDriverToRental(Driver *head, const char *vehicleType);
 void updateDriverStatus(Driver *driver, DriverStatus status);
 void updateDriverRating(Driver *driver, float newRating);
-void completeDriverTrip(Driver *driver, float tripEarnings);
+void completeDriverTrip(Driver *driver, Money tripEarnings);
 
 // Driver Statistics
 void showDriverStatistics(Driver *head);
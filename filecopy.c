@@ -0,0 +1,264 @@
+#define _GNU_SOURCE // copy_file_range
+#include "filecopy.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+#ifdef __linux__
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#endif
+
+#define COPY_BUFFER (1024 * 1024)
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+
+const char *copyMethodName(CopyMethod method)
+{
+    switch (method)
+    {
+    case COPY_REFLINK:
+        return "reflink";
+    case COPY_RANGE:
+        return "copy_file_range";
+    case COPY_SENDFILE:
+        return "sendfile";
+    default:
+        return "read/write";
+    }
+}
+
+// The errors that mean "not here": the file system, kernel or pair of files does
+// not support the method, so the next one is tried.
+static int unsupported(int error)
+{
+    return error == ENOSYS || error == EXDEV || error == EINVAL || error == EOPNOTSUPP ||
+           error == ENOTTY || error == EBADF;
+}
+
+// Each copier returns 1 when done, 0 if its method cannot be used for these files
+// (nothing was written yet) and -1 on a real failure.
+
+static int copyWithRange(int in, long long inOffset, int out, long long outOffset, long long length)
+{
+#ifdef __linux__
+    off_t from = (off_t)inOffset, to = (off_t)outOffset;
+    long long done = 0;
+    while (done < length)
+    {
+        ssize_t n = copy_file_range(in, &from, out, &to, (size_t)(length - done), 0);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return done == 0 && unsupported(errno) ? 0 : -1;
+        }
+        if (n == 0)
+        {
+            // Some pseudo file systems report nothing copied instead of an error.
+            if (done == 0)
+                return 0;
+            errno = EIO; // The source ended early
+            return -1;
+        }
+        done += n;
+    }
+    return 1;
+#else
+    (void)in, (void)inOffset, (void)out, (void)outOffset, (void)length;
+    return 0;
+#endif
+}
+
+static int copyWithSendfile(int in, long long inOffset, int out, long long outOffset, long long length)
+{
+#ifdef __linux__
+    if (lseek(out, (off_t)outOffset, SEEK_SET) < 0)
+        return 0;
+    off_t from = (off_t)inOffset;
+    long long done = 0;
+    while (done < length)
+    {
+        ssize_t n = sendfile(out, in, &from, (size_t)(length - done));
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return done == 0 && unsupported(errno) ? 0 : -1;
+        }
+        if (n == 0)
+        {
+            errno = EIO;
+            return -1;
+        }
+        done += n;
+    }
+    return 1;
+#else
+    (void)in, (void)inOffset, (void)out, (void)outOffset, (void)length;
+    return 0;
+#endif
+}
+
+// Reads and writes at explicit offsets, so neither file's position moves.
+static long readAt(int fd, char *buffer, long long size, long long offset)
+{
+#ifdef _WIN32
+    if (_lseeki64(fd, offset, SEEK_SET) < 0)
+        return -1;
+    return (long)read(fd, buffer, (unsigned)size);
+#else
+    return (long)pread(fd, buffer, (size_t)size, (off_t)offset);
+#endif
+}
+
+static long writeAt(int fd, const char *buffer, long long size, long long offset)
+{
+#ifdef _WIN32
+    if (_lseeki64(fd, offset, SEEK_SET) < 0)
+        return -1;
+    return (long)write(fd, buffer, (unsigned)size);
+#else
+    return (long)pwrite(fd, buffer, (size_t)size, (off_t)offset);
+#endif
+}
+
+static int copyWithBuffer(int in, long long inOffset, int out, long long outOffset, long long length)
+{
+    char *buffer = (char *)malloc(COPY_BUFFER);
+    if (!buffer)
+        return -1;
+    long long done = 0;
+    int result = 1;
+    while (done < length && result == 1)
+    {
+        long long want = length - done < COPY_BUFFER ? length - done : COPY_BUFFER;
+        long got = readAt(in, buffer, want, inOffset + done);
+        if (got <= 0)
+        {
+            if (got < 0 && errno == EINTR)
+                continue;
+            if (got == 0)
+                errno = EIO; // The source ended early
+            result = -1;
+            break;
+        }
+        for (long written = 0; written < got;)
+        {
+            long n = writeAt(out, buffer + written, got - written, outOffset + done + written);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+            {
+                result = -1;
+                break;
+            }
+            written += n;
+        }
+        done += got;
+    }
+    free(buffer);
+    return result;
+}
+
+static int copyWith(CopyMethod method, int in, long long inOffset, int out, long long outOffset, long long length)
+{
+    switch (method)
+    {
+    case COPY_RANGE:
+        return copyWithRange(in, inOffset, out, outOffset, length);
+    case COPY_SENDFILE:
+        return copyWithSendfile(in, inOffset, out, outOffset, length);
+    case COPY_BUFFERED:
+        return copyWithBuffer(in, inOffset, out, outOffset, length);
+    default:
+        return 0;
+    }
+}
+
+int copyFileRange(int in, long long inOffset, int out, long long outOffset, long long length, CopyMethod *used)
+{
+    for (int method = COPY_RANGE; method < COPY_METHOD_COUNT; method++)
+    {
+        int result = copyWith((CopyMethod)method, in, inOffset, out, outOffset, length);
+        if (result == 0)
+            continue;
+        if (result > 0 && used)
+            *used = (CopyMethod)method;
+        return result > 0 ? 0 : -1;
+    }
+    return -1;
+}
+
+// Runs one method (or, with fallback, every method from 'first' on) over whole files.
+static int copyWholeFile(const char *sourcePath, const char *destPath, CopyMethod first, int fallback,
+                         CopyMethod *used)
+{
+    int in = open(sourcePath, O_RDONLY | O_BINARY);
+    if (in < 0)
+        return 0;
+    struct stat st;
+    int out = fstat(in, &st) == 0 ? open(destPath, O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, 0644) : -1;
+    if (out < 0)
+    {
+        close(in);
+        return 0;
+    }
+
+    int result = 0;
+    CopyMethod method = first;
+#ifdef FICLONE
+    if (method == COPY_REFLINK)
+    {
+        if (ioctl(out, FICLONE, in) == 0)
+            result = 1;
+        else if (fallback && unsupported(errno))
+            method = COPY_RANGE;
+        else
+            result = -1;
+    }
+#else
+    if (method == COPY_REFLINK && fallback)
+        method = COPY_RANGE;
+#endif
+    if (method != COPY_REFLINK && result == 0)
+    {
+        if (fallback)
+            result = copyFileRange(in, 0, out, 0, (long long)st.st_size, &method) == 0 ? 1 : -1;
+        else
+            result = copyWith(method, in, 0, out, 0, (long long)st.st_size);
+    }
+#ifndef _WIN32
+    if (result > 0 && fsync(out) != 0)
+        result = -1;
+#endif
+    if (close(out) != 0)
+        result = -1;
+    close(in);
+    if (result <= 0)
+    {
+        remove(destPath);
+        return 0;
+    }
+    if (used)
+        *used = method;
+    return 1;
+}
+
+int copyFile(const char *sourcePath, const char *destPath, CopyMethod *used)
+{
+    return copyWholeFile(sourcePath, destPath, COPY_REFLINK, 1, used);
+}
+
+int copyFileWith(const char *sourcePath, const char *destPath, CopyMethod method)
+{
+    return copyWholeFile(sourcePath, destPath, method, 0, NULL);
+}
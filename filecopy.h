@@ -0,0 +1,34 @@
+// File: filecopy.h
+// Description: File copies that stay in the kernel. A copy first tries to share the
+// source's blocks (reflink, FICLONE), then copy_file_range, then sendfile, and only
+// falls back to reading and writing through a buffer when the file system or
+// platform offers none of them.
+
+#ifndef FILECOPY_H
+#define FILECOPY_H
+
+typedef enum
+{
+    COPY_REFLINK,    // Whole files only: the copy shares the source's extents
+    COPY_RANGE,      // copy_file_range
+    COPY_SENDFILE,
+    COPY_BUFFERED,   // read/write through a user-space buffer
+    COPY_METHOD_COUNT
+} CopyMethod;
+
+// "reflink", "copy_file_range", "sendfile" or "read/write".
+const char *copyMethodName(CopyMethod method);
+
+// Copies 'length' bytes from offset 'inOffset' of 'in' to offset 'outOffset' of 'out'
+// with the first method that works, starting at COPY_RANGE. *used (if not NULL)
+// receives the method that did the copy. Returns 0, or -1 with errno set.
+int copyFileRange(int in, long long inOffset, int out, long long outOffset, long long length, CopyMethod *used);
+
+// Copies the whole of sourcePath to destPath (created or truncated) and fsyncs it,
+// trying COPY_REFLINK first. Returns 1 on success, 0 on failure.
+int copyFile(const char *sourcePath, const char *destPath, CopyMethod *used);
+// Same, with exactly one method and no fallback; for the backup benchmark. Returns 0
+// as well if the method is not supported here.
+int copyFileWith(const char *sourcePath, const char *destPath, CopyMethod method);
+
+#endif // FILECOPY_H
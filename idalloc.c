@@ -0,0 +1,123 @@
+#include "idalloc.h"
+#include "snapshot.h"
+#include "asyncio.h"
+#include "threadpool.h"
+#include "dirty.h"
+#include "utils.h"
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+
+#define ID_FILE "data/ids.csv"
+
+// Next id not yet leased to any thread. One cache line per kind, so threads
+// leasing customer ids do not slow down threads leasing rental ids.
+typedef struct
+{
+    _Alignas(CACHE_LINE_SIZE) atomic_int next;
+    atomic_int generation; // Bumped when observeId raises 'next'; older leases are dropped
+    const char *name;      // As written in ids.csv
+} IdCounter;
+
+static IdCounter counters[ID_KIND_COUNT] = {
+    {1001, 0, "customer"},
+    {2001, 0, "vehicle"},
+    {3001, 0, "route"},
+    {4001, 0, "driver"},
+    {5001, 0, "rental"},
+    {6001, 0, "invoice"},
+    {7001, 0, "complaint"},
+};
+
+// The block of ids this thread may hand out: [next, end).
+typedef struct
+{
+    int next;
+    int end;
+    int generation;
+} IdLease;
+
+static _Thread_local IdLease leases[ID_KIND_COUNT];
+
+int allocateId(IdKind kind)
+{
+    IdCounter *counter = &counters[kind];
+    IdLease *lease = &leases[kind];
+    int generation = atomic_load_explicit(&counter->generation, memory_order_acquire);
+    if (lease->next == lease->end || lease->generation != generation)
+    {
+        lease->next = atomic_fetch_add(&counter->next, ID_LEASE_BLOCK);
+        lease->end = lease->next + ID_LEASE_BLOCK;
+        lease->generation = generation;
+    }
+    markDirty(DIRTY_IDS);
+    return lease->next++;
+}
+
+void observeId(IdKind kind, int id)
+{
+    IdCounter *counter = &counters[kind];
+    int next = atomic_load(&counter->next);
+    while (id >= next)
+    {
+        if (atomic_compare_exchange_weak(&counter->next, &next, id + 1))
+        {
+            atomic_fetch_add_explicit(&counter->generation, 1, memory_order_release);
+            markDirty(DIRTY_IDS);
+            break;
+        }
+    }
+}
+
+void loadIdAllocator(void)
+{
+    FILE *f = openDataFile(ID_FILE);
+    if (!f)
+        return; // First run: the loaders raise the defaults from the data files
+
+    char line[128];
+    while (fgets(line, sizeof(line), f))
+    {
+        char name[32];
+        int next;
+        if (sscanf(line, "%31[^,],%d", name, &next) != 2)
+            continue; // Header or damaged line
+        for (int k = 0; k < ID_KIND_COUNT; k++)
+        {
+            if (strcmp(name, counters[k].name) == 0)
+                observeId((IdKind)k, next - 1);
+        }
+    }
+    fclose(f);
+    markClean(DIRTY_IDS);
+}
+
+void saveIdAllocator(void)
+{
+    waitBackgroundSave();
+    size_t added;
+    if (beginTableSave(DIRTY_IDS, &added) == SAVE_SKIP)
+        return;
+    AsyncFile out;
+    FILE *f = asyncFileOpen(&out, ID_FILE);
+    if (!f)
+    {
+        printf("Error: could not save %s\n", ID_FILE);
+        endTableSave(DIRTY_IDS, SAVE_REWRITE, -1);
+        return;
+    }
+    fprintf(f, "kind,next\n");
+    for (int k = 0; k < ID_KIND_COUNT; k++)
+    {
+        // Hand back the unused rest of this thread's block if nobody leased after
+        // it, so the next run continues right after the last id actually used.
+        // Blocks held by other threads are skipped over.
+        IdLease *lease = &leases[k];
+        int end = lease->end;
+        if (lease->next != end && atomic_compare_exchange_strong(&counters[k].next, &end, lease->next))
+            lease->end = lease->next;
+        fprintf(f, "%s,%d\n", counters[k].name, atomic_load(&counters[k].next));
+    }
+    long result = asyncFileClose(&out);
+    endTableSave(DIRTY_IDS, SAVE_REWRITE, result < 0 ? -1 : (long)out.length);
+}
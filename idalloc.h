@@ -0,0 +1,36 @@
+// File: idalloc.h
+// Description: One id allocator per entity. Each keeps a high-water mark that is
+// persisted in data/ids.csv, so ids are never handed out twice across restarts,
+// even for records that have since been deleted. Threads lease blocks of ids
+// with a single atomic add and then allocate from their block without sharing.
+
+#ifndef IDALLOC_H
+#define IDALLOC_H
+
+typedef enum
+{
+    ID_CUSTOMER = 0,
+    ID_VEHICLE,
+    ID_ROUTE,
+    ID_DRIVER,
+    ID_RENTAL,
+    ID_INVOICE,
+    ID_COMPLAINT,
+    ID_KIND_COUNT
+} IdKind;
+
+// Ids a thread takes from the shared counter at a time.
+#define ID_LEASE_BLOCK 32
+
+// Returns a fresh id for 'kind'. Safe to call from any thread.
+int allocateId(IdKind kind);
+
+// Records an id read from a data file, so it is never allocated again. The
+// loaders call this for every record; it replaces rescanning lists for a maximum.
+void observeId(IdKind kind, int id);
+
+// High-water marks. Load before the entity files and save along with them.
+void loadIdAllocator(void);
+void saveIdAllocator(void);
+
+#endif // IDALLOC_H
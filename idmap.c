@@ -0,0 +1,77 @@
+#include "idmap.h"
+#include <stdlib.h>
+#include <string.h>
+
+static size_t slotOf(const IdMap *map, int id)
+{
+    // Ids are sequential; multiplying spreads neighbours over the table.
+    return (size_t)((uint32_t)id * 2654435761u) & (map->capacity - 1);
+}
+
+static int grow(IdMap *map)
+{
+    size_t capacity = map->capacity ? map->capacity * 2 : 1024;
+    int *ids = (int *)calloc(capacity, sizeof(int));
+    uintptr_t *values = (uintptr_t *)malloc(capacity * sizeof(uintptr_t));
+    if (!ids || !values)
+    {
+        free(ids);
+        free(values);
+        return 0;
+    }
+    IdMap bigger = {ids, values, capacity, 0};
+    for (size_t i = 0; i < map->capacity; i++)
+    {
+        if (map->ids[i])
+            idMapPut(&bigger, map->ids[i], map->values[i]);
+    }
+    idMapFree(map);
+    *map = bigger;
+    return 1;
+}
+
+void idMapInit(IdMap *map)
+{
+    memset(map, 0, sizeof(*map));
+}
+
+void idMapFree(IdMap *map)
+{
+    free(map->ids);
+    free(map->values);
+    memset(map, 0, sizeof(*map));
+}
+
+int idMapPut(IdMap *map, int id, uintptr_t value)
+{
+    if (id <= 0)
+        return 0;
+    // Kept at most half full, so probe runs stay short.
+    if ((map->count + 1) * 2 > map->capacity && !grow(map))
+        return 0;
+    size_t slot = slotOf(map, id);
+    while (map->ids[slot] && map->ids[slot] != id)
+        slot = (slot + 1) & (map->capacity - 1);
+    if (!map->ids[slot])
+    {
+        map->ids[slot] = id;
+        map->count++;
+    }
+    map->values[slot] = value;
+    return 1;
+}
+
+int idMapGet(const IdMap *map, int id, uintptr_t *value)
+{
+    if (!map->capacity || id <= 0)
+        return 0;
+    for (size_t slot = slotOf(map, id); map->ids[slot]; slot = (slot + 1) & (map->capacity - 1))
+    {
+        if (map->ids[slot] == id)
+        {
+            *value = map->values[slot];
+            return 1;
+        }
+    }
+    return 0;
+}
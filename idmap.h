@@ -0,0 +1,27 @@
+// File: idmap.h
+// Description: Hash map from a record id to one value the caller keeps for it (a row
+// position or a pointer), with open addressing. For runs of lookups by id that would
+// otherwise scan a whole table each time, such as replaying the journal.
+
+#ifndef IDMAP_H
+#define IDMAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct
+{
+    int *ids; // 0 marks an empty slot; record ids start at 1
+    uintptr_t *values;
+    size_t capacity;
+    size_t count;
+} IdMap;
+
+void idMapInit(IdMap *map);
+void idMapFree(IdMap *map);
+// Adds 'id' or replaces its value. Returns 0 if out of memory or the id is not positive.
+int idMapPut(IdMap *map, int id, uintptr_t value);
+// Returns 1 and fills *value if 'id' is in the map.
+int idMapGet(const IdMap *map, int id, uintptr_t *value);
+
+#endif // IDMAP_H
@@ -1,42 +1,66 @@
 #include "invoice.h"
+#include "snapshot.h"
+#include "asyncio.h"
+#include "journal.h"
+#include "dirty.h"
+#include "idalloc.h"
 #include "utils.h"
+#include "invoiceview.h"
+#include "partition.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <pthread.h>
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
 
-static void ensureCsvWithHeader(const char *path, const char *headerLine)
-{
-    FILE *r = fopen(path, "r");
-    if (r)
-    {
-        fclose(r);
-        return;
-    }
-    FILE *w = fopen(path, "w");
-    if (!w)
-    {
-        printf("Error: could not create %s\n", path);
-        return;
-    }
-    fputs(headerLine, w);
-    fputc('\n', w);
-    fclose(w);
-}
-
-#define INVOICE_FILE "data/invoices.csv"
+// Invoices with older versions, trimmed once no snapshot needs them.
+#define INVOICE_VERSION_SWEEP 1024
+
+static pthread_mutex_t versionLock = PTHREAD_MUTEX_INITIALIZER;
+static Invoice **versioned;
+static size_t versionedCount;
+static size_t versionedCapacity;
+static size_t sweepAt = INVOICE_VERSION_SWEEP;
+
+// Saved in month partitions by creation time (see partition.h).
+#define INVOICE_DIR "data/invoices"
+#define INVOICE_HEADER "id,customerId,rentalId,driverId,subtotal,discountAmount,taxAmount,totalAmount,status,paymentMethod,paymentReference,promoCode,createdAt"
+// Where every invoice was kept before the partitions; read once if there is no
+// partition manifest yet.
+#define LEGACY_INVOICE_FILE "data/invoices.csv"
 #define RECEIPTS_DIR "receipts"
 
+// The statistics follow every invoice linked in or paid, from any thread, under
+// partitionLock. Saves only read them.
+static PartitionSet invoiceParts = {INVOICE_DIR, INVOICE_HEADER, NULL, 0, 0};
+static pthread_mutex_t partitionLock = PTHREAD_MUTEX_INITIALIZER;
+
 static void ensureReceiptsDirectoryExists()
 {
 #ifdef _WIN32
     system("if not exist receipts mkdir receipts");
 #else
-    system("mkdir -p receipts");
+    // Called for every receipt, so no shell: EEXIST is the usual outcome.
+    mkdir(RECEIPTS_DIR, 0755);
 #endif
 }
 
-static const char *paymentMethodStr(PaymentMethod method)
+// Same layout as ctime(), but reentrant: "Wed Jun 30 21:49:08 1993\n".
+static void formatInvoiceDate(time_t t, char *buf, size_t size)
+{
+    struct tm tmv;
+    if (!localTimeSafe(t, &tmv))
+    {
+        snprintf(buf, size, "Unknown\n");
+        return;
+    }
+    strftime(buf, size, "%a %b %d %H:%M:%S %Y\n", &tmv);
+}
+
+const char *paymentMethodStr(PaymentMethod method)
 {
     switch (method)
     {
@@ -53,7 +77,7 @@ static const char *paymentMethodStr(PaymentMethod method)
     }
 }
 
-static const char *invoiceStatusStr(InvoiceStatus status)
+const char *invoiceStatusStr(InvoiceStatus status)
 {
     switch (status)
     {
@@ -70,21 +94,22 @@ static const char *invoiceStatusStr(InvoiceStatus status)
     }
 }
 
-Invoice *createInvoice(int rentalId, int customerId, int driverId, float subtotal,
-                       float discountAmount, const char *promoCode)
+Invoice *createInvoice(int rentalId, int customerId, int driverId, Money subtotal,
+                       Money discountAmount, const char *promoCode)
 {
     Invoice *inv = (Invoice *)malloc(sizeof(Invoice));
     if (!inv)
         return NULL;
 
-    static int nextId = 6001;
-    inv->id = nextId++;
+    inv->mvcc.beginTs = MVCC_UNCOMMITTED;
+    inv->mvcc.older = NULL;
+    inv->id = allocateId(ID_INVOICE);
     inv->rentalId = rentalId;
     inv->customerId = customerId;
     inv->driverId = driverId;
     inv->subtotal = subtotal;
     inv->discountAmount = discountAmount;
-    inv->taxAmount = subtotal * 0.15;
+    inv->taxAmount = moneyApplyBasisPoints(subtotal, TAX_RATE_BPS);
     inv->totalAmount = subtotal - discountAmount + inv->taxAmount;
     inv->paymentMethod = PAYMENT_CASH;
     inv->status = INVOICE_PENDING;
@@ -93,6 +118,7 @@ Invoice *createInvoice(int rentalId, int customerId, int driverId, float subtota
     inv->paymentReference[0] = '\0';
     inv->createdAt = time(NULL);
     inv->paidAt = 0;
+    inv->saveEpoch = dirtyEpoch(DIRTY_INVOICES);
     inv->next = NULL;
 
     return inv;
@@ -100,30 +126,65 @@ Invoice *createInvoice(int rentalId, int customerId, int driverId, float subtota
 
 static Invoice *parseInvoiceCSV(const char *line)
 {
+    char buf[512];
+    strncpy(buf, line, sizeof(buf) - 1);
+    buf[sizeof(buf) - 1] = '\0';
+
+    // Split by hand: paymentReference and promoCode are usually empty, which sscanf's %[^,] rejects.
+    char *fields[13];
+    if (splitCsvLine(buf, fields, 13) < 13)
+        return NULL;
+
     Invoice *inv = (Invoice *)malloc(sizeof(Invoice));
     if (!inv)
         return NULL;
 
-    int result = sscanf(line, "%d,%d,%d,%d,%f,%f,%f,%f,%d,%d,%[^,],%[^,],%ld",
-                        &inv->id, &inv->customerId, &inv->rentalId, &inv->driverId,
-                        &inv->subtotal, &inv->discountAmount, &inv->taxAmount, &inv->totalAmount,
-                        (int*)&inv->status, (int*)&inv->paymentMethod, inv->paymentReference, inv->promoCode, (long*)&inv->createdAt);
-
-    if (result < 13)
+    inv->mvcc.beginTs = 0;
+    inv->mvcc.older = NULL;
+    inv->id = atoi(fields[0]);
+    inv->customerId = atoi(fields[1]);
+    inv->rentalId = atoi(fields[2]);
+    inv->driverId = atoi(fields[3]);
+    if (!parseMoney(fields[4], &inv->subtotal) || !parseMoney(fields[5], &inv->discountAmount) ||
+        !parseMoney(fields[6], &inv->taxAmount) || !parseMoney(fields[7], &inv->totalAmount))
     {
         free(inv);
         return NULL;
     }
-
+    inv->status = (InvoiceStatus)atoi(fields[8]);
+    inv->paymentMethod = (PaymentMethod)atoi(fields[9]);
+    strncpy(inv->paymentReference, fields[10], sizeof(inv->paymentReference) - 1);
+    inv->paymentReference[sizeof(inv->paymentReference) - 1] = '\0';
+    strncpy(inv->promoCode, fields[11], sizeof(inv->promoCode) - 1);
+    inv->promoCode[sizeof(inv->promoCode) - 1] = '\0';
+    inv->createdAt = (time_t)atol(fields[12]);
+    inv->paidAt = 0;
+    inv->saveEpoch = dirtyEpoch(DIRTY_INVOICES);
     inv->next = NULL;
     return inv;
 }
 
+// Invoices added since the last save are appended with their latest contents, so
+// only a change to one that is already saved forces its month to be rewritten.
+static void markInvoiceChanged(const Invoice *invoice)
+{
+    if (invoice->saveEpoch == dirtyEpoch(DIRTY_INVOICES))
+        return;
+    int month = partitionMonthOf(invoice->createdAt);
+    if (month)
+        markPartDirty(DIRTY_INVOICES, month);
+    else
+        markDirty(DIRTY_INVOICES);
+}
+
+static void countPending(const Invoice *inv, long change);
+
 void updateInvoiceStatus(Invoice *invoice, InvoiceStatus status, PaymentMethod method, const char *paymentRef)
 {
     if (!invoice)
         return;
 
+    countPending(invoice, (status == INVOICE_PENDING) - (invoice->status == INVOICE_PENDING));
     invoice->status = status;
     invoice->paymentMethod = method;
     if (paymentRef)
@@ -136,6 +197,7 @@ void updateInvoiceStatus(Invoice *invoice, InvoiceStatus status, PaymentMethod m
     {
         invoice->paidAt = time(NULL);
     }
+    markInvoiceChanged(invoice);
 }
 
 Invoice *findInvoiceById(Invoice *head, int invoiceId)
@@ -168,8 +230,10 @@ void generateReceipt(Invoice *invoice, const char *customerName, const char *veh
     printf("================================================================\n");
     printf("                    RIDEMATE - RECEIPT                         \n");
     printf("================================================================\n");
+    char dateStr[64];
+    formatInvoiceDate(invoice->createdAt, dateStr, sizeof(dateStr));
     printf("Invoice ID: %d\n", invoice->id);
-    printf("Date: %s", ctime(&invoice->createdAt));
+    printf("Date: %s", dateStr);
     printf("================================================================\n");
     printf("CUSTOMER INFORMATION\n");
     printf("Name: %s\n", customerName);
@@ -184,14 +248,14 @@ void generateReceipt(Invoice *invoice, const char *customerName, const char *veh
     }
     printf("================================================================\n");
     printf("PAYMENT BREAKDOWN\n");
-    printf("Subtotal: $%.2f\n", invoice->subtotal);
+    printf("Subtotal: $" MONEY_FMT "\n", MONEY_ARGS(invoice->subtotal));
     if (invoice->discountAmount > 0)
     {
-        printf("Discount (%s): -$%.2f\n", invoice->promoCode, invoice->discountAmount);
+        printf("Discount (%s): -$" MONEY_FMT "\n", invoice->promoCode, MONEY_ARGS(invoice->discountAmount));
     }
-    printf("Tax (15%%): $%.2f\n", invoice->taxAmount);
+    printf("Tax (15%%): $" MONEY_FMT "\n", MONEY_ARGS(invoice->taxAmount));
     printf("----------------------------------------------------------------\n");
-    printf("TOTAL: $%.2f\n", invoice->totalAmount);
+    printf("TOTAL: $" MONEY_FMT "\n", MONEY_ARGS(invoice->totalAmount));
     printf("================================================================\n");
     printf("PAYMENT INFORMATION\n");
     printf("Status: %s\n", invoiceStatusStr(invoice->status));
@@ -216,7 +280,8 @@ void saveReceiptToFile(Invoice *invoice, const char *customerName, const char *v
     char filename[256];
     snprintf(filename, sizeof(filename), "%s/receipt_%d.txt", RECEIPTS_DIR, invoice->id);
 
-    FILE *f = fopen(filename, "w");
+    AsyncFile out;
+    FILE *f = asyncFileOpen(&out, filename);
     if (!f)
     {
         printf("Error: Could not create receipt file.\n");
@@ -226,8 +291,10 @@ void saveReceiptToFile(Invoice *invoice, const char *customerName, const char *v
     fprintf(f, "================================================================\n");
     fprintf(f, "                    RIDEMATE - RECEIPT                          \n");
     fprintf(f, "================================================================\n");
+    char dateStr[64];
+    formatInvoiceDate(invoice->createdAt, dateStr, sizeof(dateStr));
     fprintf(f, "Invoice ID: %d\n", invoice->id);
-    fprintf(f, "Date: %s", ctime(&invoice->createdAt));
+    fprintf(f, "Date: %s", dateStr);
     fprintf(f, "================================================================\n");
     fprintf(f, "CUSTOMER INFORMATION\n");
     fprintf(f, "Name: %s\n", customerName);
@@ -242,14 +309,14 @@ void saveReceiptToFile(Invoice *invoice, const char *customerName, const char *v
     }
     fprintf(f, "================================================================\n");
     fprintf(f, "PAYMENT BREAKDOWN\n");
-    fprintf(f, "Subtotal: $%.2f\n", invoice->subtotal);
+    fprintf(f, "Subtotal: $" MONEY_FMT "\n", MONEY_ARGS(invoice->subtotal));
     if (invoice->discountAmount > 0)
     {
-        fprintf(f, "Discount (%s): -$%.2f\n", invoice->promoCode, invoice->discountAmount);
+        fprintf(f, "Discount (%s): -$" MONEY_FMT "\n", invoice->promoCode, MONEY_ARGS(invoice->discountAmount));
     }
-    fprintf(f, "Tax (15%%): $%.2f\n", invoice->taxAmount);
+    fprintf(f, "Tax (15%%): $" MONEY_FMT "\n", MONEY_ARGS(invoice->taxAmount));
     fprintf(f, "----------------------------------------------------------------\n");
-    fprintf(f, "TOTAL: $%.2f\n", invoice->totalAmount);
+    fprintf(f, "TOTAL: $" MONEY_FMT "\n", MONEY_ARGS(invoice->totalAmount));
     fprintf(f, "================================================================\n");
     fprintf(f, "PAYMENT INFORMATION\n");
     fprintf(f, "Status: %s\n", invoiceStatusStr(invoice->status));
@@ -260,19 +327,53 @@ void saveReceiptToFile(Invoice *invoice, const char *customerName, const char *v
     }
     fprintf(f, "\nThank you for choosing RideMate!\n");
 
-    fclose(f);
+    asyncFileClose(&out);
     printf("\nReceipt saved to: %s\n", filename);
 }
 
-void loadInvoices(Invoice **head)
+// One invoices.csv line, without the newline.
+static void formatInvoiceRow(const Invoice *inv, char *buf, size_t size)
 {
-    ensureCsvWithHeader(INVOICE_FILE, "id,customerId,rentalId,driverId,subtotal,discountAmount,taxAmount,totalAmount,status,paymentMethod,paymentReference,promoCode,createdAt\n");
-    FILE *f = fopen(INVOICE_FILE, "r");
-    if (!f)
-    {
-        *head = NULL;
-        return;
-    }
+    snprintf(buf, size, "%d,%d,%d,%d," MONEY_FMT "," MONEY_FMT "," MONEY_FMT "," MONEY_FMT ",%d,%d,%s,%s,%ld",
+             inv->id, inv->customerId, inv->rentalId, inv->driverId,
+             MONEY_ARGS(inv->subtotal), MONEY_ARGS(inv->discountAmount), MONEY_ARGS(inv->taxAmount), MONEY_ARGS(inv->totalAmount),
+             (int)inv->status, (int)inv->paymentMethod, inv->paymentReference, inv->promoCode, (long)inv->createdAt);
+}
+
+// Counts an invoice in its month's statistics. 'cache' (may be NULL) speeds up runs.
+static void countInvoice(const Invoice *inv, MonthCache *cache)
+{
+    int month = cache ? partitionMonthCached(cache, inv->createdAt) : partitionMonthOf(inv->createdAt);
+    pthread_mutex_lock(&partitionLock);
+    Partition *p = partitionFor(&invoiceParts, month);
+    if (p)
+        partitionCountRow(p, (int64_t)inv->createdAt, inv->status == INVOICE_PENDING, 0);
+    pthread_mutex_unlock(&partitionLock);
+}
+
+// One fewer (or one more) pending invoice in the invoice's month.
+static void countPending(const Invoice *inv, long change)
+{
+    pthread_mutex_lock(&partitionLock);
+    Partition *p = findPartition(&invoiceParts, partitionMonthOf(inv->createdAt));
+    if (p)
+        p->open += change;
+    pthread_mutex_unlock(&partitionLock);
+}
+
+void linkNewInvoice(Invoice **head, Invoice *invoice)
+{
+    invoice->next = __atomic_load_n(head, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(head, &invoice->next, invoice, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+        ;
+    markAdded(DIRTY_INVOICES);
+    countInvoice(invoice, NULL);
+}
+
+// Links in the invoices of one file.
+static void readInvoiceFile(Invoice **head, FILE *f)
+{
+    MonthCache cache = {0};
     char line[512];
     fgets(line, sizeof(line), f);
     while (fgets(line, sizeof(line), f))
@@ -283,28 +384,189 @@ void loadInvoices(Invoice **head)
         {
             inv->next = *head;
             *head = inv;
+            observeId(ID_INVOICE, inv->id);
+            countInvoice(inv, &cache);
         }
     }
-    fclose(f);
 }
 
-void saveInvoices(Invoice *head)
+void loadInvoices(Invoice **head)
 {
-    FILE *f = fopen(INVOICE_FILE, "w");
-    if (!f)
+    if (!loadPartitionManifest(&invoiceParts))
     {
-        printf("Error: could not open %s\n", INVOICE_FILE);
+        // Not split into months yet. The list stays dirty, so the first save writes
+        // the partitions.
+        FILE *f = openDataFile(LEGACY_INVOICE_FILE);
+        if (f)
+        {
+            readInvoiceFile(head, f);
+            fclose(f);
+        }
         return;
     }
-    fprintf(f, "id,customerId,rentalId,driverId,subtotal,discountAmount,taxAmount,totalAmount,status,paymentMethod,paymentReference,promoCode,createdAt\n");
-    for (Invoice *inv = head; inv; inv = inv->next)
+    for (int i = 0; i < invoiceParts.count; i++)
+    {
+        Partition *p = &invoiceParts.parts[i];
+        if (!partitionWanted(p))
+            continue;
+        int month = p->month;
+        char path[256];
+        partitionPath(&invoiceParts, month, path, sizeof(path));
+        partitionResetStats(p); // Counted again as the invoices are read
+        p->loaded = 1;
+        FILE *f = openDataFile(path);
+        if (f)
+        {
+            readInvoiceFile(head, f);
+            fclose(f);
+        }
+        // An invoice filed under another month may have added a partition before this one.
+        i = (int)(findPartition(&invoiceParts, month) - invoiceParts.parts);
+    }
+    markClean(DIRTY_INVOICES);
+}
+
+// Writes the invoices of one month, order[0 .. count - 1]: the whole file if
+// 'rewrite', otherwise appended. Returns the bytes written, or -1.
+static long saveInvoicePartition(int month, Invoice **order, size_t count, int rewrite)
+{
+    char path[256];
+    partitionPath(&invoiceParts, month, path, sizeof(path));
+    AsyncFile out;
+    FILE *f = rewrite ? asyncFileOpen(&out, path) : asyncFileAppend(&out, path);
+    if (!f)
+    {
+        // Appending fails if the file is gone or was cut off; the next save rewrites the month.
+        printf("Error: could not open %s\n", path);
+        return -1;
+    }
+    if (rewrite)
+        fprintf(f, "%s\n", invoiceParts.header);
+    for (size_t i = 0; i < count; i++)
     {
-        fprintf(f, "%d,%d,%d,%d,%.2f,%.2f,%.2f,%.2f,%d,%d,%s,%s,%ld\n",
-                inv->id, inv->customerId, inv->rentalId, inv->driverId,
-                inv->subtotal, inv->discountAmount, inv->taxAmount, inv->totalAmount,
-                (int)inv->status, (int)inv->paymentMethod, inv->paymentReference, inv->promoCode, (long)inv->createdAt);
+        char row[512];
+        formatInvoiceRow(order[i], row, sizeof(row));
+        fputs(row, f);
+        fputc('\n', f);
     }
-    fclose(f);
+    long result = asyncFileClose(&out);
+    return result < 0 ? -1 : (long)out.length;
+}
+
+void saveInvoices(Invoice *head)
+{
+    waitBackgroundSave();
+    size_t added;
+    int changed[DIRTY_MAX_PARTS], changedCount;
+    SaveMode mode = beginPartitionedSave(DIRTY_INVOICES, &added, changed, &changedCount);
+    if (mode == SAVE_SKIP)
+        return;
+    ensurePartitionDir(&invoiceParts);
+    int parts = invoiceParts.count;
+    char *rewrite = (char *)calloc((size_t)parts + 1, 1);
+    size_t *starts = (size_t *)calloc((size_t)parts + 2, sizeof(size_t));
+    size_t listed = 0;
+    for (Invoice *inv = head; inv; inv = inv->next)
+        listed++;
+    Invoice **nodes = (Invoice **)malloc((listed + 1) * sizeof(Invoice *));
+    int *slots = (int *)malloc((listed + 1) * sizeof(int));
+    Invoice **order = (Invoice **)malloc((listed + 1) * sizeof(Invoice *));
+    long bytes = rewrite && starts && nodes && slots && order ? 0 : -1;
+    if (bytes < 0)
+        printf("Error: not enough memory to save the invoices\n");
+
+    // The invoices to write: all of each month being rewritten, and the new ones
+    // (linked in at the head, so the first 'added') of the others.
+    for (int i = 0; bytes >= 0 && i < parts; i++)
+    {
+        const Partition *p = &invoiceParts.parts[i];
+        rewrite[i] = p->loaded && (mode == SAVE_REWRITE || (mode == SAVE_PARTIAL && partitionListed(changed, changedCount, p->month)));
+    }
+    size_t count = 0, position = 0;
+    MonthCache cache = {0};
+    for (Invoice *inv = head; bytes >= 0 && inv && (mode != SAVE_APPEND || position < added); inv = inv->next, position++)
+    {
+        Partition *p = findPartition(&invoiceParts, partitionMonthCached(&cache, inv->createdAt));
+        int slot = p ? (int)(p - invoiceParts.parts) : -1;
+        if (slot < 0 || (!rewrite[slot] && position >= added))
+            continue;
+        nodes[count] = inv;
+        slots[count++] = slot;
+        starts[slot + 2]++;
+    }
+    // Grouped by month, keeping list order within each.
+    for (int i = 0; bytes >= 0 && i < parts; i++)
+        starts[i + 2] += starts[i + 1];
+    for (size_t i = 0; bytes >= 0 && i < count; i++)
+        order[starts[slots[i] + 1]++] = nodes[i];
+    for (int i = 0; bytes >= 0 && i < parts; i++)
+    {
+        size_t first = starts[i], last = starts[i + 1];
+        if (!rewrite[i] && first == last)
+            continue;
+        long written = saveInvoicePartition(invoiceParts.parts[i].month, order + first, last - first, rewrite[i]);
+        bytes = written < 0 ? -1 : bytes + written;
+    }
+    free(rewrite);
+    free(starts);
+    free(nodes);
+    free(slots);
+    free(order);
+
+    if (bytes >= 0 && !savePartitionManifest(&invoiceParts))
+        bytes = -1;
+    if (bytes >= 0)
+        retireLegacyFile(&invoiceParts, LEGACY_INVOICE_FILE);
+    endTableSave(DIRTY_INVOICES, mode, bytes);
+}
+
+void journalInvoice(const Invoice *invoice)
+{
+    if (!journalEnabled())
+        return;
+    char row[512];
+    formatInvoiceRow(invoice, row, sizeof(row));
+    journalAppend(JOURNAL_INVOICE, row);
+}
+
+int applyJournaledInvoice(Invoice **head, const char *row, IdMap *index)
+{
+    Invoice *parsed = parseInvoiceCSV(row);
+    if (!parsed)
+        return 0;
+    Invoice *inv = NULL;
+    if (index)
+    {
+        if (index->count == 0)
+        {
+            for (Invoice *i = *head; i; i = i->next)
+                idMapPut(index, i->id, (uintptr_t)i);
+        }
+        uintptr_t found;
+        if (idMapGet(index, parsed->id, &found))
+            inv = (Invoice *)found;
+    }
+    else
+    {
+        for (inv = *head; inv && inv->id != parsed->id; inv = inv->next)
+            ;
+    }
+    if (inv)
+    {
+        countPending(inv, (parsed->status == INVOICE_PENDING) - (inv->status == INVOICE_PENDING));
+        parsed->next = inv->next;
+        parsed->mvcc = inv->mvcc;
+        parsed->saveEpoch = inv->saveEpoch;
+        *inv = *parsed;
+        free(parsed);
+        markInvoiceChanged(inv);
+        return 1;
+    }
+    linkNewInvoice(head, parsed);
+    if (index)
+        idMapPut(index, parsed->id, (uintptr_t)parsed);
+    observeId(ID_INVOICE, parsed->id);
+    return 1;
 }
 
 void displayInvoice(const Invoice *invoice)
@@ -317,17 +579,19 @@ void displayInvoice(const Invoice *invoice)
     printf("Customer ID: %d\n", invoice->customerId);
     printf("Rental ID: %d\n", invoice->rentalId);
     printf("Driver ID: %d\n", invoice->driverId);
-    printf("Subtotal: $%.2f\n", invoice->subtotal);
-    printf("Discount: $%.2f\n", invoice->discountAmount);
-    printf("Tax: $%.2f\n", invoice->taxAmount);
-    printf("Total: $%.2f\n", invoice->totalAmount);
+    printf("Subtotal: $" MONEY_FMT "\n", MONEY_ARGS(invoice->subtotal));
+    printf("Discount: $" MONEY_FMT "\n", MONEY_ARGS(invoice->discountAmount));
+    printf("Tax: $" MONEY_FMT "\n", MONEY_ARGS(invoice->taxAmount));
+    printf("Total: $" MONEY_FMT "\n", MONEY_ARGS(invoice->totalAmount));
     printf("Status: %s\n", invoiceStatusStr(invoice->status));
     printf("Payment Method: %s\n", paymentMethodStr(invoice->paymentMethod));
     if (invoice->promoCode[0])
         printf("Promo Code: %s\n", invoice->promoCode);
     if (invoice->paymentReference[0])
         printf("Payment Reference: %s\n", invoice->paymentReference);
-    printf("Created: %s", ctime(&invoice->createdAt));
+    char dateStr[64];
+    formatInvoiceDate(invoice->createdAt, dateStr, sizeof(dateStr));
+    printf("Created: %s", dateStr);
 }
 
 void listAllInvoices(Invoice *head)
@@ -344,9 +608,12 @@ void listAllInvoices(Invoice *head)
 
     for (Invoice *inv = head; inv; inv = inv->next)
     {
-        printf("%-8d %-8d %-8d %-8d $%-9.2f $%-9.2f %-8s\n",
+        char subtotal[MONEY_STR_SIZE], total[MONEY_STR_SIZE];
+        formatMoney(inv->subtotal, subtotal, sizeof(subtotal));
+        formatMoney(inv->totalAmount, total, sizeof(total));
+        printf("%-8d %-8d %-8d %-8d $%-9s $%-9s %-8s\n",
                inv->id, inv->customerId, inv->rentalId, inv->driverId,
-               inv->subtotal, inv->totalAmount, invoiceStatusStr(inv->status));
+               subtotal, total, invoiceStatusStr(inv->status));
     }
 }
 
@@ -367,9 +634,12 @@ void listInvoicesByCustomer(Invoice *head, int customerId)
     {
         if (inv->customerId == customerId)
         {
-            printf("%-8d %-8d %-8d $%-9.2f $%-9.2f %-8s\n",
+            char subtotal[MONEY_STR_SIZE], total[MONEY_STR_SIZE];
+            formatMoney(inv->subtotal, subtotal, sizeof(subtotal));
+            formatMoney(inv->totalAmount, total, sizeof(total));
+            printf("%-8d %-8d %-8d $%-9s $%-9s %-8s\n",
                    inv->id, inv->rentalId, inv->driverId,
-                   inv->subtotal, inv->totalAmount, invoiceStatusStr(inv->status));
+                   subtotal, total, invoiceStatusStr(inv->status));
             found = 1;
         }
     }
@@ -395,9 +665,12 @@ void listInvoicesByStatus(Invoice *head, InvoiceStatus status)
     {
         if (inv->status == status)
         {
-            printf("%-8d %-8d %-8d %-8d $%-9.2f $%-9.2f\n",
+            char subtotal[MONEY_STR_SIZE], total[MONEY_STR_SIZE];
+            formatMoney(inv->subtotal, subtotal, sizeof(subtotal));
+            formatMoney(inv->totalAmount, total, sizeof(total));
+            printf("%-8d %-8d %-8d %-8d $%-9s $%-9s\n",
                    inv->id, inv->customerId, inv->rentalId, inv->driverId,
-                   inv->subtotal, inv->totalAmount);
+                   subtotal, total);
             found = 1;
         }
     }
@@ -406,35 +679,78 @@ void listInvoicesByStatus(Invoice *head, InvoiceStatus status)
         printf("No invoices found with status %s.\n", invoiceStatusStr(status));
 }
 
-int processPayment(Invoice *invoice, PaymentMethod method, const char *paymentRef)
+// versionLock held.
+static void trimLockedVersions(void)
 {
-    if (!invoice)
-        return 0;
-
-    if (invoice->status == INVOICE_PAID)
+    uint64_t oldest = mvccOldestSnapshot();
+    size_t kept = 0;
+    for (size_t i = 0; i < versionedCount; i++)
     {
-        printf("Invoice is already paid.\n");
-        return 0;
+        if (!mvccTrim(&versioned[i]->mvcc, oldest))
+            versioned[kept++] = versioned[i];
     }
+    versionedCount = kept;
+    sweepAt = kept * 2 > INVOICE_VERSION_SWEEP ? kept * 2 : INVOICE_VERSION_SWEEP;
+}
 
-    updateInvoiceStatus(invoice, INVOICE_PAID, method, paymentRef);
-    printf("Payment processed successfully!\n");
-    return 1;
+void trimInvoiceVersions(void)
+{
+    pthread_mutex_lock(&versionLock);
+    trimLockedVersions();
+    pthread_mutex_unlock(&versionLock);
 }
 
-void refundInvoice(Invoice *invoice, const char *reason)
+static void noteVersionedInvoice(Invoice *invoice)
 {
-    if (!invoice)
-        return;
+    pthread_mutex_lock(&versionLock);
+    if (versionedCount == versionedCapacity)
+    {
+        size_t capacity = versionedCapacity ? versionedCapacity * 2 : 256;
+        Invoice **grown = (Invoice **)realloc(versioned, capacity * sizeof(Invoice *));
+        if (grown)
+        {
+            versioned = grown;
+            versionedCapacity = capacity;
+        }
+    }
+    // Without room the versions are kept until the list is freed.
+    if (versionedCount < versionedCapacity)
+        versioned[versionedCount++] = invoice;
+    if (versionedCount >= sweepAt)
+        trimLockedVersions();
+    pthread_mutex_unlock(&versionLock);
+}
 
-    if (invoice->status != INVOICE_PAID)
+// Moves an invoice from 'from' to 'to' as one committed change, keeping the previous
+// version for open snapshots. Fails if the invoice is not in state 'from'.
+static int changeInvoiceStatus(Invoice *invoice, InvoiceStatus from, InvoiceStatus to,
+                               PaymentMethod method, const char *paymentRef)
+{
+    if (!invoice || invoice->status != from)
+        return 0;
+
+    uint64_t previousTs = mvccClaim(&invoice->mvcc);
+    if (invoice->status != from || !mvccPreserve(&invoice->mvcc, sizeof(Invoice), previousTs))
     {
-        printf("Invoice is not paid, cannot refund.\n");
-        return;
+        mvccRelease(&invoice->mvcc, previousTs);
+        return 0;
     }
+    updateInvoiceStatus(invoice, to, method, paymentRef);
+    journalInvoice(invoice);
+    MvccHeader *record = &invoice->mvcc;
+    mvccCommit(&record, 1);
+    noteVersionedInvoice(invoice);
+    return 1;
+}
+
+int processPayment(Invoice *invoice, PaymentMethod method, const char *paymentRef)
+{
+    return changeInvoiceStatus(invoice, INVOICE_PENDING, INVOICE_PAID, method, paymentRef);
+}
 
-    updateInvoiceStatus(invoice, INVOICE_REFUNDED, PAYMENT_CASH, "");
-    printf("Invoice refunded successfully. Reason: %s\n", reason ? reason : "No reason provided");
+int refundInvoice(Invoice *invoice)
+{
+    return changeInvoiceStatus(invoice, INVOICE_PAID, INVOICE_REFUNDED, PAYMENT_CASH, "");
 }
 
 void showInvoiceStatistics(Invoice *head)
@@ -445,38 +761,32 @@ void showInvoiceStatistics(Invoice *head)
         return;
     }
 
-    int total = 0, pending = 0, paid = 0, cancelled = 0, refunded = 0;
-    float totalRevenue = 0.0, totalDiscounts = 0.0;
-
-    for (Invoice *inv = head; inv; inv = inv->next)
+    InvoiceColumns cols;
+    if (!buildInvoiceColumns(head, &cols))
     {
-        total++;
-        totalRevenue += inv->totalAmount;
-        totalDiscounts += inv->discountAmount;
-
-        switch (inv->status)
-        {
-        case INVOICE_PENDING:
-            pending++;
-            break;
-        case INVOICE_PAID:
-            paid++;
-            break;
-        case INVOICE_CANCELLED:
-            cancelled++;
-            break;
-        case INVOICE_REFUNDED:
-            refunded++;
-            break;
-        }
+        printf("Error: not enough memory to compute statistics.\n");
+        return;
     }
+    InvoiceCube cube;
+    invoiceCubeCompute(&cols, &cube);
+
+    long total = (long)cols.count;
+    long byStatus[INVOICE_STATUS_COUNT] = {0};
+    for (int s = 0; s < INVOICE_STATUS_COUNT; s++)
+        for (int m = 0; m < PAYMENT_METHOD_COUNT; m++)
+            byStatus[s] += cube.count[s][m];
+    Money totalRevenue = invoiceColumnSum(cols.totalAmount, 0, cols.count);
+    Money totalDiscounts = invoiceColumnSum(cols.discountAmount, 0, cols.count);
+    freeInvoiceColumns(&cols);
 
     printf("\n--- Invoice Statistics ---\n");
-    printf("Total Invoices: %d\n", total);
-    printf("Pending: %d | Paid: %d | Cancelled: %d | Refunded: %d\n", pending, paid, cancelled, refunded);
-    printf("Total Revenue: $%.2f\n", totalRevenue);
-    printf("Total Discounts Given: $%.2f\n", totalDiscounts);
-    printf("Average Invoice Value: $%.2f\n", total > 0 ? totalRevenue / total : 0.0);
+    printf("Total Invoices: %ld\n", total);
+    printf("Pending: %ld | Paid: %ld | Cancelled: %ld | Refunded: %ld\n",
+           byStatus[INVOICE_PENDING], byStatus[INVOICE_PAID], byStatus[INVOICE_CANCELLED], byStatus[INVOICE_REFUNDED]);
+    printf("Total Revenue: $" MONEY_FMT "\n", MONEY_ARGS(totalRevenue));
+    printf("Total Discounts Given: $" MONEY_FMT "\n", MONEY_ARGS(totalDiscounts));
+    Money average = total > 0 ? (totalRevenue + total / 2) / total : 0;
+    printf("Average Invoice Value: $" MONEY_FMT "\n", MONEY_ARGS(average));
 }
 
 void showPaymentMethodStats(Invoice *head)
@@ -487,39 +797,28 @@ void showPaymentMethodStats(Invoice *head)
         return;
     }
 
-    int cash = 0, card = 0, mobile = 0;
-    float cashTotal = 0.0, cardTotal = 0.0, mobileTotal = 0.0;
-
-    for (Invoice *inv = head; inv; inv = inv->next)
+    InvoiceColumns cols;
+    if (!buildInvoiceColumns(head, &cols))
     {
-        if (inv->status == INVOICE_PAID)
-        {
-            switch (inv->paymentMethod)
-            {
-            case PAYMENT_CASH:
-                cash++;
-                cashTotal += inv->totalAmount;
-                break;
-            case PAYMENT_CARD:
-                card++;
-                cardTotal += inv->totalAmount;
-                break;
-            case PAYMENT_MOBILE_BANKING:
-                mobile++;
-                mobileTotal += inv->totalAmount;
-                break;
-            case PAYMENT_CRYPTO:
-                mobile++;
-                mobileTotal += inv->totalAmount;
-                break;
-            }
-        }
+        printf("Error: not enough memory to compute statistics.\n");
+        return;
     }
+    InvoiceCube cube;
+    invoiceCubeCompute(&cols, &cube);
+    freeInvoiceColumns(&cols);
+
+    // Only paid invoices count towards payment method totals; crypto is grouped with mobile.
+    long cash = cube.count[INVOICE_PAID][PAYMENT_CASH];
+    long card = cube.count[INVOICE_PAID][PAYMENT_CARD];
+    long mobile = cube.count[INVOICE_PAID][PAYMENT_MOBILE_BANKING] + cube.count[INVOICE_PAID][PAYMENT_CRYPTO];
+    Money cashTotal = cube.totalAmount[INVOICE_PAID][PAYMENT_CASH];
+    Money cardTotal = cube.totalAmount[INVOICE_PAID][PAYMENT_CARD];
+    Money mobileTotal = cube.totalAmount[INVOICE_PAID][PAYMENT_MOBILE_BANKING] + cube.totalAmount[INVOICE_PAID][PAYMENT_CRYPTO];
 
     printf("\n--- Payment Method Statistics ---\n");
-    printf("Cash Payments: %d (Total: $%.2f)\n", cash, cashTotal);
-    printf("Card Payments: %d (Total: $%.2f)\n", card, cardTotal);
-    printf("Mobile Payments: %d (Total: $%.2f)\n", mobile, mobileTotal);
+    printf("Cash Payments: %ld (Total: $" MONEY_FMT ")\n", cash, MONEY_ARGS(cashTotal));
+    printf("Card Payments: %ld (Total: $" MONEY_FMT ")\n", card, MONEY_ARGS(cardTotal));
+    printf("Mobile Payments: %ld (Total: $" MONEY_FMT ")\n", mobile, MONEY_ARGS(mobileTotal));
 }
 
 void freeInvoiceList(Invoice **head)
@@ -527,12 +826,18 @@ void freeInvoiceList(Invoice **head)
     Invoice *current = *head;
     Invoice *next;
 
+    pthread_mutex_lock(&versionLock);
+    versionedCount = 0;
+    pthread_mutex_unlock(&versionLock);
+
     while (current != NULL)
     {
         next = current->next;
+        mvccDropVersions(&current->mvcc);
         free(current);
         current = next;
     }
 
     *head = NULL;
+    partitionSetClear(&invoiceParts);
 }
@@ -2,6 +2,9 @@
 #define INVOICE_H
 
 #include <time.h>
+#include "money.h"
+#include "mvcc.h"
+#include "idmap.h"
 
 // --- Payment Method Enum ---
 typedef enum
@@ -24,20 +27,22 @@ typedef enum
 // --- Invoice Struct ---
 typedef struct InvoiceNode
 {
+    MvccHeader mvcc;             // Versions for report snapshots
     int id;                      // Unique invoice ID
     int rentalId;                // Associated rental ID
     int customerId;              // Customer ID
     int driverId;                // Driver ID (if assigned)
-    float subtotal;              // Original cost before discounts
-    float discountAmount;        // Discount amount applied
-    float taxAmount;             // Tax amount
-    float totalAmount;           // Final amount to pay
+    Money subtotal;              // Original cost before discounts
+    Money discountAmount;        // Discount amount applied
+    Money taxAmount;             // Tax amount
+    Money totalAmount;           // Final amount to pay
     PaymentMethod paymentMethod; // How payment was made
     InvoiceStatus status;        // Current invoice status
     char promoCode[20];          // Promo code used (if any)
     char paymentReference[50];   // Payment reference/transaction ID
     time_t createdAt;            // Invoice creation timestamp
     time_t paidAt;               // Payment timestamp
+    unsigned saveEpoch;          // dirtyEpoch(DIRTY_INVOICES) when added; newer than the file if still current
     struct InvoiceNode *next;    // Pointer to next invoice
 } Invoice;
 
@@ -46,10 +51,20 @@ typedef struct InvoiceNode
 // CSV I/O Functions
 void loadInvoices(Invoice **head);
 void saveInvoices(Invoice *head);
+// Links a new invoice in at the head of the list, from any thread, and counts it for
+// the next save.
+void linkNewInvoice(Invoice **head, Invoice *invoice);
+// Appends the invoice's current row to the journal (see journal.h).
+void journalInvoice(const Invoice *invoice);
+// Applies one journaled invoices.csv row on top of the loaded list. 'index' (may be
+// NULL) maps invoice ids to list nodes, as applyJournaledRental's does to rows.
+int applyJournaledInvoice(Invoice **head, const char *row, IdMap *index);
 
 // Invoice Management Functions
-Invoice *createInvoice(int rentalId, int customerId, int driverId, float subtotal,
-                       float discountAmount, const char *promoCode);
+// The new invoice is uncommitted: snapshots wait for it until the caller commits
+// it with mvccCommit, together with the rental it belongs to.
+Invoice *createInvoice(int rentalId, int customerId, int driverId, Money subtotal,
+                       Money discountAmount, const char *promoCode);
 void updateInvoiceStatus(Invoice *invoice, InvoiceStatus status, PaymentMethod method,
                          const char *paymentRef);
 Invoice *findInvoiceById(Invoice *head, int invoiceId);
@@ -61,15 +76,20 @@ void generateReceipt(Invoice *invoice, const char *customerName, const char *veh
 void saveReceiptToFile(Invoice *invoice, const char *customerName, const char *vehicleInfo,
                        const char *driverName);
 void displayInvoice(const Invoice *invoice);
+const char *invoiceStatusStr(InvoiceStatus status);
+const char *paymentMethodStr(PaymentMethod method);
 
 // Invoice Listings
 void listAllInvoices(Invoice *head);
 void listInvoicesByCustomer(Invoice *head, int customerId);
 void listInvoicesByStatus(Invoice *head, InvoiceStatus status);
 
-// Payment Processing
+// Payment Processing. Both return 1 on success, 0 if the invoice is missing or not
+// in the right state (only pending invoices can be paid, only paid ones refunded).
 int processPayment(Invoice *invoice, PaymentMethod method, const char *paymentRef);
-void refundInvoice(Invoice *invoice, const char *reason);
+int refundInvoice(Invoice *invoice);
+// Unlinks the payment and refund versions no open snapshot needs any more.
+void trimInvoiceVersions(void);
 
 // Invoice Statistics
 void showInvoiceStatistics(Invoice *head);
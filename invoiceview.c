@@ -0,0 +1,662 @@
+#include "invoiceview.h"
+#include "threadpool.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define INVOICEVIEW_X86 1
+#include <immintrin.h>
+#endif
+
+// Rows per group-by block; sized so the block's key and amount columns stay in L1/L2.
+#define CUBE_BLOCK_ROWS 2048
+#define CUBE_KEYS (INVOICE_STATUS_COUNT * PAYMENT_METHOD_COUNT)
+// Blocks touching more cells than this use the single-pass scatter kernel.
+#define MASKED_PASS_MAX_KEYS 2
+
+int buildInvoiceColumns(Invoice *head, InvoiceColumns *cols)
+{
+    memset(cols, 0, sizeof(*cols));
+
+    // An upper bound: invoices committed after the snapshot below are skipped.
+    size_t n = 0;
+    for (Invoice *inv = head; inv; inv = inv->next)
+        n++;
+    if (n == 0)
+        return 1;
+
+    cols->subtotal = (Money *)malloc(n * sizeof(Money));
+    cols->discountAmount = (Money *)malloc(n * sizeof(Money));
+    cols->taxAmount = (Money *)malloc(n * sizeof(Money));
+    cols->totalAmount = (Money *)malloc(n * sizeof(Money));
+    cols->status = (uint8_t *)malloc(n);
+    cols->paymentMethod = (uint8_t *)malloc(n);
+    cols->createdAt = (int64_t *)malloc(n * sizeof(int64_t));
+    cols->paidAt = (int64_t *)malloc(n * sizeof(int64_t));
+    if (!cols->subtotal || !cols->discountAmount || !cols->taxAmount || !cols->totalAmount ||
+        !cols->status || !cols->paymentMethod || !cols->createdAt || !cols->paidAt)
+    {
+        freeInvoiceColumns(cols);
+        return 0;
+    }
+
+    MvccSnapshot snap;
+    mvccBeginSnapshot(&snap);
+    size_t i = 0;
+    for (Invoice *node = head; node; node = node->next)
+    {
+        Invoice inv;
+        if (!mvccRead(&node->mvcc, sizeof(Invoice), &snap, &inv))
+            continue;
+        cols->subtotal[i] = inv.subtotal;
+        cols->discountAmount[i] = inv.discountAmount;
+        cols->taxAmount[i] = inv.taxAmount;
+        cols->totalAmount[i] = inv.totalAmount;
+        cols->status[i] = (uint8_t)inv.status;
+        cols->paymentMethod[i] = (uint8_t)inv.paymentMethod;
+        cols->createdAt[i] = (int64_t)inv.createdAt;
+        cols->paidAt[i] = (int64_t)inv.paidAt;
+        i++;
+    }
+    mvccEndSnapshot(&snap);
+    trimInvoiceVersions();
+    cols->count = i;
+    return 1;
+}
+
+void freeInvoiceColumns(InvoiceColumns *cols)
+{
+    free(cols->subtotal);
+    free(cols->discountAmount);
+    free(cols->taxAmount);
+    free(cols->totalAmount);
+    free(cols->status);
+    free(cols->paymentMethod);
+    free(cols->createdAt);
+    free(cols->paidAt);
+    memset(cols, 0, sizeof(*cols));
+}
+
+// --- Scalar kernels (reference implementation and tail handling) ---
+
+static Money sumScalar(const Money *column, size_t begin, size_t end)
+{
+    Money acc = 0;
+    for (size_t i = begin; i < end; i++)
+        acc += column[i];
+    return acc;
+}
+
+static size_t countEqualScalar(const uint8_t *column, size_t begin, size_t end, uint8_t value)
+{
+    size_t n = 0;
+    for (size_t i = begin; i < end; i++)
+        n += column[i] == value;
+    return n;
+}
+
+// Adds rows [begin, end) whose key equals 'key' into cell 'key' of the cube.
+static void cubeKeyScalar(const InvoiceColumns *cols, const int32_t *keys, size_t base,
+                          size_t begin, size_t end, int key, InvoiceCube *cube)
+{
+    int s = key / PAYMENT_METHOD_COUNT, m = key % PAYMENT_METHOD_COUNT;
+    for (size_t i = begin; i < end; i++)
+    {
+        if (keys[i - base] != key)
+            continue;
+        cube->count[s][m]++;
+        cube->subtotal[s][m] += cols->subtotal[i];
+        cube->discountAmount[s][m] += cols->discountAmount[i];
+        cube->taxAmount[s][m] += cols->taxAmount[i];
+        cube->totalAmount[s][m] += cols->totalAmount[i];
+    }
+}
+
+// Dense blocks: one pass, scattering each row into its cell.
+static void cubeBlockScalar(const InvoiceColumns *cols, const int32_t *keys, size_t base,
+                            size_t begin, size_t end, InvoiceCube *cube)
+{
+    for (size_t i = begin; i < end; i++)
+    {
+        int32_t key = keys[i - base];
+        if (key < 0)
+            continue;
+        int s = key / PAYMENT_METHOD_COUNT, m = key % PAYMENT_METHOD_COUNT;
+        cube->count[s][m]++;
+        cube->subtotal[s][m] += cols->subtotal[i];
+        cube->discountAmount[s][m] += cols->discountAmount[i];
+        cube->taxAmount[s][m] += cols->taxAmount[i];
+        cube->totalAmount[s][m] += cols->totalAmount[i];
+    }
+}
+
+#ifdef INVOICEVIEW_X86
+
+// --- SSE2 kernels ---
+
+__attribute__((target("sse2"))) static Money sumSse2(const Money *column, size_t begin, size_t end)
+{
+    __m128i acc0 = _mm_setzero_si128(), acc1 = _mm_setzero_si128();
+    size_t i = begin;
+    for (; i + 4 <= end; i += 4)
+    {
+        acc0 = _mm_add_epi64(acc0, _mm_loadu_si128((const __m128i *)(column + i)));
+        acc1 = _mm_add_epi64(acc1, _mm_loadu_si128((const __m128i *)(column + i + 2)));
+    }
+    int64_t lanes[2];
+    _mm_storeu_si128((__m128i *)lanes, _mm_add_epi64(acc0, acc1));
+    return lanes[0] + lanes[1] + sumScalar(column, i, end);
+}
+
+__attribute__((target("sse2"))) static size_t countEqualSse2(const uint8_t *column, size_t begin, size_t end, uint8_t value)
+{
+    const __m128i needle = _mm_set1_epi8((char)value);
+    size_t total = 0;
+    size_t i = begin;
+    while (i + 16 <= end)
+    {
+        // Byte counters overflow after 255 rounds, so widen them periodically.
+        __m128i counts = _mm_setzero_si128();
+        for (int round = 0; round < 255 && i + 16 <= end; round++, i += 16)
+        {
+            __m128i v = _mm_loadu_si128((const __m128i *)(column + i));
+            counts = _mm_sub_epi8(counts, _mm_cmpeq_epi8(v, needle));
+        }
+        __m128i sums = _mm_sad_epu8(counts, _mm_setzero_si128());
+        total += (size_t)_mm_cvtsi128_si32(sums) + (size_t)_mm_extract_epi16(sums, 4);
+    }
+    return total + countEqualScalar(column, i, end, value);
+}
+
+__attribute__((target("sse2"))) static void cubeKeySse2(const InvoiceColumns *cols, const int32_t *keys, size_t base,
+                                                        size_t begin, size_t end, int key, InvoiceCube *cube)
+{
+    const Money *columns[4] = {cols->subtotal, cols->discountAmount, cols->taxAmount, cols->totalAmount};
+    const __m128i keyVec = _mm_set1_epi32(key);
+    __m128i counts = _mm_setzero_si128();
+    __m128i acc[4];
+    for (int c = 0; c < 4; c++)
+        acc[c] = _mm_setzero_si128();
+
+    size_t i = begin;
+    for (; i + 4 <= end; i += 4)
+    {
+        __m128i mask = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)(keys + (i - base))), keyVec);
+        counts = _mm_sub_epi32(counts, mask);
+        // Duplicating each 32-bit lane widens the mask to 64-bit lanes.
+        __m128i maskLo = _mm_unpacklo_epi32(mask, mask);
+        __m128i maskHi = _mm_unpackhi_epi32(mask, mask);
+        for (int c = 0; c < 4; c++)
+        {
+            __m128i lo = _mm_and_si128(maskLo, _mm_loadu_si128((const __m128i *)(columns[c] + i)));
+            __m128i hi = _mm_and_si128(maskHi, _mm_loadu_si128((const __m128i *)(columns[c] + i + 2)));
+            acc[c] = _mm_add_epi64(acc[c], _mm_add_epi64(lo, hi));
+        }
+    }
+
+    int s = key / PAYMENT_METHOD_COUNT, m = key % PAYMENT_METHOD_COUNT;
+    int32_t countLanes[4];
+    _mm_storeu_si128((__m128i *)countLanes, counts);
+    cube->count[s][m] += countLanes[0] + countLanes[1] + countLanes[2] + countLanes[3];
+
+    Money *cells[4] = {&cube->subtotal[s][m], &cube->discountAmount[s][m], &cube->taxAmount[s][m], &cube->totalAmount[s][m]};
+    for (int c = 0; c < 4; c++)
+    {
+        int64_t lanes[2];
+        _mm_storeu_si128((__m128i *)lanes, acc[c]);
+        *cells[c] += lanes[0] + lanes[1];
+    }
+    cubeKeyScalar(cols, keys, base, i, end, key, cube);
+}
+
+// Dense blocks: transpose two rows at a time so each row's four amounts form a pair
+// of vectors, then add them to that row's cell. Two accumulator banks alternate
+// between rows to keep consecutive rows with the same key from serialising on one cell.
+__attribute__((target("sse2"))) static void cubeBlockSse2(const InvoiceColumns *cols, const int32_t *keys, size_t base,
+                                                          size_t end, InvoiceCube *cube)
+{
+    __m128i lo[2][CUBE_KEYS + 1], hi[2][CUBE_KEYS + 1];
+    long counts[CUBE_KEYS + 1] = {0};
+    for (int b = 0; b < 2; b++)
+        for (int k = 0; k <= CUBE_KEYS; k++)
+            lo[b][k] = hi[b][k] = _mm_setzero_si128();
+
+    size_t i = base;
+    for (; i + 2 <= end; i += 2)
+    {
+        __m128i sub = _mm_loadu_si128((const __m128i *)(cols->subtotal + i));
+        __m128i disc = _mm_loadu_si128((const __m128i *)(cols->discountAmount + i));
+        __m128i tax = _mm_loadu_si128((const __m128i *)(cols->taxAmount + i));
+        __m128i tot = _mm_loadu_si128((const __m128i *)(cols->totalAmount + i));
+        __m128i rowLo[2] = {_mm_unpacklo_epi64(sub, disc), _mm_unpackhi_epi64(sub, disc)};
+        __m128i rowHi[2] = {_mm_unpacklo_epi64(tax, tot), _mm_unpackhi_epi64(tax, tot)};
+        for (int r = 0; r < 2; r++)
+        {
+            int32_t key = keys[i - base + r];
+            int slot = key < 0 ? CUBE_KEYS : key;
+            counts[slot]++;
+            lo[r][slot] = _mm_add_epi64(lo[r][slot], rowLo[r]);
+            hi[r][slot] = _mm_add_epi64(hi[r][slot], rowHi[r]);
+        }
+    }
+
+    for (int k = 0; k < CUBE_KEYS; k++)
+    {
+        if (!counts[k])
+            continue;
+        int s = k / PAYMENT_METHOD_COUNT, m = k % PAYMENT_METHOD_COUNT;
+        int64_t a[2], b[2];
+        _mm_storeu_si128((__m128i *)a, _mm_add_epi64(lo[0][k], lo[1][k]));
+        _mm_storeu_si128((__m128i *)b, _mm_add_epi64(hi[0][k], hi[1][k]));
+        cube->count[s][m] += counts[k];
+        cube->subtotal[s][m] += a[0];
+        cube->discountAmount[s][m] += a[1];
+        cube->taxAmount[s][m] += b[0];
+        cube->totalAmount[s][m] += b[1];
+    }
+    cubeBlockScalar(cols, keys, base, i, end, cube);
+}
+
+// --- AVX2 kernels ---
+
+__attribute__((target("avx2"))) static Money sumAvx2(const Money *column, size_t begin, size_t end)
+{
+    __m256i acc0 = _mm256_setzero_si256(), acc1 = _mm256_setzero_si256();
+    size_t i = begin;
+    for (; i + 8 <= end; i += 8)
+    {
+        acc0 = _mm256_add_epi64(acc0, _mm256_loadu_si256((const __m256i *)(column + i)));
+        acc1 = _mm256_add_epi64(acc1, _mm256_loadu_si256((const __m256i *)(column + i + 4)));
+    }
+    int64_t lanes[4];
+    _mm256_storeu_si256((__m256i *)lanes, _mm256_add_epi64(acc0, acc1));
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + sumScalar(column, i, end);
+}
+
+__attribute__((target("avx2"))) static void cubeKeyAvx2(const InvoiceColumns *cols, const int32_t *keys, size_t base,
+                                                        size_t begin, size_t end, int key, InvoiceCube *cube)
+{
+    const Money *columns[4] = {cols->subtotal, cols->discountAmount, cols->taxAmount, cols->totalAmount};
+    const __m256i keyVec = _mm256_set1_epi32(key);
+    __m256i counts = _mm256_setzero_si256();
+    __m256i acc[4];
+    for (int c = 0; c < 4; c++)
+        acc[c] = _mm256_setzero_si256();
+
+    size_t i = begin;
+    for (; i + 8 <= end; i += 8)
+    {
+        __m256i mask = _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i *)(keys + (i - base))), keyVec);
+        counts = _mm256_sub_epi32(counts, mask);
+        // Sign-extending the all-ones / all-zeros lanes widens the mask to 64 bits.
+        __m256i maskLo = _mm256_cvtepi32_epi64(_mm256_castsi256_si128(mask));
+        __m256i maskHi = _mm256_cvtepi32_epi64(_mm256_extracti128_si256(mask, 1));
+        for (int c = 0; c < 4; c++)
+        {
+            __m256i lo = _mm256_and_si256(maskLo, _mm256_loadu_si256((const __m256i *)(columns[c] + i)));
+            __m256i hi = _mm256_and_si256(maskHi, _mm256_loadu_si256((const __m256i *)(columns[c] + i + 4)));
+            acc[c] = _mm256_add_epi64(acc[c], _mm256_add_epi64(lo, hi));
+        }
+    }
+
+    int s = key / PAYMENT_METHOD_COUNT, m = key % PAYMENT_METHOD_COUNT;
+    int32_t countLanes[8];
+    _mm256_storeu_si256((__m256i *)countLanes, counts);
+    for (int l = 0; l < 8; l++)
+        cube->count[s][m] += countLanes[l];
+
+    Money *cells[4] = {&cube->subtotal[s][m], &cube->discountAmount[s][m], &cube->taxAmount[s][m], &cube->totalAmount[s][m]};
+    for (int c = 0; c < 4; c++)
+    {
+        int64_t lanes[4];
+        _mm256_storeu_si256((__m256i *)lanes, acc[c]);
+        *cells[c] += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    }
+    cubeKeyScalar(cols, keys, base, i, end, key, cube);
+}
+
+// Dense blocks: a 4x4 transpose of 64-bit lanes turns four rows of the four amount
+// columns into one vector per row, which is added to that row's cell.
+__attribute__((target("avx2"))) static void cubeBlockAvx2(const InvoiceColumns *cols, const int32_t *keys, size_t base,
+                                                          size_t end, InvoiceCube *cube)
+{
+    __m256i acc[2][CUBE_KEYS + 1];
+    long counts[CUBE_KEYS + 1] = {0};
+    for (int b = 0; b < 2; b++)
+        for (int k = 0; k <= CUBE_KEYS; k++)
+            acc[b][k] = _mm256_setzero_si256();
+
+    size_t i = base;
+    for (; i + 4 <= end; i += 4)
+    {
+        __m256i c0 = _mm256_loadu_si256((const __m256i *)(cols->subtotal + i));
+        __m256i c1 = _mm256_loadu_si256((const __m256i *)(cols->discountAmount + i));
+        __m256i c2 = _mm256_loadu_si256((const __m256i *)(cols->taxAmount + i));
+        __m256i c3 = _mm256_loadu_si256((const __m256i *)(cols->totalAmount + i));
+        __m256i t0 = _mm256_unpacklo_epi64(c0, c1);
+        __m256i t1 = _mm256_unpackhi_epi64(c0, c1);
+        __m256i t2 = _mm256_unpacklo_epi64(c2, c3);
+        __m256i t3 = _mm256_unpackhi_epi64(c2, c3);
+        __m256i rows[4] = {_mm256_permute2x128_si256(t0, t2, 0x20), _mm256_permute2x128_si256(t1, t3, 0x20),
+                           _mm256_permute2x128_si256(t0, t2, 0x31), _mm256_permute2x128_si256(t1, t3, 0x31)};
+        for (int r = 0; r < 4; r++)
+        {
+            int32_t key = keys[i - base + r];
+            int slot = key < 0 ? CUBE_KEYS : key;
+            int bank = r & 1;
+            counts[slot]++;
+            acc[bank][slot] = _mm256_add_epi64(acc[bank][slot], rows[r]);
+        }
+    }
+
+    for (int k = 0; k < CUBE_KEYS; k++)
+    {
+        if (!counts[k])
+            continue;
+        int s = k / PAYMENT_METHOD_COUNT, m = k % PAYMENT_METHOD_COUNT;
+        int64_t lanes[4];
+        _mm256_storeu_si256((__m256i *)lanes, _mm256_add_epi64(acc[0][k], acc[1][k]));
+        cube->count[s][m] += counts[k];
+        cube->subtotal[s][m] += lanes[0];
+        cube->discountAmount[s][m] += lanes[1];
+        cube->taxAmount[s][m] += lanes[2];
+        cube->totalAmount[s][m] += lanes[3];
+    }
+    cubeBlockScalar(cols, keys, base, i, end, cube);
+}
+
+#endif // INVOICEVIEW_X86
+
+// --- Dispatch ---
+
+typedef enum
+{
+    ISA_SCALAR,
+    ISA_SSE2,
+    ISA_AVX2
+} KernelIsa;
+
+static KernelIsa detectIsa(void)
+{
+#ifdef INVOICEVIEW_X86
+    static int detected = -1;
+    if (detected < 0)
+    {
+        __builtin_cpu_init();
+        if (getenv("RIDEMATE_SCALAR_KERNELS"))
+            detected = ISA_SCALAR;
+        else if (__builtin_cpu_supports("avx2"))
+            detected = ISA_AVX2;
+        else if (__builtin_cpu_supports("sse2"))
+            detected = ISA_SSE2;
+        else
+            detected = ISA_SCALAR;
+    }
+    return (KernelIsa)detected;
+#else
+    return ISA_SCALAR;
+#endif
+}
+
+static int isaSupported(KernelIsa isa)
+{
+#ifdef INVOICEVIEW_X86
+    __builtin_cpu_init();
+    if (isa == ISA_AVX2)
+        return __builtin_cpu_supports("avx2");
+    if (isa == ISA_SSE2)
+        return __builtin_cpu_supports("sse2");
+#endif
+    return isa == ISA_SCALAR;
+}
+
+static const char *isaName(KernelIsa isa)
+{
+    switch (isa)
+    {
+    case ISA_AVX2:
+        return "avx2";
+    case ISA_SSE2:
+        return "sse2";
+    default:
+        return "scalar";
+    }
+}
+
+const char *invoiceKernelIsa(void)
+{
+    return isaName(detectIsa());
+}
+
+static Money columnSum(KernelIsa isa, const Money *column, size_t begin, size_t end)
+{
+#ifdef INVOICEVIEW_X86
+    switch (isa)
+    {
+    case ISA_AVX2:
+        return sumAvx2(column, begin, end);
+    case ISA_SSE2:
+        return sumSse2(column, begin, end);
+    default:
+        break;
+    }
+#endif
+    return sumScalar(column, begin, end);
+}
+
+Money invoiceColumnSum(const Money *column, size_t begin, size_t end)
+{
+    return columnSum(detectIsa(), column, begin, end);
+}
+
+static size_t columnCountEqual(KernelIsa isa, const uint8_t *column, size_t begin, size_t end, uint8_t value)
+{
+#ifdef INVOICEVIEW_X86
+    if (isa != ISA_SCALAR)
+        return countEqualSse2(column, begin, end, value);
+#endif
+    return countEqualScalar(column, begin, end, value);
+}
+
+size_t invoiceColumnCountEqual(const uint8_t *column, size_t begin, size_t end, uint8_t value)
+{
+    return columnCountEqual(detectIsa(), column, begin, end, value);
+}
+
+static void groupByStatusMethod(KernelIsa isa, const InvoiceColumns *cols, size_t begin, size_t end, InvoiceCube *cube)
+{
+    int32_t keys[CUBE_BLOCK_ROWS];
+
+    for (size_t base = begin; base < end; base += CUBE_BLOCK_ROWS)
+    {
+        size_t blockEnd = base + CUBE_BLOCK_ROWS < end ? base + CUBE_BLOCK_ROWS : end;
+
+        // Fuse status and method into one key per row and note which keys occur,
+        // so the masked passes below only run for cells that actually have rows.
+        unsigned present = 0;
+        for (size_t i = base; i < blockEnd; i++)
+        {
+            uint8_t s = cols->status[i], m = cols->paymentMethod[i];
+            int32_t key = (s < INVOICE_STATUS_COUNT && m < PAYMENT_METHOD_COUNT) ? s * PAYMENT_METHOD_COUNT + m : -1;
+            keys[i - base] = key;
+            if (key >= 0)
+                present |= 1u << key;
+        }
+
+        // Few distinct cells: a streaming masked pass per cell is cheapest.
+        // Otherwise fall back to a single scatter pass over the block.
+        if (__builtin_popcount(present) > MASKED_PASS_MAX_KEYS)
+        {
+            switch (isa)
+            {
+#ifdef INVOICEVIEW_X86
+            case ISA_AVX2:
+                cubeBlockAvx2(cols, keys, base, blockEnd, cube);
+                break;
+            case ISA_SSE2:
+                cubeBlockSse2(cols, keys, base, blockEnd, cube);
+                break;
+#endif
+            default:
+                cubeBlockScalar(cols, keys, base, base, blockEnd, cube);
+                break;
+            }
+            continue;
+        }
+
+        for (int key = 0; key < CUBE_KEYS; key++)
+        {
+            if (!(present & (1u << key)))
+                continue;
+            switch (isa)
+            {
+#ifdef INVOICEVIEW_X86
+            case ISA_AVX2:
+                cubeKeyAvx2(cols, keys, base, base, blockEnd, key, cube);
+                break;
+            case ISA_SSE2:
+                cubeKeySse2(cols, keys, base, base, blockEnd, key, cube);
+                break;
+#endif
+            default:
+                cubeKeyScalar(cols, keys, base, base, blockEnd, key, cube);
+                break;
+            }
+        }
+    }
+}
+
+void invoiceGroupByStatusMethod(const InvoiceColumns *cols, size_t begin, size_t end, InvoiceCube *cube)
+{
+    groupByStatusMethod(detectIsa(), cols, begin, end, cube);
+}
+
+static void scanCube(size_t begin, size_t end, void *partial, void *ctx)
+{
+    invoiceGroupByStatusMethod((const InvoiceColumns *)ctx, begin, end, (InvoiceCube *)partial);
+}
+
+static void mergeCube(void *total, const void *partial, void *ctx)
+{
+    (void)ctx;
+    InvoiceCube *t = (InvoiceCube *)total;
+    const InvoiceCube *p = (const InvoiceCube *)partial;
+    for (int s = 0; s < INVOICE_STATUS_COUNT; s++)
+    {
+        for (int m = 0; m < PAYMENT_METHOD_COUNT; m++)
+        {
+            t->count[s][m] += p->count[s][m];
+            t->subtotal[s][m] += p->subtotal[s][m];
+            t->discountAmount[s][m] += p->discountAmount[s][m];
+            t->taxAmount[s][m] += p->taxAmount[s][m];
+            t->totalAmount[s][m] += p->totalAmount[s][m];
+        }
+    }
+}
+
+void invoiceCubeCompute(const InvoiceColumns *cols, InvoiceCube *cube)
+{
+    memset(cube, 0, sizeof(*cube));
+    parallelScan(cols->count, sizeof(InvoiceCube), scanCube, mergeCube, cube, (void *)cols);
+}
+
+// --- Kernel check ---
+
+// Synthetic columns: the first half of the rows falls into two cells per block, which
+// takes the masked passes, the second half spreads over every cell plus some rows with
+// out-of-range codes, which takes the scatter pass.
+static int fillCheckColumns(InvoiceColumns *cols, size_t rows)
+{
+    memset(cols, 0, sizeof(*cols));
+    cols->subtotal = (Money *)malloc(rows * sizeof(Money));
+    cols->discountAmount = (Money *)malloc(rows * sizeof(Money));
+    cols->taxAmount = (Money *)malloc(rows * sizeof(Money));
+    cols->totalAmount = (Money *)malloc(rows * sizeof(Money));
+    cols->status = (uint8_t *)malloc(rows);
+    cols->paymentMethod = (uint8_t *)malloc(rows);
+    if (!cols->subtotal || !cols->discountAmount || !cols->taxAmount || !cols->totalAmount ||
+        !cols->status || !cols->paymentMethod)
+    {
+        freeInvoiceColumns(cols);
+        return 0;
+    }
+    unsigned seed = 2024;
+    for (size_t i = 0; i < rows; i++)
+    {
+        seed = seed * 1103515245u + 12345u;
+        cols->subtotal[i] = (Money)(seed >> 8) % 50000 + 100;
+        cols->discountAmount[i] = (Money)(seed >> 4) % 2000;
+        cols->taxAmount[i] = cols->subtotal[i] * 15 / 100;
+        cols->totalAmount[i] = cols->subtotal[i] - cols->discountAmount[i] + cols->taxAmount[i];
+        if (i < rows / 2)
+        {
+            cols->status[i] = (seed >> 20) & 1 ? INVOICE_PAID : INVOICE_PENDING;
+            cols->paymentMethod[i] = cols->status[i] == INVOICE_PAID ? PAYMENT_CARD : PAYMENT_CASH;
+        }
+        else
+        {
+            cols->status[i] = (uint8_t)((seed >> 16) % (INVOICE_STATUS_COUNT + 1));
+            cols->paymentMethod[i] = (uint8_t)((seed >> 24) % PAYMENT_METHOD_COUNT);
+        }
+    }
+    cols->count = rows;
+    return 1;
+}
+
+int invoiceKernelCheck(size_t rows)
+{
+    InvoiceColumns cols;
+    if (!fillCheckColumns(&cols, rows))
+    {
+        printf("Error: out of memory for %zu rows\n", rows);
+        return 1;
+    }
+    printf("Kernels in use: %s\n", invoiceKernelIsa());
+    printf("%-8s %20s %12s %12s %10s\n", "ISA", "Total (cents)", "Paid rows", "Cube rows", "Cube ms");
+
+    // An odd start and end leave unaligned heads and tails for each kernel.
+    size_t begin = rows > 7 ? 3 : 0, end = rows > 7 ? rows - 2 : rows;
+    Money referenceTotal = 0;
+    size_t referencePaid = 0;
+    InvoiceCube reference, cube;
+    int failed = 0;
+    for (int isa = ISA_SCALAR; isa <= ISA_AVX2; isa++)
+    {
+        if (!isaSupported((KernelIsa)isa))
+        {
+            printf("%-8s %20s\n", isaName((KernelIsa)isa), "(not supported)");
+            continue;
+        }
+        Money total = columnSum((KernelIsa)isa, cols.totalAmount, begin, end);
+        size_t paid = columnCountEqual((KernelIsa)isa, cols.status, begin, end, INVOICE_PAID);
+        struct timespec start, stop;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        memset(&cube, 0, sizeof(cube));
+        groupByStatusMethod((KernelIsa)isa, &cols, begin, end, &cube);
+        clock_gettime(CLOCK_MONOTONIC, &stop);
+        long cubeRows = 0;
+        for (int s = 0; s < INVOICE_STATUS_COUNT; s++)
+            for (int m = 0; m < PAYMENT_METHOD_COUNT; m++)
+                cubeRows += cube.count[s][m];
+        double ms = (double)(stop.tv_sec - start.tv_sec) * 1e3 + (double)(stop.tv_nsec - start.tv_nsec) / 1e6;
+        printf("%-8s %20lld %12zu %12ld %10.2f\n", isaName((KernelIsa)isa), (long long)total, paid, cubeRows, ms);
+
+        if (isa == ISA_SCALAR)
+        {
+            referenceTotal = total;
+            referencePaid = paid;
+            reference = cube;
+        }
+        else if (total != referenceTotal || paid != referencePaid || memcmp(&cube, &reference, sizeof(cube)) != 0)
+        {
+            printf("Error: the %s kernels disagree with the scalar ones\n", isaName((KernelIsa)isa));
+            failed = 1;
+        }
+    }
+    freeInvoiceColumns(&cols);
+    if (!failed)
+        printf("All kernels agree.\n");
+    return failed;
+}
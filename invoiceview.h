@@ -0,0 +1,61 @@
+// File: invoiceview.h
+// Description: A columnar (structure-of-arrays) snapshot of the invoice list and the
+// vectorized sum / count / group-by kernels that the invoice statistics run on.
+
+#ifndef INVOICEVIEW_H
+#define INVOICEVIEW_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "invoice.h"
+
+#define INVOICE_STATUS_COUNT 4
+#define PAYMENT_METHOD_COUNT 4
+
+// --- Columnar Invoice View ---
+// Row i of every column describes the same invoice.
+typedef struct
+{
+    size_t count;
+    Money *subtotal;
+    Money *discountAmount;
+    Money *taxAmount;
+    Money *totalAmount;
+    uint8_t *status;        // InvoiceStatus
+    uint8_t *paymentMethod; // PaymentMethod
+    int64_t *createdAt;
+    int64_t *paidAt;
+} InvoiceColumns;
+
+// --- Status x Payment Method aggregate ---
+typedef struct
+{
+    long count[INVOICE_STATUS_COUNT][PAYMENT_METHOD_COUNT];
+    Money subtotal[INVOICE_STATUS_COUNT][PAYMENT_METHOD_COUNT];
+    Money discountAmount[INVOICE_STATUS_COUNT][PAYMENT_METHOD_COUNT];
+    Money taxAmount[INVOICE_STATUS_COUNT][PAYMENT_METHOD_COUNT];
+    Money totalAmount[INVOICE_STATUS_COUNT][PAYMENT_METHOD_COUNT];
+} InvoiceCube;
+
+// Builds the view from the linked list as of one snapshot, so payments and refunds
+// committing meanwhile do not show up half-way. Returns 1 on success, 0 on allocation failure.
+int buildInvoiceColumns(Invoice *head, InvoiceColumns *cols);
+void freeInvoiceColumns(InvoiceColumns *cols);
+
+// Kernels over the half-open row range [begin, end).
+Money invoiceColumnSum(const Money *column, size_t begin, size_t end);
+size_t invoiceColumnCountEqual(const uint8_t *column, size_t begin, size_t end, uint8_t value);
+void invoiceGroupByStatusMethod(const InvoiceColumns *cols, size_t begin, size_t end, InvoiceCube *cube);
+
+// Whole-view group-by, partitioned across the thread pool.
+void invoiceCubeCompute(const InvoiceColumns *cols, InvoiceCube *cube);
+
+// Name of the instruction set the kernels dispatched to ("avx2", "sse2" or "scalar").
+const char *invoiceKernelIsa(void);
+
+// Runs every kernel the CPU supports over 'rows' synthetic invoices (--check-kernels),
+// prints each one's totals and group-by time and compares them with the scalar
+// kernels'. Returns 0 if all agree, 1 otherwise.
+int invoiceKernelCheck(size_t rows);
+
+#endif // INVOICEVIEW_H
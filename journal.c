@@ -0,0 +1,734 @@
+#include "journal.h"
+#include "asyncio.h"
+#include "atomicfile.h"
+#include "filecopy.h"
+#include "utils.h"
+#include <dirent.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
+
+// Longest journal line: sequence number, time, kind and one CSV row.
+#define JOURNAL_LINE_MAX 1024
+// Archive files are named after the day they were written: YYYY-MM-DD.log.
+#define ARCHIVE_NAME_SIZE 16
+
+// Rows appended since the flusher last took the buffer.
+typedef struct
+{
+    char *data;
+    size_t length;
+    size_t capacity;
+    long rows;
+    double firstAppended; // Monotonic seconds
+    double appendedSum;   // Append times summed over the rows, for the average latency
+} JournalBuffer;
+
+static pthread_mutex_t journalLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t rowsReady;  // First row of a batch, a full batch, or stop
+static pthread_cond_t committed;  // A batch was acknowledged
+static pthread_t flusher;
+static int running;
+static int stopping;
+static int flushing;              // The flusher is writing a batch outside the lock
+static long ownerPid;
+static int journalFd = -1;
+static int notifyFd = -1;
+static long appendedSequence;
+static long durableSequence;
+static long brokenSequence;       // First row of the first batch that failed; 0 if none
+static long checkpointSequence;   // Last sequence written to the checkpoint file
+static JournalBuffer pending;
+static JournalStats stats;
+static __thread long threadSequence;
+
+#ifndef _WIN32
+
+static double monotonicNow(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static long envLong(const char *name, long fallback, long min, long max)
+{
+    const char *text = getenv(name);
+    if (!text || !*text)
+        return fallback;
+    char *end;
+    long value = strtol(text, &end, 10);
+    if (*end || value < min || value > max)
+    {
+        printf("Warning: ignoring %s=%s (expected %ld-%ld)\n", name, text, min, max);
+        return fallback;
+    }
+    return value;
+}
+
+// "sequence@time,kind,row". Lines written before rows had a time are
+// "sequence,kind,row" and get time 0, the earliest possible.
+static int parseJournalLine(const char *line, long *sequence, long long *stamp, char *kind, int *consumed)
+{
+    *stamp = 0;
+    *consumed = 0;
+    if (sscanf(line, "%ld@%lld,%c,%n", sequence, stamp, kind, consumed) == 3 && *consumed)
+        return 1;
+    *consumed = 0;
+    return sscanf(line, "%ld,%c,%n", sequence, kind, consumed) == 2 && *consumed;
+}
+
+static long readCheckpoint(void)
+{
+    FILE *f = fopen(JOURNAL_CHECKPOINT_FILE, "r");
+    if (!f)
+        return 0;
+    char line[64];
+    long sequence = 0;
+    if (fgets(line, sizeof(line), f) && strncmp(line, "sequence", 8) == 0 && fgets(line, sizeof(line), f))
+        sequence = atol(line);
+    fclose(f);
+    return sequence > 0 ? sequence : 0;
+}
+
+long journalCheckpointSequence(void)
+{
+    return readCheckpoint();
+}
+
+// Applies the rows after 'checkpoint' and returns how many. *validLength is where
+// the last complete line ends; a torn line after it is cut off before appending.
+static long replayJournal(JournalApplyFn apply, void *ctx, long checkpoint, long *lastSequence, long *validLength)
+{
+    *lastSequence = checkpoint;
+    *validLength = 0;
+    FILE *f = fopen(JOURNAL_FILE, "r");
+    if (!f)
+        return 0;
+
+    long replayed = 0;
+    char line[JOURNAL_LINE_MAX];
+    while (fgets(line, sizeof(line), f))
+    {
+        size_t length = strlen(line);
+        if (length == 0 || line[length - 1] != '\n')
+            break; // Torn by a crash in the middle of an append, or not a journal line
+        line[length - 1] = '\0';
+
+        long sequence;
+        long long stamp;
+        char kind;
+        int consumed;
+        if (!parseJournalLine(line, &sequence, &stamp, &kind, &consumed))
+            break;
+        *validLength = ftell(f);
+        if (sequence > *lastSequence)
+            *lastSequence = sequence;
+        if (sequence > checkpoint)
+        {
+            apply(kind, line + consumed, ctx);
+            replayed++;
+        }
+    }
+    fclose(f);
+    return replayed;
+}
+
+static int writeAll(int fd, const char *data, size_t length)
+{
+    size_t done = 0;
+    while (done < length)
+    {
+        ssize_t n = write(fd, data + done, length - done);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return errno;
+        }
+        done += (size_t)n;
+    }
+    return 0;
+}
+
+static int syncData(int fd)
+{
+#ifdef __linux__
+    return fdatasync(fd) == 0 ? 0 : errno;
+#else
+    return fsync(fd) == 0 ? 0 : errno;
+#endif
+}
+
+static void *flusherMain(void *unused)
+{
+    (void)unused;
+    JournalBuffer batch = {0};
+    pthread_mutex_lock(&journalLock);
+    for (;;)
+    {
+        while (!pending.rows && !stopping)
+            pthread_cond_wait(&rowsReady, &journalLock);
+        if (!pending.rows)
+            break;
+
+        // Hold the batch open for the window, so callers arriving meanwhile share the fsync.
+        if (stats.windowUs > 0 && !stopping)
+        {
+            double deadline = pending.firstAppended + (double)stats.windowUs / 1e6;
+            struct timespec until;
+            until.tv_sec = (time_t)deadline;
+            until.tv_nsec = (long)((deadline - (double)until.tv_sec) * 1e9);
+            while (pending.rows < stats.batchLimit && !stopping &&
+                   pthread_cond_timedwait(&rowsReady, &journalLock, &until) != ETIMEDOUT)
+                ;
+        }
+
+        JournalBuffer taken = pending;
+        pending = batch;
+        pending.length = 0;
+        pending.rows = 0;
+        pending.appendedSum = 0.0;
+        batch = taken;
+        long last = appendedSequence;
+        flushing = 1;
+        pthread_mutex_unlock(&journalLock);
+
+        int error = writeAll(journalFd, batch.data, batch.length);
+        if (!error)
+            error = syncData(journalFd);
+        double done = monotonicNow();
+
+        pthread_mutex_lock(&journalLock);
+        flushing = 0;
+        stats.commits++;
+        if (batch.rows > stats.maxBatch)
+            stats.maxBatch = batch.rows;
+        if (error)
+        {
+            stats.failures++;
+            if (!brokenSequence)
+            {
+                brokenSequence = last - batch.rows + 1;
+                printf("Error: could not write %s (%s); changes are kept by the next full save only\n",
+                       JOURNAL_FILE, strerror(error));
+            }
+        }
+        else
+        {
+            stats.records += batch.rows;
+            stats.latencySum += (double)batch.rows * done - batch.appendedSum;
+            if (done - batch.firstAppended > stats.maxLatency)
+                stats.maxLatency = done - batch.firstAppended;
+        }
+        durableSequence = last;
+        pthread_cond_broadcast(&committed);
+        if (notifyFd >= 0)
+        {
+            uint64_t one = 1;
+            if (write(notifyFd, &one, sizeof(one)) < 0)
+            {
+                // Already signalled and not read yet; nothing is lost.
+            }
+        }
+    }
+    pthread_mutex_unlock(&journalLock);
+    free(batch.data);
+    return NULL;
+}
+
+long journalStart(JournalApplyFn apply, void *ctx)
+{
+    if (running)
+        return 0;
+
+    // Replayed even with the journal turned off, so switching it off loses nothing.
+    long checkpoint = readCheckpoint();
+    checkpointSequence = checkpoint;
+    long lastSequence, validLength;
+    long replayed = replayJournal(apply, ctx, checkpoint, &lastSequence, &validLength);
+    if (replayed > 0)
+        printf("Replayed %ld journaled changes from %s\n", replayed, JOURNAL_FILE);
+    appendedSequence = lastSequence;
+    durableSequence = lastSequence;
+    const char *mode = getenv("RIDEMATE_JOURNAL");
+    if (mode && strcmp(mode, "0") == 0)
+        return replayed;
+
+    stats.windowUs = envLong("RIDEMATE_COMMIT_WINDOW_US", JOURNAL_DEFAULT_WINDOW_US, 0, 1000000);
+    stats.batchLimit = envLong("RIDEMATE_COMMIT_BATCH", JOURNAL_DEFAULT_BATCH, 1, 1000000);
+
+    journalFd = open(JOURNAL_FILE, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (journalFd < 0 || ftruncate(journalFd, (off_t)validLength) < 0)
+    {
+        printf("Error: could not open %s (%s); changes are kept by full saves only\n", JOURNAL_FILE, strerror(errno));
+        if (journalFd >= 0)
+            close(journalFd);
+        journalFd = -1;
+        return replayed;
+    }
+
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&rowsReady, &attr);
+    pthread_condattr_destroy(&attr);
+    pthread_cond_init(&committed, NULL);
+#ifdef __linux__
+    notifyFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+#endif
+
+    stopping = 0;
+    ownerPid = (long)getpid();
+    if (pthread_create(&flusher, NULL, flusherMain, NULL) != 0)
+    {
+        close(journalFd);
+        journalFd = -1;
+        return replayed;
+    }
+    running = 1;
+    return replayed;
+}
+
+void journalStop(void)
+{
+    if (!running || (long)getpid() != ownerPid)
+        return;
+    pthread_mutex_lock(&journalLock);
+    stopping = 1;
+    pthread_cond_signal(&rowsReady);
+    pthread_mutex_unlock(&journalLock);
+    pthread_join(flusher, NULL); // It commits what is pending first
+    running = 0;
+    close(journalFd);
+    journalFd = -1;
+    if (notifyFd >= 0)
+        close(notifyFd);
+    notifyFd = -1;
+    free(pending.data);
+    memset(&pending, 0, sizeof(pending));
+    pthread_cond_destroy(&rowsReady);
+    pthread_cond_destroy(&committed);
+}
+
+long journalAppend(char kind, const char *row)
+{
+    if (!running)
+        return 0;
+    char line[JOURNAL_LINE_MAX];
+    double now = monotonicNow();
+
+    pthread_mutex_lock(&journalLock);
+    // Stamped under the lock, so times never go down as sequence numbers go up
+    // (unless the clock itself is set back).
+    long sequence = appendedSequence + 1;
+    int length = snprintf(line, sizeof(line), "%ld@%lld,%c,%s\n", sequence, (long long)time(NULL), kind, row);
+    if (length <= 0 || length >= (int)sizeof(line))
+    {
+        pthread_mutex_unlock(&journalLock);
+        printf("Error: journal row too long, kept by the next full save only: %.40s...\n", row);
+        return 0;
+    }
+    if (pending.length + (size_t)length > pending.capacity)
+    {
+        size_t capacity = pending.capacity ? pending.capacity * 2 : 64 * 1024;
+        while (capacity < pending.length + (size_t)length)
+            capacity *= 2;
+        char *data = (char *)realloc(pending.data, capacity);
+        if (!data)
+        {
+            pthread_mutex_unlock(&journalLock);
+            printf("Error: out of memory appending to the journal\n");
+            return 0;
+        }
+        pending.data = data;
+        pending.capacity = capacity;
+    }
+    memcpy(pending.data + pending.length, line, (size_t)length);
+    pending.length += (size_t)length;
+    if (pending.rows++ == 0)
+        pending.firstAppended = now;
+    pending.appendedSum += now;
+    appendedSequence = sequence;
+    if (pending.rows == 1 || pending.rows >= stats.batchLimit)
+        pthread_cond_signal(&rowsReady);
+    pthread_mutex_unlock(&journalLock);
+
+    threadSequence = sequence;
+    return sequence;
+}
+
+int journalWait(long sequence)
+{
+    if (sequence <= 0 || !running)
+        return 1;
+    pthread_mutex_lock(&journalLock);
+    while (durableSequence < sequence)
+        pthread_cond_wait(&committed, &journalLock);
+    int ok = !brokenSequence || sequence < brokenSequence;
+    pthread_mutex_unlock(&journalLock);
+    return ok;
+}
+
+// No lock: a forked child calls it, and the lock may have been held at the fork.
+long journalLastSequence(void)
+{
+    return __atomic_load_n(&appendedSequence, __ATOMIC_ACQUIRE);
+}
+
+long journalDurableSequence(void)
+{
+    pthread_mutex_lock(&journalLock);
+    long sequence = durableSequence;
+    pthread_mutex_unlock(&journalLock);
+    return sequence;
+}
+
+// Name of the archive file for the day 't' falls on (local time), "YYYY-MM-DD.log".
+static void archiveDayName(char *name, size_t size, time_t t)
+{
+    struct tm tm;
+    if (!localTimeSafe(t, &tm) || !strftime(name, size, "%Y-%m-%d.log", &tm))
+        snprintf(name, size, "0000-00-00.log");
+}
+
+static int isArchiveName(const char *name)
+{
+    int year, month, day, consumed = 0;
+    return strlen(name) == ARCHIVE_NAME_SIZE - 2 &&
+           sscanf(name, "%4d-%2d-%2d.log%n", &year, &month, &day, &consumed) == 3 && consumed == ARCHIVE_NAME_SIZE - 2;
+}
+
+static int compareArchiveNames(const void *a, const void *b)
+{
+    return strcmp((const char *)a, (const char *)b);
+}
+
+// The archive files, oldest day first. Returns how many (0 if there is no archive);
+// the caller frees *names.
+static int listArchive(char (**names)[ARCHIVE_NAME_SIZE])
+{
+    *names = NULL;
+    DIR *dir = opendir(JOURNAL_ARCHIVE_DIR);
+    if (!dir)
+        return 0;
+    int count = 0, capacity = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL)
+    {
+        if (!isArchiveName(entry->d_name))
+            continue;
+        if (count == capacity)
+        {
+            capacity = capacity ? capacity * 2 : 64;
+            char(*grown)[ARCHIVE_NAME_SIZE] = realloc(*names, (size_t)capacity * ARCHIVE_NAME_SIZE);
+            if (!grown)
+                break;
+            *names = grown;
+        }
+        // isArchiveName checked the length, so the name fits.
+        memcpy((*names)[count], entry->d_name, ARCHIVE_NAME_SIZE - 2);
+        (*names)[count++][ARCHIVE_NAME_SIZE - 2] = '\0';
+    }
+    closedir(dir);
+    if (count > 1)
+        qsort(*names, (size_t)count, ARCHIVE_NAME_SIZE, compareArchiveNames);
+    return count;
+}
+
+// Removes the archive files of days older than RIDEMATE_LOG_RETENTION_DAYS.
+static void pruneArchive(time_t now)
+{
+    long days = envLong("RIDEMATE_LOG_RETENTION_DAYS", JOURNAL_DEFAULT_RETENTION_DAYS, 0, 36500);
+    if (days == 0)
+        return; // Keep everything
+    char oldest[ARCHIVE_NAME_SIZE];
+    archiveDayName(oldest, sizeof(oldest), now - (time_t)days * 24 * 60 * 60);
+    char(*names)[ARCHIVE_NAME_SIZE];
+    int count = listArchive(&names);
+    for (int i = 0; i < count && strcmp(names[i], oldest) < 0; i++)
+    {
+        char path[64];
+        snprintf(path, sizeof(path), "%s/%s", JOURNAL_ARCHIVE_DIR, names[i]);
+        if (remove(path) != 0)
+            printf("Warning: could not remove %s (%s)\n", path, strerror(errno));
+    }
+    free(names);
+}
+
+// Appends the whole journal to today's archive file and makes it durable. Called with
+// journalLock held and nothing pending, so the journal does not change meanwhile.
+// Returns 0, or an errno value; the journal must then not be emptied.
+static int archiveJournal(void)
+{
+    int in = open(JOURNAL_FILE, O_RDONLY | O_CLOEXEC);
+    if (in < 0)
+        return errno;
+    struct stat journalStat;
+    if (fstat(in, &journalStat) < 0)
+    {
+        int error = errno;
+        close(in);
+        return error;
+    }
+    if (journalStat.st_size == 0)
+    {
+        close(in);
+        return 0;
+    }
+
+    time_t now = time(NULL);
+    char name[ARCHIVE_NAME_SIZE], path[64];
+    archiveDayName(name, sizeof(name), now);
+    snprintf(path, sizeof(path), "%s/%s", JOURNAL_ARCHIVE_DIR, name);
+    mkdir(JOURNAL_ARCHIVE_DIR, 0755);
+    int created = access(path, F_OK) != 0;
+    int out = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    struct stat archiveStat;
+    if (out < 0 || fstat(out, &archiveStat) < 0)
+    {
+        int error = errno;
+        if (out >= 0)
+            close(out);
+        close(in);
+        return error;
+    }
+
+    // A crash during an earlier append can leave a torn last line; end it first so
+    // the rows copied now start on a line of their own.
+    long long offset = (long long)archiveStat.st_size;
+    char last = '\n';
+    int error = 0;
+    if (offset > 0 && pread(out, &last, 1, (off_t)(offset - 1)) == 1 && last != '\n')
+    {
+        error = pwrite(out, "\n", 1, (off_t)offset) == 1 ? 0 : errno;
+        offset++;
+    }
+    if (!error && copyFileRange(in, 0, out, offset, (long long)journalStat.st_size, NULL) != 0)
+        error = errno;
+    if (!error)
+        error = syncData(out);
+    close(out);
+    close(in);
+    if (!error && created)
+    {
+        if (syncParentDirectory(path) != 0 || syncParentDirectory(JOURNAL_ARCHIVE_DIR) != 0)
+            error = errno;
+        pruneArchive(now); // Once a day is plenty
+    }
+    return error;
+}
+
+// Applies the rows of one log file that come after *lastSequence and are stamped no
+// later than 'until'. Returns 0 once a row past 'until' is reached, 1 otherwise.
+static int replayLogFile(const char *path, time_t until, JournalApplyFn apply, void *ctx, long *lastSequence,
+                         long *applied)
+{
+    FILE *f = fopen(path, "r");
+    if (!f)
+        return 1;
+    int more = 1;
+    char line[JOURNAL_LINE_MAX];
+    while (fgets(line, sizeof(line), f))
+    {
+        size_t length = strlen(line);
+        if (length == 0 || line[length - 1] != '\n')
+            continue; // A torn line; the archive ended it when it appended after it
+        line[length - 1] = '\0';
+        long sequence;
+        long long stamp;
+        char kind;
+        int consumed;
+        if (!parseJournalLine(line, &sequence, &stamp, &kind, &consumed) || sequence <= *lastSequence)
+            continue; // Already applied, or copied again after a crash before the journal was emptied
+        if (stamp > (long long)until)
+        {
+            more = 0;
+            break;
+        }
+        apply(kind, line + consumed, ctx);
+        *lastSequence = sequence;
+        (*applied)++;
+    }
+    fclose(f);
+    return more;
+}
+
+long replayMutationLog(long after, time_t since, time_t until, JournalApplyFn apply, void *ctx)
+{
+    // An archive file only holds rows appended up to the end of its day, so days
+    // before 'since' cannot hold anything newer than a backup taken at 'since'.
+    char first[ARCHIVE_NAME_SIZE];
+    archiveDayName(first, sizeof(first), since);
+    char(*names)[ARCHIVE_NAME_SIZE];
+    int count = listArchive(&names);
+    long lastSequence = after, applied = 0;
+    int more = 1;
+    for (int i = 0; i < count && more; i++)
+    {
+        if (strcmp(names[i], first) < 0)
+            continue;
+        char path[64];
+        snprintf(path, sizeof(path), "%s/%s", JOURNAL_ARCHIVE_DIR, names[i]);
+        more = replayLogFile(path, until, apply, ctx, &lastSequence, &applied);
+    }
+    free(names);
+    if (more)
+        replayLogFile(JOURNAL_FILE, until, apply, ctx, &lastSequence, &applied);
+    return applied;
+}
+
+void saveJournalCheckpoint(void)
+{
+    if (!running && !appendedSequence)
+        return; // No journal, nothing replayed: nothing to vouch for
+    // In a background-save child the lock may have been held at the fork; the
+    // copied counter is exactly what the child's snapshot of the data contains.
+    int owner = (long)getpid() == ownerPid;
+    long sequence = __atomic_load_n(&appendedSequence, __ATOMIC_ACQUIRE);
+
+    // The checkpoint must not reach the disk before the files it vouches for.
+    asyncIoDrain();
+    if (sequence != checkpointSequence)
+    {
+        AtomicFile checkpoint;
+        FILE *f = atomicFileOpen(&checkpoint, JOURNAL_CHECKPOINT_FILE);
+        if (!f)
+        {
+            printf("Error: could not open %s for writing\n", checkpoint.temp);
+            return;
+        }
+        fprintf(f, "sequence\n%ld\n", sequence);
+        if (atomicFileCommit(&checkpoint) != 0)
+        {
+            printf("Error: could not write %s\n", JOURNAL_CHECKPOINT_FILE);
+            return;
+        }
+        checkpointSequence = sequence;
+    }
+    if (!owner || !running)
+        return;
+
+    // Every row is in the saved files now; start the journal over if none came in since.
+    pthread_mutex_lock(&journalLock);
+    // The rows go to the archive first, for point-in-time recovery.
+    if (appendedSequence == sequence && durableSequence == sequence && !flushing && !pending.rows)
+    {
+        int error = archiveJournal();
+        if (error)
+            printf("Warning: could not archive %s (%s); it is kept until the next save\n", JOURNAL_FILE,
+                   strerror(error));
+        else if (ftruncate(journalFd, 0) < 0)
+            printf("Warning: could not empty %s (%s)\n", JOURNAL_FILE, strerror(errno));
+    }
+    pthread_mutex_unlock(&journalLock);
+}
+
+#else
+
+long journalStart(JournalApplyFn apply, void *ctx)
+{
+    (void)apply;
+    (void)ctx;
+    return 0;
+}
+
+void journalStop(void)
+{
+}
+
+long journalAppend(char kind, const char *row)
+{
+    (void)kind;
+    (void)row;
+    return 0;
+}
+
+int journalWait(long sequence)
+{
+    (void)sequence;
+    return 1;
+}
+
+long journalLastSequence(void)
+{
+    return 0;
+}
+
+long journalDurableSequence(void)
+{
+    return 0;
+}
+
+void saveJournalCheckpoint(void)
+{
+}
+
+long journalCheckpointSequence(void)
+{
+    return 0;
+}
+
+long replayMutationLog(long after, time_t since, time_t until, JournalApplyFn apply, void *ctx)
+{
+    (void)after;
+    (void)since;
+    (void)until;
+    (void)apply;
+    (void)ctx;
+    return 0;
+}
+
+#endif // _WIN32
+
+int journalEnabled(void)
+{
+    return running;
+}
+
+long journalThreadSequence(void)
+{
+    return threadSequence;
+}
+
+int journalNotifyFd(void)
+{
+    return notifyFd;
+}
+
+void getJournalStats(JournalStats *out)
+{
+    pthread_mutex_lock(&journalLock);
+    *out = stats;
+    pthread_mutex_unlock(&journalLock);
+}
+
+void describeJournalStatus(char *buf, size_t size)
+{
+    if (!running)
+    {
+        snprintf(buf, size, "Journal: off (changes are kept by full saves only)");
+        return;
+    }
+    JournalStats s;
+    getJournalStats(&s);
+    double perCommit = s.commits ? (double)s.records / (double)s.commits : 0.0;
+    double latency = s.records ? s.latencySum / (double)s.records * 1000.0 : 0.0;
+    snprintf(buf, size,
+             "Journal: %ld rows in %ld commits (%.1f per commit, max %ld), commit latency avg %.2f ms, max %.2f ms, "
+             "%ld failed; window %ld us, batch %ld",
+             s.records, s.commits, perCommit, s.maxBatch, latency, s.maxLatency * 1000.0, s.failures,
+             s.windowUs, s.batchLimit);
+}
@@ -0,0 +1,95 @@
+// File: journal.h
+// Description: Group-commit journal for rentals, invoices and drivers. Every change
+// to one of them appends the changed row to data/journal.log. A flusher thread
+// collects the rows appended by all callers for up to a short window (or until a
+// batch is full), writes them with one append and one fsync, and then acknowledges
+// every caller in the batch. On start-up the rows appended after the last full save
+// are replayed over the CSV files, so an acknowledged change survives a crash.
+// Each row carries the time it was appended; at a checkpoint the journal is moved
+// to a per-day archive instead of being thrown away, so the data can be rebuilt as
+// of any instant from a backup plus the archived rows.
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <stddef.h>
+#include <time.h>
+
+#define JOURNAL_FILE "data/journal.log"
+// Journal position the CSV files were last saved at; older rows are not replayed.
+#define JOURNAL_CHECKPOINT_FILE "data/journal_checkpoint.csv"
+// Archived journal rows, one file per day: data/journal/YYYY-MM-DD.log.
+#define JOURNAL_ARCHIVE_DIR "data/journal"
+// Default for RIDEMATE_LOG_RETENTION_DAYS: archive files older than this are
+// removed (0 keeps them all). Recovery can go back as far as the archive does.
+#define JOURNAL_DEFAULT_RETENTION_DAYS 30
+
+// Defaults for RIDEMATE_COMMIT_WINDOW_US and RIDEMATE_COMMIT_BATCH. A longer window
+// or a bigger batch means fewer fsyncs and more bookings per second, at the price of
+// a longer wait for each caller.
+#define JOURNAL_DEFAULT_WINDOW_US 500
+#define JOURNAL_DEFAULT_BATCH 256
+
+// Row kinds, the second field of every journal line ("sequence@time,kind,row").
+#define JOURNAL_RENTAL 'R'
+#define JOURNAL_INVOICE 'I'
+#define JOURNAL_DRIVER 'D'
+
+// Applies one replayed row (a line of the kind's CSV file) to the loaded data.
+typedef void (*JournalApplyFn)(char kind, char *row, void *ctx);
+
+typedef struct
+{
+    long records;       // Rows made durable
+    long commits;       // Appends + fsyncs; each acknowledges a batch of rows
+    long maxBatch;
+    long failures;      // Commits whose write or fsync failed
+    double latencySum;  // Seconds from append to acknowledgement, summed over rows
+    double maxLatency;
+    long windowUs;
+    long batchLimit;
+} JournalStats;
+
+// Replays the rows appended since the last checkpoint through 'apply', then opens
+// the journal and starts the flusher. Call once, after the CSV files are loaded.
+// RIDEMATE_JOURNAL=0 skips both. Returns the number of rows replayed.
+long journalStart(JournalApplyFn apply, void *ctx);
+// Makes everything appended durable and stops the flusher.
+void journalStop(void);
+int journalEnabled(void);
+
+// Appends one row and returns its sequence number without waiting for the fsync,
+// or 0 if the journal is off. Call it while the change is still exclusive to the
+// caller (under the lock or claim that made it), so rows of one record are
+// journaled in the order they were changed.
+long journalAppend(char kind, const char *row);
+// Sequence number of the last row this thread appended (0 if none).
+long journalThreadSequence(void);
+// Sequence number of the last row appended by any thread (0 if none).
+long journalLastSequence(void);
+// Everything up to this sequence number is durable.
+long journalDurableSequence(void);
+// Blocks until row 'sequence' is durable. Returns 0 if it could not be written.
+int journalWait(long sequence);
+// Readable (Linux eventfd) whenever a batch has been acknowledged, for event loops
+// that wait on several descriptors; -1 if not available. Read it to clear it.
+int journalNotifyFd(void);
+
+// Records that the CSV files just saved hold every row appended so far, so those
+// rows are not replayed again, and empties the journal if nothing was appended
+// meanwhile. Call after saving every file; it waits for queued writes first.
+void saveJournalCheckpoint(void);
+
+// Sequence number saved in the checkpoint file: every row up to it is in the CSV files.
+long journalCheckpointSequence(void);
+// Applies, in order, the archived and current journal rows with a sequence number
+// above 'after' and a time no later than 'until'. 'since' (the time the data being
+// replayed over was taken) lets it skip archive days that cannot hold such rows.
+// Returns the number of rows applied.
+long replayMutationLog(long after, time_t since, time_t until, JournalApplyFn apply, void *ctx);
+
+void getJournalStats(JournalStats *stats);
+// One line for the admin panel and the batch summary.
+void describeJournalStatus(char *buf, size_t size);
+
+#endif // JOURNAL_H
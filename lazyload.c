@@ -0,0 +1,127 @@
+#include "lazyload.h"
+#include "dirty.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+extern Route *routeHead;
+extern Promo *promoHead;
+extern Invoice *invoiceHead;
+extern ComplaintTable complaintTable;
+
+static const DirtyTable dirtyTableOf[LAZY_TABLE_COUNT] = {DIRTY_ROUTES, DIRTY_PROMOS, DIRTY_INVOICES,
+                                                          DIRTY_COMPLAINTS};
+
+// One lock for all four: the loaders share the data-file source and the partition
+// settings, and a table that is needed right away is small next to start-up.
+static pthread_mutex_t loadLock = PTHREAD_MUTEX_INITIALIZER;
+static atomic_int loaded[LAZY_TABLE_COUNT];
+static pthread_t prefetchThread;
+static int prefetchStarted;
+
+void deferLazyTables(void)
+{
+    for (int t = 0; t < LAZY_TABLE_COUNT; t++)
+    {
+        if (!atomic_load(&loaded[t]))
+            markClean(dirtyTableOf[t]);
+    }
+}
+
+static void ensureLoaded(LazyTable table)
+{
+    if (atomic_load_explicit(&loaded[table], memory_order_acquire))
+        return;
+    pthread_mutex_lock(&loadLock);
+    if (!atomic_load_explicit(&loaded[table], memory_order_relaxed))
+    {
+        // A loader marks its table clean once the file is read. One that does not
+        // (the file is missing, or in an old format) wants the next save to write it;
+        // deferLazyTables already cleared the mark, so it is set again here. Nothing
+        // is marked while the load runs, so a save started meanwhile has no reason to.
+        unsigned epoch = dirtyEpoch(dirtyTableOf[table]);
+        switch (table)
+        {
+        case LAZY_ROUTES:
+            loadRoutes(&routeHead);
+            break;
+        case LAZY_PROMOS:
+            loadPromos(&promoHead);
+            break;
+        case LAZY_INVOICES:
+            loadInvoices(&invoiceHead);
+            break;
+        case LAZY_COMPLAINTS:
+            loadComplaints(&complaintTable);
+            break;
+        default:
+            break;
+        }
+        if (dirtyEpoch(dirtyTableOf[table]) == epoch)
+            markDirty(dirtyTableOf[table]);
+        atomic_store_explicit(&loaded[table], 1, memory_order_release);
+    }
+    pthread_mutex_unlock(&loadLock);
+}
+
+Route **loadedRoutes(void)
+{
+    ensureLoaded(LAZY_ROUTES);
+    return &routeHead;
+}
+
+Promo **loadedPromos(void)
+{
+    ensureLoaded(LAZY_PROMOS);
+    return &promoHead;
+}
+
+Invoice **loadedInvoices(void)
+{
+    ensureLoaded(LAZY_INVOICES);
+    return &invoiceHead;
+}
+
+ComplaintTable *loadedComplaints(void)
+{
+    ensureLoaded(LAZY_COMPLAINTS);
+    return &complaintTable;
+}
+
+int lazyTableLoaded(LazyTable table)
+{
+    return atomic_load_explicit(&loaded[table], memory_order_acquire);
+}
+
+void loadAllLazyTables(void)
+{
+    // Booking needs routes and promo codes first, so they go first.
+    for (int t = 0; t < LAZY_TABLE_COUNT; t++)
+        ensureLoaded((LazyTable)t);
+}
+
+static void *prefetchMain(void *arg)
+{
+    (void)arg;
+    loadAllLazyTables();
+    return NULL;
+}
+
+void startLazyPrefetch(void)
+{
+    if (prefetchStarted)
+        return;
+    const char *env = getenv("RIDEMATE_PREFETCH");
+    if (!env || strcmp(env, "1") != 0)
+        return;
+    prefetchStarted = pthread_create(&prefetchThread, NULL, prefetchMain, NULL) == 0;
+}
+
+void stopLazyPrefetch(void)
+{
+    if (!prefetchStarted)
+        return;
+    pthread_join(prefetchThread, NULL);
+    prefetchStarted = 0;
+}
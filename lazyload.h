@@ -0,0 +1,47 @@
+// File: lazyload.h
+// Description: Tables read on first use. Start-up only loads what logging in and the
+// menus around it need (vehicles, customers, rentals, drivers); routes, promo codes,
+// invoices and complaints stay on disk until one of the accessors below is first
+// called, which loads the table then. With RIDEMATE_PREFETCH=1 a background thread
+// loads them all once the main menu is up, so the first use rarely waits.
+
+#ifndef LAZYLOAD_H
+#define LAZYLOAD_H
+
+#include "vehicle.h"
+#include "promo.h"
+#include "invoice.h"
+#include "complaint.h"
+
+typedef enum
+{
+    LAZY_ROUTES = 0,
+    LAZY_PROMOS,
+    LAZY_INVOICES,
+    LAZY_COMPLAINTS,
+    LAZY_TABLE_COUNT
+} LazyTable;
+
+// Marks the tables as matching their files, so saves leave them alone until they are
+// loaded. Call once, after the eager loads and before anything saves.
+void deferLazyTables(void);
+
+// The table, loaded first if it is not yet. Safe to call from any thread; a caller
+// that arrives while the prefetch is loading the table waits for it.
+Route **loadedRoutes(void);
+Promo **loadedPromos(void);
+Invoice **loadedInvoices(void);
+ComplaintTable *loadedComplaints(void);
+
+// 1 once the table is in memory. Saves skip the tables that are not: their files
+// already hold them. Takes no lock, so background-save children can ask.
+int lazyTableLoaded(LazyTable table);
+// Loads every table now, e.g. while a backup is being read or the journal replayed.
+void loadAllLazyTables(void);
+
+// Starts the background prefetch if RIDEMATE_PREFETCH=1; later calls do nothing.
+void startLazyPrefetch(void);
+// Waits for the prefetch to finish. Call before freeing the tables.
+void stopLazyPrefetch(void);
+
+#endif // LAZYLOAD_H
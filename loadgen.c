@@ -0,0 +1,240 @@
+#include "loadgen.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "batch.h"
+#include "server.h"
+
+#define LOADGEN_MAX_EVENTS 256
+
+typedef struct
+{
+    int fd;
+    int vehicleId;
+    int rentalId; // Booked and not completed yet, 0 if none
+    int sent;
+    uint64_t sentAt;
+    size_t inLength;
+    char in[BATCH_RESPONSE_MAX];
+} LoadClient;
+
+typedef struct
+{
+    const LoadGenOptions *options;
+    int epollFd;
+    int active;
+    uint64_t *latencies; // Nanoseconds, one per answered request
+    size_t answered;
+    long errors;
+} LoadGen;
+
+static uint64_t nowNanos(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static int compareLatency(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static int connectClient(const char *path)
+{
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return -1;
+    // Connect blocking (waits out a full accept backlog), then switch to non-blocking.
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) < 0)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void finishClient(LoadGen *gen, LoadClient *client)
+{
+    epoll_ctl(gen->epollFd, EPOLL_CTL_DEL, client->fd, NULL);
+    close(client->fd);
+    client->fd = -1;
+    gen->active--;
+}
+
+// One request at a time per client: complete the open rental if there is one,
+// otherwise book the client's vehicle again.
+static int sendNext(LoadGen *gen, LoadClient *client)
+{
+    char request[160];
+    int length;
+    if (client->rentalId)
+        length = snprintf(request, sizeof(request), "{\"op\":\"complete\",\"rental\":%d}\n", client->rentalId);
+    else
+        length = snprintf(request, sizeof(request),
+                          "{\"op\":\"book\",\"customer\":%d,\"vehicle\":%d,\"type\":\"hourly\",\"hours\":1}\n",
+                          gen->options->customerId, client->vehicleId);
+    client->sentAt = nowNanos();
+    client->sent++;
+    // A request this small always fits an idle socket's buffer.
+    return send(client->fd, request, (size_t)length, MSG_NOSIGNAL) == length;
+}
+
+static void handleResponse(LoadGen *gen, LoadClient *client, const char *line)
+{
+    gen->latencies[gen->answered++] = nowNanos() - client->sentAt;
+    if (!strstr(line, "\"ok\":true"))
+    {
+        gen->errors++;
+        client->rentalId = 0;
+        return;
+    }
+    const char *rental = strstr(line, "\"rental\":");
+    if (strstr(line, "\"op\":\"book\"") && rental)
+        client->rentalId = atoi(rental + 9);
+    else
+        client->rentalId = 0;
+}
+
+static void readResponses(LoadGen *gen, LoadClient *client)
+{
+    for (;;)
+    {
+        ssize_t n = read(client->fd, client->in + client->inLength, sizeof(client->in) - 1 - client->inLength);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return;
+        if (n <= 0)
+        {
+            gen->errors++;
+            finishClient(gen, client);
+            return;
+        }
+        client->inLength += (size_t)n;
+        client->in[client->inLength] = '\0';
+
+        char *newline = strchr(client->in, '\n');
+        if (!newline)
+        {
+            if (client->inLength == sizeof(client->in) - 1)
+                client->inLength = 0; // Not a reply we understand; drop it
+            continue;
+        }
+        *newline = '\0';
+        handleResponse(gen, client, client->in);
+        client->inLength = 0;
+
+        if (client->sent >= gen->options->requestsPerClient || !sendNext(gen, client))
+            finishClient(gen, client);
+        return;
+    }
+}
+
+int runLoadGen(const LoadGenOptions *options)
+{
+    raiseOpenFileLimit();
+
+    LoadGen gen = {options, epoll_create1(EPOLL_CLOEXEC), 0, NULL, 0, 0};
+    LoadClient *clients = (LoadClient *)calloc((size_t)options->clients, sizeof(LoadClient));
+    gen.latencies = (uint64_t *)malloc((size_t)options->clients * (size_t)options->requestsPerClient * sizeof(uint64_t));
+    if (gen.epollFd < 0 || !clients || !gen.latencies)
+    {
+        printf("Error: could not set up the load generator\n");
+        free(clients);
+        free(gen.latencies);
+        if (gen.epollFd >= 0)
+            close(gen.epollFd);
+        return 1;
+    }
+
+    int connected = 0;
+    for (int i = 0; i < options->clients; i++)
+    {
+        LoadClient *client = &clients[i];
+        client->vehicleId = options->firstVehicle + i;
+        client->fd = connectClient(options->socketPath);
+        if (client->fd < 0)
+        {
+            printf("Warning: client %d could not connect to %s: %s\n", i, options->socketPath, strerror(errno));
+            break;
+        }
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.ptr = client;
+        epoll_ctl(gen.epollFd, EPOLL_CTL_ADD, client->fd, &ev);
+        connected++;
+        gen.active++;
+    }
+    if (connected == 0)
+    {
+        free(clients);
+        free(gen.latencies);
+        close(gen.epollFd);
+        return 1;
+    }
+
+    uint64_t start = nowNanos();
+    for (int i = 0; i < connected; i++)
+    {
+        if (options->requestsPerClient <= 0 || !sendNext(&gen, &clients[i]))
+            finishClient(&gen, &clients[i]);
+    }
+
+    struct epoll_event events[LOADGEN_MAX_EVENTS];
+    while (gen.active > 0)
+    {
+        int n = epoll_wait(gen.epollFd, events, LOADGEN_MAX_EVENTS, -1);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        for (int i = 0; i < n; i++)
+        {
+            LoadClient *client = (LoadClient *)events[i].data.ptr;
+            if (client->fd >= 0)
+                readResponses(&gen, client);
+        }
+    }
+    double seconds = (double)(nowNanos() - start) / 1e9;
+
+    for (int i = 0; i < connected; i++)
+    {
+        if (clients[i].fd >= 0)
+            close(clients[i].fd);
+    }
+    close(gen.epollFd);
+
+    printf("Load: %d clients, %zu requests in %.3f s (%.0f requests/s), %ld errors\n",
+           connected, gen.answered, seconds, seconds > 0 ? gen.answered / seconds : 0.0, gen.errors);
+    if (gen.answered > 0)
+    {
+        qsort(gen.latencies, gen.answered, sizeof(uint64_t), compareLatency);
+        printf("Latency: p50 %.1f us, p99 %.1f us, max %.1f us\n",
+               gen.latencies[gen.answered / 2] / 1e3,
+               gen.latencies[(gen.answered * 99) / 100] / 1e3,
+               gen.latencies[gen.answered - 1] / 1e3);
+    }
+
+    free(clients);
+    free(gen.latencies);
+    return 0;
+}
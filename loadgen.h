@@ -0,0 +1,21 @@
+// File: loadgen.h
+// Description: Local load generator for the booking server. Opens many client
+// connections at once, has each one run book/complete cycles on its own vehicle
+// and reports throughput and p50/p99 request latency.
+
+#ifndef LOADGEN_H
+#define LOADGEN_H
+
+typedef struct
+{
+    const char *socketPath;
+    int clients;
+    int requestsPerClient;
+    int customerId;   // Customer every booking is made for
+    int firstVehicle; // Client i books vehicle firstVehicle + i
+} LoadGenOptions;
+
+// Runs the load and prints a summary. Returns 0 on success, 1 if no client could connect.
+int runLoadGen(const LoadGenOptions *options);
+
+#endif // LOADGEN_H
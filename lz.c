@@ -0,0 +1,218 @@
+#include "lz.h"
+#include <stdint.h>
+#include <string.h>
+
+#define MIN_MATCH 4
+#define HASH_BITS 13
+#define MAX_OFFSET 65535
+// No match starts in the last bytes of a block; they are always literals.
+#define END_LITERALS 8
+// After this many misses in a row the search steps over more bytes at a time, so
+// data that does not compress costs little time.
+#define SKIP_TRIGGER 6
+
+static uint32_t read32(const uint8_t *p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static uint64_t read64(const uint8_t *p)
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static uint32_t hash4(uint32_t v)
+{
+    return (v * 2654435761u) >> (32 - HASH_BITS);
+}
+
+// How many bytes from p on equal those from ref, stopping at limit.
+static size_t commonLength(const uint8_t *p, const uint8_t *ref, const uint8_t *limit)
+{
+    const uint8_t *start = p;
+    // Eight bytes at a time; in a little-endian word the first differing byte is
+    // the lowest set bit of the XOR.
+    while (p + 8 <= limit)
+    {
+        uint64_t diff = read64(p) ^ read64(ref);
+        if (diff)
+        {
+#if defined(__GNUC__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+            return (size_t)(p - start) + (size_t)(__builtin_ctzll(diff) >> 3);
+#else
+            break;
+#endif
+        }
+        p += 8;
+        ref += 8;
+    }
+    while (p < limit && *p == *ref)
+    {
+        p++;
+        ref++;
+    }
+    return (size_t)(p - start);
+}
+
+// Lengths of 15 and up continue in extra bytes: 255 for each full 255, then the rest.
+static uint8_t *writeLength(uint8_t *op, size_t length)
+{
+    for (; length >= 255; length -= 255)
+        *op++ = 255;
+    *op++ = (uint8_t)length;
+    return op;
+}
+
+// Writes one sequence: 'literalLength' bytes from 'literals', then a match of
+// 'matchLength' bytes at 'offset' (no match for the last sequence). 'end' is the end
+// of the input. Returns the new output position, or NULL if the sequence does not fit.
+static uint8_t *writeSequence(uint8_t *op, const uint8_t *oend, const uint8_t *literals, size_t literalLength,
+                              const uint8_t *end, size_t offset, size_t matchLength)
+{
+    size_t worst = 1 + literalLength / 255 + 1 + literalLength + 2 + matchLength / 255 + 1;
+    if ((size_t)(oend - op) < worst)
+        return NULL;
+    uint8_t *token = op++;
+    *token = (uint8_t)((literalLength < 15 ? literalLength : 15) << 4);
+    if (literalLength >= 15)
+        op = writeLength(op, literalLength - 15);
+    if (literalLength <= 16 && oend - op >= 16 && end - literals >= 16)
+        memcpy(op, literals, 16); // Fixed size: a couple of moves instead of a call
+    else
+        memcpy(op, literals, literalLength);
+    op += literalLength;
+    if (!matchLength)
+        return op;
+    *op++ = (uint8_t)offset;
+    *op++ = (uint8_t)(offset >> 8);
+    size_t code = matchLength - MIN_MATCH;
+    *token |= (uint8_t)(code < 15 ? code : 15);
+    if (code >= 15)
+        op = writeLength(op, code - 15);
+    return op;
+}
+
+size_t lzCompress(const void *src, size_t size, void *dst, size_t capacity)
+{
+    const uint8_t *base = (const uint8_t *)src;
+    const uint8_t *ip = base, *anchor = base;
+    const uint8_t *end = base + size;
+    uint8_t *op = (uint8_t *)dst;
+    const uint8_t *oend = op + capacity;
+    if (size > LZ_MAX_BLOCK)
+        return 0;
+
+    if (size > END_LITERALS + MIN_MATCH)
+    {
+        uint16_t table[1 << HASH_BITS];
+        memset(table, 0, sizeof(table));
+        const uint8_t *searchEnd = end - END_LITERALS - MIN_MATCH;
+        unsigned misses = 0;
+        ip++;
+        while (ip < searchEnd)
+        {
+            uint32_t sequence = read32(ip);
+            uint32_t h = hash4(sequence);
+            const uint8_t *ref = base + table[h];
+            table[h] = (uint16_t)(ip - base);
+            if (ref >= ip || ip - ref > MAX_OFFSET || read32(ref) != sequence)
+            {
+                ip += 1 + (misses++ >> SKIP_TRIGGER);
+                continue;
+            }
+            misses = 0;
+
+            // Extend backwards over literals that also match, then forwards.
+            while (ip > anchor && ref > base && ip[-1] == ref[-1])
+            {
+                ip--;
+                ref--;
+            }
+            const uint8_t *matchEnd = ip + MIN_MATCH;
+            matchEnd += commonLength(matchEnd, ref + MIN_MATCH, end - END_LITERALS);
+
+            op = writeSequence(op, oend, anchor, (size_t)(ip - anchor), end, (size_t)(ip - ref),
+                               (size_t)(matchEnd - ip));
+            if (!op)
+                return 0;
+            ip = anchor = matchEnd;
+            if (ip < searchEnd)
+                table[hash4(read32(ip - 2))] = (uint16_t)(ip - 2 - base);
+        }
+    }
+
+    op = writeSequence(op, oend, anchor, (size_t)(end - anchor), end, 0, 0);
+    return op ? (size_t)(op - (uint8_t *)dst) : 0;
+}
+
+// Reads a length continued in extra bytes; returns 0 if the input ends first.
+static int readLength(const uint8_t **ip, const uint8_t *iend, size_t *length)
+{
+    uint8_t b;
+    do
+    {
+        if (*ip >= iend)
+            return 0;
+        b = *(*ip)++;
+        *length += b;
+    } while (b == 255);
+    return 1;
+}
+
+long lzDecompress(const void *src, size_t size, void *dst, size_t capacity)
+{
+    const uint8_t *ip = (const uint8_t *)src;
+    const uint8_t *iend = ip + size;
+    uint8_t *out = (uint8_t *)dst;
+    uint8_t *op = out;
+    const uint8_t *oend = out + capacity;
+
+    while (ip < iend)
+    {
+        uint8_t token = *ip++;
+        size_t length = token >> 4;
+        if (length == 15 && !readLength(&ip, iend, &length))
+            return -1;
+        if (length > (size_t)(iend - ip) || length > (size_t)(oend - op))
+            return -1;
+        if (length <= 16 && iend - ip >= 16 && oend - op >= 16)
+            memcpy(op, ip, 16); // Fixed size: a couple of moves instead of a call
+        else
+            memcpy(op, ip, length);
+        ip += length;
+        op += length;
+        if (ip == iend)
+            break; // The last sequence has no match
+
+        if (iend - ip < 2)
+            return -1;
+        size_t offset = (size_t)ip[0] | (size_t)ip[1] << 8;
+        ip += 2;
+        length = token & 15;
+        if (length == 15 && !readLength(&ip, iend, &length))
+            return -1;
+        length += MIN_MATCH;
+        if (offset == 0 || offset > (size_t)(op - out) || length > (size_t)(oend - op))
+            return -1;
+        const uint8_t *match = op - offset;
+        if (offset >= 8 && (size_t)(oend - op) >= length + 8)
+        {
+            // Eight bytes per step, possibly past the end of the match into space
+            // the next sequence overwrites. Steps never overlap at this offset.
+            for (size_t i = 0; i < length; i += 8)
+                memcpy(op + i, match + i, 8);
+        }
+        else
+        {
+            // Overlapping: the match repeats bytes it is itself writing.
+            for (size_t i = 0; i < length; i++)
+                op[i] = match[i];
+        }
+        op += length;
+    }
+    return (long)(op - out);
+}
@@ -0,0 +1,24 @@
+// File: lz.h
+// Description: Fast LZ77 block compression for backup chunks, in the style of LZ4:
+// a block is a run of sequences, each a token byte, literal bytes copied as they
+// are, and a back-reference (2-byte offset, length) into the output so far. Blocks
+// are compressed independently and are at most 64 KB, so offsets always fit.
+
+#ifndef LZ_H
+#define LZ_H
+
+#include <stddef.h>
+
+#define LZ_MAX_BLOCK (64 * 1024)
+
+// Compresses 'size' bytes (at most LZ_MAX_BLOCK) into dst. Returns the compressed
+// size, or 0 if it would not fit in 'capacity', so callers can ask for a minimum
+// saving by passing a smaller capacity than the input.
+size_t lzCompress(const void *src, size_t size, void *dst, size_t capacity);
+
+// Decompresses a block into dst. Returns the decompressed size, or -1 if the block
+// is malformed or does not fit in 'capacity'. Never reads or writes out of bounds,
+// whatever the input.
+long lzDecompress(const void *src, size_t size, void *dst, size_t capacity);
+
+#endif // LZ_H
@@ -1,6 +1,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
 #include "utils.h"
 #include "vehicle.h"
@@ -15,15 +18,36 @@
 #include "alert.h"
 #include "backup.h"
 #include "complaint.h"
+#include "threadpool.h"
+#include "idalloc.h"
+#include "snapshot.h"
+#include "batch.h"
+#include "server.h"
+#include "loadgen.h"
+#include "backupbench.h"
+#include "asyncio.h"
+#include "journal.h"
+#include "dirty.h"
+#include "lazyload.h"
+#include "invoiceview.h"
+#include "bookingstress.h"
 
 Vehicle *vehicleHead = NULL;
 Customer *customerHead = NULL;
-Rental *rentalHead = NULL;
+RentalTable rentalTable = {0};
 Promo *promoHead = NULL;
 Driver *driverHead = NULL;
 Invoice *invoiceHead = NULL;
 Route *routeHead = NULL;
-Complaint *complaintHead = NULL;
+ComplaintTable complaintTable = {0};
+
+// Id indexes over the tables a journal replay updates, so a long replay does not
+// scan them once per row.
+typedef struct
+{
+    IdMap rentals;
+    IdMap invoices;
+} ReplayIndex;
 
 static void displayMainMenu(void);
 static void adminMenu(void);
@@ -31,22 +55,185 @@ static void adminRentalsMenu(void);
 static void adminDriverMenu(Driver **driverHead);
 static void adminInvoiceMenu(Invoice **invoiceHead);
 static void customerMenu(Customer *current);
+static void saveTables(void);
+static void saveAllData(void);
+static void writeBackupSnapshot(void);
+static void persistChanges(void);
+static void freeAllData(void);
+static void applyJournalRecord(char kind, char *row, void *ctx);
+static void discardJournalRecord(char kind, char *row, void *ctx);
+static int runBatchMode(const char *path, int threads, FILE *results);
+static int runServerMode(const char *socketPath);
+static int runLoadGenMode(int argc, char **argv);
+static int runBackupBenchMode(int argc, char **argv);
+static int runRecoveryBenchMode(int argc, char **argv);
+static int runKernelCheckMode(int argc, char **argv);
+static int runBookingStressMode(int argc, char **argv);
+static int runSnapshotStressMode(int argc, char **argv);
+static int finishRestore(const char *name, const char *recoverTo, long replayed, double seconds[3]);
+static double monotonicSeconds(void);
 
-int main(void)
+int main(int argc, char **argv)
 {
+    // ridemate --loadgen [socket] [options]: drive a running server; needs no data.
+    if (argc >= 2 && strcmp(argv[1], "--loadgen") == 0)
+        return runLoadGenMode(argc, argv);
+
+    // ridemate --bench-backup [--size MB] [--dir PATH]: time backups and restores of a
+    // synthetic data set; touches no real data.
+    if (argc >= 2 && strcmp(argv[1], "--bench-backup") == 0)
+        return runBackupBenchMode(argc, argv);
+
+    // ridemate --bench-recovery [--rows MAX] [--dir PATH]: time --recover over growing
+    // journal lengths, on a scratch copy of the data files here.
+    if (argc >= 2 && strcmp(argv[1], "--bench-recovery") == 0)
+        return runRecoveryBenchMode(argc, argv);
+
+    // ridemate --check-kernels [--rows N]: run the invoice statistics kernels for each
+    // instruction set on synthetic rows and check they agree; needs no data.
+    if (argc >= 2 && strcmp(argv[1], "--check-kernels") == 0)
+        return runKernelCheckMode(argc, argv);
+
+    // ridemate --stress-booking [--threads N] [--vehicles N] [--bookings N]: book a few
+    // shared vehicles from many threads and check for double bookings and repeated
+    // ids; works on an in-memory table and touches no data.
+    if (argc >= 2 && strcmp(argv[1], "--stress-booking") == 0)
+        return runBookingStressMode(argc, argv);
+
+    // ridemate --stress-snapshot [--writers N] [--vehicles N] [--seconds S]: read report
+    // snapshots twice while writers book and complete, and check both reads agree;
+    // touches no data.
+    if (argc >= 2 && strcmp(argv[1], "--stress-snapshot") == 0)
+        return runSnapshotStressMode(argc, argv);
+
+    // ridemate --batch [file] [--threads N]: run JSON-lines commands from file (or
+    // stdin) through an N-thread pipeline and exit.
+    int batchMode = argc >= 2 && strcmp(argv[1], "--batch") == 0;
+    int serverMode = argc >= 2 && strcmp(argv[1], "--server") == 0;
+    if (serverMode)
+        blockServerSignals(); // Before the journal and I/O threads start
+    FILE *batchResults = NULL;
+    if (batchMode)
+    {
+        // The loaders and savers report progress with printf. Keep the real stdout
+        // for result lines only and send everything else to stderr.
+        fflush(stdout);
+        batchResults = fdopen(dup(STDOUT_FILENO), "w");
+        if (!batchResults || dup2(STDERR_FILENO, STDOUT_FILENO) < 0)
+        {
+            fprintf(stderr, "Error: could not set up batch output\n");
+            return 1;
+        }
+    }
+
+    // ridemate --restore NAME: load the data straight from backup NAME instead of the
+    // data files, write it out as the new data files and exit.
+    // ridemate --recover "YYYY-MM-DD HH:MM[:SS]": the same with the newest backup taken
+    // before that time, plus the journaled changes made between the two.
+    const char *restoreName = !batchMode && argc >= 3 && strcmp(argv[1], "--restore") == 0 ? argv[2] : NULL;
+    const char *recoverTo = !batchMode && argc >= 3 && strcmp(argv[1], "--recover") == 0 ? argv[2] : NULL;
+    char recoverFrom[128];
+    time_t recoverAt = 0, backupCreated = 0;
+    long backupSequence = 0;
+    if (recoverTo)
+    {
+        if (!stringToTime(recoverTo, &recoverAt))
+        {
+            printf("Error: expected a time like \"2025-06-01 14:30\", not '%s'\n", recoverTo);
+            return 1;
+        }
+        if (!findBackupBefore(recoverAt, recoverFrom, sizeof(recoverFrom), &backupCreated, &backupSequence))
+        {
+            printf("Error: no backup with a journal position was taken before %s\n", recoverTo);
+            return 1;
+        }
+        restoreName = recoverFrom;
+    }
+    // A restore that a crash cut short is finished before anything is read.
+    if (finishInterruptedRestore() < 0)
+    {
+        printf("Error: an interrupted restore in restore.staging/ could not be finished\n");
+        return 1;
+    }
+    double phaseStart = monotonicSeconds();
+    double seconds[3] = {0}; // Loading, replaying the journal, saving
+    if (restoreName && !beginBackupLoad(restoreName))
+    {
+        printf("Error: backup '%s' not found or could not be read\n", restoreName);
+        return 1;
+    }
+
+    // Journaled rows and a restored backup may belong to any month, so RIDEMATE_LOAD_MONTHS
+    // only applies to a clean start.
+    struct stat journal;
+    int replaying = restoreName || (stat(JOURNAL_FILE, &journal) == 0 && journal.st_size > 0);
+    setLoadAllPartitions(replaying);
+    // RIDEMATE_ARCHIVE_MONTHS=N moves settled months older than N months into the
+    // cold tier (archive.h) before the rentals are read; likewise only on a clean start.
+    const char *archiveMonths = getenv("RIDEMATE_ARCHIVE_MONTHS");
+    if (!replaying && archiveMonths && atoi(archiveMonths) > 0 && archiveRentals(atoi(archiveMonths)) < 0)
+        printf("Warning: rentals could not be archived; they stay where they are.\n");
+    loadIdAllocator();
     loadVehicles(&vehicleHead);
     loadCustomers(&customerHead);
-    loadRentals(&rentalHead);
-    loadRoutes(&routeHead);
-    loadPromos(&promoHead);
+    loadRentals(&rentalTable);
     loadDrivers(&driverHead);
-    loadInvoices(&invoiceHead);
-    loadComplaints(&complaintHead);
+    // Routes, promo codes, invoices and complaints wait for their first use
+    // (lazyload.h), except when a backup or the journal needs all of them now.
+    if (replaying)
+        loadAllLazyTables();
+    deferLazyTables();
+    if (restoreName && !endBackupLoad())
+    {
+        printf("Error: backup '%s' is damaged; nothing was restored\n", restoreName);
+        freeAllData();
+        return 1;
+    }
+    seconds[0] = monotonicSeconds() - phaseStart;
+    ReplayIndex replayIndex;
+    idMapInit(&replayIndex.rentals);
+    idMapInit(&replayIndex.invoices);
+    long replayed = 0;
+    if (recoverTo)
+    {
+        phaseStart = monotonicSeconds();
+        replayed = replayMutationLog(backupSequence, backupCreated, recoverAt, applyJournalRecord, &replayIndex);
+        seconds[1] = monotonicSeconds() - phaseStart;
+    }
+    // After a restore, the journal describes the data that was just replaced.
+    journalStart(restoreName ? discardJournalRecord : applyJournalRecord, &replayIndex);
+    idMapFree(&replayIndex.rentals);
+    idMapFree(&replayIndex.invoices);
+    asyncIoStart();
+    if (restoreName)
+        return finishRestore(restoreName, recoverTo, replayed, seconds);
+    setOnlineBackupWriter(writeBackupSnapshot);
+
+    if (batchMode)
+    {
+        const char *path = "-";
+        int threads = 1;
+        for (int i = 2; i < argc; i++)
+        {
+            if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+                threads = atoi(argv[++i]);
+            else
+                path = argv[i];
+        }
+        return runBatchMode(path, threads, batchResults);
+    }
+
+    // ridemate --server [socket]: answer batch commands over a Unix socket until
+    // Ctrl+C, then save.
+    if (serverMode)
+        return runServerMode(argc >= 3 ? argv[2] : SERVER_DEFAULT_SOCKET);
 
+    backupIfDue();
     int running = 1;
     while (running)
     {
         displayMainMenu();
+        startLazyPrefetch();
         int choice = getIntegerInput("Enter your choice: ", 1, 4);
 
         switch (choice)
@@ -94,23 +281,12 @@ int main(void)
         }
         case 4:
             printf("\nSaving all data...\n");
-            saveVehicles(vehicleHead);
-            saveCustomers(customerHead);
-            saveRentals(rentalHead);
-            saveRoutes(routeHead);
-            savePromos(promoHead);
-            saveDrivers(driverHead);
-            saveInvoices(invoiceHead);
-            saveComplaints(complaintHead);
-
-            freeVehicleList(&vehicleHead);
-            freeCustomerList(&customerHead);
-            freeRentalList(&rentalHead);
-            freeRouteList(&routeHead);
-            freePromoList(&promoHead);
-            freeDriverList(&driverHead);
-            freeInvoiceList(&invoiceHead);
-            freeComplaintList(&complaintHead);
+            saveAllData();
+            backupIfDue();
+            freeAllData();
+            char saveCounters[160];
+            describeSaveCounters(saveCounters, sizeof(saveCounters));
+            printf("%s\n", saveCounters);
 
             printf("Exiting RideMate. Goodbye!\n");
             running = 0;
@@ -120,6 +296,252 @@ int main(void)
     return 0;
 }
 
+// Writes every data file. Also runs in the background-save and online-backup
+// children, so it must stay free of prompts, the thread pool and locks.
+static void saveTables(void)
+{
+    saveVehicles(vehicleHead);
+    saveCustomers(customerHead);
+    saveRentals(&rentalTable);
+    if (lazyTableLoaded(LAZY_ROUTES))
+        saveRoutes(routeHead);
+    if (lazyTableLoaded(LAZY_PROMOS))
+        savePromos(promoHead);
+    saveDrivers(driverHead);
+    if (lazyTableLoaded(LAZY_INVOICES))
+        saveInvoices(invoiceHead);
+    if (lazyTableLoaded(LAZY_COMPLAINTS))
+        saveComplaints(&complaintTable);
+    saveIdAllocator();
+}
+
+static void saveAllData(void)
+{
+    saveTables();
+    saveJournalCheckpoint();
+}
+
+// The online-backup writer: the tables as they are in this process's memory. The
+// checkpoint is left alone, since none of this reaches the data files. The text heap
+// is never rewritten, only appended to, so its first text.size bytes are all the
+// complaints refer to. Tables not loaded yet are taken from their files.
+static void writeBackupSnapshot(void)
+{
+    saveTables();
+    if (lazyTableLoaded(LAZY_COMPLAINTS))
+        captureBackupFile(COMPLAINT_TEXT_FILE, (long long)complaintTable.text.size);
+}
+
+// Writes out the data a restore or recovery loaded, backs it up and exits.
+static int finishRestore(const char *name, const char *recoverTo, long replayed, double seconds[3])
+{
+    double started = monotonicSeconds();
+    markAllDirty();
+    saveAllData();
+    seconds[2] = monotonicSeconds() - started;
+    // Later recoveries have to start from here: the journal does not record the
+    // restore itself, so replaying it over an older backup would undo it.
+    char backupName[128];
+    BackupStats stats;
+    int backedUp = createBackup(backupName, sizeof(backupName), &stats);
+    freeAllData();
+
+    if (recoverTo)
+        printf("Recovered the data as of %s: backup '%s' plus %ld journaled changes\n", recoverTo, name, replayed);
+    else
+        printf("Restored the data from backup '%s'\n", name);
+    printf("Recovery took %.1f ms: load %.1f ms, replay %.1f ms, save %.1f ms\n",
+           (seconds[0] + seconds[1] + seconds[2]) * 1000.0, seconds[0] * 1000.0, seconds[1] * 1000.0,
+           seconds[2] * 1000.0);
+    if (backedUp)
+        printf("Backup '%s' holds the restored data\n", backupName);
+    else
+        printf("Warning: the restored data could not be backed up; recoveries to a later time may miss it\n");
+    return 0;
+}
+
+static double monotonicSeconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+// Replays one row journaled after the last save over the freshly loaded data. ctx is
+// the ReplayIndex shared by all rows of the replay.
+static void applyJournalRecord(char kind, char *row, void *ctx)
+{
+    ReplayIndex *index = (ReplayIndex *)ctx;
+    int applied = 0;
+    if (kind == JOURNAL_RENTAL)
+        applied = applyJournaledRental(&rentalTable, vehicleHead, row, &index->rentals);
+    else if (kind == JOURNAL_INVOICE)
+        applied = applyJournaledInvoice(loadedInvoices(), row, &index->invoices);
+    else if (kind == JOURNAL_DRIVER)
+        applied = applyJournaledDriver(&driverHead, row);
+    if (!applied)
+        printf("Warning: skipped journal row %c,%s\n", kind, row);
+}
+
+// The journal holds changes to the data a restore just replaced; none of them apply.
+static void discardJournalRecord(char kind, char *row, void *ctx)
+{
+    (void)kind;
+    (void)row;
+    (void)ctx;
+}
+
+// Saves after a change made from the menus. In background mode (the default;
+// RIDEMATE_BACKGROUND_SAVE=0 turns it off) a forked child writes a snapshot of
+// the changed files and the menu returns at once. Nothing happens if the action
+// changed nothing, e.g. a booking that was turned down.
+static void persistChanges(void)
+{
+    if (!anyTableDirty())
+        return;
+    // Before the save: the changes are in the journal already, and the backup does
+    // not have to wait for the save to finish.
+    backupIfDue();
+    const char *mode = getenv("RIDEMATE_BACKGROUND_SAVE");
+    int background = !mode || strcmp(mode, "0") != 0;
+    if (!background || !startBackgroundSave(saveAllData))
+        saveAllData();
+}
+
+// Prints the queued writes that failed since the last call; successful ones are silent.
+static void reportAsyncIoFailures(void)
+{
+    AsyncIoCompletion done[32];
+    int n;
+    while ((n = asyncIoPoll(done, 32)) > 0)
+    {
+        for (int i = 0; i < n; i++)
+        {
+            if (!done[i].ok)
+                printf("Error: could not write %s (%s)\n", done[i].path, strerror(done[i].error));
+        }
+    }
+}
+
+static void freeAllData(void)
+{
+    waitOnlineBackup();
+    journalStop();
+    stopLazyPrefetch();
+    asyncIoDrain();
+    reportAsyncIoFailures();
+    asyncIoStop();
+    freeVehicleList(&vehicleHead);
+    freeCustomerList(&customerHead);
+    freeRentalTable(&rentalTable);
+    freeRouteList(&routeHead);
+    freePromoList(&promoHead);
+    freeDriverList(&driverHead);
+    freeInvoiceList(&invoiceHead);
+    freeComplaintTable(&complaintTable);
+    threadPoolShutdown();
+}
+
+// Results go to 'results' (the original stdout), one line per command; the summary
+// goes to stderr. Everything is saved once, after the last command.
+static int runBatchMode(const char *path, int threads, FILE *results)
+{
+    FILE *in = stdin;
+    if (strcmp(path, "-") != 0)
+    {
+        in = fopen(path, "r");
+        if (!in)
+        {
+            fprintf(stderr, "Error: could not open %s\n", path);
+            fclose(results);
+            freeAllData();
+            return 1;
+        }
+    }
+
+    BatchStats stats;
+    BatchModel model = {&rentalTable, vehicleHead, customerHead, *loadedPromos(), driverHead, loadedInvoices()};
+    runBatch(in, results, threads, &model, &stats);
+    if (in != stdin)
+        fclose(in);
+    fclose(results);
+
+    saveAllData();
+    backupIfDue();
+    char journalStatus[256];
+    describeJournalStatus(journalStatus, sizeof(journalStatus));
+    freeAllData();
+    char saveCounters[160];
+    describeSaveCounters(saveCounters, sizeof(saveCounters));
+
+    fflush(stdout);
+    printBatchStats(stderr, &stats);
+    fprintf(stderr, "%s\n%s\n", journalStatus, saveCounters);
+    return 0;
+}
+
+static int runServerMode(const char *socketPath)
+{
+    BatchModel model = {&rentalTable, vehicleHead, customerHead, *loadedPromos(), driverHead, loadedInvoices()};
+    int result = runServer(socketPath, &model);
+    char journalStatus[256];
+    describeJournalStatus(journalStatus, sizeof(journalStatus));
+    printf("%s\n", journalStatus);
+    if (result == 0)
+    {
+        saveAllData();
+        backupIfDue();
+    }
+    freeAllData();
+    describeSaveCounters(journalStatus, sizeof(journalStatus));
+    printf("%s\n", journalStatus);
+    return result;
+}
+
+// ridemate --loadgen [socket] [--clients N] [--requests M] [--customer ID] [--vehicle FIRST]
+static int runLoadGenMode(int argc, char **argv)
+{
+    LoadGenOptions options = {SERVER_DEFAULT_SOCKET, 100, 100, 1, 1};
+    for (int i = 2; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--clients") == 0 && i + 1 < argc)
+            options.clients = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--requests") == 0 && i + 1 < argc)
+            options.requestsPerClient = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--customer") == 0 && i + 1 < argc)
+            options.customerId = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--vehicle") == 0 && i + 1 < argc)
+            options.firstVehicle = atoi(argv[++i]);
+        else
+            options.socketPath = argv[i];
+    }
+    if (options.clients < 1 || options.requestsPerClient < 1)
+    {
+        printf("Error: --clients and --requests must be at least 1\n");
+        return 1;
+    }
+    return runLoadGen(&options);
+}
+
+// ridemate --bench-backup [--size MB] [--dir PATH]
+static int runBackupBenchMode(int argc, char **argv)
+{
+    BackupBenchOptions options = {".", 256};
+    for (int i = 2; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--size") == 0 && i + 1 < argc)
+            options.megabytes = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--dir") == 0 && i + 1 < argc)
+            options.directory = argv[++i];
+    }
+    if (options.megabytes < 1)
+    {
+        printf("Error: --size must be at least 1 (MB)\n");
+        return 1;
+    }
+    return runBackupBenchmark(&options);
+}
+
 static void displayMainMenu(void)
 {
     clearScreen();
@@ -140,7 +562,17 @@ static void adminMenu(void)
     {
         clearScreen();
 
-        displayAdminAlerts(rentalHead, vehicleHead);
+        displayAdminAlerts(&rentalTable, vehicleHead);
+        char saveStatus[256];
+        describeSnapshotStatus(saveStatus, sizeof(saveStatus));
+        printf("%s\n", saveStatus);
+        describeAsyncIoStatus(saveStatus, sizeof(saveStatus));
+        printf("%s\n", saveStatus);
+        describeJournalStatus(saveStatus, sizeof(saveStatus));
+        printf("%s\n", saveStatus);
+        describeSaveCounters(saveStatus, sizeof(saveStatus));
+        printf("%s\n", saveStatus);
+        reportAsyncIoFailures();
 
         printf("\n--- Admin Panel ---\n");
         printf("1. Manage Vehicles & Routes\n");
@@ -161,7 +593,7 @@ static void adminMenu(void)
         switch (choice)
         {
         case 1:
-            adminVehicleMenu(&vehicleHead, rentalHead);
+            adminVehicleMenu(&vehicleHead, &rentalTable);
             break;
         case 2:
             adminCustomerMenu(&customerHead);
@@ -171,21 +603,21 @@ static void adminMenu(void)
             adminRentalsMenu();
             break;
         case 4:
-            adminSearchMenu(vehicleHead, rentalHead);
+            adminSearchMenu(vehicleHead, &rentalTable);
             break;
         case 5:
-            showAdminDashboard(vehicleHead, customerHead, rentalHead);
+            showAdminDashboard(vehicleHead, customerHead, &rentalTable);
             pressEnterToContinue();
             break;
         case 6:
-            adminReportsMenu(vehicleHead, customerHead, rentalHead);
+            adminReportsMenu(vehicleHead, customerHead, &rentalTable);
             break;
         case 7:
-            adminPromoMenu(&promoHead);
+            adminPromoMenu(loadedPromos());
             savePromos(promoHead);
             break;
         case 8:
-            showBookingCalendar(vehicleHead, rentalHead);
+            showBookingCalendar(vehicleHead, &rentalTable);
             pressEnterToContinue();
             break;
         case 9:
@@ -193,13 +625,15 @@ static void adminMenu(void)
             saveDrivers(driverHead);
             break;
         case 10:
-            adminInvoiceMenu(&invoiceHead);
+            adminInvoiceMenu(loadedInvoices());
             saveInvoices(invoiceHead);
             break;
         case 11:
-            adminComplaintMenu(&complaintHead, rentalHead);
+            adminComplaintMenu(loadedComplaints(), &rentalTable);
             break;
         case 12:
+            // Backups copy the data files, so bring them up to date first.
+            finishBackgroundSaves();
             adminBackupMenu();
             break;
         case 13:
@@ -224,19 +658,15 @@ static void adminRentalsMenu(void)
         switch (choice)
         {
         case 1:
-            listAllRentals(rentalHead);
+            listAllRentals(&rentalTable);
             break;
         case 2:
-            completeRentalPrompt(rentalHead, vehicleHead, driverHead);
-            saveRentals(rentalHead);
-            saveVehicles(vehicleHead);
-            saveDrivers(driverHead);
+            completeRentalPrompt(&rentalTable, vehicleHead, driverHead);
+            persistChanges();
             break;
         case 3:
-            cancelRentalPrompt(rentalHead, vehicleHead, driverHead);
-            saveRentals(rentalHead);
-            saveVehicles(vehicleHead);
-            saveDrivers(driverHead);
+            cancelRentalPrompt(&rentalTable, vehicleHead, driverHead);
+            persistChanges();
             break;
         case 4:
             running = 0;
@@ -253,6 +683,7 @@ static void customerMenu(Customer *current)
     while (running)
     {
         clearScreen();
+        reportAsyncIoFailures();
         printf("\n--- Customer Panel (Welcome, %s) ---\n", current->name);
         printf("1. View My Profile\n");
         printf("2. Update My Profile\n");
@@ -283,26 +714,27 @@ static void customerMenu(Customer *current)
             break;
         }
         case 5:
-            createRentalByCustomer(&rentalHead, vehicleHead, current, promoHead, driverHead, &invoiceHead);
-            saveRentals(rentalHead);
-            saveVehicles(vehicleHead);
-            saveDrivers(driverHead);
-            saveInvoices(invoiceHead);
+            createRentalByCustomer(&rentalTable, vehicleHead, current, *loadedPromos(), driverHead, loadedInvoices());
+            persistChanges();
             break;
         case 6:
-            displayRentalsByCustomer(rentalHead, current->id);
+            displayRentalsByCustomer(&rentalTable, current->id);
             break;
         case 7:
         {
             // Show customer's rentals first
-            displayRentalsByCustomer(rentalHead, current->id);
-            if (rentalHead)
+            displayRentalsByCustomer(&rentalTable, current->id);
+            if (rentalTable.count > 0)
             {
                 int rentalId = getIntegerInput("\nEnter Rental ID to file complaint for: ", 5001, 9999);
-                Rental *rental = findRentalById(rentalHead, rentalId);
+                Rental *rental = findRentalById(&rentalTable, rentalId);
+                Rental archived;
+                RentalDetail archivedDetail;
+                if (!rental && fetchArchivedRental(&rentalTable, rentalId, &archived, &archivedDetail))
+                    rental = &archived;
                 if (rental && rental->customerId == current->id)
                 {
-                    fileComplaint(&complaintHead, rentalId, current->id);
+                    fileComplaint(loadedComplaints(), rentalId, current->id);
                 }
                 else
                 {
@@ -316,7 +748,7 @@ static void customerMenu(Customer *current)
             break;
         }
         case 8:
-            viewCustomerComplaints(complaintHead, current->id);
+            viewCustomerComplaints(loadedComplaints(), current->id);
             break;
         case 9:
             running = 0;
@@ -445,4 +877,82 @@ static void adminInvoiceMenu(Invoice **invoiceHead)
         if (running)
             pressEnterToContinue();
     }
-}
\ No newline at end of file
+}
+
+// ridemate --bench-recovery [--rows MAX] [--dir PATH]
+static int runRecoveryBenchMode(int argc, char **argv)
+{
+    RecoveryBenchOptions options = {".", 100000};
+    for (int i = 2; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--rows") == 0 && i + 1 < argc)
+            options.maxRows = atol(argv[++i]);
+        else if (strcmp(argv[i], "--dir") == 0 && i + 1 < argc)
+            options.directory = argv[++i];
+    }
+    if (options.maxRows < 0)
+    {
+        printf("Error: --rows must not be negative\n");
+        return 1;
+    }
+    return runRecoveryBenchmark(&options);
+}
+
+// ridemate --check-kernels [--rows N]
+static int runKernelCheckMode(int argc, char **argv)
+{
+    long rows = 1000000;
+    for (int i = 2; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--rows") == 0 && i + 1 < argc)
+            rows = atol(argv[++i]);
+    }
+    if (rows < 1)
+    {
+        printf("Error: --rows must be at least 1\n");
+        return 1;
+    }
+    return invoiceKernelCheck((size_t)rows);
+}
+
+// ridemate --stress-booking [--threads N] [--vehicles N] [--bookings N]
+static int runBookingStressMode(int argc, char **argv)
+{
+    BookingStressOptions options = {16, 8, 1000};
+    for (int i = 2; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+            options.threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--vehicles") == 0 && i + 1 < argc)
+            options.vehicles = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--bookings") == 0 && i + 1 < argc)
+            options.bookings = atoi(argv[++i]);
+    }
+    if (options.threads < 1 || options.vehicles < 1 || options.bookings < 1)
+    {
+        printf("Error: --threads, --vehicles and --bookings must be at least 1\n");
+        return 1;
+    }
+    return runBookingStress(&options);
+}
+
+// ridemate --stress-snapshot [--writers N] [--vehicles N] [--seconds S]
+static int runSnapshotStressMode(int argc, char **argv)
+{
+    SnapshotStressOptions options = {8, 64, 3};
+    for (int i = 2; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--writers") == 0 && i + 1 < argc)
+            options.writers = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--vehicles") == 0 && i + 1 < argc)
+            options.vehicles = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc)
+            options.seconds = atoi(argv[++i]);
+    }
+    if (options.writers < 1 || options.seconds < 1 || options.vehicles < options.writers)
+    {
+        printf("Error: --writers and --seconds must be at least 1, and --vehicles at least --writers\n");
+        return 1;
+    }
+    return runSnapshotStress(&options);
+}
@@ -0,0 +1,77 @@
+#include "money.h"
+#include <ctype.h>
+#include <stdio.h>
+
+int parseHundredths(const char *text, int64_t *out)
+{
+    if (!text)
+        return 0;
+    while (isspace((unsigned char)*text))
+        text++;
+
+    int negative = 0;
+    if (*text == '-' || *text == '+')
+    {
+        negative = (*text == '-');
+        text++;
+    }
+
+    int64_t whole = 0;
+    int digits = 0;
+    while (isdigit((unsigned char)*text))
+    {
+        whole = whole * 10 + (*text - '0');
+        text++;
+        digits++;
+    }
+
+    int64_t frac = 0;
+    if (*text == '.')
+    {
+        text++;
+        int fracDigits = 0;
+        while (isdigit((unsigned char)*text))
+        {
+            if (fracDigits < 2)
+                frac = frac * 10 + (*text - '0');
+            else if (fracDigits == 2 && *text >= '5')
+                frac++; // round on the third digit
+            fracDigits++;
+            digits++;
+            text++;
+        }
+        if (fracDigits == 1)
+            frac *= 10;
+    }
+
+    while (isspace((unsigned char)*text))
+        text++;
+    if (digits == 0 || *text != '\0')
+        return 0;
+
+    int64_t value = whole * 100 + frac;
+    *out = negative ? -value : value;
+    return 1;
+}
+
+int parseMoney(const char *text, Money *out)
+{
+    return parseHundredths(text, out);
+}
+
+void formatMoney(Money amount, char *buf, size_t size)
+{
+    snprintf(buf, size, MONEY_FMT, MONEY_ARGS(amount));
+}
+
+Money moneyApplyBasisPoints(Money amount, int64_t bps)
+{
+    int64_t product = amount * bps;
+    int64_t half = BPS_SCALE / 2;
+    return product >= 0 ? (product + half) / BPS_SCALE : -((-product + half) / BPS_SCALE);
+}
+
+Money moneyFromUnits(int64_t units)
+{
+    return units * MONEY_SCALE;
+}
@@ -0,0 +1,43 @@
+// File: money.h
+// Description: Fixed-point money type. Every amount in the model is an integer number
+// of cents, so sums are exact and do not depend on the order they are added in.
+
+#ifndef MONEY_H
+#define MONEY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef int64_t Money; // Amount in cents
+
+#define MONEY_SCALE 100
+#define MONEY_STR_SIZE 24
+
+// Basis points (1/100 of a percent). 1500 bps = 15%.
+#define BPS_SCALE 10000
+#define TAX_RATE_BPS 1500
+#define DRIVER_SHARE_BPS 3000
+
+// printf helpers for amounts without a field width: printf("$" MONEY_FMT, MONEY_ARGS(m))
+#define MONEY_FMT "%s%lld.%02lld"
+#define MONEY_ARGS(m) ((m) < 0 ? "-" : ""), (long long)(((m) < 0 ? -(m) : (m)) / MONEY_SCALE), \
+                      (long long)(((m) < 0 ? -(m) : (m)) % MONEY_SCALE)
+
+// Parses a decimal with up to two fractional digits ("12", "12.3", "-0.05") into
+// hundredths. Extra fractional digits are rounded half away from zero.
+// Returns 1 on success, 0 if the text is not a number.
+int parseHundredths(const char *text, int64_t *out);
+
+// Same as parseHundredths; named for call sites reading money.
+int parseMoney(const char *text, Money *out);
+
+// Writes "1234.50" / "-0.05" into buf (use MONEY_STR_SIZE).
+void formatMoney(Money amount, char *buf, size_t size);
+
+// amount * bps / 10000, rounded half away from zero.
+Money moneyApplyBasisPoints(Money amount, int64_t bps);
+
+// Whole units (dollars) from a count: moneyFromUnits(3) == 300 cents.
+Money moneyFromUnits(int64_t units);
+
+#endif // MONEY_H
@@ -0,0 +1,239 @@
+#include "mvcc.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Taking a snapshot and stamping a commit are serialized by this lock, so a snapshot
+// timestamp never covers a commit whose records are still being stamped. It is held
+// for a handful of loads and stores and never while taking another lock.
+static pthread_mutex_t clockLock = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t commitClock = 1;                        // Last timestamp handed out
+static uint64_t openSnapshots[MVCC_MAX_SNAPSHOTS];      // Timestamps; 0 marks a free slot
+
+typedef struct Retired
+{
+    void *ptr;
+    uint64_t ts; // commitClock when it was retired
+    struct Retired *next;
+} Retired;
+
+static pthread_mutex_t retireLock = PTHREAD_MUTEX_INITIALIZER;
+static Retired *retiredList;
+
+// Oldest open snapshot, or UINT64_MAX if none is open. clockLock held.
+static uint64_t oldestOpen(void)
+{
+    uint64_t oldest = UINT64_MAX;
+    for (int i = 0; i < MVCC_MAX_SNAPSHOTS; i++)
+    {
+        if (openSnapshots[i] && openSnapshots[i] < oldest)
+            oldest = openSnapshots[i];
+    }
+    return oldest;
+}
+
+void mvccBeginSnapshot(MvccSnapshot *snap)
+{
+    for (;;)
+    {
+        pthread_mutex_lock(&clockLock);
+        for (int i = 0; i < MVCC_MAX_SNAPSHOTS; i++)
+        {
+            if (!openSnapshots[i])
+            {
+                openSnapshots[i] = commitClock;
+                snap->ts = commitClock;
+                snap->slot = i;
+                pthread_mutex_unlock(&clockLock);
+                return;
+            }
+        }
+        pthread_mutex_unlock(&clockLock);
+        sched_yield();
+    }
+}
+
+void mvccEndSnapshot(MvccSnapshot *snap)
+{
+    pthread_mutex_lock(&clockLock);
+    openSnapshots[snap->slot] = 0;
+    pthread_mutex_unlock(&clockLock);
+    snap->slot = -1;
+    mvccReclaim();
+}
+
+int mvccRead(const MvccHeader *record, size_t size, const MvccSnapshot *snap, void *out)
+{
+    while (record)
+    {
+        uint64_t begin = __atomic_load_n(&record->beginTs, __ATOMIC_ACQUIRE);
+        if (begin == MVCC_UNCOMMITTED)
+        {
+            // A writer holds the record for a moment; its older version is only
+            // linked for certain once it has committed.
+            sched_yield();
+            continue;
+        }
+        if (begin > snap->ts)
+        {
+            record = __atomic_load_n(&record->older, __ATOMIC_ACQUIRE);
+            continue;
+        }
+        // A writer may claim the record while it is copied; the timestamp check
+        // afterwards catches that and the copy is taken again.
+        memcpy(out, record, size);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&record->beginTs, __ATOMIC_RELAXED) == begin)
+            return 1;
+    }
+    return 0;
+}
+
+uint64_t mvccClaim(MvccHeader *record)
+{
+    for (;;)
+    {
+        uint64_t begin = __atomic_load_n(&record->beginTs, __ATOMIC_ACQUIRE);
+        if (begin == MVCC_UNCOMMITTED)
+            sched_yield();
+        else if (__atomic_compare_exchange_n(&record->beginTs, &begin, MVCC_UNCOMMITTED, 0,
+                                             __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        {
+            // Orders the claim before the caller's changes, for mvccRead's check.
+            __atomic_thread_fence(__ATOMIC_RELEASE);
+            return begin;
+        }
+    }
+}
+
+void mvccRelease(MvccHeader *record, uint64_t previousTs)
+{
+    __atomic_store_n(&record->beginTs, previousTs, __ATOMIC_RELEASE);
+}
+
+int mvccPreserve(MvccHeader *record, size_t size, uint64_t previousTs)
+{
+    MvccHeader *version = (MvccHeader *)malloc(size);
+    if (!version)
+        return 0;
+    memcpy(version, record, size);
+    version->beginTs = previousTs;
+    // mvccTrim may unlink the chain at the same time; whatever is linked when the
+    // exchange succeeds is what the new version points to.
+    version->older = __atomic_load_n(&record->older, __ATOMIC_ACQUIRE);
+    while (!__atomic_compare_exchange_n(&record->older, &version->older, version, 1,
+                                        __ATOMIC_RELEASE, __ATOMIC_ACQUIRE))
+        ;
+    return 1;
+}
+
+void mvccCommit(MvccHeader *const *records, int count)
+{
+    pthread_mutex_lock(&clockLock);
+    uint64_t ts = ++commitClock;
+    for (int i = 0; i < count; i++)
+        __atomic_store_n(&records[i]->beginTs, ts, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&clockLock);
+}
+
+uint64_t mvccOldestSnapshot(void)
+{
+    pthread_mutex_lock(&clockLock);
+    uint64_t oldest = oldestOpen();
+    if (oldest == UINT64_MAX)
+        oldest = commitClock;
+    pthread_mutex_unlock(&clockLock);
+    return oldest;
+}
+
+int mvccTrim(MvccHeader *record, uint64_t oldest)
+{
+    MvccHeader *chain = __atomic_load_n(&record->older, __ATOMIC_ACQUIRE);
+    if (!chain)
+        return 1;
+    // Every open snapshot must see the record itself, not one of its older versions.
+    uint64_t begin = __atomic_load_n(&record->beginTs, __ATOMIC_ACQUIRE);
+    if (begin == MVCC_UNCOMMITTED || begin > oldest)
+        return 0;
+    if (!__atomic_compare_exchange_n(&record->older, &chain, NULL, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        return 0; // A writer just linked a newer version
+    while (chain)
+    {
+        MvccHeader *next = chain->older;
+        mvccRetire(chain);
+        chain = next;
+    }
+    return 1;
+}
+
+void mvccRetire(void *ptr)
+{
+    if (!ptr)
+        return;
+    pthread_mutex_lock(&clockLock);
+    uint64_t ts = commitClock;
+    int readers = oldestOpen() != UINT64_MAX;
+    pthread_mutex_unlock(&clockLock);
+    if (!readers)
+    {
+        free(ptr);
+        return;
+    }
+
+    Retired *node = (Retired *)malloc(sizeof(Retired));
+    if (!node)
+        return; // Leaked rather than freed under a reader
+    node->ptr = ptr;
+    node->ts = ts;
+    pthread_mutex_lock(&retireLock);
+    node->next = retiredList;
+    retiredList = node;
+    pthread_mutex_unlock(&retireLock);
+}
+
+void mvccReclaim(void)
+{
+    pthread_mutex_lock(&clockLock);
+    uint64_t oldest = oldestOpen();
+    pthread_mutex_unlock(&clockLock);
+
+    // A snapshot opened at or before the retire time may still hold the pointer.
+    pthread_mutex_lock(&retireLock);
+    Retired *freeable = NULL;
+    for (Retired **link = &retiredList; *link;)
+    {
+        Retired *node = *link;
+        if (node->ts < oldest)
+        {
+            *link = node->next;
+            node->next = freeable;
+            freeable = node;
+        }
+        else
+        {
+            link = &node->next;
+        }
+    }
+    pthread_mutex_unlock(&retireLock);
+
+    while (freeable)
+    {
+        Retired *next = freeable->next;
+        free(freeable->ptr);
+        free(freeable);
+        freeable = next;
+    }
+}
+
+void mvccDropVersions(MvccHeader *record)
+{
+    MvccHeader *chain = record->older;
+    record->older = NULL;
+    while (chain)
+    {
+        MvccHeader *next = chain->older;
+        free(chain);
+        chain = next;
+    }
+}
@@ -0,0 +1,75 @@
+// File: mvcc.h
+// Description: Multi-version records, so a report can read one point-in-time view of
+// the data while bookings, completions and payments keep committing. A versioned
+// record starts with an MvccHeader. A writer keeps a copy of the record's current
+// contents as an older version, changes the record in place and stamps the change
+// with a timestamp from one global commit clock. A reader takes a snapshot timestamp
+// and sees, for every record, the newest version committed at or before it.
+// Versions no open snapshot can see any more are unlinked, and their memory is freed
+// once the readers that might still hold a pointer to them have finished.
+
+#ifndef MVCC_H
+#define MVCC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// beginTs of a record while it is being written; readers wait for the commit.
+#define MVCC_UNCOMMITTED UINT64_MAX
+// beginTs of a stale copy of a new record that will be committed elsewhere, after
+// every snapshot that can still reach the copy; readers skip it.
+#define MVCC_INVISIBLE (UINT64_MAX - 1)
+
+// Snapshots open at the same time. Further readers wait for one to end.
+#define MVCC_MAX_SNAPSHOTS 64
+
+typedef struct MvccHeader
+{
+    uint64_t beginTs;         // Commit timestamp of this version; 0 for records loaded from disk
+    struct MvccHeader *older; // The version this one replaced, or NULL
+} MvccHeader;
+
+typedef struct
+{
+    uint64_t ts; // Sees every commit stamped at or before this
+    int slot;
+} MvccSnapshot;
+
+// --- Readers ---
+void mvccBeginSnapshot(MvccSnapshot *snap);
+void mvccEndSnapshot(MvccSnapshot *snap);
+
+// Copies the version of 'record' visible in 'snap' into 'out'. 'record' is a struct
+// of 'size' bytes that starts with its header. Returns 0 if the record was created
+// after the snapshot was taken.
+int mvccRead(const MvccHeader *record, size_t size, const MvccSnapshot *snap, void *out);
+
+// --- Writers ---
+// Claims a committed record for an update, waiting out another writer's claim, and
+// returns the record's timestamp. Until mvccCommit or mvccRelease, only the claiming
+// thread may change the record; readers keep seeing the committed versions.
+uint64_t mvccClaim(MvccHeader *record);
+// Gives a claim back without having changed anything.
+void mvccRelease(MvccHeader *record, uint64_t previousTs);
+// Keeps the claimed record's current contents as an older version for the snapshots
+// that must not see the update. Returns 0 if out of memory.
+int mvccPreserve(MvccHeader *record, size_t size, uint64_t previousTs);
+// Stamps claimed records, and new ones created with beginTs MVCC_UNCOMMITTED, with
+// one new timestamp, so a snapshot sees either all of them or none.
+void mvccCommit(MvccHeader *const *records, int count);
+
+// --- Reclamation ---
+// Timestamp of the oldest open snapshot, or of the next one if none is open.
+uint64_t mvccOldestSnapshot(void);
+// Unlinks the older versions of 'record' if no snapshot at or after 'oldest' needs
+// them. Returns 1 if the record has no older versions left.
+int mvccTrim(MvccHeader *record, uint64_t oldest);
+// Frees 'ptr' once every snapshot open right now has ended.
+void mvccRetire(void *ptr);
+// Frees the retired memory no open snapshot can reach. mvccEndSnapshot calls this.
+void mvccReclaim(void);
+// Frees the older versions of 'record' at once. Only while no snapshot is open,
+// e.g. when the data is unloaded.
+void mvccDropVersions(MvccHeader *record);
+
+#endif // MVCC_H
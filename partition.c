@@ -0,0 +1,353 @@
+#include "partition.h"
+#include "asyncio.h"
+#include "utils.h"
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#endif
+
+#define UNDATED_NAME "undated"
+
+static int loadAll;
+
+void partitionSetInit(PartitionSet *set, const char *dir, const char *header)
+{
+    memset(set, 0, sizeof(*set));
+    set->dir = dir;
+    set->header = header;
+}
+
+void partitionSetClear(PartitionSet *set)
+{
+    free(set->parts);
+    partitionSetInit(set, set->dir, set->header);
+}
+
+int partitionMonthOf(time_t at)
+{
+    struct tm tmv;
+    if (at <= 0 || !localTimeSafe(at, &tmv))
+        return 0;
+    return (tmv.tm_year + 1900) * 100 + tmv.tm_mon + 1;
+}
+
+// Local midnight on the first day of month 'month' (0 = January, 12 = next January) of 'year'.
+static time_t monthStart(int year, int month)
+{
+    struct tm tmv = {0};
+    tmv.tm_year = year - 1900 + month / 12;
+    tmv.tm_mon = month % 12;
+    tmv.tm_mday = 1;
+    tmv.tm_isdst = -1; // As localtime would see it
+    return mktime(&tmv);
+}
+
+int partitionMonthCached(MonthCache *cache, time_t at)
+{
+    if (cache->month && at >= cache->from && at < cache->to)
+        return cache->month;
+    int month = partitionMonthOf(at);
+    if (month)
+    {
+        cache->month = month;
+        cache->from = monthStart(month / 100, month % 100 - 1);
+        cache->to = monthStart(month / 100, month % 100);
+    }
+    return month;
+}
+
+int partitionMonthOfText(const char *text)
+{
+    // Cheaper than parsing the whole date: this runs for every row saved or scanned.
+    int year = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        if (text[i] < '0' || text[i] > '9')
+            return 0;
+        year = year * 10 + (text[i] - '0');
+    }
+    if (text[4] != '-' || text[5] < '0' || text[5] > '1' || text[6] < '0' || text[6] > '9')
+        return 0;
+    int month = (text[5] - '0') * 10 + (text[6] - '0');
+    return month >= 1 && month <= 12 ? year * 100 + month : 0;
+}
+
+int partitionMonthAdd(int month, int delta)
+{
+    int index = (month / 100) * 12 + month % 100 - 1 + delta;
+    return (index / 12) * 100 + index % 12 + 1;
+}
+
+void partitionPath(const PartitionSet *set, int month, char *buf, size_t size)
+{
+    if (month)
+        snprintf(buf, size, "%s/%04d-%02d.csv", set->dir, month / 100, month % 100);
+    else
+        snprintf(buf, size, "%s/" UNDATED_NAME ".csv", set->dir);
+}
+
+// Position of the month in set->parts, or where it would go.
+static int searchMonth(const PartitionSet *set, int month)
+{
+    int lo = 0, hi = set->count;
+    while (lo < hi)
+    {
+        int mid = lo + (hi - lo) / 2;
+        if (set->parts[mid].month < month)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+Partition *findPartition(const PartitionSet *set, int month)
+{
+    // New rows nearly always belong to the latest month.
+    if (set->count && set->parts[set->count - 1].month == month)
+        return &set->parts[set->count - 1];
+    int at = searchMonth(set, month);
+    return at < set->count && set->parts[at].month == month ? &set->parts[at] : NULL;
+}
+
+Partition *partitionFor(PartitionSet *set, int month)
+{
+    Partition *p = findPartition(set, month);
+    if (p)
+        return p;
+    if (set->count == set->capacity)
+    {
+        int capacity = set->capacity ? set->capacity * 2 : 16;
+        Partition *parts = (Partition *)realloc(set->parts, (size_t)capacity * sizeof(Partition));
+        if (!parts)
+            return NULL;
+        set->parts = parts;
+        set->capacity = capacity;
+    }
+    int at = searchMonth(set, month);
+    memmove(&set->parts[at + 1], &set->parts[at], (size_t)(set->count - at) * sizeof(Partition));
+    set->count++;
+    p = &set->parts[at];
+    memset(p, 0, sizeof(*p));
+    p->month = month;
+    p->loaded = 1;
+    return p;
+}
+
+void partitionRemove(PartitionSet *set, int month)
+{
+    Partition *p = findPartition(set, month);
+    if (!p)
+        return;
+    int at = (int)(p - set->parts);
+    memmove(p, p + 1, (size_t)(set->count - at - 1) * sizeof(Partition));
+    set->count--;
+}
+
+void partitionCountRow(Partition *p, int64_t at, int open, size_t position)
+{
+    if (p->rows <= 0)
+    {
+        p->rows = 0;
+        p->minAt = at;
+        p->maxAt = at;
+    }
+    if (at < p->minAt)
+        p->minAt = at;
+    if (at > p->maxAt)
+        p->maxAt = at;
+    p->rows++;
+    if (open)
+        p->open++;
+    if (p->first == p->last)
+    {
+        p->first = position;
+        p->last = position + 1;
+    }
+    else
+    {
+        if (position < p->first)
+            p->first = position;
+        if (position >= p->last)
+            p->last = position + 1;
+    }
+}
+
+void partitionResetStats(Partition *p)
+{
+    p->minAt = 0;
+    p->maxAt = 0;
+    p->rows = 0;
+    p->open = 0;
+    p->first = 0;
+    p->last = 0;
+}
+
+// "2026-10" or "undated" back to a month; -1 if it is neither.
+static int parseMonthName(const char *name, size_t length)
+{
+    if (length == sizeof(UNDATED_NAME) - 1 && strncmp(name, UNDATED_NAME, length) == 0)
+        return 0;
+    if (length != 7)
+        return -1;
+    int month = partitionMonthOfText(name);
+    return month ? month : -1;
+}
+
+// Partition files the manifest does not list (written just before a crash, say) are
+// added with unknown statistics, so they are loaded and counted again.
+static void addUnlistedPartitions(PartitionSet *set)
+{
+    DIR *dir = opendir(set->dir);
+    struct dirent *entry;
+    while (dir && (entry = readdir(dir)) != NULL)
+    {
+        const char *dot = strrchr(entry->d_name, '.');
+        if (!dot || strcmp(dot, ".csv") != 0 || strcmp(entry->d_name, PARTITION_MANIFEST) == 0)
+            continue;
+        int month = parseMonthName(entry->d_name, (size_t)(dot - entry->d_name));
+        if (month < 0 || findPartition(set, month))
+            continue;
+        Partition *p = partitionFor(set, month);
+        if (p)
+            p->rows = -1;
+    }
+    if (dir)
+        closedir(dir);
+}
+
+int loadPartitionManifest(PartitionSet *set)
+{
+    partitionSetClear(set);
+    char path[256];
+    snprintf(path, sizeof(path), "%s/" PARTITION_MANIFEST, set->dir);
+    FILE *f = openDataFile(path);
+    if (!f)
+    {
+        // The table is about to be read from its old single file. Partition files
+        // already here (from a newer copy of the data) are taken as empty, so the
+        // first save overwrites them instead of leaving their rows behind.
+        addUnlistedPartitions(set);
+        for (int i = 0; i < set->count; i++)
+            partitionResetStats(&set->parts[i]);
+        return 0;
+    }
+    char line[256];
+    while (fgets(line, sizeof(line), f))
+    {
+        line[strcspn(line, "\r\n")] = '\0';
+        char *fields[5];
+        if (splitCsvLine(line, fields, 5) < 5)
+            continue;
+        int month = parseMonthName(fields[0], strlen(fields[0]));
+        Partition *p = month < 0 ? NULL : partitionFor(set, month);
+        if (!p)
+            continue; // The header, or out of memory
+        p->minAt = atoll(fields[1]);
+        p->maxAt = atoll(fields[2]);
+        p->rows = atol(fields[3]);
+        p->open = atol(fields[4]);
+        p->loaded = 0;
+    }
+    fclose(f);
+    addUnlistedPartitions(set);
+    return 1;
+}
+
+int savePartitionManifest(const PartitionSet *set)
+{
+    char path[256];
+    snprintf(path, sizeof(path), "%s/" PARTITION_MANIFEST, set->dir);
+    ensurePartitionDir(set);
+    AsyncFile out;
+    FILE *f = asyncFileOpen(&out, path);
+    if (!f)
+    {
+        printf("Error: could not open %s\n", path);
+        return 0;
+    }
+    fprintf(f, "month,minAt,maxAt,rows,open\n");
+    for (int i = 0; i < set->count; i++)
+    {
+        const Partition *p = &set->parts[i];
+        if (p->month)
+            fprintf(f, "%04d-%02d", p->month / 100, p->month % 100);
+        else
+            fprintf(f, UNDATED_NAME);
+        fprintf(f, ",%lld,%lld,%ld,%ld\n", (long long)p->minAt, (long long)p->maxAt, p->rows, p->open);
+    }
+    return asyncFileClose(&out) >= 0;
+}
+
+void ensurePartitionDir(const PartitionSet *set)
+{
+    struct stat st;
+    if (stat(set->dir, &st) == 0)
+        return;
+#ifdef _WIN32
+    _mkdir(set->dir);
+#else
+    mkdir(set->dir, 0755);
+#endif
+}
+
+void retireLegacyFile(const PartitionSet *set, const char *legacy)
+{
+    struct stat st;
+    if (asyncIoCapturing() || stat(legacy, &st) != 0)
+        return;
+    asyncIoDrain();
+    char path[256];
+    snprintf(path, sizeof(path), "%s/" PARTITION_MANIFEST, set->dir);
+    if (stat(path, &st) == 0 && remove(legacy) == 0)
+        printf("Moved %s into monthly partitions in %s/\n", legacy, set->dir);
+}
+
+// First month RIDEMATE_LOAD_MONTHS asks for, or 0 to load every month. Read once.
+static int firstWantedMonth(void)
+{
+    static int cached = -1;
+    if (cached >= 0)
+        return cached;
+    const char *env = getenv("RIDEMATE_LOAD_MONTHS");
+    int months = env ? atoi(env) : 0;
+    cached = 0;
+    if (months > 0)
+    {
+        cached = partitionMonthAdd(partitionMonthOf(time(NULL)), -(months - 1));
+    }
+    return cached;
+}
+
+int partitionWanted(const Partition *p)
+{
+    int first = firstWantedMonth();
+    // Undated rows and unknown statistics cannot be judged by month.
+    return loadAll || first == 0 || p->month == 0 || p->rows < 0 || p->open > 0 || p->month >= first;
+}
+
+void setLoadAllPartitions(int all)
+{
+    loadAll = all;
+}
+
+int partitionOverlaps(const Partition *p, int64_t from, int64_t to)
+{
+    if (p->rows < 0)
+        return 1;
+    return p->rows > 0 && p->maxAt >= from && p->minAt < to;
+}
+
+int partitionListed(const int *months, int count, int month)
+{
+    for (int i = 0; i < count; i++)
+    {
+        if (months[i] == month)
+            return 1;
+    }
+    return 0;
+}
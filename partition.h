@@ -0,0 +1,96 @@
+// File: partition.h
+// Description: Month partitions for the tables that only grow with time, rentals
+// and invoices. Such a table is a directory with one CSV file per month
+// (YYYY-MM.csv) and a manifest.csv listing every month with the earliest and latest
+// timestamp of its rows, its row count and how many of its rows can still change.
+// A scan of a time range reads only the months whose timestamps overlap it, and
+// start-up can leave the old, settled months on disk (RIDEMATE_LOAD_MONTHS).
+
+#ifndef PARTITION_H
+#define PARTITION_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#define PARTITION_MANIFEST "manifest.csv"
+
+typedef struct
+{
+    int month;     // yyyy * 100 + mm in local time; 0 for rows without a usable date
+    int64_t minAt; // Earliest and latest timestamp of its rows
+    int64_t maxAt;
+    long rows;
+    long open;     // Rows that can still change (active rentals, pending invoices)
+    int loaded;    // Its rows are in memory; only loaded partitions are rewritten
+    size_t first;  // Where the table keeps its rows in memory, if it keeps them in
+    size_t last;   // one array: positions first .. last - 1 hold all of them
+} Partition;
+
+typedef struct
+{
+    const char *dir;    // e.g. "data/rentals"
+    const char *header; // First line of every partition file, without the newline
+    Partition *parts;   // Sorted by month
+    int count;
+    int capacity;
+} PartitionSet;
+
+void partitionSetInit(PartitionSet *set, const char *dir, const char *header);
+// Forgets every partition; dir and header stay.
+void partitionSetClear(PartitionSet *set);
+
+// The month a row belongs to, from its timestamp or from a "YYYY-MM..." date.
+int partitionMonthOf(time_t at);
+int partitionMonthOfText(const char *text);
+// partitionMonthOf for a run of timestamps, most of them in the same month: the
+// month's bounds are kept between calls. Zero it before the first call.
+typedef struct
+{
+    int month;
+    time_t from; // The month is [from, to)
+    time_t to;
+} MonthCache;
+int partitionMonthCached(MonthCache *cache, time_t at);
+// "<dir>/YYYY-MM.csv", or "<dir>/undated.csv" for month 0.
+void partitionPath(const PartitionSet *set, int month, char *buf, size_t size);
+
+// 'month' moved by 'delta' months, e.g. partitionMonthAdd(202601, -1) == 202512.
+int partitionMonthAdd(int month, int delta);
+
+Partition *findPartition(const PartitionSet *set, int month);
+// Finds the month's partition or adds an empty, loaded one. NULL if out of memory.
+// Adding may move the other partitions.
+Partition *partitionFor(PartitionSet *set, int month);
+// Drops the month from the set, e.g. once its rows are archived elsewhere.
+void partitionRemove(PartitionSet *set, int month);
+// Counts a row in its partition's statistics and row positions.
+void partitionCountRow(Partition *p, int64_t at, int open, size_t position);
+// Resets the statistics of a partition about to be counted again from its rows.
+void partitionResetStats(Partition *p);
+
+// Reads <dir>/manifest.csv through openDataFile. Returns 0 if there is none, which
+// for an existing table means it is still in its old single file; any partition
+// files found are then listed as loaded and empty.
+int loadPartitionManifest(PartitionSet *set);
+// Writes the manifest; 0 if it could not be written.
+int savePartitionManifest(const PartitionSet *set);
+// Creates the table's directory so its files can be written.
+void ensurePartitionDir(const PartitionSet *set);
+// Removes the file a table was kept in before it had partitions, once the
+// partitions that replace it are durable. Not while a backup captures the saves.
+void retireLegacyFile(const PartitionSet *set, const char *legacy);
+
+// 1 if start-up should load the partition: every one, unless RIDEMATE_LOAD_MONTHS
+// limits loading to that many recent months (plus any month with open rows).
+int partitionWanted(const Partition *p);
+// Makes partitionWanted load everything, e.g. while the journal or a backup is
+// replayed over the tables, which may touch any row.
+void setLoadAllPartitions(int all);
+
+// 1 if 'month' is one of months[0 .. count - 1].
+int partitionListed(const int *months, int count, int month);
+// 1 if some row of p may have a timestamp in [from, to).
+int partitionOverlaps(const Partition *p, int64_t from, int64_t to);
+
+#endif // PARTITION_H
@@ -1,4 +1,7 @@
 #include "promo.h"
+#include "snapshot.h"
+#include "asyncio.h"
+#include "dirty.h"
 #include "utils.h"
 #include <stdio.h>
 #include <stdlib.h>
@@ -29,14 +32,21 @@ static Promo *parsePromoCSV(char *line)
     if (!p)
         return NULL;
     p->next = NULL;
-    sscanf(line, "%19[^,],%f,%d", p->code, &p->discountPercent, &p->isActive);
+    // The file keeps the percentage as text ("10.50"); read it exactly as basis points.
+    char percent[MONEY_STR_SIZE];
+    if (sscanf(line, "%19[^,],%23[^,],%d", p->code, percent, &p->isActive) != 3 ||
+        !parseHundredths(percent, &p->discountBps))
+    {
+        free(p);
+        return NULL;
+    }
     return p;
 }
 
 void loadPromos(Promo **head)
 {
     ensurePromoFileExists();
-    FILE *f = fopen(PROMO_FILE, "r");
+    FILE *f = openDataFile(PROMO_FILE);
     if (!f)
     {
         *head = NULL;
@@ -60,22 +70,30 @@ void loadPromos(Promo **head)
         }
     }
     fclose(f);
+    markClean(DIRTY_PROMOS);
 }
 
 void savePromos(Promo *head)
 {
-    FILE *f = fopen(PROMO_FILE, "w");
+    waitBackgroundSave();
+    size_t added;
+    if (beginTableSave(DIRTY_PROMOS, &added) == SAVE_SKIP)
+        return;
+    AsyncFile out;
+    FILE *f = asyncFileOpen(&out, PROMO_FILE);
     if (!f)
     {
         printf("Error: Could not save promo data!\n");
+        endTableSave(DIRTY_PROMOS, SAVE_REWRITE, -1);
         return;
     }
     fprintf(f, "code,discountPercent,isActive\n");
     for (Promo *p = head; p; p = p->next)
     {
-        fprintf(f, "%s,%.2f,%d\n", p->code, p->discountPercent, p->isActive);
+        fprintf(f, "%s," MONEY_FMT ",%d\n", p->code, MONEY_ARGS(p->discountBps), p->isActive);
     }
-    fclose(f);
+    long result = asyncFileClose(&out);
+    endTableSave(DIRTY_PROMOS, SAVE_REWRITE, result < 0 ? -1 : (long)out.length);
 }
 
 Promo *findActivePromoByCode(Promo *head, const char *code)
@@ -101,14 +119,15 @@ static void addPromo(Promo **head)
 
     printf("\n--- Create New Promo Code ---\n");
     getStringInput("Enter new promo code (e.g., EID25): ", newPromo->code, 20);
-    newPromo->discountPercent = getFloatInput("Enter discount percentage (e.g., 10.5): ", 0.1, 100.0);
+    newPromo->discountBps = getHundredthsInput("Enter discount percentage (e.g., 10.5): ", 10, 100 * 100);
     newPromo->isActive = 1;
 
     newPromo->next = *head;
     newPromo->next = *head;
     *head = newPromo;
+    markDirty(DIRTY_PROMOS);
     savePromos(*head);
-    printf("Promo code '%s' for %.1f%% discount created successfully!\n", newPromo->code, newPromo->discountPercent);
+    printf("Promo code '%s' for " MONEY_FMT "%% discount created successfully!\n", newPromo->code, MONEY_ARGS(newPromo->discountBps));
 }
 
 static void listAllPromos(Promo *head)
@@ -123,7 +142,9 @@ static void listAllPromos(Promo *head)
     }
     for (Promo *p = head; p; p = p->next)
     {
-        printf("%-20s %-15.2f %-10s\n", p->code, p->discountPercent, p->isActive ? "Active" : "Inactive");
+        char percent[MONEY_STR_SIZE];
+        formatMoney(p->discountBps, percent, sizeof(percent));
+        printf("%-20s %-15s %-10s\n", p->code, percent, p->isActive ? "Active" : "Inactive");
     }
 }
 
@@ -146,6 +167,7 @@ static void togglePromoActive(Promo *head)
     if (target)
     {
         target->isActive = !target->isActive;
+        markDirty(DIRTY_PROMOS);
         savePromos(head);
         printf("Promo code '%s' is now %s.\n", target->code, target->isActive ? "ACTIVE" : "INACTIVE");
     }
@@ -4,11 +4,13 @@
 #ifndef PROMO_H
 #define PROMO_H
 
+#include <stdint.h>
+
 // --- The Promo Struct (Node for Linked List) ---
 typedef struct PromoNode
 {
     char code[20];          // The code the user types, e.g., "SAVE10"
-    float discountPercent;  // The discount value, e.g., 10.0 for 10%
+    int64_t discountBps;    // The discount in basis points, e.g., 1050 for 10.5%
     int isActive;           // Admin can turn this on (1) or off (0)
     struct PromoNode *next; // Pointer to the next promo in the list
 } Promo;
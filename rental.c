@@ -2,35 +2,75 @@
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <pthread.h>
+#include <sys/stat.h>
 
 #include "utils.h"
+#include "snapshot.h"
+#include "asyncio.h"
+#include "journal.h"
+#include "dirty.h"
 #include "vehicle.h"
 #include "customer.h"
 #include "rental.h"
 #include "driver.h"
 #include "invoice.h"
+#include "money.h"
+#include "idalloc.h"
+#include "threadpool.h"
+#include "lazyload.h"
 #include <time.h>
-#include <math.h>
 
-#define RENTAL_FILE "rentals.csv"
+#define RENTAL_DIR "data/rentals"
+#define RENTAL_HEADER "id,customerId,vehicleId,routeId,driverId,type,startTime,endTime,totalCost,status,vehicleRating,driverRating,comment"
+// Where every rental was kept before the partitions. Read, once, when there is no
+// partition manifest yet; the first save replaces it.
+#define LEGACY_RENTAL_FILE "rentals.csv"
 
-extern Route *routeHead;
+// Bookings of the same vehicle are serialized by one of these locks (vehicle id
+// modulo the stripe count), held from the availability check until the row is
+// appended. Lock order: vehicle stripe, then the table lock, then the driver and
+// rating locks, which take nothing but the journal's lock. Completing or
+// cancelling takes no stripe: it only ever frees a vehicle, and the row itself is
+// claimed for the status change with mvccClaim.
+#define RENTAL_LOCK_STRIPES 64
 
-static int isVehicleBooked(Rental *head, int vehicleId, time_t newStart, time_t newEnd)
+// Rows with older versions collected before they are trimmed.
+#define RENTAL_VERSION_SWEEP 1024
+
+typedef struct
+{
+    _Alignas(CACHE_LINE_SIZE) pthread_mutex_t lock;
+} VehicleLock;
+
+static VehicleLock vehicleLocks[RENTAL_LOCK_STRIPES];
+static pthread_once_t vehicleLocksOnce = PTHREAD_ONCE_INIT;
+
+static void initVehicleLocks(void)
+{
+    for (int i = 0; i < RENTAL_LOCK_STRIPES; i++)
+        pthread_mutex_init(&vehicleLocks[i].lock, NULL);
+}
+
+static pthread_mutex_t *vehicleLockFor(int vehicleId)
+{
+    pthread_once(&vehicleLocksOnce, initVehicleLocks);
+    return &vehicleLocks[(unsigned)vehicleId % RENTAL_LOCK_STRIPES].lock;
+}
+
+
+static int isVehicleBooked(const RentalTable *table, int vehicleId, time_t newStart, time_t newEnd)
 {
-    for (Rental *r = head; r; r = r->next)
+    for (size_t i = 0; i < table->count; i++)
     {
-        if (r->vehicleId == vehicleId && r->status == RENT_ACTIVE)
+        const Rental *r = &table->rows[i];
+        if (r->vehicleId == vehicleId && __atomic_load_n(&r->status, __ATOMIC_ACQUIRE) == RENT_ACTIVE &&
+            r->startAt && r->endAt)
         {
-            time_t existingStart, existingEnd;
-
-            if (stringToTime(r->startTime, &existingStart) && stringToTime(r->endTime, &existingEnd))
+            // Check for overlap: new booking overlaps with existing booking
+            if (newStart < r->endAt && newEnd > r->startAt)
             {
-                // Check for overlap: new booking overlaps with existing booking
-                if (newStart < existingEnd && newEnd > existingStart)
-                {
-                    return 1;
-                }
+                return 1;
             }
         }
     }
@@ -38,33 +78,30 @@ static int isVehicleBooked(Rental *head, int vehicleId, time_t newStart, time_t
 }
 
 // Enhanced conflict detection with detailed information
-static int checkRentalConflicts(Rental *head, int vehicleId, time_t newStart, time_t newEnd, char *conflictInfo, size_t infoSize)
+static int checkRentalConflicts(const RentalTable *table, int vehicleId, time_t newStart, time_t newEnd, char *conflictInfo, size_t infoSize)
 {
     int conflictCount = 0;
     char tempInfo[256];
     
-    for (Rental *r = head; r; r = r->next)
+    for (size_t i = 0; i < table->count; i++)
     {
-        if (r->vehicleId == vehicleId && r->status == RENT_ACTIVE)
+        const Rental *r = &table->rows[i];
+        if (r->vehicleId == vehicleId && r->status == RENT_ACTIVE && r->startAt && r->endAt)
         {
-            time_t existingStart, existingEnd;
-
-            if (stringToTime(r->startTime, &existingStart) && stringToTime(r->endTime, &existingEnd))
+            // Check for overlap
+            if (newStart < r->endAt && newEnd > r->startAt)
             {
-                // Check for overlap
-                if (newStart < existingEnd && newEnd > existingStart)
+                conflictCount++;
+                
+                // Format conflict information
+                const RentalDetail *d = &table->details[i];
+                snprintf(tempInfo, sizeof(tempInfo), 
+                        "Conflict #%d: Rental ID %d (Customer %d) - %s to %s\n",
+                        conflictCount, r->id, r->customerId, d->startTime, d->endTime);
+                
+                if (conflictInfo && infoSize > 0)
                 {
-                    conflictCount++;
-                    
-                    // Format conflict information
-                    snprintf(tempInfo, sizeof(tempInfo), 
-                            "Conflict #%d: Rental ID %d (Customer %d) - %s to %s\n",
-                            conflictCount, r->id, r->customerId, r->startTime, r->endTime);
-                    
-                    if (conflictInfo && infoSize > 0)
-                    {
-                        strncat(conflictInfo, tempInfo, infoSize - strlen(conflictInfo) - 1);
-                    }
+                    strncat(conflictInfo, tempInfo, infoSize - strlen(conflictInfo) - 1);
                 }
             }
         }
@@ -76,9 +113,9 @@ static int checkRentalConflicts(Rental *head, int vehicleId, time_t newStart, ti
 
 
 // Public function to check vehicle availability for a specific time range
-int isVehicleAvailableForTime(Rental *head, int vehicleId, time_t startTime, time_t endTime)
+int isVehicleAvailableForTime(const RentalTable *table, int vehicleId, time_t startTime, time_t endTime)
 {
-    return !isVehicleBooked(head, vehicleId, startTime, endTime);
+    return !isVehicleBooked(table, vehicleId, startTime, endTime);
 }
 
 // Public function to validate rental time range
@@ -87,8 +124,9 @@ int validateRentalTimeRange(time_t startTime, time_t endTime, int rentalType)
     time_t now = time(NULL);
     time_t minDuration, maxDuration;
     
-    // Check if start time is in the future
-    if (startTime <= now)
+    // Start times are kept to the minute, so a rental starting now is already up to
+    // a minute old when it gets here (two if the clock ticks over in between).
+    if (startTime + 2 * 60 <= now)
     {
         return 0;
     }
@@ -128,45 +166,213 @@ int validateRentalTimeRange(time_t startTime, time_t endTime, int rentalType)
     return 1;
 }
 
-static int nextRentalId = 5001;
 
 static void nowString(char *buf, size_t n)
 {
     time_t t = time(NULL);
-    struct tm *tmv = localtime(&t);
-    strftime(buf, n, "%Y-%m-%d %H:%M", tmv);
+    struct tm tmv;
+    localTimeSafe(t, &tmv);
+    strftime(buf, n, "%Y-%m-%d %H:%M", &tmv);
 }
 
 static void futureStringMinutes(int minutes, char *buf, size_t n)
 {
     time_t t = time(NULL);
     t += (time_t)minutes * 60;
-    struct tm *tmv = localtime(&t);
-    strftime(buf, n, "%Y-%m-%d %H:%M", tmv);
+    struct tm tmv;
+    localTimeSafe(t, &tmv);
+    strftime(buf, n, "%Y-%m-%d %H:%M", &tmv);
 }
 
-static void adjustNextId(Rental *head)
+// Epoch seconds for a "YYYY-MM-DD HH:MM" string, 0 if it does not parse.
+static int64_t epochOf(const char *text)
 {
-    int maxId = nextRentalId - 1;
-    for (Rental *r = head; r; r = r->next)
-        if (r->id > maxId)
-            maxId = r->id;
-    nextRentalId = maxId + 1;
+    time_t t;
+    return stringToTime(text, &t) ? (int64_t)t : 0;
 }
 
-static Rental *parseRentalCSV(char *line)
+static void setStartTime(Rental *r, RentalDetail *d, const char *text)
 {
-    Rental *r = (Rental *)malloc(sizeof(Rental));
-    if (!r)
-        return NULL;
-    r->next = NULL;
+    strncpy(d->startTime, text, sizeof(d->startTime) - 1);
+    d->startTime[sizeof(d->startTime) - 1] = '\0';
+    r->startAt = epochOf(d->startTime);
+}
+
+static void setEndTime(Rental *r, RentalDetail *d, const char *text)
+{
+    strncpy(d->endTime, text, sizeof(d->endTime) - 1);
+    d->endTime[sizeof(d->endTime) - 1] = '\0';
+    r->endAt = epochOf(d->endTime);
+}
+
+void rentalTableInit(RentalTable *table)
+{
+    memset(table, 0, sizeof(*table));
+    pthread_rwlock_init(&table->lock, NULL);
+    pthread_mutex_init(&table->versionLock, NULL);
+    table->sweepAt = RENTAL_VERSION_SWEEP;
+    partitionSetInit(&table->partitions, RENTAL_DIR, RENTAL_HEADER);
+    coldTierInit(&table->cold, RENTAL_DIR);
+}
+
+static int growRentalTable(RentalTable *table)
+{
+    size_t capacity = table->capacity ? table->capacity * 2 : 64;
+    // Not realloc: a report snapshot may still be reading the old rows.
+    Rental *rows = (Rental *)malloc(capacity * sizeof(Rental));
+    if (!rows)
+        return 0;
+    if (table->count)
+        memcpy(rows, table->rows, table->count * sizeof(Rental));
+    // A booking appended but not yet committed is committed in the new rows, so its
+    // old copy would stay uncommitted and a snapshot reading it would wait forever.
+    // Snapshots still on the old rows began before this move, and so before that
+    // commit: none of them may see the row. (Claims of committed rows hold the read
+    // lock, so they cannot be in flight here.)
+    for (size_t i = 0; i < table->count; i++)
+    {
+        if (__atomic_load_n(&table->rows[i].mvcc.beginTs, __ATOMIC_ACQUIRE) == MVCC_UNCOMMITTED)
+            __atomic_store_n(&table->rows[i].mvcc.beginTs, MVCC_INVISIBLE, __ATOMIC_RELEASE);
+    }
+    mvccRetire(table->rows);
+    table->rows = rows;
+    RentalDetail *details = (RentalDetail *)realloc(table->details, capacity * sizeof(RentalDetail));
+    if (!details)
+        return 0;
+    table->details = details;
+    table->capacity = capacity;
+    return 1;
+}
+
+// Returns the index of the new row, or -1 if out of memory.
+static long appendRow(RentalTable *table, const Rental *row, const RentalDetail *detail)
+{
+    long index = -1;
+    pthread_rwlock_wrlock(&table->lock);
+    Partition *p = partitionFor(&table->partitions, partitionMonthOfText(detail->startTime));
+    if (p && (table->count < table->capacity || growRentalTable(table)))
+    {
+        table->rows[table->count] = *row;
+        table->details[table->count] = *detail;
+        index = (long)table->count++;
+        partitionCountRow(p, row->startAt, row->status == RENT_ACTIVE, (size_t)index);
+        markAdded(DIRTY_RENTALS);
+    }
+    pthread_rwlock_unlock(&table->lock);
+    return index;
+}
+
+Rental *rentalTableAppend(RentalTable *table, const Rental *row, const RentalDetail *detail)
+{
+    long index = appendRow(table, row, detail);
+    return index < 0 ? NULL : &table->rows[index];
+}
+
+void rentalTableReadLock(RentalTable *table)
+{
+    pthread_rwlock_rdlock(&table->lock);
+}
+
+void rentalTableReadUnlock(RentalTable *table)
+{
+    pthread_rwlock_unlock(&table->lock);
+}
+
+RentalDetail *rentalDetail(const RentalTable *table, const Rental *r)
+{
+    return &table->details[r - table->rows];
+}
+
+void freeRentalTable(RentalTable *table)
+{
+    for (size_t i = 0; i < table->versionedCount; i++)
+        mvccDropVersions(&table->rows[table->versioned[i]].mvcc);
+    free(table->versioned);
+    free(table->rows);
+    free(table->details);
+    partitionSetClear(&table->partitions);
+    coldTierClear(&table->cold);
+    pthread_rwlock_destroy(&table->lock);
+    pthread_mutex_destroy(&table->versionLock);
+    rentalTableInit(table);
+}
+
+// Unlinks the versions no open snapshot needs. versionLock held, rows not moving.
+static void trimRentalVersions(RentalTable *table)
+{
+    uint64_t oldest = mvccOldestSnapshot();
+    size_t kept = 0;
+    for (size_t i = 0; i < table->versionedCount; i++)
+    {
+        size_t index = table->versioned[i];
+        if (!mvccTrim(&table->rows[index].mvcc, oldest))
+            table->versioned[kept++] = index;
+    }
+    table->versionedCount = kept;
+    // While a long snapshot pins the versions, do not rescan them on every change.
+    table->sweepAt = kept * 2 > RENTAL_VERSION_SWEEP ? kept * 2 : RENTAL_VERSION_SWEEP;
+}
+
+static void noteVersionedRow(RentalTable *table, size_t index)
+{
+    pthread_mutex_lock(&table->versionLock);
+    if (table->versionedCount == table->versionedCapacity)
+    {
+        size_t capacity = table->versionedCapacity ? table->versionedCapacity * 2 : 256;
+        size_t *versioned = (size_t *)realloc(table->versioned, capacity * sizeof(size_t));
+        if (versioned)
+        {
+            table->versioned = versioned;
+            table->versionedCapacity = capacity;
+        }
+    }
+    // Without room the versions are kept until the table is freed.
+    if (table->versionedCount < table->versionedCapacity)
+        table->versioned[table->versionedCount++] = index;
+    if (table->versionedCount >= table->sweepAt)
+        trimRentalVersions(table);
+    pthread_mutex_unlock(&table->versionLock);
+}
+
+void rentalSnapshotBegin(const RentalTable *table, RentalSnapshot *snap)
+{
+    RentalTable *t = (RentalTable *)table; // The locks are not part of the table's contents
+    // The snapshot is registered first, so the rows captured below cannot be freed
+    // by a later append until it ends.
+    mvccBeginSnapshot(&snap->mvcc);
+    pthread_rwlock_rdlock(&t->lock);
+    snap->rows = table->rows;
+    snap->count = table->count;
+    pthread_rwlock_unlock(&t->lock);
+}
+
+int rentalSnapshotRow(const RentalSnapshot *snap, size_t i, Rental *out)
+{
+    return mvccRead(&snap->rows[i].mvcc, sizeof(Rental), &snap->mvcc, out);
+}
+
+void rentalSnapshotEnd(const RentalTable *table, RentalSnapshot *snap)
+{
+    RentalTable *t = (RentalTable *)table;
+    mvccEndSnapshot(&snap->mvcc);
+    pthread_rwlock_rdlock(&t->lock);
+    pthread_mutex_lock(&t->versionLock);
+    trimRentalVersions(t);
+    pthread_mutex_unlock(&t->versionLock);
+    pthread_rwlock_unlock(&t->lock);
+    mvccReclaim();
+}
+
+static int parseRentalCSV(char *line, Rental *r, RentalDetail *d)
+{
+    memset(r, 0, sizeof(*r));
+    memset(d, 0, sizeof(*d));
 
     int id, custId, vehId, routeId, driverId, type, status, vehicleRating, driverRating;
-    char start[32] = {0}, end[32] = {0}, comment[51] = {0};
-    float total;
+    char start[32] = {0}, end[32] = {0}, comment[51] = {0}, total[MONEY_STR_SIZE] = {0};
 
-    int n = sscanf(line, "%d,%d,%d,%d,%d,%d,%19[^,],%19[^,],%f,%d,%d,%d,%50[^,\n]",
-                   &id, &custId, &vehId, &routeId, &driverId, &type, start, end, &total, &status, &vehicleRating, &driverRating, comment);
+    int n = sscanf(line, "%d,%d,%d,%d,%d,%d,%19[^,],%19[^,],%23[^,],%d,%d,%d,%50[^,\n]",
+                   &id, &custId, &vehId, &routeId, &driverId, &type, start, end, total, &status, &vehicleRating, &driverRating, comment);
 
     if (n == 10)
     {
@@ -180,8 +386,11 @@ static Rental *parseRentalCSV(char *line)
     }
     else if (n != 13)
     {
-        free(r);
-        return NULL;
+        return 0;
+    }
+    if (!parseMoney(total, &r->totalCost))
+    {
+        return 0;
     }
 
     r->id = id;
@@ -189,28 +398,121 @@ static Rental *parseRentalCSV(char *line)
     r->vehicleId = vehId;
     r->routeId = routeId;
     r->driverId = driverId;
-    r->type = (RentalType)type;
-    strncpy(r->startTime, start, sizeof(r->startTime) - 1);
-    r->startTime[sizeof(r->startTime) - 1] = '\0';
-    strncpy(r->endTime, end, sizeof(r->endTime) - 1);
-    r->endTime[sizeof(r->endTime) - 1] = '\0';
-    r->totalCost = total;
-    r->status = (RentalStatus)status;
-    r->vehicleRating = vehicleRating;
-    r->driverRating = driverRating;
-    strncpy(r->comment, comment, sizeof(r->comment) - 1);
-    r->comment[sizeof(r->comment) - 1] = '\0';
+    r->type = (uint8_t)type;
+    r->status = (uint8_t)status;
+    setStartTime(r, d, start);
+    setEndTime(r, d, end);
+    d->vehicleRating = vehicleRating;
+    d->driverRating = driverRating;
+    strncpy(d->comment, comment, sizeof(d->comment) - 1);
+    d->comment[sizeof(d->comment) - 1] = '\0';
 
-    return r;
+    return 1;
 }
 
-void loadRentals(Rental **head)
+// One line of a rentals file, without the newline.
+static void formatRentalRow(const Rental *r, const RentalDetail *d, char *buf, size_t size)
 {
-    *head = NULL;
-    FILE *f = fopen(RENTAL_FILE, "r");
-    if (!f)
+    snprintf(buf, size, "%d,%d,%d,%d,%d,%d,%s,%s," MONEY_FMT ",%d,%d,%d,%s",
+             r->id, r->customerId, r->vehicleId, r->routeId, r->driverId, (int)r->type,
+             d->startTime, d->endTime, MONEY_ARGS(r->totalCost), (int)r->status, d->vehicleRating, d->driverRating, d->comment);
+}
+
+// A changed row only forces its month's file to be rewritten if it is already in
+// it; rows booked since the last save are appended with their latest contents.
+// Callers hold the table's read lock, or are the only thread, so count is stable.
+static void markRentalChanged(const RentalTable *table, const Rental *r)
+{
+    size_t index = (size_t)(r - table->rows);
+    if (index + dirtyAddedCount(DIRTY_RENTALS) >= table->count)
+        return;
+    int month = partitionMonthOfText(table->details[index].startTime);
+    if (month)
+        markPartDirty(DIRTY_RENTALS, month);
+    else
+        markDirty(DIRTY_RENTALS);
+}
+
+// Keeps the count of active rentals in the row's month up to date. Called with the
+// table's read lock at least, so the partitions do not move.
+static void countOpenRental(RentalTable *table, const Rental *r, long change)
+{
+    Partition *p = findPartition(&table->partitions, partitionMonthOfText(rentalDetail(table, r)->startTime));
+    if (p && change)
+        __atomic_fetch_add(&p->open, change, __ATOMIC_RELAXED);
+}
+
+static void journalRental(const Rental *r, const RentalDetail *d)
+{
+    if (!journalEnabled())
         return;
+    char row[512];
+    formatRentalRow(r, d, row, sizeof(row));
+    journalAppend(JOURNAL_RENTAL, row);
+}
 
+int applyJournaledRental(RentalTable *table, Vehicle *vehicleHead, char *row, IdMap *index)
+{
+    Rental parsed;
+    RentalDetail detail;
+    if (!parseRentalCSV(row, &parsed, &detail))
+        return 0;
+
+    Rental *r = NULL;
+    if (index)
+    {
+        if (index->count == 0)
+        {
+            for (size_t i = 0; i < table->count; i++)
+                idMapPut(index, table->rows[i].id, i);
+        }
+        uintptr_t position;
+        if (idMapGet(index, parsed.id, &position))
+            r = &table->rows[position];
+    }
+    else
+    {
+        // Journaled rentals are recent ones, so search from the end.
+        for (size_t i = table->count; i-- > 0;)
+        {
+            if (table->rows[i].id == parsed.id)
+            {
+                r = &table->rows[i];
+                break;
+            }
+        }
+    }
+    int wasActive = r && r->status == RENT_ACTIVE;
+    if (r)
+    {
+        parsed.mvcc = r->mvcc;
+        *rentalDetail(table, r) = detail;
+        *r = parsed;
+        countOpenRental(table, r, (parsed.status == RENT_ACTIVE) - wasActive);
+        markRentalChanged(table, r);
+    }
+    else
+    {
+        if (!rentalTableAppend(table, &parsed, &detail))
+            return 0;
+        if (index)
+            idMapPut(index, parsed.id, table->count - 1);
+        observeId(ID_RENTAL, parsed.id);
+    }
+
+    // vehicles.csv is as old as the checkpoint; only a booking or its end moves the flag.
+    Vehicle *v = findVehicleById(vehicleHead, parsed.vehicleId);
+    if (v && (parsed.status == RENT_ACTIVE || wasActive))
+    {
+        v->available = parsed.status == RENT_ACTIVE ? 0 : 1;
+        markDirty(DIRTY_VEHICLES);
+    }
+    return 1;
+}
+
+// Appends the rows of one rentals file. Returns 0 if memory ran out.
+static int readRentalFile(RentalTable *table, FILE *f, const char *path)
+{
     char line[512];
     if (fgets(line, sizeof(line), f))
     {
@@ -225,254 +527,803 @@ void loadRentals(Rental **head)
         line[strcspn(line, "\n")] = 0;
         if (!line[0])
             continue;
-        Rental *r = parseRentalCSV(line);
-        if (r)
+        Rental row;
+        RentalDetail detail;
+        if (!parseRentalCSV(line, &row, &detail))
+            continue;
+        if (!rentalTableAppend(table, &row, &detail))
         {
-            r->next = *head;
-            *head = r;
+            printf("Error: out of memory loading %s\n", path);
+            return 0;
         }
+        observeId(ID_RENTAL, row.id);
     }
-    fclose(f);
-    adjustNextId(*head);
+    return 1;
 }
 
-void saveRentals(Rental *head)
+// A month both archived and still a partition was being archived when the program
+// stopped; its segment and rollups were complete, so only the old file is left to go.
+static void finishArchivedMonths(RentalTable *table)
 {
-    FILE *f = fopen(RENTAL_FILE, "w");
-    if (!f)
+    PartitionSet *set = &table->partitions;
+    int removed = 0;
+    for (int i = 0; i < table->cold.count; i++)
+    {
+        const ColdMonth *m = &table->cold.months[i];
+        observeId(ID_RENTAL, m->maxId);
+        if (!findPartition(set, m->month))
+            continue;
+        partitionRemove(set, m->month);
+        char path[256];
+        partitionPath(set, m->month, path, sizeof(path));
+        if (!dataFileSourceSet())
+            remove(path);
+        removed = 1;
+    }
+    if (removed && !dataFileSourceSet())
+        savePartitionManifest(set);
+}
+
+void loadRentals(RentalTable *table)
+{
+    freeRentalTable(table);
+    PartitionSet *set = &table->partitions;
+    int partitioned = loadPartitionManifest(set);
+    loadColdTier(&table->cold);
+    finishArchivedMonths(table);
+    if (!partitioned)
     {
-        printf("Error: could not open %s\n", RENTAL_FILE);
+        // Not split into months yet. The table stays dirty, so the first save
+        // writes the partitions.
+        FILE *f = openDataFile(LEGACY_RENTAL_FILE);
+        if (f)
+        {
+            readRentalFile(table, f, LEGACY_RENTAL_FILE);
+            fclose(f);
+        }
         return;
     }
-    fprintf(f, "id,customerId,vehicleId,routeId,driverId,type,startTime,endTime,totalCost,status,vehicleRating,driverRating,comment\n");
-    for (Rental *r = head; r; r = r->next)
+
+    int ok = 1;
+    for (int i = 0; ok && i < set->count; i++)
     {
-        fprintf(f, "%d,%d,%d,%d,%d,%d,%s,%s,%.2f,%d,%d,%d,%s\n",
-                r->id, r->customerId, r->vehicleId, r->routeId, r->driverId, (int)r->type,
-                r->startTime, r->endTime, r->totalCost, (int)r->status, r->vehicleRating, r->driverRating, r->comment);
+        Partition *p = &set->parts[i];
+        if (!partitionWanted(p))
+            continue;
+        int month = p->month;
+        char path[256];
+        partitionPath(set, month, path, sizeof(path));
+        partitionResetStats(p); // Counted again as the rows are appended
+        p->loaded = 1;
+        FILE *f = openDataFile(path);
+        if (f)
+        {
+            ok = readRentalFile(table, f, path);
+            fclose(f);
+        }
+        // A row filed under another month may have added a partition before this one.
+        i = (int)(findPartition(set, month) - set->parts);
     }
-    fclose(f);
+    markClean(DIRTY_RENTALS);
 }
 
-Rental *findRentalById(Rental *head, int rentalId)
+// Writes one month: the whole file if 'rewrite', otherwise only its rows from
+// position 'firstNew' on, appended. Returns the bytes written, or -1.
+static long saveRentalPartition(const RentalTable *table, Partition *p, int rewrite, size_t firstNew)
 {
-    for (Rental *cur = head; cur; cur = cur->next)
-        if (cur->id == rentalId)
-            return cur;
-    return NULL;
+    const PartitionSet *set = &table->partitions;
+    char path[256];
+    partitionPath(set, p->month, path, sizeof(path));
+    AsyncFile out;
+    FILE *f = rewrite ? NULL : asyncFileAppend(&out, path);
+    if (!f && !p->loaded)
+    {
+        // Its older rows are not in memory, so it cannot be written whole.
+        printf("Error: could not append to %s\n", path);
+        return -1;
+    }
+    if (!f)
+    {
+        rewrite = 1; // Nothing to append to, or its last row was cut off
+        f = asyncFileOpen(&out, path);
+    }
+    if (!f)
+    {
+        printf("Error: could not open %s\n", path);
+        return -1;
+    }
+    if (rewrite)
+        fprintf(f, "%s\n", set->header);
+    size_t from = rewrite || firstNew < p->first ? p->first : firstNew;
+    for (size_t i = from; i < p->last; i++)
+    {
+        if (partitionMonthOfText(table->details[i].startTime) != p->month)
+            continue; // Booked in between, for another month
+        char row[512];
+        formatRentalRow(&table->rows[i], &table->details[i], row, sizeof(row));
+        fputs(row, f);
+        fputc('\n', f);
+    }
+    long result = asyncFileClose(&out);
+    return result < 0 ? -1 : (long)out.length;
 }
 
-int completeRental(Rental *r, Vehicle *vehicleHead, Driver *driverHead)
+void saveRentals(const RentalTable *table)
 {
-    if (!r)
+    waitBackgroundSave();
+    size_t added;
+    int changed[DIRTY_MAX_PARTS], changedCount;
+    SaveMode mode = beginPartitionedSave(DIRTY_RENTALS, &added, changed, &changedCount);
+    if (mode == SAVE_SKIP)
+        return;
+    // The partition statistics are bookkeeping, not part of the table's contents.
+    PartitionSet *set = (PartitionSet *)&table->partitions;
+    ensurePartitionDir(set);
+    // New rows are the last 'added' ones; everything before them is in the files.
+    size_t firstNew = added < table->count ? table->count - added : 0;
+    long bytes = 0;
+    for (int i = 0; bytes >= 0 && i < set->count; i++)
     {
-        printf("Error: NULL rental.\n");
-        return 0;
+        Partition *p = &set->parts[i];
+        int rewrite = p->loaded && (mode == SAVE_REWRITE ||
+                                    (mode == SAVE_PARTIAL && partitionListed(changed, changedCount, p->month)));
+        if (!rewrite && p->last <= firstNew)
+            continue; // Unchanged
+        long written = saveRentalPartition(table, p, rewrite, firstNew);
+        bytes = written < 0 ? -1 : bytes + written;
     }
-    if (r->status != RENT_ACTIVE)
+    if (bytes >= 0 && !savePartitionManifest(set))
+        bytes = -1;
+    // The archive's index and rollups never change, but a full save (e.g. after a
+    // restore) writes them too, so they always match the partitions beside them.
+    char coldIndex[256];
+    struct stat st;
+    snprintf(coldIndex, sizeof(coldIndex), "%s/" COLD_INDEX_FILE, table->cold.dir);
+    if (bytes >= 0 && mode == SAVE_REWRITE && (table->cold.count || stat(coldIndex, &st) == 0) &&
+        !saveColdTier(&table->cold))
+        bytes = -1;
+    if (bytes >= 0)
+        retireLegacyFile(set, LEGACY_RENTAL_FILE);
+    endTableSave(DIRTY_RENTALS, mode, bytes);
+}
+
+static int compareRanges(const void *a, const void *b)
+{
+    const RentalRange *x = (const RentalRange *)a;
+    const RentalRange *y = (const RentalRange *)b;
+    return (x->first > y->first) - (x->first < y->first);
+}
+
+int planRentalScan(const RentalTable *table, const RentalSnapshot *snap, int64_t from, int64_t to, RentalScanPlan *plan)
+{
+    RentalTable *t = (RentalTable *)table;
+    memset(plan, 0, sizeof(*plan));
+    pthread_rwlock_rdlock(&t->lock);
+    const PartitionSet *set = &table->partitions;
+    plan->partitions = set->count;
+    plan->ranges = (RentalRange *)malloc((size_t)(set->count + 1) * sizeof(RentalRange));
+    plan->diskMonths = (int *)malloc((size_t)(set->count + 1) * sizeof(int));
+    plan->coldMonths = (int *)malloc((size_t)(table->cold.count + 1) * sizeof(int));
+    int ok = plan->ranges && plan->diskMonths && plan->coldMonths;
+    plan->partitions += table->cold.count;
+    for (int i = 0; ok && i < table->cold.count; i++)
     {
-        printf("Rental #%d is not ACTIVE (current status: %d).\n", r->id, (int)r->status);
+        const ColdMonth *m = &table->cold.months[i];
+        if (m->rows > 0 && m->maxAt >= from && m->minAt < to)
+        {
+            plan->coldMonths[plan->coldCount++] = m->month;
+            plan->scanned++;
+            plan->rows += m->rows;
+        }
+    }
+    for (int i = 0; ok && i < set->count; i++)
+    {
+        const Partition *p = &set->parts[i];
+        if (!partitionOverlaps(p, from, to))
+            continue;
+        plan->scanned++;
+        plan->rows += p->rows > 0 ? p->rows : 0;
+        if (!p->loaded)
+        {
+            plan->diskMonths[plan->diskCount++] = p->month;
+            continue;
+        }
+        size_t last = p->last < snap->count ? p->last : snap->count; // Booked after the snapshot
+        if (p->first < last)
+            plan->ranges[plan->rangeCount++] = (RentalRange){p->first, last};
+    }
+    pthread_rwlock_unlock(&t->lock);
+    if (!ok)
+    {
+        freeRentalScanPlan(plan);
         return 0;
     }
-
-    char actualEnd[32];
-    printf("Enter actual end time (YYYY-MM-DD HH:MM) or leave blank to keep [%s]: ",
-           r->endTime[0] ? r->endTime : "(empty)");
-    getInput("", actualEnd, sizeof(actualEnd));
-    if (strlen(actualEnd) == 16 && actualEnd[4] == '-' && actualEnd[7] == '-' &&
-        actualEnd[10] == ' ' && actualEnd[13] == ':')
+    // Months booked out of order can share rows; each row is scanned once.
+    qsort(plan->ranges, (size_t)plan->rangeCount, sizeof(RentalRange), compareRanges);
+    int merged = 0;
+    for (int i = 0; i < plan->rangeCount; i++)
     {
-        strncpy(r->endTime, actualEnd, sizeof(r->endTime) - 1);
-        r->endTime[sizeof(r->endTime) - 1] = '\0';
+        if (merged && plan->ranges[i].first <= plan->ranges[merged - 1].last)
+        {
+            if (plan->ranges[i].last > plan->ranges[merged - 1].last)
+                plan->ranges[merged - 1].last = plan->ranges[i].last;
+        }
+        else
+        {
+            plan->ranges[merged++] = plan->ranges[i];
+        }
     }
-    else if (!r->endTime[0])
+    plan->rangeCount = merged;
+    return 1;
+}
+
+void freeRentalScanPlan(RentalScanPlan *plan)
+{
+    free(plan->ranges);
+    free(plan->diskMonths);
+    free(plan->coldMonths);
+    memset(plan, 0, sizeof(*plan));
+}
+
+long scanRentalPartition(const RentalTable *table, int month, RentalRowFn fn, void *ctx)
+{
+    char path[256];
+    partitionPath(&table->partitions, month, path, sizeof(path));
+    FILE *f = fopen(path, "r");
+    if (!f)
+        return -1;
+    char line[512];
+    long rows = 0;
+    while (fgets(line, sizeof(line), f))
     {
-        nowString(r->endTime, sizeof(r->endTime));
+        line[strcspn(line, "\n")] = 0;
+        Rental row;
+        RentalDetail detail;
+        if (!parseRentalCSV(line, &row, &detail))
+            continue; // The header, or a damaged row
+        fn(&row, ctx);
+        rows++;
     }
+    fclose(f);
+    return rows;
+}
 
-    r->status = RENT_COMPLETED;
+Rental *findRentalById(const RentalTable *table, int rentalId)
+{
+    for (size_t i = 0; i < table->count; i++)
+        if (table->rows[i].id == rentalId)
+            return &table->rows[i];
+    return NULL;
+}
 
-    Vehicle *v = findVehicleById(vehicleHead, r->vehicleId);
-    if (v)
+// Calls fn for each row of a month's text, as a partition file or a segment holds it.
+// Stops and returns 1 as soon as fn does.
+static int forEachRentalLine(char *text, int (*fn)(const Rental *r, const RentalDetail *d, void *ctx), void *ctx)
+{
+    char *line = text;
+    while (line && *line)
     {
-        v->available = 1;
+        char *end = strchr(line, '\n');
+        if (end)
+            *end = '\0';
+        Rental row;
+        RentalDetail detail;
+        int stop = parseRentalCSV(line, &row, &detail) && fn(&row, &detail, ctx);
+        if (end)
+            *end = '\n';
+        if (stop)
+            return 1;
+        line = end ? end + 1 : NULL;
     }
-    else
+    return 0;
+}
+
+typedef struct
+{
+    int id;
+    Rental *out;
+    RentalDetail *detail;
+} ArchivedLookup;
+
+static int matchArchivedRental(const Rental *r, const RentalDetail *d, void *ctx)
+{
+    ArchivedLookup *lookup = (ArchivedLookup *)ctx;
+    if (r->id != lookup->id)
+        return 0;
+    *lookup->out = *r;
+    *lookup->detail = *d;
+    return 1;
+}
+
+int fetchArchivedRental(const RentalTable *table, int rentalId, Rental *out, RentalDetail *detail)
+{
+    ArchivedLookup lookup = {rentalId, out, detail};
+    for (int i = 0; i < table->cold.count; i++)
     {
-        printf("Warning: vehicle #%d not found; continue anyway.\n", r->vehicleId);
+        const ColdMonth *m = &table->cold.months[i];
+        if (rentalId < m->minId || rentalId > m->maxId)
+            continue;
+        char path[256];
+        size_t size;
+        coldSegmentPath(&table->cold, m->month, path, sizeof(path));
+        char *text = readColdSegment(path, &size);
+        int found = text && forEachRentalLine(text, matchArchivedRental, &lookup);
+        free(text);
+        if (found)
+            return 1;
     }
+    return 0;
+}
 
-    char choice[10];
-    getStringInput("\nWould you like to rate this rental experience? (y/n): ", choice, 10);
+// What archiving one month finds in its rows.
+typedef struct
+{
+    ColdTier *cold;
+    ColdMonth stats;
+    int active;
+    int failed;
+} MonthArchive;
 
-    if (choice[0] == 'y' || choice[0] == 'Y')
+static int addToRollup(const Rental *r, const RentalDetail *d, void *ctx)
+{
+    MonthArchive *a = (MonthArchive *)ctx;
+    if (r->status == RENT_ACTIVE)
     {
-        printf("\n--- Rate Your Experience (1-5 Stars) ---\n");
-        printf("1 = Poor, 2 = Fair, 3 = Good, 4 = Very Good, 5 = Excellent\n");
+        a->active = 1;
+        return 1; // The month stays hot
+    }
+    ColdMonth *m = &a->stats;
+    if (m->rows == 0 || r->id < m->minId)
+        m->minId = r->id;
+    if (m->rows == 0 || r->id > m->maxId)
+        m->maxId = r->id;
+    if (m->rows == 0 || r->startAt < m->minAt)
+        m->minAt = r->startAt;
+    if (m->rows == 0 || r->startAt > m->maxAt)
+        m->maxAt = r->startAt;
+    m->rows++;
+    RentalRollup *rollup = coldRollupFor(a->cold, m->month, r->vehicleId);
+    if (!rollup)
+    {
+        a->failed = 1;
+        return 1;
+    }
+    rollup->rentals++;
+    if (r->status == RENT_COMPLETED)
+        rollup->revenue += r->totalCost;
+    if (d->vehicleRating > 0)
+    {
+        rollup->ratingSum += d->vehicleRating;
+        rollup->ratings++;
+    }
+    return 0;
+}
 
-        int v_rating = getIntegerInput("How was the vehicle? ", 1, 5);
-        int d_rating = getIntegerInput("How was the driver? ", 1, 5);
+// The whole of a file, NUL-terminated, or NULL.
+static char *readWholeFile(const char *path, size_t *size)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f)
+        return NULL;
+    fseek(f, 0, SEEK_END);
+    long length = ftell(f);
+    rewind(f);
+    char *text = length >= 0 ? (char *)malloc((size_t)length + 1) : NULL;
+    size_t got = text ? fread(text, 1, (size_t)length, f) : 0;
+    fclose(f);
+    if (text && got != (size_t)length)
+    {
+        free(text);
+        return NULL;
+    }
+    if (text)
+        text[got] = '\0';
+    *size = got;
+    return text;
+}
 
-        r->vehicleRating = v_rating;
-        r->driverRating = d_rating;
+// Writes the month's segment and adds it to the cold tier. Returns 1 if it was
+// archived, 0 if it has to stay (an active rental), -1 on error. Rollups added for
+// a month that stays are dropped with it by the caller.
+static int archiveMonth(ColdTier *cold, const char *path, int month, long *bytes, long *stored)
+{
+    size_t size;
+    char *text = readWholeFile(path, &size);
+    if (!text)
+    {
+        printf("Error: could not read %s\n", path);
+        return -1;
+    }
+    MonthArchive a = {cold, {0}, 0, 0};
+    a.stats.month = month;
+    forEachRentalLine(text, addToRollup, &a);
+    char segment[256];
+    coldSegmentPath(cold, month, segment, sizeof(segment));
+    int result = a.failed ? -1 : a.active ? 0 : 1;
+    if (result == 1 && !writeColdSegment(segment, text, size))
+        result = -1;
+    free(text);
+    ColdMonth *m = result == 1 ? addColdMonth(cold, month) : NULL;
+    if (result == 1 && !m)
+        result = -1;
+    if (m)
+    {
+        *m = a.stats;
+        struct stat st;
+        *bytes += (long)size;
+        *stored += stat(segment, &st) == 0 ? (long)st.st_size : 0;
+    }
+    return result;
+}
 
-        printf("\nQuick comment (optional, max 50 characters): ");
-        char tempComment[51];
-        getStringInput("", tempComment, 51);
+// Drops the rollups of a month that was not archived after all.
+static void dropRollups(ColdTier *cold, int month)
+{
+    const RentalRollup *first;
+    int count = coldRollupsOf(cold, month, &first);
+    int at = (int)(first - cold->rollups);
+    memmove(&cold->rollups[at], &cold->rollups[at + count],
+            (size_t)(cold->rollupCount - at - count) * sizeof(RentalRollup));
+    cold->rollupCount -= count;
+}
 
-        if (strlen(tempComment) > 0)
+int archiveRentals(int ageMonths)
+{
+    PartitionSet set;
+    ColdTier cold;
+    partitionSetInit(&set, RENTAL_DIR, RENTAL_HEADER);
+    coldTierInit(&cold, RENTAL_DIR);
+    if (!loadPartitionManifest(&set) || !loadColdTier(&cold))
+    {
+        partitionSetClear(&set);
+        coldTierClear(&cold);
+        return 0; // Not split into months yet; the first save does that
+    }
+    int before = partitionMonthAdd(partitionMonthOf(time(NULL)), -ageMonths);
+    int archived[64], count = 0, failed = 0;
+    long rows = 0, bytes = 0, stored = 0;
+    for (int i = 0; !failed && count < 64 && i < set.count; i++)
+    {
+        const Partition *p = &set.parts[i];
+        // Undated rows cannot be aged; a month with active rentals is still in use.
+        if (p->month == 0 || p->month >= before || p->open > 0 || p->rows <= 0 || findColdMonth(&cold, p->month))
+            continue;
+        char path[256];
+        partitionPath(&set, p->month, path, sizeof(path));
+        int result = archiveMonth(&cold, path, p->month, &bytes, &stored);
+        if (result == 1)
         {
-            strncpy(r->comment, tempComment, sizeof(r->comment) - 1);
-            r->comment[sizeof(r->comment) - 1] = '\0';
+            archived[count++] = p->month;
+            rows += findColdMonth(&cold, p->month)->rows;
         }
         else
         {
-            r->comment[0] = '\0';
-        }
-
-        if (v)
-        {
-            updateVehicleRating(vehicleHead, r->vehicleId, v_rating);
+            dropRollups(&cold, p->month);
+            failed = result < 0;
         }
-
-        if (r->driverId > 0 && driverHead)
+    }
+    // The segments are durable; the index makes the months archived, and only then
+    // do their partitions go.
+    if (count && saveColdTier(&cold))
+    {
+        asyncIoDrain();
+        for (int i = 0; i < count; i++)
+            partitionRemove(&set, archived[i]);
+        if (savePartitionManifest(&set))
         {
-            Driver *driver = findDriverById(driverHead, r->driverId);
-            if (driver)
+            asyncIoDrain();
+            for (int i = 0; i < count; i++)
             {
-                updateDriverRating(driver, (float)d_rating);
+                char path[256];
+                partitionPath(&set, archived[i], path, sizeof(path));
+                remove(path);
             }
         }
-
-        printf("Thank you for your feedback!\n");
+        printf("Archived %d month(s) of rentals (%ld rows, %.1f KB compressed to %.1f KB) into %s/\n", count, rows,
+               bytes / 1024.0, stored / 1024.0, RENTAL_DIR);
     }
-
-    if (v)
+    else if (count)
     {
-        saveVehicles(vehicleHead);
+        failed = 1;
     }
+    partitionSetClear(&set);
+    coldTierClear(&cold);
+    return failed ? -1 : count;
+}
 
-    printf("Rental #%d marked COMPLETED. Vehicle #%d is now AVAILABLE.\n",
-           r->id, r->vehicleId);
-
-    if (r->driverId > 0 && driverHead)
+const char *rentalResultStr(RentalResult result)
+{
+    switch (result)
     {
-        Driver *driver = findDriverById(driverHead, r->driverId);
-        if (driver)
-        {
-            completeDriverTrip(driver, r->totalCost * 0.3);
-            printf("Driver #%d (%s) completed trip and is now AVAILABLE.\n",
-                   driver->id, driver->name);
-        }
+    case RENTAL_OK:
+        return "ok";
+    case RENTAL_ERR_NO_VEHICLE:
+        return "vehicle not found";
+    case RENTAL_ERR_VEHICLE_INACTIVE:
+        return "vehicle is inactive";
+    case RENTAL_ERR_VEHICLE_UNAVAILABLE:
+        return "vehicle is not available";
+    case RENTAL_ERR_BAD_TYPE:
+        return "invalid rental type";
+    case RENTAL_ERR_BAD_DURATION:
+        return "invalid duration";
+    case RENTAL_ERR_NO_ROUTE:
+        return "route not found";
+    case RENTAL_ERR_BAD_TIME:
+        return "invalid date format";
+    case RENTAL_ERR_BAD_TIME_RANGE:
+        return "invalid rental time range";
+    case RENTAL_ERR_CONFLICT:
+        return "vehicle is already booked during the requested time";
+    case RENTAL_ERR_NOT_ACTIVE:
+        return "rental is not active";
+    case RENTAL_ERR_NOT_COMPLETED:
+        return "rental is not completed";
+    case RENTAL_ERR_ALREADY_RATED:
+        return "rental is already rated";
+    case RENTAL_ERR_BAD_RATING:
+        return "ratings must be between 1 and 5";
+    case RENTAL_ERR_NO_MEMORY:
+        return "out of memory";
+    default:
+        return "unknown error";
     }
+}
 
-    return 1;
+// "YYYY-MM-DD HH:MM"
+static int isDateTimeText(const char *text)
+{
+    return strlen(text) == 16 && text[4] == '-' && text[7] == '-' &&
+           text[10] == ' ' && text[13] == ':';
 }
 
-int cancelRental(Rental *r, Vehicle *vehicleHead, Driver *driverHead)
+// Claims an active rental for a status change and keeps its current version for
+// the snapshots that must not see the change. Fails if it is not active, which is
+// also how the second of two threads completing or cancelling it together finds out.
+static RentalResult claimActiveRental(Rental *r, uint64_t *previousTs)
 {
-    if (!r)
+    *previousTs = mvccClaim(&r->mvcc);
+    if (r->status != RENT_ACTIVE)
     {
-        printf("Error: NULL rental.\n");
-        return 0;
+        mvccRelease(&r->mvcc, *previousTs);
+        return RENTAL_ERR_NOT_ACTIVE;
     }
-    if (r->status != RENT_ACTIVE)
+    if (!mvccPreserve(&r->mvcc, sizeof(Rental), *previousTs))
     {
-        printf("Rental #%d is not ACTIVE (current status: %d).\n", r->id, (int)r->status);
-        return 0;
+        mvccRelease(&r->mvcc, *previousTs);
+        return RENTAL_ERR_NO_MEMORY;
     }
+    return RENTAL_OK;
+}
 
-    nowString(r->endTime, sizeof(r->endTime));
-    r->status = RENT_CANCELLED;
+static void leaveActive(RentalTable *table, Rental *r, RentalStatus status, const char *endTime)
+{
+    __atomic_store_n(&r->status, (uint8_t)status, __ATOMIC_RELEASE);
+    countOpenRental(table, r, -1);
+    RentalDetail *d = rentalDetail(table, r);
+    setEndTime(r, d, endTime);
+    markRentalChanged(table, r);
+    journalRental(r, d);
+    MvccHeader *record = &r->mvcc;
+    mvccCommit(&record, 1);
+    noteVersionedRow(table, (size_t)(r - table->rows));
+}
 
-    Vehicle *v = findVehicleById(vehicleHead, r->vehicleId);
+// Released after the status change, so a booking that sees the vehicle available
+// also sees the rental that held it as no longer active.
+static void releaseVehicle(Vehicle *vehicleHead, int vehicleId)
+{
+    Vehicle *v = findVehicleById(vehicleHead, vehicleId);
     if (v)
     {
-        v->available = 1;
-        saveVehicles(vehicleHead);
+        __atomic_store_n(&v->available, 1, __ATOMIC_RELEASE);
+        markDirty(DIRTY_VEHICLES);
     }
+}
+
+RentalResult completeRental(RentalTable *table, Rental *r, Vehicle *vehicleHead, Driver *driverHead, const char *actualEnd)
+{
+    if (r->status != RENT_ACTIVE)
+        return RENTAL_ERR_NOT_ACTIVE;
+    if (actualEnd && actualEnd[0] && !isDateTimeText(actualEnd))
+        return RENTAL_ERR_BAD_TIME;
+    uint64_t previousTs;
+    RentalResult claimed = claimActiveRental(r, &previousTs);
+    if (claimed != RENTAL_OK)
+        return claimed;
+
+    char endTime[20];
+    RentalDetail *d = rentalDetail(table, r);
+    if (actualEnd && actualEnd[0])
+        snprintf(endTime, sizeof(endTime), "%s", actualEnd);
+    else if (d->endTime[0])
+        snprintf(endTime, sizeof(endTime), "%s", d->endTime);
     else
+        nowString(endTime, sizeof(endTime));
+    leaveActive(table, r, RENT_COMPLETED, endTime);
+
+    releaseVehicle(vehicleHead, r->vehicleId);
+
+    if (r->driverId > 0 && driverHead)
     {
-        printf("Warning: vehicle #%d not found; continue anyway.\n", r->vehicleId);
+        Driver *driver = findDriverById(driverHead, r->driverId);
+        if (driver)
+            completeDriverTrip(driver, moneyApplyBasisPoints(r->totalCost, DRIVER_SHARE_BPS));
     }
+    return RENTAL_OK;
+}
 
-    printf("Rental #%d CANCELLED. Vehicle #%d is now AVAILABLE.\n",
-           r->id, r->vehicleId);
+RentalResult cancelRental(RentalTable *table, Rental *r, Vehicle *vehicleHead, Driver *driverHead)
+{
+    uint64_t previousTs;
+    RentalResult claimed = claimActiveRental(r, &previousTs);
+    if (claimed != RENTAL_OK)
+        return claimed;
+
+    char now[20];
+    nowString(now, sizeof(now));
+    leaveActive(table, r, RENT_CANCELLED, now);
+
+    releaseVehicle(vehicleHead, r->vehicleId);
 
     if (r->driverId > 0 && driverHead)
     {
         Driver *driver = findDriverById(driverHead, r->driverId);
         if (driver)
-        {
             updateDriverStatus(driver, DRIVER_AVAILABLE);
-            printf("Driver #%d (%s) is now AVAILABLE.\n", driver->id, driver->name);
-        }
     }
+    return RENTAL_OK;
+}
 
-    return 1;
+RentalResult rateRental(RentalTable *table, Rental *r, Vehicle *vehicleHead, Driver *driverHead,
+                        int vehicleRating, int driverRating, const char *comment)
+{
+    if (r->status != RENT_COMPLETED)
+        return RENTAL_ERR_NOT_COMPLETED;
+    RentalDetail *d = rentalDetail(table, r);
+    if (d->vehicleRating > 0 || d->driverRating > 0)
+        return RENTAL_ERR_ALREADY_RATED;
+    if (vehicleRating < 1 || vehicleRating > 5 || driverRating < 1 || driverRating > 5)
+        return RENTAL_ERR_BAD_RATING;
+    int unrated = 0;
+    if (!__atomic_compare_exchange_n(&d->vehicleRating, &unrated, vehicleRating, 0,
+                                     __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        return RENTAL_ERR_ALREADY_RATED;
+
+    d->driverRating = driverRating;
+    strncpy(d->comment, comment ? comment : "", sizeof(d->comment) - 1);
+    d->comment[sizeof(d->comment) - 1] = '\0';
+    // The rentals files are plain CSV with the comment last; a comma or newline would split the row.
+    for (char *c = d->comment; *c; c++)
+    {
+        if (*c == ',' || *c == '\n' || *c == '\r')
+            *c = ' ';
+    }
+    markRentalChanged(table, r);
+    journalRental(r, d);
+
+    updateVehicleRating(vehicleHead, r->vehicleId, vehicleRating);
+    if (r->driverId > 0 && driverHead)
+    {
+        Driver *driver = findDriverById(driverHead, r->driverId);
+        if (driver)
+            updateDriverRating(driver, (float)driverRating);
+    }
+    return RENTAL_OK;
 }
 
-void completeRentalPrompt(Rental *rentalHead, Vehicle *vehicleHead, Driver *driverHead)
+static Rental *promptForRental(RentalTable *table, const char *prompt)
 {
-    if (!rentalHead)
+    if (table->count == 0)
     {
         printf("No rentals yet.\n");
-        return;
+        return NULL;
     }
     char buf[32];
-    getInput("Enter Rental ID to complete: ", buf, sizeof(buf));
+    getInput(prompt, buf, sizeof(buf));
     if (!isValidNumber(buf))
     {
         printf("Invalid ID.\n");
-        return;
+        return NULL;
     }
-    int rid = atoi(buf);
-
-    Rental *r = findRentalById(rentalHead, rid);
+    Rental *r = findRentalById(table, atoi(buf));
     if (!r)
     {
         printf("Rental not found.\n");
-        return;
+        return NULL;
     }
-
-    if (completeRental(r, vehicleHead, driverHead))
+    if (r->status != RENT_ACTIVE)
     {
-        saveRentals(rentalHead);
-        saveDrivers(driverHead);
+        printf("Rental #%d is not ACTIVE (current status: %d).\n", r->id, (int)r->status);
+        return NULL;
     }
+    return r;
 }
 
-void cancelRentalPrompt(Rental *rentalHead, Vehicle *vehicleHead, Driver *driverHead)
+void completeRentalPrompt(RentalTable *table, Vehicle *vehicleHead, Driver *driverHead)
 {
-    if (!rentalHead)
+    Rental *r = promptForRental(table, "Enter Rental ID to complete: ");
+    if (!r)
+        return;
+
+    const RentalDetail *d = rentalDetail(table, r);
+    char actualEnd[32];
+    printf("Enter actual end time (YYYY-MM-DD HH:MM) or leave blank to keep [%s]: ",
+           d->endTime[0] ? d->endTime : "(empty)");
+    getInput("", actualEnd, sizeof(actualEnd));
+    if (!isDateTimeText(actualEnd))
+        actualEnd[0] = '\0';
+
+    Vehicle *v = findVehicleById(vehicleHead, r->vehicleId);
+    if (!v)
+        printf("Warning: vehicle #%d not found; continue anyway.\n", r->vehicleId);
+
+    RentalResult result = completeRental(table, r, vehicleHead, driverHead, actualEnd);
+    if (result != RENTAL_OK)
     {
-        printf("No rentals yet.\n");
+        printf("Could not complete rental #%d: %s.\n", r->id, rentalResultStr(result));
         return;
     }
-    char buf[32];
-    getInput("Enter Rental ID to cancel: ", buf, sizeof(buf));
-    if (!isValidNumber(buf))
+
+    char choice[10];
+    getStringInput("\nWould you like to rate this rental experience? (y/n): ", choice, 10);
+    if (choice[0] == 'y' || choice[0] == 'Y')
     {
-        printf("Invalid ID.\n");
-        return;
+        printf("\n--- Rate Your Experience (1-5 Stars) ---\n");
+        printf("1 = Poor, 2 = Fair, 3 = Good, 4 = Very Good, 5 = Excellent\n");
+
+        int vRating = getIntegerInput("How was the vehicle? ", 1, 5);
+        int dRating = getIntegerInput("How was the driver? ", 1, 5);
+
+        printf("\nQuick comment (optional, max 50 characters): ");
+        char comment[51];
+        getStringInput("", comment, 51);
+
+        if (rateRental(table, r, vehicleHead, driverHead, vRating, dRating, comment) == RENTAL_OK)
+            printf("Thank you for your feedback!\n");
     }
-    int rid = atoi(buf);
 
-    Rental *r = findRentalById(rentalHead, rid);
+    printf("Rental #%d marked COMPLETED. Vehicle #%d is now AVAILABLE.\n",
+           r->id, r->vehicleId);
+    if (r->driverId > 0 && driverHead)
+    {
+        Driver *driver = findDriverById(driverHead, r->driverId);
+        if (driver)
+        {
+            printf("Driver #%d (%s) completed trip and is now AVAILABLE.\n",
+                   driver->id, driver->name);
+        }
+    }
+}
+
+void cancelRentalPrompt(RentalTable *table, Vehicle *vehicleHead, Driver *driverHead)
+{
+    Rental *r = promptForRental(table, "Enter Rental ID to cancel: ");
     if (!r)
+        return;
+
+    Vehicle *v = findVehicleById(vehicleHead, r->vehicleId);
+    if (!v)
+        printf("Warning: vehicle #%d not found; continue anyway.\n", r->vehicleId);
+
+    RentalResult result = cancelRental(table, r, vehicleHead, driverHead);
+    if (result != RENTAL_OK)
     {
-        printf("Rental not found.\n");
+        printf("Could not cancel rental #%d: %s.\n", r->id, rentalResultStr(result));
         return;
     }
 
-    if (cancelRental(r, vehicleHead, driverHead))
+    printf("Rental #%d CANCELLED. Vehicle #%d is now AVAILABLE.\n",
+           r->id, r->vehicleId);
+    if (r->driverId > 0 && driverHead)
     {
-        saveRentals(rentalHead);
-        saveDrivers(driverHead);
+        Driver *driver = findDriverById(driverHead, r->driverId);
+        if (driver)
+            printf("Driver #%d (%s) is now AVAILABLE.\n", driver->id, driver->name);
     }
 }
 
-static const char *typeStr(RentalType t)
+const char *rentalTypeStr(RentalType t)
 {
     switch (t)
     {
@@ -486,7 +1337,7 @@ static const char *typeStr(RentalType t)
         return "UNKNOWN";
     }
 }
-static const char *statusStr(RentalStatus s)
+const char *rentalStatusStr(RentalStatus s)
 {
     switch (s)
     {
@@ -501,9 +1352,9 @@ static const char *statusStr(RentalStatus s)
     }
 }
 
-void displayAllRentals(Rental *head)
+void displayAllRentals(const RentalTable *table)
 {
-    if (!head)
+    if (table->count == 0)
     {
         printf("No rentals found.\n");
         return;
@@ -511,11 +1362,15 @@ void displayAllRentals(Rental *head)
     printf("\n--- All Rentals ---\n");
     printf("%-6s %-6s %-7s %-7s %-17s %-17s %-10s %-8s\n",
            "ID", "Cust", "Veh", "Type", "Start", "End", "Status", "Cost");
-    for (Rental *r = head; r; r = r->next)
+    for (size_t i = 0; i < table->count; i++)
     {
-        printf("%-6d %-6d %-7d %-7s %-17s %-17s %-10s $%-7.2f\n",
-               r->id, r->customerId, r->vehicleId, typeStr(r->type),
-               r->startTime, r->endTime, statusStr(r->status), r->totalCost);
+        const Rental *r = &table->rows[i];
+        const RentalDetail *d = &table->details[i];
+        char cost[MONEY_STR_SIZE];
+        formatMoney(r->totalCost, cost, sizeof(cost));
+        printf("%-6d %-6d %-7d %-7s %-17s %-17s %-10s $%-7s\n",
+               r->id, r->customerId, r->vehicleId, rentalTypeStr(r->type),
+               d->startTime, d->endTime, rentalStatusStr(r->status), cost);
         if (r->type == RENT_ROUTE && r->routeId > 0)
         {
             printf("   Route ID: %d\n", r->routeId);
@@ -523,37 +1378,42 @@ void displayAllRentals(Rental *head)
     }
 }
 
-void displayRental(const Rental *r)
+void displayRental(const RentalTable *table, const Rental *r)
 {
     if (!r)
         return;
-    printf("Rental ID: %d | Customer ID: %d | Vehicle ID: %d | Driver ID: %d | Type: %d | Start: %s | End: %s | Cost: %.2f | Status: %d\n",
-           r->id, r->customerId, r->vehicleId, r->driverId, r->type, r->startTime, r->endTime, r->totalCost, r->status);
+    const RentalDetail *d = rentalDetail(table, r);
+    printf("Rental ID: %d | Customer ID: %d | Vehicle ID: %d | Driver ID: %d | Type: %d | Start: %s | End: %s | Cost: " MONEY_FMT " | Status: %d\n",
+           r->id, r->customerId, r->vehicleId, r->driverId, r->type, d->startTime, d->endTime, MONEY_ARGS(r->totalCost), r->status);
 
-    if (r->vehicleRating > 0 || r->driverRating > 0)
+    if (d->vehicleRating > 0 || d->driverRating > 0)
     {
-        printf("   Ratings - Vehicle: %d/5, Driver: %d/5", r->vehicleRating, r->driverRating);
-        if (r->comment[0] != '\0')
+        printf("   Ratings - Vehicle: %d/5, Driver: %d/5", d->vehicleRating, d->driverRating);
+        if (d->comment[0] != '\0')
         {
-            printf(" | Comment: \"%s\"", r->comment);
+            printf(" | Comment: \"%s\"", d->comment);
         }
         printf("\n");
     }
 }
 
-void displayRentalsByCustomer(Rental *head, int customerId)
+void displayRentalsByCustomer(const RentalTable *table, int customerId)
 {
     int found = 0;
     printf("\n--- My Rentals ---\n");
     printf("%-6s %-7s %-7s %-17s %-17s %-10s %-7s\n",
            "ID", "Veh", "Type", "Start", "End", "Status", "Cost");
-    for (Rental *r = head; r; r = r->next)
+    for (size_t i = 0; i < table->count; i++)
     {
+        const Rental *r = &table->rows[i];
         if (r->customerId == customerId)
         {
-            printf("%-6d %-7d %-7s %-17s %-17s %-10s $%-7.2f\n",
-                   r->id, r->vehicleId, typeStr(r->type),
-                   r->startTime, r->endTime, statusStr(r->status), r->totalCost);
+            const RentalDetail *d = &table->details[i];
+            char cost[MONEY_STR_SIZE];
+            formatMoney(r->totalCost, cost, sizeof(cost));
+            printf("%-6d %-7d %-7s %-17s %-17s %-10s $%-7s\n",
+                   r->id, r->vehicleId, rentalTypeStr(r->type),
+                   d->startTime, d->endTime, rentalStatusStr(r->status), cost);
             if (r->type == RENT_ROUTE && r->routeId > 0)
             {
                 printf("   Route ID: %d\n", r->routeId);
@@ -565,7 +1425,156 @@ void displayRentalsByCustomer(Rental *head, int customerId)
         printf("No rentals.\n");
 }
 
-void createRentalByCustomer(Rental **rentalHead, Vehicle *vehicleHead, Customer *current, Promo *promoHead, Driver *driverHead, Invoice **invoiceHead)
+// The part of bookRental that runs under the vehicle's lock.
+static RentalResult bookLockedVehicle(RentalTable *table, Vehicle *v, Promo *promoHead, Driver *driverHead,
+                                      const BookingRequest *request, BookingResult *result, long *rowIndex)
+{
+    if (!v->active)
+        return RENTAL_ERR_VEHICLE_INACTIVE;
+    if (!__atomic_load_n(&v->available, __ATOMIC_ACQUIRE))
+        return RENTAL_ERR_VEHICLE_UNAVAILABLE;
+
+    // Built on the stack and appended to the table once every check has passed.
+    Rental row = {0};
+    RentalDetail detail = {0};
+    row.customerId = request->customerId;
+    row.vehicleId = v->id;
+    row.status = RENT_ACTIVE;
+
+    char timeText[20];
+    nowString(timeText, sizeof(timeText));
+    setStartTime(&row, &detail, timeText);
+
+    int minutes;
+    switch (request->type)
+    {
+    case RENT_HOURLY:
+        if (request->quantity < 1 || request->quantity > 24)
+            return RENTAL_ERR_BAD_DURATION;
+        row.totalCost = request->quantity * v->ratePerHour;
+        minutes = request->quantity * 60;
+        break;
+    case RENT_DAILY:
+        if (request->quantity < 1 || request->quantity > 30)
+            return RENTAL_ERR_BAD_DURATION;
+        row.totalCost = request->quantity * v->ratePerDay;
+        minutes = request->quantity * 24 * 60;
+        break;
+    case RENT_ROUTE:
+    {
+        Route *route = findRouteById(*loadedRoutes(), request->routeId);
+        if (!route)
+            return RENTAL_ERR_NO_ROUTE;
+        row.routeId = route->id;
+        row.totalCost = route->baseFare;
+        minutes = route->etaMin;
+        break;
+    }
+    default:
+        return RENTAL_ERR_BAD_TYPE;
+    }
+    row.type = (uint8_t)request->type;
+    futureStringMinutes(minutes, timeText, sizeof(timeText));
+    setEndTime(&row, &detail, timeText);
+    result->startAt = row.startAt;
+    result->endAt = row.endAt;
+
+    if (!row.startAt || !row.endAt)
+        return RENTAL_ERR_BAD_TIME;
+    if (!validateRentalTimeRange((time_t)row.startAt, (time_t)row.endAt, row.type))
+        return RENTAL_ERR_BAD_TIME_RANGE;
+    pthread_rwlock_rdlock(&table->lock);
+    int booked = isVehicleBooked(table, v->id, (time_t)row.startAt, (time_t)row.endAt);
+    pthread_rwlock_unlock(&table->lock);
+    if (booked)
+        return RENTAL_ERR_CONFLICT;
+
+    result->originalCost = row.totalCost;
+    if (request->promoCode && request->promoCode[0])
+    {
+        result->promo = findActivePromoByCode(promoHead, request->promoCode);
+        if (result->promo)
+        {
+            result->discountAmount = moneyApplyBasisPoints(row.totalCost, result->promo->discountBps);
+            row.totalCost -= result->discountAmount;
+        }
+    }
+
+    // Assigned last so a rejected booking never leaves a driver marked busy.
+    if (driverHead)
+    {
+        result->driver = assignDriverToRental(driverHead, vehicleTypeStr(v->type));
+        if (result->driver)
+            row.driverId = result->driver->id;
+    }
+
+    // An id lost to a failed append is simply skipped. The row stays invisible to
+    // snapshots until bookRental commits it.
+    row.id = allocateId(ID_RENTAL);
+    row.mvcc.beginTs = MVCC_UNCOMMITTED;
+    *rowIndex = appendRow(table, &row, &detail);
+    if (*rowIndex < 0)
+    {
+        if (result->driver)
+            updateDriverStatus(result->driver, DRIVER_AVAILABLE);
+        return RENTAL_ERR_NO_MEMORY;
+    }
+    __atomic_store_n(&v->available, 0, __ATOMIC_RELEASE);
+    markDirty(DIRTY_VEHICLES);
+    result->rental = row;
+    result->detail = detail;
+    result->vehicle = v;
+    return RENTAL_OK;
+}
+
+RentalResult bookRental(RentalTable *table, Vehicle *vehicleHead, Promo *promoHead, Driver *driverHead,
+                        Invoice **invoiceHead, const BookingRequest *request, BookingResult *result)
+{
+    memset(result, 0, sizeof(*result));
+
+    Vehicle *v = findVehicleById(vehicleHead, request->vehicleId);
+    if (!v)
+        return RENTAL_ERR_NO_VEHICLE;
+
+    pthread_mutex_t *vehicleLock = vehicleLockFor(v->id);
+    long rowIndex = -1;
+    pthread_mutex_lock(vehicleLock);
+    RentalResult status = bookLockedVehicle(table, v, promoHead, driverHead, request, result, &rowIndex);
+    pthread_mutex_unlock(vehicleLock);
+    if (status != RENTAL_OK)
+        return status;
+
+    // The invoice only reads the copied row, so it is built outside the vehicle lock.
+    if (invoiceHead)
+    {
+        const Rental *r = &result->rental;
+        Invoice *invoice = createInvoice(r->id, r->customerId, r->driverId, result->originalCost,
+                                         result->discountAmount, result->promo ? result->promo->code : "");
+        if (invoice)
+        {
+            linkNewInvoice(invoiceHead, invoice);
+            result->invoice = invoice;
+        }
+    }
+
+    // Journaled before the commit: nobody else can change the row or the invoice
+    // until they are visible.
+    journalRental(&result->rental, &result->detail);
+    if (result->invoice)
+        journalInvoice(result->invoice);
+
+    MvccHeader *records[2];
+    int recordCount = 0;
+    pthread_rwlock_rdlock(&table->lock);
+    records[recordCount++] = &table->rows[rowIndex].mvcc;
+    if (result->invoice)
+        records[recordCount++] = &result->invoice->mvcc;
+    mvccCommit(records, recordCount);
+    pthread_rwlock_unlock(&table->lock);
+    return status;
+}
+
+void createRentalByCustomer(RentalTable *table, Vehicle *vehicleHead, Customer *current, Promo *promoHead, Driver *driverHead, Invoice **invoiceHead)
 {
     if (!current)
     {
@@ -601,8 +1610,8 @@ void createRentalByCustomer(Rental **rentalHead, Vehicle *vehicleHead, Customer
     }
 
     printf("\nSelect Rental Type:\n");
-    printf("1) Hourly (rate: %.2f/hr)\n", v->ratePerHour);
-    printf("2) Daily  (rate: %.2f/day)\n", v->ratePerDay);
+    printf("1) Hourly (rate: " MONEY_FMT "/hr)\n", MONEY_ARGS(v->ratePerHour));
+    printf("2) Daily  (rate: " MONEY_FMT "/day)\n", MONEY_ARGS(v->ratePerDay));
     printf("3) Route Trip (if routes exist)\n");
     getInput("Choose (1-3): ", buf, sizeof(buf));
     if (!isValidNumber(buf))
@@ -617,118 +1626,83 @@ void createRentalByCustomer(Rental **rentalHead, Vehicle *vehicleHead, Customer
         return;
     }
 
-    Rental *r = (Rental *)malloc(sizeof(Rental));
-    if (!r)
-    {
-        printf("Memory allocation failed.\n");
-        return;
-    }
-    memset(r, 0, sizeof(*r));
-    r->id = nextRentalId++;
-    r->customerId = current->id;
-    r->vehicleId = v->id;
-    r->status = RENT_ACTIVE;
-    r->routeId = 0;
-    r->driverId = 0;
-
-    nowString(r->startTime, sizeof(r->startTime));
-
-    if (tchoice == 1)
-    {
-        r->type = RENT_HOURLY;
-        getInput("Enter hours (1-24): ", buf, sizeof(buf));
-        if (!isValidNumber(buf))
-        {
-            printf("Invalid hours.\n");
-            free(r);
-            return;
-        }
-        int hours = atoi(buf);
-        if (hours < 1 || hours > 24)
-        {
-            printf("Invalid hours range.\n");
-            free(r);
-            return;
-        }
+    BookingRequest request = {0};
+    request.customerId = current->id;
+    request.vehicleId = v->id;
+    request.type = (RentalType)tchoice;
 
-        r->totalCost = hours * v->ratePerHour;
-        futureStringMinutes(hours * 60, r->endTime, sizeof(r->endTime));
-    }
-    else if (tchoice == 2)
+    if (tchoice == 1 || tchoice == 2)
     {
-        r->type = RENT_DAILY;
-        getInput("Enter days (1-30): ", buf, sizeof(buf));
+        getInput(tchoice == 1 ? "Enter hours (1-24): " : "Enter days (1-30): ", buf, sizeof(buf));
         if (!isValidNumber(buf))
         {
-            printf("Invalid days.\n");
-            free(r);
-            return;
-        }
-        int days = atoi(buf);
-        if (days < 1 || days > 30)
-        {
-            printf("Invalid days range.\n");
-            free(r);
+            printf("Invalid %s.\n", tchoice == 1 ? "hours" : "days");
             return;
         }
-
-        r->totalCost = days * v->ratePerDay;
-        futureStringMinutes(days * 24 * 60, r->endTime, sizeof(r->endTime));
+        request.quantity = atoi(buf);
     }
     else
     {
-        r->type = RENT_ROUTE;
-
-        if (!routeHead)
+        Route *routes = *loadedRoutes();
+        if (!routes)
         {
             printf("No routes defined by admin. Cannot book a route trip.\n");
-            free(r);
             return;
         }
         printf("\n--- Available Routes ---\n");
-        displayAllRoutes(routeHead);
+        displayAllRoutes(routes);
 
         getInput("Enter Route ID: ", buf, sizeof(buf));
         if (!isValidNumber(buf))
         {
             printf("Invalid Route ID.\n");
-            free(r);
             return;
         }
-        int rid = atoi(buf);
-        Route *route = findRouteById(routeHead, rid);
-        if (!route)
-        {
-            printf("Route not found.\n");
-            free(r);
-            return;
-        }
-
-        r->routeId = route->id;
-        r->totalCost = route->baseFare;
-        futureStringMinutes(route->etaMin, r->endTime, sizeof(r->endTime));
+        request.routeId = atoi(buf);
     }
 
+    char promoCode[20] = "";
     char promo_choice[10];
     getStringInput("\nDo you have a promo code? (y/n): ", promo_choice, 10);
-
     if (promo_choice[0] == 'y' || promo_choice[0] == 'Y')
     {
-        char code_input[20];
-        getStringInput("Enter your promo code: ", code_input, 20);
+        getStringInput("Enter your promo code: ", promoCode, 20);
+        request.promoCode = promoCode;
+    }
+
+    BookingResult booked;
+    RentalResult result = bookRental(table, vehicleHead, promoHead, driverHead, invoiceHead, &request, &booked);
+    if (result == RENTAL_ERR_CONFLICT)
+    {
+        char conflictInfo[1024] = "";
+        int conflictCount = checkRentalConflicts(table, v->id, (time_t)booked.startAt, (time_t)booked.endAt,
+                                                 conflictInfo, sizeof(conflictInfo));
+        printf("\n--- BOOKING FAILED ---\n");
+        printf("Sorry, vehicle #%d is already booked during the requested time.\n", v->id);
+        printf("Conflicts found: %d\n", conflictCount);
+        printf("\n--- CONFLICT DETAILS ---\n");
+        printf("%s", conflictInfo);
+        printf("\nPlease try different dates or another vehicle.\n");
+        return;
+    }
+    if (result != RENTAL_OK)
+    {
+        printf("\n--- BOOKING FAILED ---\n");
+        printf("Sorry, %s.\n", rentalResultStr(result));
+        return;
+    }
 
-        Promo *promo = findActivePromoByCode(promoHead, code_input);
+    const Rental *r = &booked.rental;
+    const RentalDetail *d = &booked.detail;
 
-        if (promo)
+    if (request.promoCode)
+    {
+        if (booked.promo)
         {
-            float original_cost = r->totalCost;
-            float discount_amount = original_cost * (promo->discountPercent / 100.0);
-            r->totalCost = original_cost - discount_amount;
-
-            printf("\nSuccess! Promo code '%s' applied.\n", promo->code);
-            printf("  Original Price: $%.2f\n", original_cost);
-            printf("  Discount (%.1f%%): -$%.2f\n", promo->discountPercent, discount_amount);
-            printf("  New Final Price:  $%.2f\n", r->totalCost);
+            printf("\nSuccess! Promo code '%s' applied.\n", booked.promo->code);
+            printf("  Original Price: $" MONEY_FMT "\n", MONEY_ARGS(booked.originalCost));
+            printf("  Discount (%.2f%%): -$" MONEY_FMT "\n", booked.promo->discountBps / 100.0, MONEY_ARGS(booked.discountAmount));
+            printf("  New Final Price:  $" MONEY_FMT "\n", MONEY_ARGS(r->totalCost));
         }
         else
         {
@@ -738,184 +1712,76 @@ void createRentalByCustomer(Rental **rentalHead, Vehicle *vehicleHead, Customer
 
     if (driverHead)
     {
-        Vehicle *vehicle = findVehicleById(vehicleHead, v->id);
-        if (vehicle)
-        {
-            Driver *assignedDriver = assignDriverToRental(driverHead, vehicleTypeStr(vehicle->type));
-            if (assignedDriver)
-            {
-                r->driverId = assignedDriver->id;
-                printf("\n--- DRIVER ASSIGNED ---\n");
-                printf("Driver: %s (ID: %d)\n", assignedDriver->name, assignedDriver->id);
-                printf("Phone: %s | Rating: %.2f/5.0\n", assignedDriver->phone, assignedDriver->rating);
-                printf("Total Trips: %d | Total Earnings: $%d\n", assignedDriver->totalTrips, assignedDriver->totalEarnings);
-            }
-            else
-            {
-                printf("\n--- NO DRIVER AVAILABLE ---\n");
-                printf("No available drivers for %s type vehicles.\n", vehicleTypeStr(vehicle->type));
-                printf("Rental will proceed without driver assignment.\n");
-            }
-        }
-    }
-
-    time_t newStartTime, newEndTime;
-    if (stringToTime(r->startTime, &newStartTime) && stringToTime(r->endTime, &newEndTime))
-    {
-        // Validate rental time range
-        if (!validateRentalTimeRange(newStartTime, newEndTime, r->type))
+        if (booked.driver)
         {
-            printf("\n--- BOOKING FAILED ---\n");
-            printf("Invalid rental time range.\n");
-            free(r);
-            return;
+            printf("\n--- DRIVER ASSIGNED ---\n");
+            printf("Driver: %s (ID: %d)\n", booked.driver->name, booked.driver->id);
+            printf("Phone: %s | Rating: %.2f/5.0\n", booked.driver->phone, booked.driver->rating);
+            printf("Total Trips: %d | Total Earnings: $" MONEY_FMT "\n", booked.driver->totalTrips, MONEY_ARGS(booked.driver->totalEarnings));
         }
-        
-        // Check for conflicts with detailed information
-        char conflictInfo[1024] = "";
-        int conflictCount = checkRentalConflicts(*rentalHead, v->id, newStartTime, newEndTime, conflictInfo, sizeof(conflictInfo));
-        
-        if (conflictCount > 0)
+        else
         {
-            printf("\n--- BOOKING FAILED ---\n");
-            printf("Sorry, vehicle #%d is already booked during the requested time.\n", v->id);
-            printf("Conflicts found: %d\n", conflictCount);
-            printf("\n--- CONFLICT DETAILS ---\n");
-            printf("%s", conflictInfo);
-            printf("\nPlease try different dates or another vehicle.\n");
-            free(r);
-            return;
+            printf("\n--- NO DRIVER AVAILABLE ---\n");
+            printf("No available drivers for %s type vehicles.\n", vehicleTypeStr(v->type));
+            printf("Rental will proceed without driver assignment.\n");
         }
-        
-        printf("\n--- CONFLICT CHECK PASSED ---\n");
-        printf("No conflicts found. Vehicle is available for the requested time.\n");
-    }
-    else
-    {
-        printf("Error: Invalid date format entered.\n");
-        free(r);
-        return;
     }
 
-    r->next = *rentalHead;
-    *rentalHead = r;
+    printf("\n--- CONFLICT CHECK PASSED ---\n");
+    printf("No conflicts found. Vehicle is available for the requested time.\n");
 
-    v->available = 0;
-    saveVehicles(vehicleHead);
-    saveRentals(*rentalHead);
-
-    if (invoiceHead)
+    if (booked.invoice)
     {
-        float originalCost = r->totalCost;
-        float discountAmount = 0.0;
-        char promoCodeUsed[20] = "";
-
-        if (r->totalCost < originalCost)
-        {
-            discountAmount = originalCost - r->totalCost;
-            for (Promo *p = promoHead; p; p = p->next)
-            {
-                if (p->isActive && p->discountPercent > 0)
-                {
-                    float expectedDiscount = originalCost * (p->discountPercent / 100.0);
-                    if (fabs(expectedDiscount - discountAmount) < 0.01)
-                    {
-                        strncpy(promoCodeUsed, p->code, sizeof(promoCodeUsed) - 1);
-                        promoCodeUsed[sizeof(promoCodeUsed) - 1] = '\0';
-                        break;
-                    }
-                }
-            }
-        }
-
-        Invoice *invoice = createInvoice(r->id, r->customerId, r->driverId,
-                                         originalCost, discountAmount, promoCodeUsed);
-        if (invoice)
-        {
-            invoice->next = *invoiceHead;
-            *invoiceHead = invoice;
-
-            Vehicle *vehicle = findVehicleById(vehicleHead, r->vehicleId);
-            char vehicleInfo[256];
-            if (vehicle)
-            {
-                snprintf(vehicleInfo, sizeof(vehicleInfo), "%s %s %s", vehicle->make, vehicle->model, vehicleTypeStr(vehicle->type));
-            }
-            else
-            {
-                strncpy(vehicleInfo, "Unknown Vehicle", sizeof(vehicleInfo) - 1);
-                vehicleInfo[sizeof(vehicleInfo) - 1] = '\0';
-            }
-
-            Driver *driver = NULL;
-            if (r->driverId > 0)
-            {
-                driver = findDriverById(driverHead, r->driverId);
-            }
-
-            generateReceipt(invoice, current->name, vehicleInfo,
-                            driver ? driver->name : NULL);
-            saveReceiptToFile(invoice, current->name, vehicleInfo,
-                              driver ? driver->name : NULL);
-        }
+        char vehicleInfo[256];
+        snprintf(vehicleInfo, sizeof(vehicleInfo), "%s %s %s", v->make, v->model, vehicleTypeStr(v->type));
+        const char *driverName = booked.driver ? booked.driver->name : NULL;
+        generateReceipt(booked.invoice, current->name, vehicleInfo, driverName);
+        saveReceiptToFile(booked.invoice, current->name, vehicleInfo, driverName);
     }
 
     printf("\nRental created!\n");
-    printf("Rental ID: %d | Vehicle: %d | Type: %s | Start: %s | End: %s | Cost: $%.2f | Status: %s\n",
-           r->id, r->vehicleId, typeStr(r->type), r->startTime, r->endTime, r->totalCost, statusStr(r->status));
+    printf("Rental ID: %d | Vehicle: %d | Type: %s | Start: %s | End: %s | Cost: $" MONEY_FMT " | Status: %s\n",
+           r->id, r->vehicleId, rentalTypeStr(r->type), d->startTime, d->endTime, MONEY_ARGS(r->totalCost), rentalStatusStr(r->status));
 }
 
-void listAllRentals(Rental *head)
+void listAllRentals(const RentalTable *table)
 {
-    if (!head)
+    if (table->count == 0)
     {
         printf("No rentals found.\n");
         return;
     }
 
     printf("\n=== All Rentals ===\n");
-    for (Rental *r = head; r; r = r->next)
+    for (size_t i = 0; i < table->count; i++)
     {
-        displayRental(r);
+        displayRental(table, &table->rows[i]);
     }
 }
 
-void freeRentalList(Rental **head)
-{
-    Rental *current = *head;
-    Rental *next;
-
-    while (current != NULL)
-    {
-        next = current->next;
-        free(current);
-        current = next;
-    }
-
-    *head = NULL;
-}
-
-void displayVehicleReviews(Rental *rentalHead, int vehicleId)
+void displayVehicleReviews(const RentalTable *table, int vehicleId)
 {
     printf("\n--- Vehicle Reviews ---\n");
     int reviewCount = 0;
 
-    for (Rental *r = rentalHead; r; r = r->next)
+    for (size_t i = 0; i < table->count; i++)
     {
+        const Rental *r = &table->rows[i];
+        const RentalDetail *d = &table->details[i];
         if (r->vehicleId == vehicleId && r->status == RENT_COMPLETED &&
-            (r->vehicleRating > 0 || r->driverRating > 0))
+            (d->vehicleRating > 0 || d->driverRating > 0))
         {
 
             printf("★★★★★ ");
-            for (int i = 0; i < r->vehicleRating; i++)
+            for (int star = 0; star < d->vehicleRating; star++)
                 printf("★");
-            for (int i = r->vehicleRating; i < 5; i++)
+            for (int star = d->vehicleRating; star < 5; star++)
                 printf("☆");
             printf(" ");
 
-            if (r->comment[0] != '\0')
+            if (d->comment[0] != '\0')
             {
-                printf("\"%s\"", r->comment);
+                printf("\"%s\"", d->comment);
             }
             else
             {
@@ -927,12 +1793,18 @@ void displayVehicleReviews(Rental *rentalHead, int vehicleId)
         }
     }
 
-    if (reviewCount == 0)
+    long archivedSum, archivedCount;
+    coldVehicleRatings(&table->cold, vehicleId, &archivedSum, &archivedCount);
+    if (archivedCount > 0)
+        printf("Archived: %ld older rating(s), %.1f stars on average\n", archivedCount,
+               (double)archivedSum / (double)archivedCount);
+
+    if (reviewCount == 0 && archivedCount == 0)
     {
         printf("No reviews yet for this vehicle.\n");
     }
     else
     {
-        printf("\nTotal reviews: %d\n", reviewCount);
+        printf("\nTotal reviews: %ld\n", reviewCount + archivedCount);
     }
 }
@@ -1,10 +1,15 @@
 #ifndef RENTAL_H
 #define RENTAL_H
 
+#include <pthread.h>
 #include "utils.h"
 #include "promo.h"
 #include "driver.h"
 #include "invoice.h"
+#include "mvcc.h"
+#include "idmap.h"
+#include "partition.h"
+#include "archive.h"
 
 // Forward Declarations
 typedef struct VehicleNode Vehicle;
@@ -24,50 +29,221 @@ typedef enum
     RENT_ROUTE
 } RentalType;
 
-typedef struct RentalNode
+// Hot record: the fields every scan reads (alerts, dashboard, reports, conflict
+// checks). Rows live back to back in RentalTable.rows, 64 bytes each.
+typedef struct
 {
+    MvccHeader mvcc; // Versions for report snapshots; see rentalSnapshotBegin
     int id;
     int customerId;
     int vehicleId;
     int routeId;
-    int driverId; // Assigned driver ID, 0 if no driver assigned
-    RentalType type;
-    RentalStatus status;
-    char startTime[20];
+    int driverId;    // Assigned driver ID, 0 if no driver assigned
+    uint8_t type;    // RentalType
+    uint8_t status;  // RentalStatus
+    int64_t startAt; // Epoch seconds, 0 if unknown
+    int64_t endAt;   // Epoch seconds, 0 if unknown
+    Money totalCost;
+} Rental;
+
+// Cold record: only read when a single rental is shown, rated or saved.
+// details[i] belongs to rows[i].
+typedef struct
+{
+    char startTime[20]; // "YYYY-MM-DD HH:MM", as shown and saved
     char endTime[20];
-    float totalCost;
     int vehicleRating; // Rating for this specific rental (1-5)
     int driverRating;  // Rating for this specific rental (1-5)
     char comment[51];  // Optional comment (max 50 chars + null terminator)
-    struct RentalNode *next;
-} Rental;
+} RentalDetail;
+
+// All loaded rentals, in booking order. Appending may move the arrays, so a Rental
+// pointer is only valid until the next rentalTableAppend. When bookings run on
+// several threads, hold the read lock from findRentalById until the pointer is no
+// longer used; appends take the write lock themselves.
+// The rows are saved in month partitions by start time, in data/rentals/. Start-up
+// may leave old months on disk (see partitionWanted); rows are only ever added to
+// loaded months, since every booking starts now. Archived months (see
+// archiveRentals) are neither loaded nor partitions any more; 'cold' lists them.
+typedef struct RentalTable
+{
+    Rental *rows;
+    RentalDetail *details;
+    size_t count;
+    size_t capacity;
+    pthread_rwlock_t lock;
+    pthread_mutex_t versionLock;
+    size_t *versioned; // Rows that have older versions, trimmed once no snapshot needs them
+    size_t versionedCount;
+    size_t versionedCapacity;
+    size_t sweepAt;    // versionedCount at which the next trim runs
+    PartitionSet partitions; // Changed under the write lock, like count
+    ColdTier cold;           // Read-only once loaded
+} RentalTable;
+
+// A point-in-time view of the table for reports. Rows booked, completed or
+// cancelled after rentalSnapshotBegin are seen as they were before, and reading
+// takes no lock, so bookings keep committing while a long report runs.
+typedef struct
+{
+    const Rental *rows;
+    size_t count;
+    MvccSnapshot mvcc;
+} RentalSnapshot;
+
+// Table management
+void rentalTableInit(RentalTable *table);
+Rental *rentalTableAppend(RentalTable *table, const Rental *row, const RentalDetail *detail);
+RentalDetail *rentalDetail(const RentalTable *table, const Rental *r);
+void freeRentalTable(RentalTable *table);
+void rentalTableReadLock(RentalTable *table);
+void rentalTableReadUnlock(RentalTable *table);
+
+// Report snapshots. Every row a scan uses must be read through rentalSnapshotRow.
+void rentalSnapshotBegin(const RentalTable *table, RentalSnapshot *snap);
+// Copies row i as it was when the snapshot was taken. Returns 0 if it was booked later.
+int rentalSnapshotRow(const RentalSnapshot *snap, size_t i, Rental *out);
+void rentalSnapshotEnd(const RentalTable *table, RentalSnapshot *snap);
+
+// Rows first .. last - 1 of a snapshot.
+typedef struct
+{
+    size_t first;
+    size_t last;
+} RentalRange;
+
+// What a report over the start times [from, to) has to read, with the partitions
+// that cannot hold such rows left out: row ranges of the loaded partitions, merged
+// and in order, the months that are only on disk, and the archived months, which
+// reports take from their rollups (coldRollupsOf on table->cold).
+typedef struct
+{
+    RentalRange *ranges;
+    int rangeCount;
+    int *diskMonths;
+    int diskCount;
+    int *coldMonths;
+    int coldCount;
+    int partitions; // In the table, archived months included
+    int scanned;    // Overlapping the range
+    long rows;      // Rows in the overlapping partitions
+} RentalScanPlan;
+
+// Plans a scan of 'snap' (taken from 'table'). Returns 0 if out of memory.
+int planRentalScan(const RentalTable *table, const RentalSnapshot *snap, int64_t from, int64_t to, RentalScanPlan *plan);
+void freeRentalScanPlan(RentalScanPlan *plan);
+typedef void (*RentalRowFn)(const Rental *r, void *ctx);
+// Reads a month that is not loaded straight from its file and passes every row to
+// 'fn'. Returns the number of rows, or -1 if the file could not be read.
+long scanRentalPartition(const RentalTable *table, int month, RentalRowFn fn, void *ctx);
 
 // Core rental management functions
-void loadRentals(Rental **head);
-void saveRentals(Rental *head);
-void freeRentalList(Rental **head);
-Rental *findRentalById(Rental *head, int rentalId);
+void loadRentals(RentalTable *table);
+void saveRentals(const RentalTable *table);
+// Applies one journaled rental row on top of the loaded table, updating the
+// vehicle's availability if the row books or ends a rental. Returns 0 if the row
+// does not parse. 'index' (may be NULL) maps rental ids to row positions for a run
+// of rows; it is filled from the table on first use and kept up to date.
+int applyJournaledRental(RentalTable *table, Vehicle *vehicleHead, char *row, IdMap *index);
+Rental *findRentalById(const RentalTable *table, int rentalId);
+// Reads an archived rental back from its month's segment into *out and *detail.
+// Returns 0 if no archived month holds it. Slow (a segment is read whole); for
+// looking up one rental, not for scans.
+int fetchArchivedRental(const RentalTable *table, int rentalId, Rental *out, RentalDetail *detail);
+// Moves every month of data/rentals that started more than 'ageMonths' months ago
+// and has no active rental into the cold tier (archive.h). Works on the files, so it
+// runs before loadRentals, when they hold every change (no journal to replay).
+// Returns the number of months archived, or -1 on error.
+int archiveRentals(int ageMonths);
 
 // Conflict detection and validation functions
-int isVehicleAvailableForTime(Rental *head, int vehicleId, time_t startTime, time_t endTime);
+int isVehicleAvailableForTime(const RentalTable *table, int vehicleId, time_t startTime, time_t endTime);
 int validateRentalTimeRange(time_t startTime, time_t endTime, int rentalType);
 
-// Rental lifecycle functions
-int completeRental(Rental *r, Vehicle *vehicleHead, Driver *driverHead);
-int cancelRental(Rental *r, Vehicle *vehicleHead, Driver *driverHead);
-void completeRentalPrompt(Rental *rentalHead, Vehicle *vehicleHead, Driver *driverHead);
-void cancelRentalPrompt(Rental *rentalHead, Vehicle *vehicleHead, Driver *driverHead);
+// Outcome of a booking or lifecycle change. The core functions below never prompt or
+// print; the menus and batch mode turn the result into their own output.
+typedef enum
+{
+    RENTAL_OK = 0,
+    RENTAL_ERR_NO_VEHICLE,
+    RENTAL_ERR_VEHICLE_INACTIVE,
+    RENTAL_ERR_VEHICLE_UNAVAILABLE,
+    RENTAL_ERR_BAD_TYPE,
+    RENTAL_ERR_BAD_DURATION,
+    RENTAL_ERR_NO_ROUTE,
+    RENTAL_ERR_BAD_TIME,
+    RENTAL_ERR_BAD_TIME_RANGE,
+    RENTAL_ERR_CONFLICT,
+    RENTAL_ERR_NOT_ACTIVE,
+    RENTAL_ERR_NOT_COMPLETED,
+    RENTAL_ERR_ALREADY_RATED,
+    RENTAL_ERR_BAD_RATING,
+    RENTAL_ERR_NO_MEMORY
+} RentalResult;
+
+const char *rentalResultStr(RentalResult result);
+
+// What a customer asks for when booking. quantity is hours (RENT_HOURLY) or days
+// (RENT_DAILY); routeId is only read for RENT_ROUTE.
+typedef struct
+{
+    int customerId;
+    int vehicleId;
+    RentalType type;
+    int quantity;
+    int routeId;
+    const char *promoCode; // NULL or "" for none
+} BookingRequest;
+
+typedef struct
+{
+    Rental rental;        // Copies of the new row (other bookings may move the table)
+    RentalDetail detail;
+    Vehicle *vehicle;
+    Driver *driver;       // NULL if no driver was free
+    Invoice *invoice;     // NULL if invoiceHead was NULL
+    Promo *promo;         // NULL if no code was given or it was not active
+    Money originalCost;   // Before the promo discount
+    Money discountAmount;
+    int64_t startAt;      // Requested period; set even when the booking is rejected
+    int64_t endAt;        // for a conflict or time range
+} BookingResult;
+
+// Validates and books a rental starting now: vehicle state, duration limits, time
+// range and conflicts with active rentals. On success the rental is appended, the
+// vehicle is marked unavailable, a free driver is assigned and an invoice is pushed
+// onto *invoiceHead (if invoiceHead is not NULL). The rental and its invoice commit
+// together: a snapshot sees both or neither. Nothing is saved.
+// Safe to call from several threads at once; bookings of different vehicles only
+// contend on the table while appending. Do not call it holding the table read lock.
+RentalResult bookRental(RentalTable *table, Vehicle *vehicleHead, Promo *promoHead, Driver *driverHead,
+                        Invoice **invoiceHead, const BookingRequest *request, BookingResult *result);
+
+// Rental lifecycle functions. None of them save; the caller decides when to persist.
+// With concurrent bookings, call them under rentalTableReadLock. A rental changes
+// status at most once, even if two threads complete or cancel it together.
+// actualEnd is "YYYY-MM-DD HH:MM", or NULL/"" to keep the booked end time.
+RentalResult completeRental(RentalTable *table, Rental *r, Vehicle *vehicleHead, Driver *driverHead, const char *actualEnd);
+RentalResult cancelRental(RentalTable *table, Rental *r, Vehicle *vehicleHead, Driver *driverHead);
+// Records the customer's 1-5 ratings for a completed rental, once.
+RentalResult rateRental(RentalTable *table, Rental *r, Vehicle *vehicleHead, Driver *driverHead,
+                        int vehicleRating, int driverRating, const char *comment);
+// The prompt versions print the outcome; saving is left to the caller as well.
+void completeRentalPrompt(RentalTable *table, Vehicle *vehicleHead, Driver *driverHead);
+void cancelRentalPrompt(RentalTable *table, Vehicle *vehicleHead, Driver *driverHead);
 
 // Display functions
-void displayRental(const Rental *r);
-void displayAllRentals(Rental *head);
-void displayRentalsByCustomer(Rental *head, int customerId);
-void listAllRentals(Rental *head);
+const char *rentalTypeStr(RentalType t);
+const char *rentalStatusStr(RentalStatus s);
+void displayRental(const RentalTable *table, const Rental *r);
+void displayAllRentals(const RentalTable *table);
+void displayRentalsByCustomer(const RentalTable *table, int customerId);
+void listAllRentals(const RentalTable *table);
 
 // Customer booking function
-void createRentalByCustomer(Rental **rentalHead, Vehicle *vehicleHead, Customer *current, Promo *promoHead, Driver *driverHead, Invoice **invoiceHead);
+void createRentalByCustomer(RentalTable *table, Vehicle *vehicleHead, Customer *current, Promo *promoHead, Driver *driverHead, Invoice **invoiceHead);
 
 // Review display function
-void displayVehicleReviews(Rental *rentalHead, int vehicleId);
+void displayVehicleReviews(const RentalTable *table, int vehicleId);
 
 #endif // RENTAL_H
\ No newline at end of file
@@ -1,5 +1,7 @@
 #include "reports.h"
 #include "utils.h"
+#include "threadpool.h"
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -19,31 +21,106 @@ typedef struct
 static void generate_report_filename(char *buffer, int size, const char *prefix)
 {
     time_t now = time(NULL);
-    struct tm *t = localtime(&now);
-    snprintf(buffer, size, "reports/%s_%04d-%02d-%02d.csv", prefix, t->tm_year + 1900, t->tm_mon + 1, t->tm_mday);
+    struct tm t;
+    localTimeSafe(now, &t);
+    snprintf(buffer, size, "reports/%s_%04d-%02d-%02d.csv", prefix, t.tm_year + 1900, t.tm_mon + 1, t.tm_mday);
 }
 
-static void generateMonthlyRevenueReport(Rental *rentalHead)
+typedef struct
 {
-    printf("\n--- Monthly Revenue Report ---\n");
-    int year = getIntegerInput("Enter year to generate report for (e.g., 2025): ", 2020, 2100);
+    Money revenue[12];
+} MonthlyRevenuePartial;
 
-    float monthly_revenue[12] = {0};
+typedef struct
+{
+    const RentalSnapshot *rentals;
+    size_t base; // Snapshot position of the range being scanned
+    time_t monthStarts[13];
+    MonthlyRevenuePartial *totals; // For rows read from disk
+} MonthlyRevenueScan;
 
-    for (Rental *r = rentalHead; r; r = r->next)
+static void addMonthlyRevenue(const MonthlyRevenueScan *scan, const Rental *r, MonthlyRevenuePartial *p)
+{
+    if (r->status == RENT_COMPLETED)
     {
-        if (r->status == RENT_COMPLETED)
+        int m = monthIndexOf(scan->monthStarts, (time_t)r->startAt);
+        if (m >= 0)
         {
-            int y, m;
-            if (sscanf(r->startTime, "%d-%d", &y, &m) == 2)
-            {
-                if (y == year && m >= 1 && m <= 12)
-                {
-                    monthly_revenue[m - 1] += r->totalCost;
-                }
-            }
+            p->revenue[m] += r->totalCost;
         }
     }
+}
+
+static void scanMonthlyRevenue(size_t begin, size_t end, void *partial, void *ctx)
+{
+    MonthlyRevenueScan *scan = (MonthlyRevenueScan *)ctx;
+    MonthlyRevenuePartial *p = (MonthlyRevenuePartial *)partial;
+
+    for (size_t i = begin; i < end; i++)
+    {
+        Rental r;
+        if (rentalSnapshotRow(scan->rentals, scan->base + i, &r))
+            addMonthlyRevenue(scan, &r, p);
+    }
+}
+
+static void readMonthlyRevenue(const Rental *r, void *ctx)
+{
+    MonthlyRevenueScan *scan = (MonthlyRevenueScan *)ctx;
+    addMonthlyRevenue(scan, r, scan->totals);
+}
+
+static void mergeMonthlyRevenue(void *total, const void *partial, void *ctx)
+{
+    (void)ctx;
+    MonthlyRevenuePartial *t = (MonthlyRevenuePartial *)total;
+    const MonthlyRevenuePartial *p = (const MonthlyRevenuePartial *)partial;
+    for (int i = 0; i < 12; i++)
+        t->revenue[i] += p->revenue[i];
+}
+
+static void generateMonthlyRevenueReport(const RentalTable *rentals)
+{
+    printf("\n--- Monthly Revenue Report ---\n");
+    int year = getIntegerInput("Enter year to generate report for (e.g., 2025): ", 2020, 2100);
+
+    RentalSnapshot snapshot;
+    rentalSnapshotBegin(rentals, &snapshot);
+    MonthlyRevenueScan scan;
+    MonthlyRevenuePartial totals = {{0}};
+    scan.rentals = &snapshot;
+    scan.totals = &totals;
+    monthStartsOfYear(year, scan.monthStarts);
+    // Only the months whose rentals can start in the year are read.
+    RentalScanPlan plan;
+    if (!planRentalScan(rentals, &snapshot, (int64_t)scan.monthStarts[0], (int64_t)scan.monthStarts[12], &plan))
+    {
+        rentalSnapshotEnd(rentals, &snapshot);
+        printf("Error: not enough memory to generate the report.\n");
+        return;
+    }
+    for (int i = 0; i < plan.rangeCount; i++)
+    {
+        scan.base = plan.ranges[i].first;
+        parallelScan(plan.ranges[i].last - plan.ranges[i].first, sizeof(MonthlyRevenuePartial),
+                     scanMonthlyRevenue, mergeMonthlyRevenue, &totals, &scan);
+    }
+    for (int i = 0; i < plan.diskCount; i++)
+        scanRentalPartition(rentals, plan.diskMonths[i], readMonthlyRevenue, &scan);
+    // Archived months are summed from their rollups instead of their rows.
+    for (int i = 0; i < plan.coldCount; i++)
+    {
+        int month = plan.coldMonths[i];
+        const RentalRollup *rollup;
+        int n = coldRollupsOf(&rentals->cold, month, &rollup);
+        for (int j = 0; month / 100 == year && j < n; j++)
+            totals.revenue[month % 100 - 1] += rollup[j].revenue;
+    }
+    rentalSnapshotEnd(rentals, &snapshot);
+    printf("Read %d of %d monthly partitions (%ld rentals, %d from disk, %d archived).\n",
+           plan.scanned, plan.partitions, plan.rows, plan.diskCount, plan.coldCount);
+    freeRentalScanPlan(&plan);
+    Money *monthly_revenue = totals.revenue;
 
     char filename[128];
     snprintf(filename, sizeof(filename), "reports/revenue_report_%d.csv", year);
@@ -63,8 +140,8 @@ static void generateMonthlyRevenueReport(Rental *rentalHead)
     const char *months[] = {"January", "February", "March", "April", "May", "June", "July", "August", "September", "October", "November", "December"};
     for (int i = 0; i < 12; i++)
     {
-        fprintf(f, "%s,%.2f\n", months[i], monthly_revenue[i]);
-        printf("%-10s | $%.2f\n", months[i], monthly_revenue[i]);
+        fprintf(f, "%s," MONEY_FMT "\n", months[i], MONEY_ARGS(monthly_revenue[i]));
+        printf("%-10s | $" MONEY_FMT "\n", months[i], MONEY_ARGS(monthly_revenue[i]));
     }
 
     fclose(f);
@@ -78,7 +155,70 @@ static int compareVehicleUsage(const void *a, const void *b)
     return usageB->rentalCount - usageA->rentalCount;
 }
 
-static void generateTopVehiclesReport(Rental *rentalHead, Vehicle *vehicleHead)
+static int compareVehicleUsageById(const void *a, const void *b)
+{
+    const VehicleUsage *usageA = (const VehicleUsage *)a;
+    const VehicleUsage *usageB = (const VehicleUsage *)b;
+    return (usageA->vehicleId > usageB->vehicleId) - (usageA->vehicleId < usageB->vehicleId);
+}
+
+typedef struct
+{
+    const RentalSnapshot *rentals;
+    size_t base; // Snapshot position of the range being scanned
+    const VehicleUsage *usage; // sorted by vehicleId
+    int vehicleCount;
+    int *totals; // For rows read from disk
+} VehicleUsageScan;
+
+static void countVehicleUse(const VehicleUsageScan *scan, int vehicleId, int *counts, int rentals)
+{
+    int lo = 0, hi = scan->vehicleCount - 1;
+    while (lo <= hi)
+    {
+        int mid = lo + (hi - lo) / 2;
+        if (scan->usage[mid].vehicleId == vehicleId)
+        {
+            counts[mid] += rentals;
+            break;
+        }
+        if (scan->usage[mid].vehicleId < vehicleId)
+            lo = mid + 1;
+        else
+            hi = mid - 1;
+    }
+}
+
+// Each partition's accumulator is an int[vehicleCount] of rental counts.
+static void scanVehicleUsage(size_t begin, size_t end, void *partial, void *ctx)
+{
+    VehicleUsageScan *scan = (VehicleUsageScan *)ctx;
+    int *counts = (int *)partial;
+
+    for (size_t i = begin; i < end; i++)
+    {
+        Rental r;
+        if (rentalSnapshotRow(scan->rentals, scan->base + i, &r))
+            countVehicleUse(scan, r.vehicleId, counts, 1);
+    }
+}
+
+static void readVehicleUsage(const Rental *r, void *ctx)
+{
+    VehicleUsageScan *scan = (VehicleUsageScan *)ctx;
+    countVehicleUse(scan, r->vehicleId, scan->totals, 1);
+}
+
+static void mergeVehicleUsage(void *total, const void *partial, void *ctx)
+{
+    VehicleUsageScan *scan = (VehicleUsageScan *)ctx;
+    int *t = (int *)total;
+    const int *p = (const int *)partial;
+    for (int i = 0; i < scan->vehicleCount; i++)
+        t[i] += p[i];
+}
+
+static void generateTopVehiclesReport(const RentalTable *rentals, Vehicle *vehicleHead)
 {
     printf("\n--- Top Rented Vehicles Report ---\n");
 
@@ -111,17 +251,42 @@ static void generateTopVehiclesReport(Rental *rentalHead, Vehicle *vehicleHead)
         }
     }
 
-    for (Rental *r = rentalHead; r; r = r->next)
+    // Sort by id so each rental finds its vehicle with a binary search.
+    qsort(usage_stats, vehicle_count, sizeof(VehicleUsage), compareVehicleUsageById);
+
+    RentalSnapshot snapshot;
+    rentalSnapshotBegin(rentals, &snapshot);
+    VehicleUsageScan scan;
+    scan.rentals = &snapshot;
+    scan.usage = usage_stats;
+    scan.vehicleCount = vehicle_count;
+    int *totals = (int *)calloc(vehicle_count, sizeof(int));
+    scan.totals = totals;
+    // All time: every month, including the ones left on disk at start-up.
+    RentalScanPlan plan;
+    if (totals && planRentalScan(rentals, &snapshot, INT64_MIN, INT64_MAX, &plan))
     {
-        for (int i = 0; i < vehicle_count; i++)
+        for (int i = 0; i < plan.rangeCount; i++)
+        {
+            scan.base = plan.ranges[i].first;
+            parallelScan(plan.ranges[i].last - plan.ranges[i].first, vehicle_count * sizeof(int),
+                         scanVehicleUsage, mergeVehicleUsage, totals, &scan);
+        }
+        for (int i = 0; i < plan.diskCount; i++)
+            scanRentalPartition(rentals, plan.diskMonths[i], readVehicleUsage, &scan);
+        for (int i = 0; i < plan.coldCount; i++)
         {
-            if (r->vehicleId == usage_stats[i].vehicleId)
-            {
-                usage_stats[i].rentalCount++;
-                break;
-            }
+            const RentalRollup *rollup;
+            int n = coldRollupsOf(&rentals->cold, plan.coldMonths[i], &rollup);
+            for (int j = 0; j < n; j++)
+                countVehicleUse(&scan, rollup[j].vehicleId, totals, (int)rollup[j].rentals);
         }
+        freeRentalScanPlan(&plan);
+        for (int i = 0; i < vehicle_count; i++)
+            usage_stats[i].rentalCount = totals[i];
     }
+    free(totals);
+    rentalSnapshotEnd(rentals, &snapshot);
 
     qsort(usage_stats, vehicle_count, sizeof(VehicleUsage), compareVehicleUsage);
 
@@ -153,7 +318,7 @@ static void generateTopVehiclesReport(Rental *rentalHead, Vehicle *vehicleHead)
     printf("\nSuccessfully generated top vehicles report: '%s'\n", filename);
 }
 
-void adminReportsMenu(Vehicle *vehicleHead, Customer *customerHead __attribute__((unused)), Rental *rentalHead)
+void adminReportsMenu(Vehicle *vehicleHead, Customer *customerHead __attribute__((unused)), const RentalTable *rentals)
 {
     int running = 1;
     system("mkdir reports 2>nul");
@@ -171,10 +336,10 @@ void adminReportsMenu(Vehicle *vehicleHead, Customer *customerHead __attribute__
         switch (choice)
         {
         case 1:
-            generateMonthlyRevenueReport(rentalHead);
+            generateMonthlyRevenueReport(rentals);
             break;
         case 2:
-            generateTopVehiclesReport(rentalHead, vehicleHead);
+            generateTopVehiclesReport(rentals, vehicleHead);
             break;
         case 3:
             running = 0;
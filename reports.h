@@ -5,6 +5,6 @@
 #include "customer.h"
 #include "rental.h"
 
-void adminReportsMenu(Vehicle *vehicleHead, Customer *customerHead, Rental *rentalHead);
+void adminReportsMenu(Vehicle *vehicleHead, Customer *customerHead, const RentalTable *rentals);
 
 #endif // REPORT_H
\ No newline at end of file
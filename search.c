@@ -7,34 +7,27 @@
 #include "customer.h"
 #include "rental.h"
 
-void searchVehiclesByText(const Vehicle *head, const char *query)
+int vehicleMatches(const Vehicle *v, const VehicleQuery *query)
 {
-    printf("\n--- Search Results for '%s' ---\n", query);
-    int found = 0;
-    for (const Vehicle *v = head; v; v = v->next)
-    {
-        if (v->active)
-        {
-            if (strstr(v->make, query) || strstr(v->model, query))
-            {
-                displayVehicle(v);
-                found = 1;
-            }
-        }
-    }
-    if (!found)
-    {
-        printf("No vehicles found matching your query.\n");
-    }
+    if (!v->active)
+        return 0;
+    if (query->text && query->text[0] && !strstr(v->make, query->text) && !strstr(v->model, query->text))
+        return 0;
+    if (query->type && query->type[0] && strcmp(vehicleTypeStr(v->type), query->type) != 0)
+        return 0;
+    if (query->maxPricePerDay > 0 && v->ratePerDay > query->maxPricePerDay)
+        return 0;
+    if (query->availableOnly && !v->available)
+        return 0;
+    return 1;
 }
 
-void filterVehiclesByType(const Vehicle *head, const char *type)
+static void displayMatchingVehicles(const Vehicle *head, const VehicleQuery *query, const char *none)
 {
-    printf("\n--- Vehicles of Type: %s ---\n", type);
     int found = 0;
     for (const Vehicle *v = head; v; v = v->next)
     {
-        if (v->active && strcmp(vehicleTypeStr(v->type), type) == 0)
+        if (vehicleMatches(v, query))
         {
             displayVehicle(v);
             found = 1;
@@ -42,37 +35,44 @@ void filterVehiclesByType(const Vehicle *head, const char *type)
     }
     if (!found)
     {
-        printf("No vehicles found of this type.\n");
+        printf("%s\n", none);
     }
 }
 
-void filterVehiclesByPrice(const Vehicle *head, float maxPrice)
+void searchVehiclesByText(const Vehicle *head, const char *query)
 {
-    printf("\n--- Vehicles with Daily Rate under $%.2f ---\n", maxPrice);
-    int found = 0;
-    for (const Vehicle *v = head; v; v = v->next)
-    {
-        if (v->active && v->ratePerDay <= maxPrice)
-        {
-            displayVehicle(v);
-            found = 1;
-        }
-    }
-    if (!found)
-    {
-        printf("No vehicles found in this price range.\n");
-    }
+    printf("\n--- Search Results for '%s' ---\n", query);
+    VehicleQuery q = {0};
+    q.text = query;
+    displayMatchingVehicles(head, &q, "No vehicles found matching your query.");
+}
+
+void filterVehiclesByType(const Vehicle *head, const char *type)
+{
+    printf("\n--- Vehicles of Type: %s ---\n", type);
+    VehicleQuery q = {0};
+    q.type = type;
+    displayMatchingVehicles(head, &q, "No vehicles found of this type.");
+}
+
+void filterVehiclesByPrice(const Vehicle *head, Money maxPrice)
+{
+    printf("\n--- Vehicles with Daily Rate under $" MONEY_FMT " ---\n", MONEY_ARGS(maxPrice));
+    VehicleQuery q = {0};
+    q.maxPricePerDay = maxPrice;
+    displayMatchingVehicles(head, &q, "No vehicles found in this price range.");
 }
 
-void searchRentalsByCustomerId(const Rental *head, int customerId)
+void searchRentalsByCustomerId(const RentalTable *rentals, int customerId)
 {
     printf("\n--- Searching rentals for customer ID %d ---\n", customerId);
     int found = 0;
-    for (const Rental *r = head; r; r = r->next)
+    for (size_t i = 0; i < rentals->count; i++)
     {
+        const Rental *r = &rentals->rows[i];
         if (r->customerId == customerId)
         {
-            displayRental(r);
+            displayRental(rentals, r);
             found = 1;
         }
     }
@@ -84,7 +84,7 @@ void searchRentalsByCustomerId(const Rental *head, int customerId)
 
 int compareVehicles(const Vehicle *a, const Vehicle *b, VehicleSortField field, SortOrder order)
 {
-    float diff = 0;
+    Money diff = 0;
 
     switch (field)
     {
@@ -95,7 +95,7 @@ int compareVehicles(const Vehicle *a, const Vehicle *b, VehicleSortField field,
         diff = a->ratePerHour - b->ratePerHour;
         break;
     case SORT_YEAR:
-        diff = (float)(a->year - b->year);
+        diff = a->year - b->year;
         break;
     }
 
@@ -170,7 +170,7 @@ void sortVehicles(Vehicle **head, VehicleSortField field, SortOrder order)
     printf("\nList has been sorted.\n");
 }
 
-void adminSearchMenu(Vehicle *vehicleHead, Rental *rentalHead)
+void adminSearchMenu(Vehicle *vehicleHead, const RentalTable *rentals)
 {
     int running = 1;
     while (running)
@@ -203,7 +203,7 @@ void adminSearchMenu(Vehicle *vehicleHead, Rental *rentalHead)
         }
         case 3:
         {
-            float price = getFloatInput("Enter maximum daily rate: ", 1.0, 5000.0);
+            Money price = getMoneyInput("Enter maximum daily rate: ", moneyFromUnits(1), moneyFromUnits(5000));
             filterVehiclesByPrice(vehicleHead, price);
             break;
         }
@@ -224,7 +224,7 @@ void adminSearchMenu(Vehicle *vehicleHead, Rental *rentalHead)
         case 5:
         {
             int custId = getIntegerInput("Enter Customer ID to find rentals for: ", 1000, 9999);
-            searchRentalsByCustomerId(rentalHead, custId);
+            searchRentalsByCustomerId(rentals, custId);
             break;
         }
         case 6:
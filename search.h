@@ -16,11 +16,23 @@ typedef enum
     SORT_DESC
 } SortOrder;
 
+// Filters shared by the search menu and the batch/server "search" command.
+// Empty or zero fields do not filter; inactive vehicles never match.
+typedef struct
+{
+    const char *text;     // Substring of make or model
+    const char *type;     // vehicleTypeStr() name, e.g. "Car"
+    Money maxPricePerDay;
+    int availableOnly;
+} VehicleQuery;
+
+int vehicleMatches(const Vehicle *v, const VehicleQuery *query);
+
 void searchVehiclesByText(const Vehicle *head, const char *query);
 void filterVehiclesByType(const Vehicle *head, const char *type);
-void filterVehiclesByPrice(const Vehicle *head, float maxPrice);
+void filterVehiclesByPrice(const Vehicle *head, Money maxPrice);
 void sortVehicles(Vehicle **head, VehicleSortField field, SortOrder order);
-void searchRentalsByCustomerId(const Rental *head, int customerId);
-void adminSearchMenu(Vehicle *vehicleHead, Rental *rentalHead);
+void searchRentalsByCustomerId(const RentalTable *rentals, int customerId);
+void adminSearchMenu(Vehicle *vehicleHead, const RentalTable *rentals);
 
 #endif // SEARCH_H
@@ -0,0 +1,519 @@
+#define _GNU_SOURCE // accept4
+#include "server.h"
+#include "journal.h"
+#include "backup.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define SERVER_MAX_EVENTS 256
+// Stop reading from a client whose unsent replies pile up past this.
+#define SERVER_OUTPUT_LIMIT (64 * 1024)
+
+// Replies up to 'end' in the output buffer wait for journal row 'sequence'.
+typedef struct
+{
+    size_t end;
+    long sequence;
+} HeldReply;
+
+typedef struct Connection
+{
+    struct Connection *prev;
+    struct Connection *next;
+    int fd;
+    long requests;
+    int discarding;  // Dropping the rest of an over-long line
+    int draining;    // The client stopped sending; closed once its replies are out
+    uint32_t events; // What the fd is currently registered for
+    size_t inLength;
+    char in[BATCH_LINE_MAX];
+    char *out;
+    size_t outLength;
+    size_t outSent;
+    size_t outReady; // Replies before this offset may be sent
+    size_t outCapacity;
+    HeldReply *held; // Oldest first
+    int heldCount;
+    int heldCapacity;
+} Connection;
+
+typedef struct
+{
+    const BatchModel *model;
+    int epollFd;
+    Connection *clients; // Open connections, so they can be closed on shutdown
+    long connections; // Open right now
+    long draining;    // Of those, waiting for their last replies
+    long accepted;
+    long requests;
+} Server;
+
+// epoll data for the listening socket, the signalfd and the journal's eventfd;
+// clients carry their Connection pointer.
+static int listenTag;
+static int signalTag;
+static int journalTag;
+
+void raiseOpenFileLimit(void)
+{
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max)
+    {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+}
+
+static int setupListener(const char *path)
+{
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path))
+    {
+        printf("Error: socket path too long: %s\n", path);
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        printf("Error: could not create socket: %s\n", strerror(errno));
+        return -1;
+    }
+
+    // A leftover socket file from a previous run blocks bind; remove it unless a
+    // server is still answering on it.
+    int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (probe >= 0)
+    {
+        if (connect(probe, (struct sockaddr *)&addr, sizeof(addr)) == 0)
+        {
+            printf("Error: a server is already listening on %s\n", path);
+            close(probe);
+            close(fd);
+            return -1;
+        }
+        close(probe);
+    }
+    unlink(path);
+
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, SOMAXCONN) < 0)
+    {
+        printf("Error: could not listen on %s: %s\n", path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void closeConnection(Server *server, Connection *conn)
+{
+    if (conn->prev)
+        conn->prev->next = conn->next;
+    else
+        server->clients = conn->next;
+    if (conn->next)
+        conn->next->prev = conn->prev;
+
+    if (conn->draining)
+        server->draining--;
+    epoll_ctl(server->epollFd, EPOLL_CTL_DEL, conn->fd, NULL);
+    close(conn->fd);
+    free(conn->out);
+    free(conn->held);
+    free(conn);
+    server->connections--;
+}
+
+static int appendOutput(Connection *conn, const char *data, size_t length)
+{
+    if (conn->outLength + length > conn->outCapacity)
+    {
+        size_t capacity = conn->outCapacity ? conn->outCapacity : 1024;
+        while (capacity < conn->outLength + length)
+            capacity *= 2;
+        char *out = (char *)realloc(conn->out, capacity);
+        if (!out)
+            return 0;
+        conn->out = out;
+        conn->outCapacity = capacity;
+    }
+    memcpy(conn->out + conn->outLength, data, length);
+    conn->outLength += length;
+    return 1;
+}
+
+// Lets the replies through whose journal rows are durable.
+static void releaseReplies(Connection *conn, long durable)
+{
+    int released = 0;
+    while (released < conn->heldCount && conn->held[released].sequence <= durable)
+        conn->outReady = conn->held[released++].end;
+    conn->heldCount -= released;
+    memmove(conn->held, conn->held + released, (size_t)conn->heldCount * sizeof(HeldReply));
+}
+
+// Marks the reply just appended as sendable, or holds it (and everything after it)
+// until row 'sequence' is durable.
+static int holdReply(Connection *conn, long sequence)
+{
+    if (conn->heldCount == 0 && sequence <= journalDurableSequence())
+    {
+        conn->outReady = conn->outLength;
+        return 1;
+    }
+    if (conn->heldCount == conn->heldCapacity)
+    {
+        int capacity = conn->heldCapacity ? conn->heldCapacity * 2 : 16;
+        HeldReply *held = (HeldReply *)realloc(conn->held, (size_t)capacity * sizeof(HeldReply));
+        if (!held)
+            return 0;
+        conn->held = held;
+        conn->heldCapacity = capacity;
+    }
+    conn->held[conn->heldCount++] = (HeldReply){conn->outLength, sequence};
+    return 1;
+}
+
+// Sends what the socket takes without blocking. Returns 0 if the client is gone.
+static int flushOutput(Connection *conn)
+{
+    while (conn->outSent < conn->outReady)
+    {
+        ssize_t n = send(conn->fd, conn->out + conn->outSent, conn->outReady - conn->outSent, MSG_NOSIGNAL);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        conn->outSent += (size_t)n;
+    }
+    if (conn->outSent == conn->outLength)
+    {
+        conn->outLength = 0;
+        conn->outSent = 0;
+        conn->outReady = 0;
+    }
+    return 1;
+}
+
+// Waits for input while replies keep up, and for writability while they do not.
+// A draining connection has no more input to wait for.
+static int updateEvents(Server *server, Connection *conn)
+{
+    size_t pending = conn->outLength - conn->outSent;
+    uint32_t events = pending < SERVER_OUTPUT_LIMIT && !conn->draining ? EPOLLIN : 0;
+    if (conn->outReady > conn->outSent)
+        events |= EPOLLOUT;
+    if (events == conn->events)
+        return 1;
+
+    struct epoll_event ev;
+    ev.events = events;
+    ev.data.ptr = conn;
+    if (epoll_ctl(server->epollFd, EPOLL_CTL_MOD, conn->fd, &ev) < 0)
+        return 0;
+    conn->events = events;
+    return 1;
+}
+
+static int handleLine(Server *server, Connection *conn, const char *line)
+{
+    char response[BATCH_RESPONSE_MAX];
+    size_t length = runBatchCommand(server->model, ++conn->requests, line, response, sizeof(response));
+    server->requests++;
+    return appendOutput(conn, response, length) && holdReply(conn, journalThreadSequence());
+}
+
+static int rejectLine(Server *server, Connection *conn, const char *error)
+{
+    char response[BATCH_RESPONSE_MAX];
+    size_t length = formatBatchError(++conn->requests, error, response, sizeof(response));
+    server->requests++;
+    return appendOutput(conn, response, length) && holdReply(conn, 0);
+}
+
+// Reads everything available and answers each complete line. Returns 0 if the
+// connection should be closed.
+static int readInput(Server *server, Connection *conn)
+{
+    for (;;)
+    {
+        ssize_t n = read(conn->fd, conn->in + conn->inLength, sizeof(conn->in) - 1 - conn->inLength);
+        if (n == 0)
+        {
+            // The client is done sending. Replies still held for the journal go out
+            // as releaseDurableReplies lets them through; the connection is closed
+            // once nothing is left (closeDrainedConnections).
+            releaseReplies(conn, journalDurableSequence());
+            if (!conn->draining)
+            {
+                conn->draining = 1;
+                server->draining++;
+            }
+            return 1;
+        }
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        conn->inLength += (size_t)n;
+
+        char *start = conn->in;
+        char *end = conn->in + conn->inLength;
+        char *newline;
+        while ((newline = memchr(start, '\n', (size_t)(end - start))) != NULL)
+        {
+            *newline = '\0';
+            if (newline > start && newline[-1] == '\r')
+                newline[-1] = '\0';
+            if (conn->discarding)
+                conn->discarding = 0;
+            else if (*start && !handleLine(server, conn, start))
+                return 0;
+            start = newline + 1;
+        }
+        conn->inLength = (size_t)(end - start);
+        memmove(conn->in, start, conn->inLength);
+
+        if (conn->inLength == sizeof(conn->in) - 1)
+        {
+            // No newline in a full buffer: answer once, then skip to the next line.
+            if (!conn->discarding && !rejectLine(server, conn, "line too long"))
+                return 0;
+            conn->discarding = 1;
+            conn->inLength = 0;
+        }
+        if (conn->outLength - conn->outSent >= SERVER_OUTPUT_LIMIT)
+            return 1;
+    }
+}
+
+// A journal batch was acknowledged: send the replies that were waiting for it.
+static void releaseDurableReplies(Server *server, int notifyFd)
+{
+    uint64_t count;
+    while (read(notifyFd, &count, sizeof(count)) < 0 && errno == EINTR)
+        ;
+    long durable = journalDurableSequence();
+    for (Connection *conn = server->clients; conn; conn = conn->next)
+    {
+        if (conn->heldCount == 0)
+            continue;
+        releaseReplies(conn, durable);
+        // Not closed here even if the client is gone: a later event of this
+        // epoll_wait may still point at it. Its next event reports the failure.
+        if (flushOutput(conn))
+            updateEvents(server, conn);
+    }
+}
+
+// Closes the draining connections whose replies have all been sent. Runs after a
+// batch of events has been handled, so none of them can point at a closed one.
+static void closeDrainedConnections(Server *server)
+{
+    Connection *conn = server->clients;
+    while (conn && server->draining > 0)
+    {
+        Connection *next = conn->next;
+        if (conn->draining && conn->heldCount == 0 && conn->outLength == 0)
+            closeConnection(server, conn);
+        conn = next;
+    }
+}
+
+static void acceptClients(Server *server, int listenFd)
+{
+    for (;;)
+    {
+        int fd = accept4(listenFd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno == EMFILE || errno == ENFILE)
+                printf("Warning: out of file descriptors with %ld clients connected\n", server->connections);
+            return;
+        }
+
+        Connection *conn = (Connection *)calloc(1, sizeof(Connection));
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.ptr = conn;
+        if (!conn || epoll_ctl(server->epollFd, EPOLL_CTL_ADD, fd, &ev) < 0)
+        {
+            free(conn);
+            close(fd);
+            continue;
+        }
+        conn->fd = fd;
+        conn->events = EPOLLIN;
+        conn->next = server->clients;
+        if (server->clients)
+            server->clients->prev = conn;
+        server->clients = conn;
+        server->connections++;
+        server->accepted++;
+    }
+}
+
+// SIGINT/SIGTERM arrive through a signalfd so the loop can stop between requests;
+// SIGUSR1, the same way, starts an online backup between requests.
+static void serverSignals(sigset_t *set)
+{
+    sigemptyset(set);
+    sigaddset(set, SIGINT);
+    sigaddset(set, SIGTERM);
+    sigaddset(set, SIGUSR1);
+}
+
+void blockServerSignals(void)
+{
+    sigset_t set;
+    serverSignals(&set);
+    sigprocmask(SIG_BLOCK, &set, NULL);
+}
+
+int runServer(const char *socketPath, const BatchModel *model)
+{
+    raiseOpenFileLimit();
+
+    sigset_t stopSignals;
+    serverSignals(&stopSignals);
+    sigprocmask(SIG_BLOCK, &stopSignals, NULL);
+    int signalFd = signalfd(-1, &stopSignals, SFD_NONBLOCK | SFD_CLOEXEC);
+
+    int listenFd = setupListener(socketPath);
+    Server server = {model, epoll_create1(EPOLL_CLOEXEC), NULL, 0, 0, 0, 0};
+    if (listenFd < 0 || signalFd < 0 || server.epollFd < 0)
+    {
+        if (listenFd >= 0)
+            close(listenFd);
+        if (signalFd >= 0)
+            close(signalFd);
+        if (server.epollFd >= 0)
+            close(server.epollFd);
+        sigprocmask(SIG_UNBLOCK, &stopSignals, NULL);
+        return 1;
+    }
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = &listenTag;
+    epoll_ctl(server.epollFd, EPOLL_CTL_ADD, listenFd, &ev);
+    ev.data.ptr = &signalTag;
+    epoll_ctl(server.epollFd, EPOLL_CTL_ADD, signalFd, &ev);
+    int notifyFd = journalNotifyFd();
+    if (notifyFd >= 0)
+    {
+        ev.data.ptr = &journalTag;
+        epoll_ctl(server.epollFd, EPOLL_CTL_ADD, notifyFd, &ev);
+    }
+
+    printf("RideMate server listening on %s (Ctrl+C to stop)\n", socketPath);
+    fflush(stdout);
+
+    struct epoll_event events[SERVER_MAX_EVENTS];
+    OnlineBackupStatus backup;
+    getOnlineBackupStatus(&backup);
+    int running = 1;
+    while (running)
+    {
+        // Wakes up now and then while a backup child runs, to collect it.
+        int n = epoll_wait(server.epollFd, events, SERVER_MAX_EVENTS, backup.running ? 1000 : -1);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            printf("Error: epoll_wait failed: %s\n", strerror(errno));
+            break;
+        }
+        for (int i = 0; i < n; i++)
+        {
+            void *tag = events[i].data.ptr;
+            if (tag == &listenTag)
+            {
+                acceptClients(&server, listenFd);
+                continue;
+            }
+            if (tag == &signalTag)
+            {
+                struct signalfd_siginfo info;
+                while (read(signalFd, &info, sizeof(info)) == (ssize_t)sizeof(info))
+                {
+                    if (info.ssi_signo != SIGUSR1)
+                        running = 0;
+                    else if (startOnlineBackup())
+                        printf("Online backup started\n");
+                    else
+                        printf("Online backup not started (one is still running, or the fork failed)\n");
+                }
+                fflush(stdout);
+                continue;
+            }
+            if (tag == &journalTag)
+            {
+                releaseDurableReplies(&server, notifyFd);
+                continue;
+            }
+
+            Connection *conn = (Connection *)tag;
+            int alive = 1;
+            // A draining connection only hears of hang-ups: then no reply can reach it.
+            if (conn->draining && (events[i].events & (EPOLLHUP | EPOLLERR)))
+                alive = 0;
+            else if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+                alive = readInput(&server, conn);
+            if (alive)
+                alive = flushOutput(conn) && updateEvents(&server, conn);
+            if (!alive)
+                closeConnection(&server, conn);
+        }
+        if (server.draining > 0)
+            closeDrainedConnections(&server);
+
+        long finished = backup.completed + backup.failed;
+        if (running)
+            backupIfDue();
+        getOnlineBackupStatus(&backup);
+        if (backup.completed + backup.failed != finished)
+        {
+            char line[256];
+            describeOnlineBackupStatus(line, sizeof(line));
+            printf("%s\n", line);
+            fflush(stdout);
+        }
+    }
+
+    printf("Server stopping: %ld requests from %ld clients (%ld still connected)\n",
+           server.requests, server.accepted, server.connections);
+    // Replies still held for the journal go out before the connections close.
+    journalWait(journalThreadSequence());
+    for (Connection *conn = server.clients; conn; conn = conn->next)
+    {
+        releaseReplies(conn, journalDurableSequence());
+        flushOutput(conn);
+    }
+    while (server.clients)
+        closeConnection(&server, server.clients);
+    close(listenFd);
+    unlink(socketPath);
+    close(signalFd);
+    close(server.epollFd);
+    sigprocmask(SIG_UNBLOCK, &stopSignals, NULL);
+    return 0;
+}
@@ -0,0 +1,28 @@
+// File: server.h
+// Description: Booking server. Keeps the model in memory and answers the batch
+// command protocol (one JSON object per line in, one result line out) over a Unix
+// domain socket. A single epoll loop serves every client with non-blocking sockets.
+
+#ifndef SERVER_H
+#define SERVER_H
+
+#include "batch.h"
+
+#define SERVER_DEFAULT_SOCKET "ridemate.sock"
+
+// Serves until SIGINT or SIGTERM, then returns 0 (1 if the socket could not be set
+// up). Commands run one at a time on the loop thread, so the model has a single
+// writer. With the journal on, a reply is held back until the rows its command
+// changed are durable; the loop keeps serving meanwhile. Nothing else is saved;
+// the caller persists the model afterwards. SIGUSR1 starts an online backup.
+int runServer(const char *socketPath, const BatchModel *model);
+
+// Blocks the signals the server takes through its signalfd. Call before any thread
+// is started: threads inherit the mask, and one that does not block a signal would
+// receive it and be killed by it instead of the loop seeing it.
+void blockServerSignals(void);
+
+// Raises the open-file limit to the hard limit so thousands of sockets fit.
+void raiseOpenFileLimit(void);
+
+#endif // SERVER_H
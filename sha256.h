@@ -0,0 +1,31 @@
+// File: sha256.h
+// Description: SHA-256 (FIPS 180-4), used to name and check the chunks and files
+// kept by backups.
+
+#ifndef SHA256_H
+#define SHA256_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SHA256_SIZE 32
+// Lowercase hex digest plus the terminator.
+#define SHA256_HEX_SIZE 65
+
+typedef struct
+{
+    uint32_t state[8];
+    uint64_t length; // Bytes hashed so far
+    uint8_t block[64];
+    size_t used; // Bytes waiting in block
+} Sha256;
+
+void sha256Init(Sha256 *ctx);
+void sha256Update(Sha256 *ctx, const void *data, size_t size);
+void sha256Final(Sha256 *ctx, uint8_t digest[SHA256_SIZE]);
+
+// One-shot digest of a buffer, as hex.
+void sha256Hex(const void *data, size_t size, char hex[SHA256_HEX_SIZE]);
+void sha256ToHex(const uint8_t digest[SHA256_SIZE], char hex[SHA256_HEX_SIZE]);
+
+#endif // SHA256_H
@@ -0,0 +1,231 @@
+#include "snapshot.h"
+#include "utils.h"
+#include "asyncio.h"
+#include "dirty.h"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+static SnapshotStatus state;
+static SnapshotWriter pendingWriter;
+
+static void finishSave(int ok, double seconds)
+{
+    state.running = 0;
+    state.lastOk = ok;
+    state.lastSeconds = seconds;
+    state.lastFinishedAt = time(NULL);
+    if (ok)
+    {
+        state.completed++;
+    }
+    else
+    {
+        state.failed++;
+        // Which files made it is unknown, so the next save writes them all.
+        markAllDirty();
+    }
+}
+
+#ifdef _WIN32
+
+int startBackgroundSave(SnapshotWriter writer)
+{
+    clock_t start = clock();
+    writer();
+    finishSave(1, (double)(clock() - start) / CLOCKS_PER_SEC);
+    return 1;
+}
+
+void pollBackgroundSave(void)
+{
+}
+
+void waitBackgroundSave(void)
+{
+}
+
+#else
+
+static int reportFd = -1; // Read end of the running child's pipe
+
+// What the child sends back when it has written everything.
+typedef struct
+{
+    double seconds;
+    SaveCounters counters; // Its own saves only
+} SaveReport;
+
+static double secondsSince(const struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)(now.tv_sec - start->tv_sec) + (double)(now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static int launchSave(SnapshotWriter writer)
+{
+    int fds[2];
+    if (pipe(fds) < 0)
+        return 0;
+
+    // Files still queued in the parent would land after the child's copies of them.
+    asyncIoDrain();
+
+    struct timespec forkStart;
+    clock_gettime(CLOCK_MONOTONIC, &forkStart);
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        close(fds[0]);
+        close(fds[1]);
+        return 0;
+    }
+    if (pid == 0)
+    {
+        // Child: keep the savers' progress messages off the menu, write, report, and
+        // leave without running the parent's exit handlers or flushing its buffers.
+        close(fds[0]);
+        int devNull = open("/dev/null", O_WRONLY);
+        if (devNull >= 0)
+            dup2(devNull, STDOUT_FILENO);
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        SaveCounters before;
+        getSaveCounters(&before);
+        writer();
+        SaveReport report;
+        report.seconds = secondsSince(&start);
+        getSaveCounters(&report.counters);
+        report.counters.bytes -= before.bytes;
+        report.counters.rewrites -= before.rewrites;
+        report.counters.appends -= before.appends;
+        report.counters.skips -= before.skips;
+        if (write(fds[1], &report, sizeof(report)) != (ssize_t)sizeof(report))
+            _exit(1);
+        _exit(0);
+    }
+
+    dirtySnapshotTaken();
+
+    close(fds[1]);
+    fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    reportFd = fds[0];
+    state.running = 1;
+    state.pid = (int)pid;
+    state.startedAt = time(NULL);
+    state.forkMs = secondsSince(&forkStart) * 1000.0;
+    return 1;
+}
+
+// The child has exited (or is gone); read its report and record the outcome.
+static void collectSave(int exitedCleanly)
+{
+    SaveReport report;
+    int reported = read(reportFd, &report, sizeof(report)) == (ssize_t)sizeof(report);
+    close(reportFd);
+    reportFd = -1;
+    if (reported)
+        addSaveCounters(&report.counters);
+    else
+        report.seconds = difftime(time(NULL), state.startedAt);
+    finishSave(exitedCleanly && reported, report.seconds);
+}
+
+static int exitedCleanly(pid_t result, int status)
+{
+    return result == (pid_t)state.pid && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+int startBackgroundSave(SnapshotWriter writer)
+{
+    pollBackgroundSave();
+    if (state.running)
+    {
+        // The running child saw the data as it was at its fork; save again afterwards.
+        state.pending = 1;
+        pendingWriter = writer;
+        return 1;
+    }
+    return launchSave(writer);
+}
+
+void pollBackgroundSave(void)
+{
+    if (state.running)
+    {
+        int status = 0;
+        pid_t result = waitpid((pid_t)state.pid, &status, WNOHANG);
+        if (result == 0)
+            return;
+        collectSave(exitedCleanly(result, status));
+    }
+    if (state.pending)
+    {
+        state.pending = 0;
+        if (!launchSave(pendingWriter))
+            pendingWriter();
+    }
+}
+
+void waitBackgroundSave(void)
+{
+    if (!state.running)
+        return;
+    int status = 0;
+    pid_t result;
+    do
+        result = waitpid((pid_t)state.pid, &status, 0);
+    while (result < 0 && errno == EINTR);
+    collectSave(exitedCleanly(result, status));
+}
+
+#endif
+
+void finishBackgroundSaves(void)
+{
+    waitBackgroundSave();
+    if (state.pending)
+    {
+        state.pending = 0;
+        pendingWriter();
+    }
+}
+
+void getSnapshotStatus(SnapshotStatus *status)
+{
+    pollBackgroundSave();
+    *status = state;
+}
+
+void describeSnapshotStatus(char *buf, size_t size)
+{
+    pollBackgroundSave();
+    if (state.running)
+    {
+        snprintf(buf, size, "Background save: running for %.0f s (pid %d)%s",
+                 difftime(time(NULL), state.startedAt), state.pid,
+                 state.pending ? ", another queued" : "");
+        return;
+    }
+    if (!state.lastFinishedAt)
+    {
+        snprintf(buf, size, "Background save: none yet");
+        return;
+    }
+    char when[16];
+    struct tm tmv;
+    if (localTimeSafe(state.lastFinishedAt, &tmv))
+        strftime(when, sizeof(when), "%H:%M:%S", &tmv);
+    else
+        snprintf(when, sizeof(when), "-");
+    snprintf(buf, size, "Background save: last %s at %s in %.2f s (fork %.1f ms; %ld ok, %ld failed)",
+             state.lastOk ? "finished" : "FAILED", when, state.lastSeconds, state.forkMs,
+             state.completed, state.failed);
+}
@@ -0,0 +1,53 @@
+// File: snapshot.h
+// Description: Background saves. The process forks and the child writes every list
+// from its copy-on-write view of memory, which is a consistent snapshot of the moment
+// of the fork, while the parent goes straight back to the menus. The child reports
+// back through a pipe; the parent collects the result whenever it polls.
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stddef.h>
+#include <time.h>
+
+// Writes the data files. Runs in the child: it must not use the thread pool or
+// take locks other threads could have held at the time of the fork.
+typedef void (*SnapshotWriter)(void);
+
+typedef struct
+{
+    int running;           // A child is writing right now
+    int pending;           // Changes arrived while it was running; another save follows
+    int pid;
+    time_t startedAt;
+    double forkMs;         // How long the parent was stalled by the last fork
+    long completed;
+    long failed;
+    int lastOk;
+    time_t lastFinishedAt; // 0 until a save has finished
+    double lastSeconds;    // How long the child took to write everything
+} SnapshotStatus;
+
+// Starts a background save with 'writer', or marks one pending if a save is already
+// running. Returns 0 if the process could not fork; the caller should then save
+// synchronously. Without fork (Windows) the writer simply runs in place.
+int startBackgroundSave(SnapshotWriter writer);
+
+// Collects a finished child without blocking and starts the pending save, if any.
+void pollBackgroundSave(void);
+
+// Blocks until no background save is running. Every saveX function calls this first,
+// so the parent never writes a file while a child is writing it. A pending save
+// stays pending. In the child itself this returns at once.
+void waitBackgroundSave(void);
+
+// Waits for the running save and writes the pending one in place, so the files on
+// disk match memory when this returns.
+void finishBackgroundSaves(void);
+
+void getSnapshotStatus(SnapshotStatus *status);
+
+// One line for the admin panel, e.g. "Background save: last finished 14:02:11 in 3.41 s".
+void describeSnapshotStatus(char *buf, size_t size);
+
+#endif // SNAPSHOT_H
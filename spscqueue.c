@@ -0,0 +1,85 @@
+#include "spscqueue.h"
+#include <stdlib.h>
+#include <sched.h>
+
+#define SPSC_SPIN_LIMIT 64
+
+int spscInit(SpscQueue *q, size_t capacity)
+{
+    size_t size = 2;
+    while (size < capacity)
+        size *= 2;
+    q->slots = (void **)calloc(size, sizeof(void *));
+    if (!q->slots)
+        return 0;
+    q->mask = size - 1;
+    atomic_init(&q->head, 0);
+    atomic_init(&q->tail, 0);
+    q->pushes = 0;
+    q->depthSum = 0;
+    q->maxDepth = 0;
+    return 1;
+}
+
+void spscFree(SpscQueue *q)
+{
+    free(q->slots);
+    q->slots = NULL;
+}
+
+int spscTryPush(SpscQueue *q, void *item)
+{
+    size_t tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&q->head, memory_order_acquire);
+    if (tail - head > q->mask)
+        return 0;
+
+    q->slots[tail & q->mask] = item;
+    // Release: the slot write above becomes visible before the consumer sees the new tail.
+    atomic_store_explicit(&q->tail, tail + 1, memory_order_release);
+
+    size_t depth = tail + 1 - head;
+    q->pushes++;
+    q->depthSum += depth;
+    if (depth > q->maxDepth)
+        q->maxDepth = depth;
+    return 1;
+}
+
+void *spscTryPop(SpscQueue *q)
+{
+    size_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&q->tail, memory_order_acquire);
+    if (head == tail)
+        return NULL;
+
+    void *item = q->slots[head & q->mask];
+    // Release: the slot is read before the producer may reuse it.
+    atomic_store_explicit(&q->head, head + 1, memory_order_release);
+    return item;
+}
+
+void spscPush(SpscQueue *q, void *item)
+{
+    for (int spins = 0; !spscTryPush(q, item); spins++)
+    {
+        if (spins >= SPSC_SPIN_LIMIT)
+            sched_yield();
+    }
+}
+
+void *spscPop(SpscQueue *q)
+{
+    void *item;
+    for (int spins = 0; !(item = spscTryPop(q)); spins++)
+    {
+        if (spins >= SPSC_SPIN_LIMIT)
+            sched_yield();
+    }
+    return item;
+}
+
+double spscAverageDepth(const SpscQueue *q)
+{
+    return q->pushes ? (double)q->depthSum / (double)q->pushes : 0.0;
+}
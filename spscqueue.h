@@ -0,0 +1,42 @@
+// File: spscqueue.h
+// Description: Bounded lock-free ring buffer for exactly one producer thread and one
+// consumer thread. Used to hand work between the stages of the batch pipeline.
+
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "threadpool.h"
+
+typedef struct
+{
+    // Consumer side: next slot to read.
+    _Alignas(CACHE_LINE_SIZE) atomic_size_t head;
+    // Producer side: next slot to write, plus depth samples taken on every push.
+    _Alignas(CACHE_LINE_SIZE) atomic_size_t tail;
+    uint64_t pushes;
+    uint64_t depthSum;
+    size_t maxDepth;
+    // Shared, read-only after init.
+    _Alignas(CACHE_LINE_SIZE) void **slots;
+    size_t mask; // capacity - 1; capacity is a power of two
+} SpscQueue;
+
+// capacity is rounded up to a power of two. Returns 1 on success, 0 on failure.
+int spscInit(SpscQueue *q, size_t capacity);
+void spscFree(SpscQueue *q);
+
+// Non-blocking: return 0 (push) or NULL (pop) when the ring is full or empty.
+int spscTryPush(SpscQueue *q, void *item);
+void *spscTryPop(SpscQueue *q);
+
+// Blocking: spin briefly, then yield the CPU until there is room or an item.
+void spscPush(SpscQueue *q, void *item);
+void *spscPop(SpscQueue *q);
+
+// Average and peak number of queued items seen by the producer, including the new one.
+double spscAverageDepth(const SpscQueue *q);
+
+#endif // SPSCQUEUE_H
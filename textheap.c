@@ -0,0 +1,69 @@
+#include "textheap.h"
+#include <string.h>
+
+int textHeapOpen(TextHeap *heap, const char *path)
+{
+    heap->size = 0;
+    // "a+" keeps every write at the end of the file, whatever the read position is.
+    heap->file = fopen(path, "a+b");
+    if (!heap->file)
+    {
+        printf("Error: could not open %s\n", path);
+        return 0;
+    }
+    if (fseek(heap->file, 0, SEEK_END) == 0)
+    {
+        long end = ftell(heap->file);
+        if (end > 0)
+            heap->size = (uint64_t)end;
+    }
+    return 1;
+}
+
+void textHeapClose(TextHeap *heap)
+{
+    if (heap->file)
+        fclose(heap->file);
+    heap->file = NULL;
+    heap->size = 0;
+}
+
+int textHeapAppend(TextHeap *heap, const char *text, TextRef *ref)
+{
+    size_t length = text ? strlen(text) : 0;
+    ref->offset = heap->size;
+    ref->length = 0;
+    if (length == 0)
+        return 1;
+    if (!heap->file)
+        return 0;
+
+    // A newline after each entry keeps the file readable with a text viewer;
+    // it is not part of the stored length.
+    if (fwrite(text, 1, length, heap->file) != length || fputc('\n', heap->file) == EOF ||
+        fflush(heap->file) != 0)
+    {
+        return 0;
+    }
+    ref->length = (uint32_t)length;
+    heap->size += length + 1;
+    return 1;
+}
+
+int textHeapRead(TextHeap *heap, TextRef ref, char *buf, size_t size)
+{
+    if (size == 0)
+        return 0;
+    buf[0] = '\0';
+    if (ref.length == 0)
+        return 1;
+    if (!heap->file || ref.offset + ref.length > heap->size)
+        return 0;
+
+    size_t want = ref.length < size - 1 ? ref.length : size - 1;
+    if (fseek(heap->file, (long)ref.offset, SEEK_SET) != 0)
+        return 0;
+    size_t got = fread(buf, 1, want, heap->file);
+    buf[got] = '\0';
+    return got == want;
+}
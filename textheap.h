@@ -0,0 +1,38 @@
+// File: textheap.h
+// Description: An append-only file of variable-length text. Records keep a small
+// TextRef (offset + length) instead of a fixed char buffer and read the text back
+// only when it is actually shown.
+
+#ifndef TEXTHEAP_H
+#define TEXTHEAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Where a piece of text lives in the heap file. length 0 means empty text.
+typedef struct
+{
+    uint64_t offset;
+    uint32_t length;
+} TextRef;
+
+typedef struct
+{
+    FILE *file;
+    uint64_t size; // Bytes in the file; the next append goes here
+} TextHeap;
+
+// Opens (creating if needed) the heap file at path. Returns 1 on success, 0 on failure.
+int textHeapOpen(TextHeap *heap, const char *path);
+void textHeapClose(TextHeap *heap);
+
+// Appends text and fills *ref. Existing text is never overwritten; replacing a
+// record's text appends a new copy. Returns 1 on success, 0 on failure.
+int textHeapAppend(TextHeap *heap, const char *text, TextRef *ref);
+
+// Copies the text for ref into buf (truncated to size - 1) and NUL-terminates it.
+// Returns 1 on success, 0 if the text could not be read (buf is then "").
+int textHeapRead(TextHeap *heap, TextRef ref, char *buf, size_t size);
+
+#endif // TEXTHEAP_H
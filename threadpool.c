@@ -0,0 +1,282 @@
+#include "threadpool.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+typedef struct TaskNode
+{
+    TaskFn fn;
+    void *arg;
+    TaskGroup *group;
+    struct TaskNode *next;
+} Task;
+
+static pthread_mutex_t poolLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t poolWork = PTHREAD_COND_INITIALIZER;
+static pthread_t workers[MAX_POOL_THREADS];
+static int workerCount = 0;
+static int poolStarted = 0;
+static int poolStopping = 0;
+static Task *queueHead = NULL;
+static Task *queueTail = NULL;
+
+static void finishTask(TaskGroup *group)
+{
+    pthread_mutex_lock(&group->lock);
+    if (--group->pending == 0)
+        pthread_cond_broadcast(&group->done);
+    pthread_mutex_unlock(&group->lock);
+}
+
+static void *workerMain(void *unused)
+{
+    (void)unused;
+    for (;;)
+    {
+        pthread_mutex_lock(&poolLock);
+        while (!queueHead && !poolStopping)
+            pthread_cond_wait(&poolWork, &poolLock);
+        if (!queueHead)
+        {
+            pthread_mutex_unlock(&poolLock);
+            return NULL;
+        }
+        Task *t = queueHead;
+        queueHead = t->next;
+        if (!queueHead)
+            queueTail = NULL;
+        pthread_mutex_unlock(&poolLock);
+
+        t->fn(t->arg);
+        finishTask(t->group);
+        free(t);
+    }
+}
+
+// The pool size for 'requested' threads, or for 0: RIDEMATE_THREADS, else one per
+// CPU. Never more than MAX_POOL_THREADS, the size of the workers array.
+static int defaultThreadCount(int requested)
+{
+    int threads = requested;
+    const char *env = getenv("RIDEMATE_THREADS");
+    if (threads <= 0 && env && atoi(env) > 0)
+        threads = atoi(env);
+    if (threads <= 0)
+    {
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = n > 0 ? (int)n : 1;
+    }
+    return threads > MAX_POOL_THREADS ? MAX_POOL_THREADS : threads;
+}
+
+// Must be called with poolLock held.
+static void startWorkersLocked(int threads)
+{
+    if (poolStarted)
+        return;
+    threads = defaultThreadCount(threads);
+
+    poolStopping = 0;
+    workerCount = 0;
+    // The submitting thread always runs one partition itself, so spawn one fewer worker.
+    for (int i = 0; i < threads - 1; i++)
+    {
+        if (pthread_create(&workers[workerCount], NULL, workerMain, NULL) != 0)
+            break;
+        workerCount++;
+    }
+    poolStarted = 1;
+}
+
+void threadPoolInit(int threads)
+{
+    pthread_mutex_lock(&poolLock);
+    startWorkersLocked(threads);
+    pthread_mutex_unlock(&poolLock);
+}
+
+void threadPoolShutdown(void)
+{
+    pthread_mutex_lock(&poolLock);
+    if (!poolStarted)
+    {
+        pthread_mutex_unlock(&poolLock);
+        return;
+    }
+    poolStopping = 1;
+    pthread_cond_broadcast(&poolWork);
+    pthread_mutex_unlock(&poolLock);
+
+    for (int i = 0; i < workerCount; i++)
+        pthread_join(workers[i], NULL);
+
+    pthread_mutex_lock(&poolLock);
+    workerCount = 0;
+    poolStarted = 0;
+    pthread_mutex_unlock(&poolLock);
+}
+
+int threadPoolSize(void)
+{
+    pthread_mutex_lock(&poolLock);
+    startWorkersLocked(0);
+    int n = workerCount + 1;
+    pthread_mutex_unlock(&poolLock);
+    return n;
+}
+
+void taskGroupInit(TaskGroup *group)
+{
+    pthread_mutex_init(&group->lock, NULL);
+    pthread_cond_init(&group->done, NULL);
+    group->pending = 0;
+}
+
+void taskGroupWait(TaskGroup *group)
+{
+    pthread_mutex_lock(&group->lock);
+    while (group->pending > 0)
+        pthread_cond_wait(&group->done, &group->lock);
+    pthread_mutex_unlock(&group->lock);
+}
+
+void taskGroupDestroy(TaskGroup *group)
+{
+    pthread_mutex_destroy(&group->lock);
+    pthread_cond_destroy(&group->done);
+}
+
+void threadPoolSubmit(TaskGroup *group, TaskFn fn, void *arg)
+{
+    pthread_mutex_lock(&group->lock);
+    group->pending++;
+    pthread_mutex_unlock(&group->lock);
+
+    Task *t = (Task *)malloc(sizeof(Task));
+    pthread_mutex_lock(&poolLock);
+    startWorkersLocked(0);
+    if (!t || workerCount == 0)
+    {
+        // No workers (or no memory): run synchronously so the caller still makes progress.
+        pthread_mutex_unlock(&poolLock);
+        free(t);
+        fn(arg);
+        finishTask(group);
+        return;
+    }
+    t->fn = fn;
+    t->arg = arg;
+    t->group = group;
+    t->next = NULL;
+    if (queueTail)
+        queueTail->next = t;
+    else
+        queueHead = t;
+    queueTail = t;
+    pthread_cond_signal(&poolWork);
+    pthread_mutex_unlock(&poolLock);
+}
+
+// --- Partitioned scan ---
+
+typedef struct
+{
+    ScanRangeFn scan;
+    void *ctx;
+    size_t begin;
+    size_t end;
+    void *partial;
+} ScanPartition;
+
+static void runPartition(void *arg)
+{
+    ScanPartition *p = (ScanPartition *)arg;
+    p->scan(p->begin, p->end, p->partial, p->ctx);
+}
+
+static void *allocAligned(size_t size)
+{
+    void *ptr = NULL;
+    if (posix_memalign(&ptr, CACHE_LINE_SIZE, size) != 0)
+        return NULL;
+    return ptr;
+}
+
+void parallelScan(size_t count, size_t partialSize, ScanRangeFn scan, ScanMergeFn merge,
+                  void *total, void *ctx)
+{
+    if (count == 0)
+        return;
+
+    size_t parts = (size_t)threadPoolSize();
+    size_t maxParts = (count + PARALLEL_SCAN_MIN_ITEMS - 1) / PARALLEL_SCAN_MIN_ITEMS;
+    if (parts > maxParts)
+        parts = maxParts;
+
+    // Round each accumulator up to whole cache lines so workers never share a line.
+    size_t stride = (partialSize + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+    if (stride == 0)
+        stride = CACHE_LINE_SIZE;
+    unsigned char *partials = (unsigned char *)allocAligned(stride * parts);
+    ScanPartition *tasks = (ScanPartition *)malloc(parts * sizeof(ScanPartition));
+    if (!partials || !tasks)
+    {
+        free(partials);
+        free(tasks);
+        // Fall back to a single serial pass straight into the total.
+        scan(0, count, total, ctx);
+        return;
+    }
+    memset(partials, 0, stride * parts);
+
+    size_t chunk = count / parts;
+    size_t extra = count % parts;
+    size_t begin = 0;
+    for (size_t i = 0; i < parts; i++)
+    {
+        size_t len = chunk + (i < extra ? 1 : 0);
+        tasks[i].scan = scan;
+        tasks[i].ctx = ctx;
+        tasks[i].begin = begin;
+        tasks[i].end = begin + len;
+        tasks[i].partial = partials + i * stride;
+        begin += len;
+    }
+
+    TaskGroup group;
+    taskGroupInit(&group);
+    for (size_t i = 1; i < parts; i++)
+        threadPoolSubmit(&group, runPartition, &tasks[i]);
+    runPartition(&tasks[0]);
+    taskGroupWait(&group);
+    taskGroupDestroy(&group);
+
+    for (size_t i = 0; i < parts; i++)
+        merge(total, tasks[i].partial, ctx);
+
+    free(tasks);
+    free(partials);
+}
+
+void **listToArray(void *head, size_t nextOffset, size_t *count)
+{
+    size_t n = 0;
+    for (unsigned char *node = (unsigned char *)head; node; node = *(unsigned char **)(node + nextOffset))
+        n++;
+
+    *count = n;
+    if (n == 0)
+        return NULL;
+
+    void **items = (void **)malloc(n * sizeof(void *));
+    if (!items)
+    {
+        *count = 0;
+        return NULL;
+    }
+    size_t i = 0;
+    for (unsigned char *node = (unsigned char *)head; node; node = *(unsigned char **)(node + nextOffset))
+        items[i++] = node;
+    return items;
+}
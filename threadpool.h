@@ -0,0 +1,56 @@
+// File: threadpool.h
+// Description: A small fixed-size worker pool and a partitioned-scan helper
+// used by the report and statistics modules to aggregate large lists in parallel.
+
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <stddef.h>
+#include <pthread.h>
+
+#define CACHE_LINE_SIZE 64
+#define MAX_POOL_THREADS 16
+
+// Scans smaller than this run inline on the calling thread.
+#define PARALLEL_SCAN_MIN_ITEMS 4096
+
+// --- Task Group ---
+// Tracks a batch of submitted tasks so the submitter can wait for all of them.
+typedef struct
+{
+    pthread_mutex_t lock;
+    pthread_cond_t done;
+    int pending;
+} TaskGroup;
+
+typedef void (*TaskFn)(void *arg);
+
+// Called once per partition with the half-open index range [begin, end).
+// 'partial' is a zeroed, cache-line aligned accumulator owned by that partition.
+typedef void (*ScanRangeFn)(size_t begin, size_t end, void *partial, void *ctx);
+
+// Folds one partition's accumulator into the caller's total.
+typedef void (*ScanMergeFn)(void *total, const void *partial, void *ctx);
+
+// Pool lifecycle. The pool starts lazily on first use with one thread per CPU, or
+// RIDEMATE_THREADS; either way it is capped at MAX_POOL_THREADS.
+void threadPoolInit(int threads);
+void threadPoolShutdown(void);
+int threadPoolSize(void);
+
+// Task submission
+void taskGroupInit(TaskGroup *group);
+void taskGroupWait(TaskGroup *group);
+void taskGroupDestroy(TaskGroup *group);
+void threadPoolSubmit(TaskGroup *group, TaskFn fn, void *arg);
+
+// Splits [0, count) into one partition per worker, runs 'scan' on each with its
+// own padded accumulator of 'partialSize' bytes, then merges them into 'total' in order.
+void parallelScan(size_t count, size_t partialSize, ScanRangeFn scan, ScanMergeFn merge,
+                  void *total, void *ctx);
+
+// Copies the nodes of any singly linked list into an array so it can be partitioned.
+// 'nextOffset' is offsetof(Node, next). Returns NULL (and *count = 0) for an empty list.
+void **listToArray(void *head, size_t nextOffset, size_t *count);
+
+#endif // THREADPOOL_H
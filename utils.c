@@ -5,6 +5,17 @@
 #include <ctype.h>
 #include <time.h>
 
+// Once stdin has hit end-of-file every further read fails the same way, so the
+// retry loops below would spin forever. Give up instead.
+static void inputClosed(void)
+{
+    if (feof(stdin))
+    {
+        printf("\nEnd of input, exiting.\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
 void getStringInput(const char *prompt, char *buffer, int size)
 {
     printf("%s", prompt);
@@ -25,6 +36,7 @@ int getIntegerInput(const char *prompt, int min, int max)
         printf("%s", prompt);
         fflush(stdout);
         if (fgets(buffer, sizeof(buffer), stdin) == NULL) {
+            inputClosed();
             printf("Error reading input. Please try again.\n");
             continue;
         }
@@ -45,6 +57,7 @@ float getFloatInput(const char *prompt, float min, float max)
         printf("%s", prompt);
         fflush(stdout);
         if (fgets(buffer, sizeof(buffer), stdin) == NULL) {
+            inputClosed();
             printf("Error reading input. Please try again.\n");
             continue;
         }
@@ -56,6 +69,36 @@ float getFloatInput(const char *prompt, float min, float max)
     }
 }
 
+int64_t getHundredthsInput(const char *prompt, int64_t min, int64_t max)
+{
+    char buffer[100];
+    int64_t value;
+    char minStr[MONEY_STR_SIZE], maxStr[MONEY_STR_SIZE];
+    formatMoney(min, minStr, sizeof(minStr));
+    formatMoney(max, maxStr, sizeof(maxStr));
+    while (1)
+    {
+        printf("%s", prompt);
+        fflush(stdout);
+        if (fgets(buffer, sizeof(buffer), stdin) == NULL) {
+            inputClosed();
+            printf("Error reading input. Please try again.\n");
+            continue;
+        }
+        buffer[strcspn(buffer, "\n")] = 0;
+        if (parseHundredths(buffer, &value) && value >= min && value <= max)
+        {
+            return value;
+        }
+        printf("Invalid input. Please enter a number between %s and %s.\n", minStr, maxStr);
+    }
+}
+
+Money getMoneyInput(const char *prompt, Money min, Money max)
+{
+    return getHundredthsInput(prompt, min, max);
+}
+
 void pressEnterToContinue()
 {
     printf("\nPress Enter to continue...");
@@ -150,12 +193,6 @@ int authenticateAdmin(const char *username, const char *password)
     return (strcmp(username, "admin") == 0 && strcmp(password, "admin123") == 0);
 }
 
-int generateUniqueId(void)
-{
-    static int id = 1000;
-    return ++id;
-}
-
 void getInput(const char *prompt, char *buffer, int size)
 {
     printf("%s", prompt);
@@ -176,18 +213,52 @@ int isValidNumber(const char *str)
     return 1;
 }
 
+static DataFileSource dataFileSource;
+
+FILE *openDataFile(const char *path)
+{
+    return dataFileSource ? dataFileSource(path) : fopen(path, "r");
+}
+
+void setDataFileSource(DataFileSource source)
+{
+    dataFileSource = source;
+}
+
+int dataFileSourceSet(void)
+{
+    return dataFileSource != NULL;
+}
+
+int splitCsvLine(char *line, char **fields, int maxFields)
+{
+    int count = 0;
+    char *cursor = line;
+    while (count < maxFields)
+    {
+        fields[count++] = cursor;
+        char *comma = strchr(cursor, ',');
+        if (!comma)
+            break;
+        *comma = '\0';
+        cursor = comma + 1;
+    }
+    return count;
+}
+
 int stringToTime(const char *dateStr, time_t *outTime)
 {
     struct tm tm = {0};
-    int hour = 0, minute = 0;
+    int hour = 0, minute = 0, second = 0;
     
-    // Try datetime format first: "YYYY-MM-DD HH:MM"
-    if (sscanf(dateStr, "%d-%d-%d %d:%d", &tm.tm_year, &tm.tm_mon, &tm.tm_mday, &hour, &minute) >= 3)
+    // Try datetime format first: "YYYY-MM-DD HH:MM", optionally with ":SS"
+    if (sscanf(dateStr, "%d-%d-%d %d:%d:%d", &tm.tm_year, &tm.tm_mon, &tm.tm_mday, &hour, &minute, &second) >= 3)
     {
         tm.tm_year -= 1900;
         tm.tm_mon -= 1;
         tm.tm_hour = hour;
         tm.tm_min = minute;
+        tm.tm_sec = second;
         *outTime = mktime(&tm);
         return (*outTime != -1);
     }
@@ -202,4 +273,35 @@ int stringToTime(const char *dateStr, time_t *outTime)
     }
     
     return 0;
+}
+
+void monthStartsOfYear(int year, time_t starts[13])
+{
+    for (int m = 0; m <= 12; m++)
+    {
+        struct tm tm = {0};
+        tm.tm_year = year - 1900 + m / 12;
+        tm.tm_mon = m % 12;
+        tm.tm_mday = 1;
+        starts[m] = mktime(&tm);
+    }
+}
+
+int monthIndexOf(const time_t starts[13], time_t t)
+{
+    if (t < starts[0] || t >= starts[12])
+        return -1;
+    int m = 0;
+    while (t >= starts[m + 1])
+        m++;
+    return m;
+}
+
+int localTimeSafe(time_t t, struct tm *out)
+{
+#ifdef _WIN32
+    return localtime_s(out, &t) == 0;
+#else
+    return localtime_r(&t, out) != NULL;
+#endif
 }
\ No newline at end of file
@@ -1,13 +1,18 @@
 #ifndef UTILS_H
 #define UTILS_H
 
+#include <stdio.h>
 #include <time.h>
+#include "money.h"
 
 #define MAX_STRING 50
 
 void getStringInput(const char *prompt, char *buffer, int size);
 int getIntegerInput(const char *prompt, int min, int max);
 float getFloatInput(const char *prompt, float min, float max);
+// Reads a decimal with up to two fractional digits as hundredths (money in cents, percent in bps).
+int64_t getHundredthsInput(const char *prompt, int64_t min, int64_t max);
+Money getMoneyInput(const char *prompt, Money min, Money max);
 void pressEnterToContinue();
 void clearScreen();
 void clearInputBuffer();
@@ -18,11 +23,33 @@ unsigned long hash_string(const char *str);
 void hash_to_string(unsigned long hash, char *hash_str, size_t size);
 void hash_password(const char *password, char *hashed_password, size_t size);
 int authenticateAdmin(const char *username, const char *password);
-int generateUniqueId(void);
 void getInput(const char *prompt, char *buffer, int size);
 int isValidNumber(const char *str);
 
-// Converts a "YYYY-MM-DD" string to a time_t value. Returns 1 on success, 0 on failure.
+// Splits a CSV line in place on commas, keeping empty fields. Returns the number of fields.
+int splitCsvLine(char *line, char **fields, int maxFields);
+
+// Opens a data file for a loader to read. That is fopen(path, "r") unless a source
+// was set with setDataFileSource, e.g. while a backup is loaded straight into memory.
+FILE *openDataFile(const char *path);
+typedef FILE *(*DataFileSource)(const char *path);
+// NULL goes back to reading the data files.
+void setDataFileSource(DataFileSource source);
+// 1 while a source is set, i.e. openDataFile is not reading the data files.
+int dataFileSourceSet(void);
+
+// Converts a "YYYY-MM-DD", "YYYY-MM-DD HH:MM" or "YYYY-MM-DD HH:MM:SS" string to a
+// time_t value. Returns 1 on success, 0 on failure.
 int stringToTime(const char *dateStr, time_t *outTime);
 
+// Thread-safe replacement for localtime(). Fills *out and returns 1 on success, 0 on failure.
+int localTimeSafe(time_t t, struct tm *out);
+
+// Fills starts[0..12] with the first instant of each month of 'year' (starts[12] is
+// January 1st of the next year), using the same local-time rules as stringToTime.
+void monthStartsOfYear(int year, time_t starts[13]);
+
+// Month index (0-11) of t within the year described by starts, or -1 if outside it.
+int monthIndexOf(const time_t starts[13], time_t t);
+
 #endif // UTILS_H
\ No newline at end of file
@@ -1,8 +1,14 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
 #include "utils.h"
+#include "snapshot.h"
+#include "asyncio.h"
+#include "idalloc.h"
+#include "dirty.h"
 #include "vehicle.h"
+#include "lazyload.h"
 #include "rental.h"
 
 #define VEHICLE_FILE "data/vehicles.csv"
@@ -10,8 +16,6 @@
 
 extern Route *routeHead;
 
-static int nextVehicleId = 2001;
-static int nextRouteId = 3001;
 
 static void displayStarRating(float rating);
 
@@ -36,34 +40,17 @@ static void ensureCsvWithHeader(const char *path, const char *headerLine)
     printf("Created new CSV file: %s\n", path);
 }
 
-static void adjustVehicleNextId(Vehicle *head)
-{
-    int maxId = 2000;
-    for (Vehicle *v = head; v; v = v->next)
-        if (v->id > maxId)
-            maxId = v->id;
-    nextVehicleId = maxId + 1;
-}
-
-static void adjustRouteNextId(Route *head)
-{
-    int maxId = 3000;
-    for (Route *r = head; r; r = r->next)
-        if (r->id > maxId)
-            maxId = r->id;
-    nextRouteId = maxId + 1;
-}
-
 static Vehicle *parseVehicleCSV(char *line)
 {
     Vehicle *v = (Vehicle *)malloc(sizeof(Vehicle));
     if (!v)
         return NULL;
     
-    int result = sscanf(line, "%d,%49[^,],%49[^,],%d,%d,%f,%f,%d,%d,%d,%f",
-           &v->id, v->make, v->model, &v->year, (int *)&v->type, &v->ratePerDay, &v->ratePerHour, &v->active, &v->available, &v->ratingCount, &v->averageRating);
+    char rateDay[MONEY_STR_SIZE], rateHour[MONEY_STR_SIZE];
+    int result = sscanf(line, "%d,%49[^,],%49[^,],%d,%d,%23[^,],%23[^,],%d,%d,%d,%f",
+           &v->id, v->make, v->model, &v->year, (int *)&v->type, rateDay, rateHour, &v->active, &v->available, &v->ratingCount, &v->averageRating);
     
-    if (result != 11) {
+    if (result != 11 || !parseMoney(rateDay, &v->ratePerDay) || !parseMoney(rateHour, &v->ratePerHour)) {
         printf("Warning: Failed to parse vehicle line: %s (parsed %d fields)\n", line, result);
         free(v);
         return NULL;
@@ -78,8 +65,11 @@ static Route *parseRouteCSV(char *line)
     Route *r = (Route *)malloc(sizeof(Route));
     if (!r)
         return NULL;
-    sscanf(line, "%d,%49[^,],%49[^,],%49[^,],%f,%d,%d",
-           &r->id, r->name, r->from, r->to, &r->baseFare, &r->etaMin, &r->active);
+    char fare[MONEY_STR_SIZE] = "0";
+    sscanf(line, "%d,%49[^,],%49[^,],%49[^,],%23[^,],%d,%d",
+           &r->id, r->name, r->from, r->to, fare, &r->etaMin, &r->active);
+    if (!parseMoney(fare, &r->baseFare))
+        r->baseFare = 0;
     r->next = NULL;
     return r;
 }
@@ -87,7 +77,7 @@ static Route *parseRouteCSV(char *line)
 void loadVehicles(Vehicle **head)
 {
     ensureCsvWithHeader(VEHICLE_FILE, "id,make,model,year,type,ratePerDay,ratePerHour,active,available,ratingCount,averageRating\n");
-    FILE *f = fopen(VEHICLE_FILE, "r");
+    FILE *f = openDataFile(VEHICLE_FILE);
     if (!f)
     {
         printf("Warning: Could not open %s for reading\n", VEHICLE_FILE);
@@ -106,21 +96,28 @@ void loadVehicles(Vehicle **head)
         {
             v->next = *head;
             *head = v;
+            observeId(ID_VEHICLE, v->id);
             count++;
         }
     }
     fclose(f);
-    adjustVehicleNextId(*head);
+    markClean(DIRTY_VEHICLES);
     printf("Loaded %d vehicles from %s\n", count, VEHICLE_FILE);
 }
 
 void saveVehicles(Vehicle *head)
 {
-    FILE *f = fopen(VEHICLE_FILE, "w");
+    waitBackgroundSave();
+    size_t added;
+    if (beginTableSave(DIRTY_VEHICLES, &added) == SAVE_SKIP)
+        return;
+    AsyncFile out;
+    FILE *f = asyncFileOpen(&out, VEHICLE_FILE);
     if (!f)
     {
         printf("Error: Could not open file %s for writing\n", VEHICLE_FILE);
         perror("File error");
+        endTableSave(DIRTY_VEHICLES, SAVE_REWRITE, -1);
         return;
     }
     
@@ -128,20 +125,21 @@ void saveVehicles(Vehicle *head)
     int count = 0;
     for (Vehicle *v = head; v; v = v->next)
     {
-        fprintf(f, "%d,%s,%s,%d,%d,%.2f,%.2f,%d,%d,%d,%.2f\n", 
+        fprintf(f, "%d,%s,%s,%d,%d," MONEY_FMT "," MONEY_FMT ",%d,%d,%d,%.2f\n", 
                 v->id, v->make, v->model, v->year, v->type, 
-                v->ratePerDay, v->ratePerHour, v->active, v->available, 
+                MONEY_ARGS(v->ratePerDay), MONEY_ARGS(v->ratePerHour), v->active, v->available, 
                 v->ratingCount, v->averageRating);
         count++;
     }
-    fclose(f);
+    long result = asyncFileClose(&out);
+    endTableSave(DIRTY_VEHICLES, SAVE_REWRITE, result < 0 ? -1 : (long)out.length);
     printf("Successfully saved %d vehicles to %s\n", count, VEHICLE_FILE);
 }
 
 void loadRoutes(Route **head)
 {
     ensureCsvWithHeader(ROUTE_FILE, "id,name,from,to,baseFare,etaMin,active\n");
-    FILE *f = fopen(ROUTE_FILE, "r");
+    FILE *f = openDataFile(ROUTE_FILE);
     if (!f)
     {
         *head = NULL;
@@ -157,25 +155,35 @@ void loadRoutes(Route **head)
         {
             r->next = *head;
             *head = r;
+            observeId(ID_ROUTE, r->id);
         }
     }
     fclose(f);
+    markClean(DIRTY_ROUTES);
     routeHead = *head;
-    adjustRouteNextId(*head);
 }
 
 void saveRoutes(Route *head)
 {
-    FILE *f = fopen(ROUTE_FILE, "w");
+    routeHead = head;
+    waitBackgroundSave();
+    size_t added;
+    if (beginTableSave(DIRTY_ROUTES, &added) == SAVE_SKIP)
+        return;
+    AsyncFile out;
+    FILE *f = asyncFileOpen(&out, ROUTE_FILE);
     if (!f)
+    {
+        endTableSave(DIRTY_ROUTES, SAVE_REWRITE, -1);
         return;
+    }
     fprintf(f, "id,name,from,to,baseFare,etaMin,active\n");
     for (Route *r = head; r; r = r->next)
     {
-        fprintf(f, "%d,%s,%s,%s,%.2f,%d,%d\n", r->id, r->name, r->from, r->to, r->baseFare, r->etaMin, r->active);
+        fprintf(f, "%d,%s,%s,%s," MONEY_FMT ",%d,%d\n", r->id, r->name, r->from, r->to, MONEY_ARGS(r->baseFare), r->etaMin, r->active);
     }
-    fclose(f);
-    routeHead = head;
+    long result = asyncFileClose(&out);
+    endTableSave(DIRTY_ROUTES, SAVE_REWRITE, result < 0 ? -1 : (long)out.length);
 }
 
 Vehicle *findVehicleById(Vehicle *head, int id)
@@ -215,8 +223,8 @@ void displayVehicle(const Vehicle *v)
 {
     if (!v)
         return;
-    printf("ID: %-5d | %s %s (%d) | Type: %-10s | Rate: $%.2f/day, $%.2f/hr | Status: %s | Rating: ",
-           v->id, v->make, v->model, v->year, vehicleTypeStr(v->type), v->ratePerDay, v->ratePerHour,
+    printf("ID: %-5d | %s %s (%d) | Type: %-10s | Rate: $" MONEY_FMT "/day, $" MONEY_FMT "/hr | Status: %s | Rating: ",
+           v->id, v->make, v->model, v->year, vehicleTypeStr(v->type), MONEY_ARGS(v->ratePerDay), MONEY_ARGS(v->ratePerHour),
            v->available ? "Available" : "Rented");
 
     if (v->ratingCount > 0)
@@ -254,7 +262,7 @@ void displayAvailableVehicles(Vehicle *head)
         printf("No vehicles are currently available.\n");
 }
 
-void displayVehicleAvailabilitySchedule(Vehicle *head, Rental *rentalHead)
+void displayVehicleAvailabilitySchedule(Vehicle *head, const RentalTable *rentals)
 {
     printf("\n--- Vehicle Availability Schedule ---\n");
     int found = 0;
@@ -268,12 +276,14 @@ void displayVehicleAvailabilitySchedule(Vehicle *head, Rental *rentalHead)
             
             // Show current rental if any
             int hasActiveRental = 0;
-            for (Rental *r = rentalHead; r; r = r->next)
+            for (size_t i = 0; i < rentals->count; i++)
             {
+                const Rental *r = &rentals->rows[i];
                 if (r->vehicleId == v->id && r->status == RENT_ACTIVE)
                 {
+                    const RentalDetail *d = &rentals->details[i];
                     printf("  Current Rental: ID %d (Customer %d) - %s to %s\n", 
-                           r->id, r->customerId, r->startTime, r->endTime);
+                           r->id, r->customerId, d->startTime, d->endTime);
                     hasActiveRental = 1;
                     break;
                 }
@@ -300,7 +310,7 @@ void displayAllRoutes(Route *head)
     {
         if (r->active)
         {
-            printf("ID: %-5d | %s (%s -> %s) | Fare: $%.2f\n", r->id, r->name, r->from, r->to, r->baseFare);
+            printf("ID: %-5d | %s (%s -> %s) | Fare: $" MONEY_FMT "\n", r->id, r->name, r->from, r->to, MONEY_ARGS(r->baseFare));
             found = 1;
         }
     }
@@ -316,6 +326,7 @@ void addVehicleRating(Vehicle *v, int rating)
     float totalRating = v->averageRating * v->ratingCount + rating;
     v->ratingCount++;
     v->averageRating = totalRating / v->ratingCount;
+    markDirty(DIRTY_VEHICLES);
 }
 
 static void displayStarRating(float rating)
@@ -339,20 +350,21 @@ static void addVehicleInteractive(Vehicle **head)
         return;
     }
     
-    v->id = nextVehicleId++;
+    v->id = allocateId(ID_VEHICLE);
     getStringInput("Enter Brand Name: ", v->make, MAX_STRING);
     getStringInput("Enter Model: ", v->model, MAX_STRING);
     v->year = getIntegerInput("Enter Year: ", 2000, 2025);
     printf("Types: 0=Car, 1=Motorcycle, 2=Truck, 3=Van\n");
     v->type = (VehicleType)getIntegerInput("Enter Type: ", 0, 3);
-    v->ratePerDay = getFloatInput("Enter Rate per Day: ", 1.0, 500000.0);
-    v->ratePerHour = getFloatInput("Enter Rate per Hour: ", 1.0, 5000.0);
+    v->ratePerDay = getMoneyInput("Enter Rate per Day: ", moneyFromUnits(1), moneyFromUnits(500000));
+    v->ratePerHour = getMoneyInput("Enter Rate per Hour: ", moneyFromUnits(1), moneyFromUnits(5000));
     v->available = 1;
     v->active = 1;
     v->ratingCount = 0;
     v->averageRating = 0.0;
     v->next = *head;
     *head = v;
+    markDirty(DIRTY_VEHICLES);
     
     printf("Adding vehicle to memory: ID=%d, Make=%s, Model=%s\n", v->id, v->make, v->model);
     saveVehicles(*head);
@@ -370,9 +382,10 @@ static void updateVehicleInteractive(Vehicle *head)
     }
 
     printf("Editing Vehicle #%d: %s %s\n", v->id, v->make, v->model);
-    v->ratePerDay = getFloatInput("Enter new Rate per Day: ", 1.0, 20000.0);
-    v->ratePerHour = getFloatInput("Enter new Rate per Hour: ", 1.0, 1000.0);
+    v->ratePerDay = getMoneyInput("Enter new Rate per Day: ", moneyFromUnits(1), moneyFromUnits(20000));
+    v->ratePerHour = getMoneyInput("Enter new Rate per Hour: ", moneyFromUnits(1), moneyFromUnits(1000));
     v->available = getIntegerInput("Is it available? (1=Yes, 0=No): ", 0, 1);
+    markDirty(DIRTY_VEHICLES);
 
     saveVehicles(head);
     printf("Vehicle updated successfully.\n");
@@ -389,6 +402,7 @@ static void softDeleteVehicleInteractive(Vehicle *head)
     }
 
     v->active = !v->active;
+    markDirty(DIRTY_VEHICLES);
     saveVehicles(head);
     printf("Vehicle #%d is now %s.\n", v->id, v->active ? "Active" : "Inactive");
 }
@@ -396,15 +410,16 @@ static void softDeleteVehicleInteractive(Vehicle *head)
 static void addRouteInteractive(Route **head)
 {
     Route *r = (Route *)malloc(sizeof(Route));
-    r->id = nextRouteId++;
+    r->id = allocateId(ID_ROUTE);
     getStringInput("Enter Route Name: ", r->name, MAX_STRING);
     getStringInput("From: ", r->from, MAX_STRING);
     getStringInput("To: ", r->to, MAX_STRING);
-    r->baseFare = getFloatInput("Base Fare: ", 1.0, 10000.0);
+    r->baseFare = getMoneyInput("Base Fare: ", moneyFromUnits(1), moneyFromUnits(10000));
     r->etaMin = getIntegerInput("Estimated Time (Minutes): ", 5, 1440);
     r->active = 1;
     r->next = *head;
     *head = r;
+    markDirty(DIRTY_ROUTES);
     saveRoutes(*head);
     printf("Route #%d added successfully.\n", r->id);
 }
@@ -437,7 +452,7 @@ static void adminRouteMenu(Route **head)
     }
 }
 
-void adminVehicleMenu(Vehicle **head, Rental *rentalHead)
+void adminVehicleMenu(Vehicle **head, RentalTable *rentals)
 {
     int running = 1;
     while (running)
@@ -468,7 +483,7 @@ void adminVehicleMenu(Vehicle **head, Rental *rentalHead)
             softDeleteVehicleInteractive(*head);
             break;
         case 5:
-            adminRouteMenu(&routeHead);
+            adminRouteMenu(loadedRoutes());
             break;
         case 6:
         {
@@ -478,7 +493,7 @@ void adminVehicleMenu(Vehicle **head, Rental *rentalHead)
             break;
         }
         case 7:
-            displayVehicleAvailabilitySchedule(*head, rentalHead);
+            displayVehicleAvailabilitySchedule(*head, rentals);
             pressEnterToContinue();
             break;
         case 8:
@@ -505,14 +520,20 @@ void freeVehicleList(Vehicle **head)
     *head = NULL;
 }
 
+// Rentals of the same vehicle can be rated concurrently.
+static pthread_mutex_t ratingLock = PTHREAD_MUTEX_INITIALIZER;
+
 void updateVehicleRating(Vehicle *head, int vehicleId, int newRating)
 {
     Vehicle *v = findVehicleById(head, vehicleId);
     if (v && newRating >= 1 && newRating <= 5)
     {
+        pthread_mutex_lock(&ratingLock);
         float totalRating = v->averageRating * v->ratingCount;
         v->ratingCount++;
         v->averageRating = (totalRating + newRating) / v->ratingCount;
+        pthread_mutex_unlock(&ratingLock);
+        markDirty(DIRTY_VEHICLES);
     }
 }
 
@@ -3,8 +3,8 @@
 
 #include "utils.h"
 
-// Forward declaration for Rental type
-typedef struct RentalNode Rental;
+// Forward declaration for the rental table
+typedef struct RentalTable RentalTable;
 
 typedef enum
 {
@@ -20,7 +20,7 @@ typedef struct RouteNode
     char name[MAX_STRING];
     char from[MAX_STRING];
     char to[MAX_STRING];
-    float baseFare;
+    Money baseFare;
     int etaMin;
     int active;
     struct RouteNode *next;
@@ -33,8 +33,8 @@ typedef struct VehicleNode
     char model[MAX_STRING];
     int year;
     VehicleType type;
-    float ratePerHour;
-    float ratePerDay;
+    Money ratePerHour;
+    Money ratePerDay;
     int available;
     int active;
     int ratingCount;     // Number of ratings received
@@ -47,11 +47,11 @@ void freeVehicleList(Vehicle **head);
 void loadRoutes(Route **head);
 void saveRoutes(Route *head);
 void freeRouteList(Route **head);
-void adminVehicleMenu(Vehicle **head, Rental *rentalHead);
+void adminVehicleMenu(Vehicle **head, RentalTable *rentals);
 void displayVehicle(const Vehicle *v);
 void listAllVehicles(Vehicle *head);
 void displayAvailableVehicles(Vehicle *head);
-void displayVehicleAvailabilitySchedule(Vehicle *head, Rental *rentalHead);
+void displayVehicleAvailabilitySchedule(Vehicle *head, const RentalTable *rentals);
 Vehicle *findVehicleById(Vehicle *head, int id);
 const char *vehicleTypeStr(VehicleType t);
 void displayAllRoutes(Route *head);